@@ -888,9 +888,11 @@ bool ACrab::IsWithinRange(Vector &point) const
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  Look
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Casts an unseen-revealing ray in the direction of where this is facing.
+// Description:     Casts a fan of unseen-revealing rays in the direction of where this is
+//                  facing.
 // Arguments:       The degree angle to deviate from the current view point in the ray
-//                  casting. A random ray will be chosen out of this +-range.
+//                  casting. The fan spans this many degrees, and is centered randomly
+//                  within this +-range.
 
 bool ACrab::Look(float FOVSpread, float range)
 {
@@ -920,13 +922,12 @@ bool ACrab::Look(float FOVSpread, float range)
     aimMatrix.SetXFlipped(m_HFlipped);
     lookVector *= aimMatrix;
     // Add the spread
-    lookVector.DegRotate(FOVSpread * NormalRand());
+    lookVector.DegRotate(FOVSpread * 0.5 * NormalRand());
 
     // TODO: generate an alarm event if we spot an enemy actor?
 
-    Vector ignored;
-    // Cast the seeing ray, adjusting the skip to match the resolution of the unseen map
-    return g_SceneMan.CastSeeRay(m_Team, aimPos, lookVector, ignored, 25, (int)g_SceneMan.GetUnseenResolution(m_Team).GetSmallest() / 2);
+    // Cast a fan of seeing rays, adjusting the skip to match the resolution of the unseen map
+    return g_SceneMan.CastSeeRayFan(m_Team, aimPos, lookVector, FOVSpread, LOOKFANRAYS, 25, (int)g_SceneMan.GetUnseenResolution(m_Team).GetSmallest() / 2) > 0;
 }
 
 
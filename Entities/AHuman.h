@@ -758,10 +758,12 @@ ENTITYALLOCATION(AHuman)
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  Look
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Casts an unseen-revealing ray in the direction of where this is facing.
+// Description:     Casts a fan of unseen-revealing rays in the direction of where this is
+//                  facing.
 // Arguments:       The degree angle to deviate from the current view point in the ray
-//                  casting. A random ray will be chosen out of this +-range.
-//                  The range, in pixels, beyond the actors sharp aim that the ray will have.
+//                  casting. The fan spans this many degrees, and is centered randomly
+//                  within this +-range.
+//                  The range, in pixels, beyond the actors sharp aim that the rays will have.
 // Return value:    Whether any unseen pixels were revealed by this look.
 
     virtual bool Look(float FOVSpread, float range);
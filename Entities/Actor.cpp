@@ -687,7 +687,8 @@ Controller::InputMode Actor::SwapControllerModes(Controller::InputMode newMode,
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  Look
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Casts an unseen-revealing ray in the direction of where this is facing.
+// Description:     Casts a fan of unseen-revealing rays in the direction of where this is
+//                  facing.
 
 bool Actor::Look(float FOVSpread, float range)
 {
@@ -722,11 +723,11 @@ bool Actor::Look(float FOVSpread, float range)
         // Set the distance in the look direction
         lookVector.SetMagnitude(range);
         // Add the spread from the directed look
-        lookVector.DegRotate(FOVSpread * NormalRand());
+        lookVector.DegRotate(FOVSpread * 0.5 * NormalRand());
     }
 
-	Vector ignored;
-    return g_SceneMan.CastSeeRay(m_Team, aimPos, lookVector, ignored, 25, g_SceneMan.GetUnseenResolution(m_Team).GetSmallest() / 2);
+    // Cast a whole fan of rays at once, which is cheaper per ray than casting them one by one
+    return g_SceneMan.CastSeeRayFan(m_Team, aimPos, lookVector, FOVSpread, LOOKFANRAYS, 25, g_SceneMan.GetUnseenResolution(m_Team).GetSmallest() / 2) > 0;
 }
 
 
@@ -1010,7 +1011,7 @@ void Actor::GibThis(Vector impactImpulse, float internalBlast, MovableObject *pI
 	// If we have enough crabs - gib everything
 	if (crabs > 10 && g_MovableMan.GetMOIDCount() + crabs * 5 > 255)
 	{
-		for (int id = 1; id < g_MovableMan.GetMOIDCount() - 1; id++)
+		for (int id = 1; id < g_MovableMan.GetMOIDIndexSize() - 1; id++)
 		{
 			MovableObject * MO = g_MovableMan.GetMOFromID(id);
 			MOSRotating * MOSR = dynamic_cast<MOSRotating *>(MO);
@@ -1316,6 +1317,10 @@ bool Actor::UpdateAIScripted()
     if (!m_ScriptedAIUpdate || m_ScriptPath.empty() || m_ScriptPresetName.empty())
         return false;
 
+    // Parallel scripts can't run in the master state, so fall back to the hardcoded AI
+    if (IsScriptParallel())
+        return false;
+
     int error = 0;
 
     // Check to make sure the preset of this is still defined in the Lua state. If not, re-create it and recover gracefully
@@ -1323,26 +1328,23 @@ bool Actor::UpdateAIScripted()
         ReloadScripts();
 
     // First see if we even have a representation stored in the Lua state, and if not, create one
-    if (m_ScriptObjectName.empty())
+    if (m_ScriptObjectRef == NO_LUA_OBJECT_REF)
     {
-        // Get the unique object identifier for this object and construct the object isntance name in Lua that points to this object so we can pass it into the preset functions
-        m_ScriptObjectName = GetClassName() + "s." + g_LuaMan.GetNewObjectID();
-
         // Give access to this in the Lua state
         g_MovableMan.SetScriptedEntity(this);
-        // Create the Lua variable which will hold the object instance of this instance for as long as it exists
-        if ((error = g_LuaMan.RunScriptString(m_ScriptObjectName + " = To" + GetClassName() + "(MovableMan.ScriptedEntity);")) < 0)
+        // Create the Lua object instance of this, which LuaMan holds on to for as long as this exists so we can pass it into the preset functions
+        if ((m_ScriptObjectRef = g_LuaMan.CreateObjectReference(GetClassName())) == NO_LUA_OBJECT_REF)
             return false;
 
-        // Call the scripted creation function, but only after first checking if it and this instance's Lua representation really exists
-        if ((error = g_LuaMan.RunScriptString("if " + m_ScriptPresetName + ".Create and " + m_ScriptObjectName + " then " + m_ScriptPresetName + ".Create(" + m_ScriptObjectName + "); end")) < 0)
+        // Call the scripted creation function, if it's defined
+        if ((error = g_LuaMan.RunObjectFunction(m_ScriptPresetName, "Create", m_ScriptObjectRef)) < 0)
             return false;
     }
 
-    // Call the defined function, but only after first checking if it and this instance's Lua representation exists
+    // Call the defined function, if it's defined
 
 	g_FrameMan.StartPerformanceMeasurement(FrameMan::PERF_ACTORS_AI);
-	error = g_LuaMan.RunScriptString("if " + m_ScriptPresetName + ".UpdateAI and " + m_ScriptObjectName + " then " + m_ScriptPresetName + ".UpdateAI(" + m_ScriptObjectName + "); end");
+	error = g_LuaMan.RunObjectFunction(m_ScriptPresetName, "UpdateAI", m_ScriptObjectRef);
 	g_FrameMan.StopPerformanceMeasurement(FrameMan::PERF_ACTORS_AI);
 
     if (error < 0)
@@ -1460,7 +1462,7 @@ void Actor::VerifyMOIDs()
 
 	for (std::vector<MOID>::iterator it = MOIDs.begin(); it != MOIDs.end(); it++)
 	{
-		DAssert(*it == g_NoMOID || *it < g_MovableMan.GetMOIDCount(), "Invalid MOID in actor");
+		DAssert(*it == g_NoMOID || *it < g_MovableMan.GetMOIDIndexSize(), "Invalid MOID in actor");
 	}
 }
 
@@ -2059,21 +2061,21 @@ void Actor::DrawHUD(BITMAP *pTargetBitmap, const Vector &targetPos, int whichScr
 
         Actor *pPrevAdj = 0;
         Actor *pNextAdj = 0;
-        list<Actor *> *pRoster = g_MovableMan.GetTeamRoster(m_Team);
+        vector<Actor *> *pRoster = g_MovableMan.GetTeamRoster(m_Team);
 
         if (pRoster->size() > 1)
         {
             // Find this in the list, both ways
-            list<Actor *>::reverse_iterator selfRItr = find(pRoster->rbegin(), pRoster->rend(), this);
+            vector<Actor *>::reverse_iterator selfRItr = find(pRoster->rbegin(), pRoster->rend(), this);
             DAssert(selfRItr != pRoster->rend(), "Actor couldn't find self in Team roster!");
-            list<Actor *>::iterator selfItr = find(pRoster->begin(), pRoster->end(), this);
+            vector<Actor *>::iterator selfItr = find(pRoster->begin(), pRoster->end(), this);
             DAssert(selfItr != pRoster->end(), "Actor couldn't find self in Team roster!");
             
             // Find the adjacent actors
             if (selfItr != pRoster->end())
             {
                 // Get the previous available actor in the list (not controlled by another player)
-                list<Actor *>::reverse_iterator prevItr = selfRItr;
+                vector<Actor *>::reverse_iterator prevItr = selfRItr;
                 do
                 {
                     if (++prevItr == pRoster->rend())
@@ -2085,7 +2087,7 @@ void Actor::DrawHUD(BITMAP *pTargetBitmap, const Vector &targetPos, int whichScr
                       g_ActivityMan.GetActivity()->IsOtherPlayerBrain((*prevItr), m_Controller.GetPlayer()));
 
                 // Get the next actor in the list (not controlled by another player)
-                list<Actor *>::iterator nextItr = selfItr;
+                vector<Actor *>::iterator nextItr = selfItr;
                 do
                 {
                     if (++nextItr == pRoster->end())
@@ -26,6 +26,8 @@ class HeldDevice;
 class PieMenuGUI;
 
 #define AILINEDOTSPACING 16
+// How many rays each Look casts, fanned out across the look's spread
+#define LOOKFANRAYS 3
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Class:           Actor
@@ -572,10 +574,12 @@ ENTITYALLOCATION(Actor)
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  Look
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Casts an unseen-revealing ray in the direction of where this is facing.
+// Description:     Casts a fan of unseen-revealing rays in the direction of where this is
+//                  facing.
 // Arguments:       The degree angle to deviate from the current view point in the ray
-//                  casting. A random ray will be chosen out of this +-range.
-//                  The range, in pixels, that the ray will have.
+//                  casting. The fan spans this many degrees, and is centered randomly
+//                  within this +-range.
+//                  The range, in pixels, that the rays will have.
 // Return value:    Whether any unseen pixels were revealed by this look.
 
     virtual bool Look(float FOVSpread, float range);
@@ -16,6 +16,7 @@
 #include "SLTerrain.h"
 #include "MovableObject.h"
 #include "MOSRotating.h"
+#include "VectorBatch.h"
 #include <deque>
 #include <map>
 #include <set>
@@ -47,6 +48,7 @@ void AtomGroup::Clear()
     m_MomInertia = 0;
     m_pOwnerMO = 0;
 	m_IgnoreMOIDs.clear();
+    m_AtomOffsets.clear();
 
     m_LimbPos.Reset();
     m_JointOffset.Reset();
@@ -2375,6 +2377,23 @@ void AtomGroup::FlailAsLimb(const Vector ownerPos,
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          UpdateAtomOffsets
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Flips and rotates the offsets of all the Atom:s in this in one batch.
+
+void AtomGroup::UpdateAtomOffsets(const Matrix &rotation, bool hFlipped)
+{
+    m_AtomOffsets.resize(m_Atoms.size());
+    int i = 0;
+    for (list<Atom *>::iterator aItr = m_Atoms.begin(); aItr != m_Atoms.end(); ++aItr, ++i)
+        m_AtomOffsets[i] = (*aItr)->GetOffset();
+
+    if (!m_AtomOffsets.empty())
+        RotateOffsets(&m_AtomOffsets[0], &m_AtomOffsets[0], m_AtomOffsets.size(), rotation, hFlipped);
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          InTerrain
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -2390,10 +2409,12 @@ bool AtomGroup::InTerrain()
 
     bool penetrates = false;
     Vector aPos;
+    UpdateAtomOffsets(m_pOwnerMO->GetRotMatrix(), m_pOwnerMO->m_HFlipped);
+    int i = 0;
 // TODO: UNCOMMENT
-    for (list<Atom *>::iterator aItr = m_Atoms.begin(); aItr != m_Atoms.end() && !penetrates; ++aItr)
+    for (list<Atom *>::iterator aItr = m_Atoms.begin(); aItr != m_Atoms.end() && !penetrates; ++aItr, ++i)
     {
-        aPos = (m_pOwnerMO->GetPos() + ((*aItr)->GetOffset().GetXFlipped(m_pOwnerMO->m_HFlipped) * m_pOwnerMO->GetRotMatrix())).GetFloored();
+        aPos = (m_pOwnerMO->GetPos() + m_AtomOffsets[i]).GetFloored();
         if (g_SceneMan.GetTerrMatter(aPos.m_X, aPos.m_Y) != g_MaterialAir)
             penetrates = true;
 /*
@@ -2423,10 +2444,11 @@ float AtomGroup::RatioInTerrain()
 
     int inTerrain = 0;
     Vector aPos;
+    UpdateAtomOffsets(m_pOwnerMO->GetRotMatrix(), m_pOwnerMO->m_HFlipped);
 
-    for (list<Atom *>::iterator aItr = m_Atoms.begin(); aItr != m_Atoms.end(); ++aItr)
+    for (int i = 0; i < m_AtomOffsets.size(); ++i)
     {
-        aPos = (m_pOwnerMO->GetPos() + ((*aItr)->GetOffset().GetXFlipped(m_pOwnerMO->m_HFlipped) * m_pOwnerMO->GetRotMatrix())).GetFloored();
+        aPos = (m_pOwnerMO->GetPos() + m_AtomOffsets[i]).GetFloored();
         if (g_SceneMan.GetTerrMatter(aPos.m_X, aPos.m_Y) != g_MaterialAir)
             inTerrain++;
     }
@@ -2446,7 +2468,7 @@ bool AtomGroup::ResolveTerrainIntersection(Vector &position, Matrix &rotation, u
 {
     SLICK_PROFILE(0xFF335546);
 
-    Vector atomOffset, atomPos, atomNormal, clearPos, exitDirection, atomExitVector, totalExitVector;
+    Vector atomPos, atomNormal, clearPos, exitDirection, atomExitVector, totalExitVector;
     list<Atom *>::iterator aItr;
     list<Atom *> intersectingAtoms;
     MOID hitMaterial = g_MaterialAir;
@@ -2459,11 +2481,11 @@ bool AtomGroup::ResolveTerrainIntersection(Vector &position, Matrix &rotation, u
     intersectingAtoms.clear();
 
     // First go through all atoms to find the first intersection and get the intersected MO
-    for (aItr = m_Atoms.begin(); aItr != m_Atoms.end(); ++aItr)
+    UpdateAtomOffsets(rotation, m_pOwnerMO->IsHFlipped());
+    int i = 0;
+    for (aItr = m_Atoms.begin(); aItr != m_Atoms.end(); ++aItr, ++i)
     {
-        atomOffset = (*aItr)->GetOffset().GetXFlipped(m_pOwnerMO->IsHFlipped());
-        atomOffset *= rotation;
-        (*aItr)->SetupPos(position + atomOffset);
+        (*aItr)->SetupPos(position + m_AtomOffsets[i]);
 
         atomPos = (*aItr)->GetCurrentPos();
         if ((hitMaterial = g_SceneMan.GetTerrain()->GetPixel(atomPos.m_X, atomPos.m_Y)) != g_MaterialAir)
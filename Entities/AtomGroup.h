@@ -19,6 +19,7 @@
 #include "LimbPath.h"
 #include "Timer.h"
 #include <deque>
+#include <vector>
 
 namespace RTE
 {
@@ -718,6 +719,18 @@ private:
     void Clear();
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          UpdateAtomOffsets
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Flips and rotates the offsets of all the Atom:s in this in one batch,
+//                  into m_AtomOffsets, in the same order as m_Atoms.
+// Arguments:       The rotation to apply to the offsets.
+//                  Whether to flip the offsets horizontally first.
+// Return value:    None.
+
+    void UpdateAtomOffsets(const Matrix &rotation, bool hFlipped);
+
+
     static Entity::ClassInfo m_sClass;
 
     // Whether or not the Atom:s were automatically generated based on a sprite, or manually defined
@@ -745,6 +758,8 @@ private:
     Vector m_JointOffset;
 	// ignore hits with MOs of these IDs
 	std::list<MOID> m_IgnoreMOIDs;
+    // Scratch space for the batch rotated Atom offsets, not copied between groups
+    std::vector<Vector> m_AtomOffsets;
 
 // TODO: REMOVE THIS")
     Vector m_TestPos;
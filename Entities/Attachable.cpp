@@ -282,8 +282,8 @@ void Attachable::Detach()
 	m_RootMOID = m_MOID;
 
 #ifdef _DEBUG
-	DAssert(m_RootMOID == g_NoMOID || (m_RootMOID >= 0 && m_RootMOID < g_MovableMan.GetMOIDCount()), "MOID out of bounds!");
-	DAssert(m_MOID == g_NoMOID || (m_MOID >= 0 && m_MOID < g_MovableMan.GetMOIDCount()), "MOID out of bounds!");
+	DAssert(m_RootMOID == g_NoMOID || (m_RootMOID >= 0 && m_RootMOID < g_MovableMan.GetMOIDIndexSize()), "MOID out of bounds!");
+	DAssert(m_MOID == g_NoMOID || (m_MOID >= 0 && m_MOID < g_MovableMan.GetMOIDIndexSize()), "MOID out of bounds!");
 #endif
 
     m_RestTimer.Reset();
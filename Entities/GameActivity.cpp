@@ -2272,8 +2272,9 @@ void GameActivity::Update()
             // Kill all player teams members
             if (team != m_CPUTeam)
             {
-                list<Actor *> *pActorList = g_MovableMan.GetTeamRoster(team);
-                for (list<Actor *>::iterator itr = pActorList->begin(); itr != pActorList->end(); ++itr)
+                // Go through a copy, gibbing adds the inventory's actors to the roster
+                vector<Actor *> actorList = *g_MovableMan.GetTeamRoster(team);
+                for (vector<Actor *>::iterator itr = actorList.begin(); itr != actorList.end(); ++itr)
                 {
                     // If brain, make it explode
                     if ((*itr)->HasObjectInGroup("Brains"))
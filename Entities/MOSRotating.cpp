@@ -22,6 +22,8 @@
 
 #include "DDTError.h"
 
+#include <mutex>
+
 using namespace std;
 
 namespace RTE
@@ -45,6 +47,10 @@ BITMAP * MOSRotating::m_spTempBitmapS128 = 0;
 BITMAP * MOSRotating::m_spTempBitmapS256 = 0;
 BITMAP * MOSRotating::m_spTempBitmapS512 = 0;
 
+map<MOSRotating::SilhouetteKey, vector<MOSRotating::Silhouette> > MOSRotating::m_sSilhouettes;
+// MOs can be drawn from several threads at once, and they all share the silhouettes
+static mutex s_SilhouettesMutex;
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Clear
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -194,6 +200,7 @@ void MOSRotating::Clear()
     m_Recoiled = false;
     m_RecoilForce.Reset();
     m_RecoilOffset.Reset();
+    m_MOIDDrawnRecoil.Reset();
     m_Emitters.clear();
     m_Attachables.clear();
     m_Gibs.clear();
@@ -1014,10 +1021,19 @@ void MOSRotating::GibThis(Vector impactImpulse, float internalBlast, MovableObje
     MovableObject *pGib = 0;
     float velMin, velRange, spread, angularVel;
     Vector gibROffset, gibVel;
+    // The random speeds and spread angles of all the gibs of one kind, drawn in one go
+    vector<double> gibSpeedRands, gibSpreadRands;
     for (list<MOSRotating::Gib>::iterator gItr = m_Gibs.begin(); gItr != m_Gibs.end(); ++gItr)
     {
         SLICK_PROFILENAME("Throwing out Gibs", 0xFF446542);
 
+        if ((*gItr).GetCount() <= 0)
+            continue;
+        gibSpeedRands.resize((*gItr).GetCount());
+        gibSpreadRands.resize((*gItr).GetCount());
+        PosRandFill(&gibSpeedRands[0], (*gItr).GetCount());
+        NormalRandFill(&gibSpreadRands[0], (*gItr).GetCount());
+
         for (int i = 0; i < (*gItr).GetCount(); ++i)
         {
             // Make a copy after the preset particle
@@ -1064,16 +1080,15 @@ void MOSRotating::GibThis(Vector impactImpulse, float internalBlast, MovableObje
                 pGib->SetAngularVel((pGib->GetAngularVel() * 0.5 + pGib->GetAngularVel() * PosRand()) * (NormalRand() > 0 ? 1 : -1));
             }
 
-// TODO: Optimize making the random angles!")
             {
 				// Pretty much always zero
                 //SLICK_PROFILENAME("Making random angles", 0xFF446542);
                 gibVel = gibROffset;
                 if (gibVel.IsZero())
-                    gibVel.SetXY(velMin + velRange * PosRand(), 0);
+                    gibVel.SetXY(velMin + velRange * gibSpeedRands[i], 0);
                 else
-                    gibVel.SetMagnitude(velMin + velRange * PosRand());
-                gibVel.RadRotate(impactImpulse.GetAbsRadAngle() + spread * NormalRand());
+                    gibVel.SetMagnitude(velMin + velRange * gibSpeedRands[i]);
+                gibVel.RadRotate(impactImpulse.GetAbsRadAngle() + spread * gibSpreadRands[i]);
 // Don't! the offset was already rotated!
 //                gibVel = RotateOffset(gibVel);
                 // Distribute any impact implse out over all the gibs
@@ -1633,7 +1648,7 @@ void MOSRotating::Update()
 {
 
 #ifdef _DEBUG
-	DAssert(m_MOID == g_NoMOID || (m_MOID >= 0 && m_MOID < g_MovableMan.GetMOIDCount()), "MOID out of bounds!");
+	DAssert(m_MOID == g_NoMOID || (m_MOID >= 0 && m_MOID < g_MovableMan.GetMOIDIndexSize()), "MOID out of bounds!");
 #endif
 
     MOSprite::Update();
@@ -1807,6 +1822,26 @@ void MOSRotating::UpdateChildMOIDs(vector<MovableObject *> &MOIDIndex,
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Virtual method:  UpdateMOIDDrawState
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Remembers everything about this that shows in how it's drawn onto the
+//                  MOID layer, and tells whether any of it changed since the last time.
+
+bool MOSRotating::UpdateMOIDDrawState()
+{
+    bool changed = MOSprite::UpdateMOIDDrawState();
+
+    Vector recoil = m_Recoiled ? m_RecoilOffset : Vector();
+    if (recoil != m_MOIDDrawnRecoil)
+    {
+        m_MOIDDrawnRecoil = recoil;
+        changed = true;
+    }
+    return changed;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  GetMOIDs
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1860,8 +1895,31 @@ void MOSRotating::Draw(BITMAP *pTargetBitmap,
     if (m_Recoiled)
         spritePos += m_RecoilOffset;
 
+    // Single color silhouettes of unscaled sprites are filled in from the cache of pre-rotated ones, instead of being recolored and rotated every time
+    bool cachedSilhouette = false;
+    int silhouetteColor = keyColor;
+    int angleBuckets = g_SettingsMan.GetSilhouetteAngleBuckets();
+    if (angleBuckets > 0 && m_Scale == 1.0)
+    {
+        cachedSilhouette = true;
+        if (mode == g_DrawMaterial)
+            silhouetteColor = m_SettleMaterialDisabled ? GetMaterial()->id : GetMaterial()->GetSettleMaterialID();
+        else if (mode == g_DrawAir)
+            silhouetteColor = g_MaterialAir;
+        else if (mode == g_DrawKey)
+            silhouetteColor = keyColor;
+        else if (mode == g_DrawWhite)
+            silhouetteColor = g_WhiteColor;
+        else if (mode == g_DrawMOID)
+            silhouetteColor = m_MOID;
+        else if (mode == g_DrawNoMOID)
+            silhouetteColor = g_NoMOID;
+        else
+            cachedSilhouette = false;
+    }
+
     // If we're drawing a material silhouette, then create an intermediate material bitmap as well
-    if (mode != g_DrawColor && mode != g_DrawTrans)
+    if (mode != g_DrawColor && mode != g_DrawTrans && !cachedSilhouette)
     {
         clear_to_color(pTempBitmap, keyColor);
 
@@ -1951,9 +2009,28 @@ void MOSRotating::Draw(BITMAP *pTargetBitmap,
 	}
 
 
+    //////////////////
+    // CACHED SILHOUETTE
+    if (cachedSilhouette)
+    {
+        // Just like with the masked blits below, nothing shows up if the silhouette is the key color
+        if (silhouetteColor != keyColor)
+        {
+            const Silhouette &silhouette = GetSilhouette(m_HFlipped && pFlipBitmap, angleBuckets);
+            for (int i = 0; i < passes; ++i)
+                DrawSilhouette(pTargetBitmap, silhouette, aDrawPos[i].GetFloorIntX(), aDrawPos[i].GetFloorIntY(), silhouetteColor);
+        }
+
+        // Register potential MOID drawing
+        if (mode == g_DrawMOID)
+        {
+            for (int i = 0; i < passes; ++i)
+                g_SceneMan.RegisterMOIDDrawing(aDrawPos[i].GetFloored(), m_MaxRadius + 2);
+        }
+    }
     //////////////////
     // FLIPPED
-    if (m_HFlipped && pFlipBitmap)
+    else if (m_HFlipped && pFlipBitmap)
     {
         // Don't size the intermediate bitmaps to the m_Scale, because the scaling happens after they are done
         clear_to_color(pFlipBitmap, keyColor);
@@ -2075,6 +2152,125 @@ void MOSRotating::Draw(BITMAP *pTargetBitmap,
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetSilhouette
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the silhouette of the current sprite frame at the cached angle
+//                  closest to the current rotation.
+
+const MOSRotating::Silhouette & MOSRotating::GetSilhouette(bool hFlipped, int angleBuckets) const
+{
+    BITMAP *pSprite = m_aSprite[m_Frame];
+
+    // Pivot the same way Draw does when it rotates the sprite itself
+    SilhouetteKey key;
+    key.m_pSprite = pSprite;
+    key.m_PivotX = hFlipped ? (int)(pSprite->w + m_SpriteOffset.m_X) : (int)(-(m_SpriteOffset.m_X));
+    key.m_PivotY = (int)(-(m_SpriteOffset.m_Y));
+    key.m_HFlipped = hFlipped;
+    key.m_AngleBuckets = angleBuckets;
+
+    // Entries are never changed once built nor let go of, so what's returned stays valid after unlocking
+    lock_guard<mutex> silhouettesLock(s_SilhouettesMutex);
+
+    vector<Silhouette> &buckets = m_sSilhouettes[key];
+    if (buckets.empty())
+        buckets.resize(angleBuckets);
+
+    // Snap to the closest bucket, in Allegro's 256ths of a full turn
+    int bucket = (int)floorf(m_Rotation.GetAllegroAngle() * angleBuckets / 256.0f + 0.5f) % angleBuckets;
+    if (bucket < 0)
+        bucket += angleBuckets;
+
+    Silhouette &silhouette = buckets[bucket];
+    if (silhouette.m_Built)
+        return silhouette;
+
+    // Make a mask of the frame, flipped if need be
+    BITMAP *pMask = create_bitmap_ex(8, pSprite->w, pSprite->h);
+    clear_to_color(pMask, 0);
+    draw_character_ex(pMask, pSprite, 0, 0, 1, -1);
+    if (hFlipped)
+    {
+        BITMAP *pFlippedMask = create_bitmap_ex(8, pSprite->w, pSprite->h);
+        clear_to_color(pFlippedMask, 0);
+        draw_sprite_h_flip(pFlippedMask, pMask, 0, 0);
+        destroy_bitmap(pMask);
+        pMask = pFlippedMask;
+    }
+
+    // Rotate it with the exact same blit Draw would use, onto a bitmap that can hold it at any angle with the pivot in the middle.
+    // Blitting at whole pixel offsets doesn't change which pixels get set, so this can be drawn anywhere afterwards
+    int reach = max(abs(key.m_PivotX), abs(key.m_PivotX - pSprite->w)) + max(abs(key.m_PivotY), abs(key.m_PivotY - pSprite->h)) + 2;
+    BITMAP *pRotated = create_bitmap_ex(8, reach * 2 + 1, reach * 2 + 1);
+    clear_to_color(pRotated, 0);
+    pivot_scaled_sprite(pRotated, pMask, reach, reach, key.m_PivotX, key.m_PivotY, ftofix(bucket * 256.0f / angleBuckets), ftofix(1.0));
+    destroy_bitmap(pMask);
+
+    // Find the rows the silhouette actually covers
+    int firstRow = 0;
+    int lastRow = -1;
+    for (int y = 0; y < pRotated->h; ++y)
+    {
+        if (memchr(pRotated->line[y], 1, pRotated->w))
+        {
+            if (lastRow < 0)
+                firstRow = y;
+            lastRow = y;
+        }
+    }
+
+    // Gather up the runs of each row
+    silhouette.m_Left = -reach;
+    silhouette.m_Top = firstRow - reach;
+    silhouette.m_RowStarts.clear();
+    silhouette.m_Runs.clear();
+    for (int y = firstRow; y <= lastRow; ++y)
+    {
+        silhouette.m_RowStarts.push_back(silhouette.m_Runs.size());
+        unsigned char *pRow = pRotated->line[y];
+        for (int x = 0; x < pRotated->w; ++x)
+        {
+            if (!pRow[x])
+                continue;
+            silhouette.m_Runs.push_back(x);
+            while (x < pRotated->w && pRow[x])
+                ++x;
+            silhouette.m_Runs.push_back(x);
+        }
+    }
+    silhouette.m_RowStarts.push_back(silhouette.m_Runs.size());
+    silhouette.m_Built = true;
+
+    destroy_bitmap(pRotated);
+
+    return silhouette;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawSilhouette
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Fills in a silhouette with a single color, one span at a time.
+
+void MOSRotating::DrawSilhouette(BITMAP *pTargetBitmap, const Silhouette &silhouette, int x, int y, int color) const
+{
+    int left = x + silhouette.m_Left;
+    int top = y + silhouette.m_Top;
+    int rowCount = silhouette.m_RowStarts.size() - 1;
+
+    // Skip straight past the rows that are clipped off, hline takes care of the rest of the clipping
+    int firstRow = max(0, pTargetBitmap->ct - top);
+    int endRow = min(rowCount, pTargetBitmap->cb - top);
+
+    for (int row = firstRow; row < endRow; ++row)
+    {
+        for (int run = silhouette.m_RowStarts[row]; run < silhouette.m_RowStarts[row + 1]; run += 2)
+            hline(pTargetBitmap, left + silhouette.m_Runs[run], top + row, left + silhouette.m_Runs[run + 1] - 1, color);
+    }
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          ApplyAttachableForces
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1123,6 +1123,17 @@ protected:
                                  MOID rootMOID = g_NoMOID,
                                  bool makeNewMOID = true);
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Virtual method:  UpdateMOIDDrawState
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Remembers everything about this that shows in how it's drawn onto the
+//                  MOID layer, and tells whether any of it changed since the last time.
+// Arguments:       None.
+// Return value:    Whether this would come out different on the MOID layer now.
+
+    virtual bool UpdateMOIDDrawState();
+
     // Member variables
     static Entity::ClassInfo m_sClass;
 //    float m_Torque; // In kg * r/s^2 (Newtons).
@@ -1149,6 +1160,8 @@ protected:
     Vector m_RecoilForce;
     // The vector that the recoil offsets the sprite when m_Recoiled is true.
     Vector m_RecoilOffset;
+    // How far recoil had pushed the sprite when this was last registered for drawing onto the MOID layer
+    Vector m_MOIDDrawnRecoil;
     // The list of AEmitters currently attached to this MOSRotating, and owned here as well
     std::list<AEmitter *> m_Emitters;
     // The list of general Attachables currently attached and Owned by this.
@@ -1200,11 +1213,82 @@ protected:
     static BITMAP *m_spTempBitmapS256;
     static BITMAP *m_spTempBitmapS512;
 
+    // A sprite frame's silhouette rotated to one of the cached angles, stored as the runs of solid pixels on each of its rows
+    struct Silhouette
+    {
+        // Whether this angle has been rendered yet
+        bool m_Built;
+        // Offset of the top left corner of the silhouette from the pivot point it is drawn at
+        int m_Left;
+        int m_Top;
+        // Index of the first run of each row in m_Runs, plus one past the last row
+        std::vector<int> m_RowStarts;
+        // The start and one-past-end X of each run, relative to m_Left
+        std::vector<short> m_Runs;
+
+        Silhouette() { m_Built = false; m_Left = m_Top = 0; }
+    };
+
+    // What silhouettes are cached by; the same sprite frame can be pivoted differently by different presets, and the angle bucket setting can change
+    struct SilhouetteKey
+    {
+        BITMAP *m_pSprite;
+        int m_PivotX;
+        int m_PivotY;
+        bool m_HFlipped;
+        int m_AngleBuckets;
+
+        bool operator<(const SilhouetteKey &rhs) const
+        {
+            if (m_pSprite != rhs.m_pSprite)
+                return m_pSprite < rhs.m_pSprite;
+            if (m_PivotX != rhs.m_PivotX)
+                return m_PivotX < rhs.m_PivotX;
+            if (m_PivotY != rhs.m_PivotY)
+                return m_PivotY < rhs.m_PivotY;
+            if (m_HFlipped != rhs.m_HFlipped)
+                return m_HFlipped < rhs.m_HFlipped;
+            return m_AngleBuckets < rhs.m_AngleBuckets;
+        }
+    };
+
+    // All the silhouettes rendered so far, shared between all MOSRotatings and only touched under a lock. Each key has one per angle bucket, built as they're first needed.
+    // Keys come from loaded sprite frames and preset pivots only, so this can't grow past what the loaded data module content can make
+    static std::map<SilhouetteKey, std::vector<Silhouette> > m_sSilhouettes;
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Private member variable and method declarations
 
 private:
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetSilhouette
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the silhouette of the current sprite frame at the cached angle
+//                  closest to the current rotation, rendering it first if this is the
+//                  first time it's needed.
+// Arguments:       Whether to get the horizontally flipped silhouette.
+//                  How many angles silhouettes are cached at.
+// Return value:    The silhouette, which is drawn with its pivot at the draw position.
+//                  Thread safe, and stays valid for as long as the game runs.
+
+    const Silhouette & GetSilhouette(bool hFlipped, int angleBuckets) const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawSilhouette
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Fills in a silhouette with a single color, one span at a time.
+// Arguments:       The bitmap to draw on.
+//                  The silhouette to draw.
+//                  Where on the bitmap to draw the silhouette's pivot point.
+//                  The color to fill the silhouette with.
+// Return value:    None.
+
+    void DrawSilhouette(BITMAP *pTargetBitmap, const Silhouette &silhouette, int x, int y, int color) const;
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Clear
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -51,6 +51,9 @@ void MOSprite::Clear()
     m_SettleMaterialDisabled = false;
     m_pEntryWound = 0;
     m_pExitWound = 0;
+    m_MOIDDrawnFrame = 0;
+    m_MOIDDrawnHFlipped = false;
+    m_MOIDDrawnAngle = 0;
 }
 
 
@@ -567,4 +570,25 @@ void MOSprite::Draw(BITMAP *pTargetBitmap,
     }
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Virtual method:  UpdateMOIDDrawState
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Remembers everything about this that shows in how it's drawn onto the
+//                  MOID layer, and tells whether any of it changed since the last time.
+
+bool MOSprite::UpdateMOIDDrawState()
+{
+    bool changed = MovableObject::UpdateMOIDDrawState();
+
+    float angle = m_Rotation.GetRadAngle();
+    if (m_Frame != m_MOIDDrawnFrame || m_HFlipped != m_MOIDDrawnHFlipped || angle != m_MOIDDrawnAngle)
+    {
+        m_MOIDDrawnFrame = m_Frame;
+        m_MOIDDrawnHFlipped = m_HFlipped;
+        m_MOIDDrawnAngle = angle;
+        changed = true;
+    }
+    return changed;
+}
+
 } // namespace RTE
\ No newline at end of file
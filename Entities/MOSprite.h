@@ -620,6 +620,17 @@ ENTITYALLOCATION(MOSprite)
 
 protected:
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Virtual method:  UpdateMOIDDrawState
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Remembers everything about this that shows in how it's drawn onto the
+//                  MOID layer, and tells whether any of it changed since the last time.
+// Arguments:       None.
+// Return value:    Whether this would come out different on the MOID layer now.
+
+    virtual bool UpdateMOIDDrawState();
+
     // Member variables
     static Entity::ClassInfo m_sClass;
 
@@ -654,6 +665,10 @@ protected:
     const AEmitter *m_pEntryWound;
     // Exit wound template
     const AEmitter *m_pExitWound;
+    // The frame, flipping and rotation this had when it was last registered for drawing onto the MOID layer
+    unsigned int m_MOIDDrawnFrame;
+    bool m_MOIDDrawnHFlipped;
+    float m_MOIDDrawnAngle;
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
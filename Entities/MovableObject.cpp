@@ -70,6 +70,11 @@ void MovableObject::Clear()
     m_MOID = g_NoMOID;
     m_RootMOID = g_NoMOID;
     m_MOIDFootprint = 0;
+    m_MOIDDirty = true;
+    m_MOIDDrawnID = g_NoMOID;
+    m_MOIDDrawnPos.Reset();
+    m_MOIDDrawnScale = 0;
+    m_MOIDDrawnHit = false;
     m_AlreadyHitBy.clear();
     m_VelOscillations = 0;
     m_ToSettle = false;
@@ -77,7 +82,8 @@ void MovableObject::Clear()
     m_HUDVisible = true;
     m_ScriptPath.clear();
     m_ScriptPresetName.clear();
-    m_ScriptObjectName.clear();
+    m_ScriptObjectRef = NO_LUA_OBJECT_REF;
+    m_ScriptParallel = false;
     m_ScreenEffectFile.Reset();
     m_pScreenEffect = 0;
 	m_EffectRotAngle = 0;
@@ -211,8 +217,9 @@ int MovableObject::Create(const MovableObject &reference)
     m_HUDVisible = reference.m_HUDVisible;
     m_ScriptPath = reference.m_ScriptPath;
     m_ScriptPresetName = reference.m_ScriptPresetName;
+    m_ScriptParallel = reference.m_ScriptParallel;
     // Should be unique to the object, will be created lazily upon first UpdateScript
-//    m_ScriptObjectName
+//    m_ScriptObjectRef
     if (reference.m_pScreenEffect)
     {
         m_ScreenEffectFile = reference.m_ScreenEffectFile;
@@ -337,6 +344,8 @@ int MovableObject::ReadProperty(std::string propName, Reader &reader)
         // Read in the Lua script function definitions for this preset
         LoadScripts(m_ScriptPath);
     }
+    else if (propName == "ScriptParallel")
+        reader >> m_ScriptParallel;
     else if (propName == "ScreenEffect")
     {
         reader >> m_ScreenEffectFile;
@@ -466,13 +475,16 @@ int MovableObject::Save(Writer &writer) const
 void MovableObject::Destroy(bool notInherited)
 {
     // Clean up the existence of this in the script state
-    if (!m_ScriptObjectName.empty())
+    if (m_ScriptObjectRef != NO_LUA_OBJECT_REF)
     {
-        // Call the scripted destruction function, but only after first checking if it and this instance's Lua representation really exists
-        g_LuaMan.RunScriptString("if " + m_ScriptPresetName + " and " + m_ScriptPresetName + ".Destroy and " + m_ScriptObjectName + " then " + m_ScriptPresetName + ".Destroy(" + m_ScriptObjectName + "); end");
-        // Assign nil to the variable that held this' representation in Lua
-        g_LuaMan.RunScriptString("if " + m_ScriptObjectName + " then " + m_ScriptObjectName + " = nil; end");
+        // Call the scripted destruction function, if it's defined
+        g_LuaMan.RunObjectFunction(m_ScriptPresetName, "Destroy", m_ScriptObjectRef);
+        // Let go of this' representation in Lua
+        g_LuaMan.ReleaseObjectReference(m_ScriptObjectRef);
     }
+    // Same in the worker state, where this' script may have run instead
+    if (m_ScriptParallel && !m_ScriptPath.empty())
+        g_LuaMan.ReleaseParallelObject(m_UniqueID, m_ScriptPath);
 
     if (!notInherited)
         SceneObject::Destroy();
@@ -513,8 +525,9 @@ int MovableObject::LoadScripts(string scriptPath)
     // Get a new ID for this original preset so we can assign the read-in function definitions to it
     m_ScriptPresetName = GetClassName() + "s." + g_LuaMan.GetNewPresetID();
 
-    // Clear out the instance object name so it gets created in the state upon first UpdateScript
-    m_ScriptObjectName.clear();
+    // Let go of the instance object so it gets created in the state anew upon first UpdateScript
+    g_LuaMan.ReleaseObjectReference(m_ScriptObjectRef);
+    m_ScriptObjectRef = NO_LUA_OBJECT_REF;
 
     // Under the class' table, create a new table for all functions of this specific preset and its unique ID
     if ((error = g_LuaMan.RunScriptString(m_ScriptPresetName + " = {};")) < 0)
@@ -552,6 +565,8 @@ int MovableObject::ReloadScripts()
         // Reload the preset funcitons of this instance
         if ((error = LoadScripts(m_ScriptPath)) < 0)
             return error;
+        // The worker states keep their own copies of the functions, so have them load the file again too
+        g_LuaMan.ForgetParallelScript(m_ScriptPath);
         // Now also reload the ones of the original preset of this so all future objects will use the new scripts
         MovableObject *pPreset = const_cast<MovableObject *>(dynamic_cast<const MovableObject *>(g_PresetMan.GetEntityPreset(GetClassName(), GetPresetName(), GetModuleID())));
         if (pPreset && pPreset != this)
@@ -833,6 +848,10 @@ int MovableObject::UpdateScript()
     if (m_ScriptPath.empty() || m_ScriptPresetName.empty())
         return -1;
 
+    // Parallel scripts are written against the worker state API, so MovableMan runs them there instead
+    if (IsScriptParallel())
+        return -1;
+
     int error = 0;
 
     // Check to make sure the preset of this is still defined in the Lua state. If not, re-create it and recover gracefully
@@ -840,24 +859,21 @@ int MovableObject::UpdateScript()
         ReloadScripts();
 
     // First see if we even have a representation stored in the Lua state, and if not, create one
-    if (m_ScriptObjectName.empty())
+    if (m_ScriptObjectRef == NO_LUA_OBJECT_REF)
     {
-        // Get the unique object identifier for this object and construct the object isntance name in Lua that points to this object so we can pass it into the preset functions
-        m_ScriptObjectName = GetClassName() + "s." + g_LuaMan.GetNewObjectID();
-
         // Give access to this in the Lua state
         g_MovableMan.SetScriptedEntity(this);
-        // Create the Lua variable which will hold the object instance of this instance for as long as it exists
-        if ((error = g_LuaMan.RunScriptString(m_ScriptObjectName + " = To" + GetClassName() + "(MovableMan.ScriptedEntity);")) < 0)
-            return error;
+        // Create the Lua object instance of this, which LuaMan holds on to for as long as this exists so we can pass it into the preset functions
+        if ((m_ScriptObjectRef = g_LuaMan.CreateObjectReference(GetClassName())) == NO_LUA_OBJECT_REF)
+            return -1;
 
-        // Call the scripted creation function, but only after first checking if it and this instance's Lua representation really exists
-        if ((error = g_LuaMan.RunScriptString("if " + m_ScriptPresetName + ".Create and " + m_ScriptObjectName + " then " + m_ScriptPresetName + ".Create(" + m_ScriptObjectName + "); end")) < 0)
+        // Call the scripted creation function, if it's defined
+        if ((error = g_LuaMan.RunObjectFunction(m_ScriptPresetName, "Create", m_ScriptObjectRef)) < 0)
             return error;
     }
 
-    // Call the defined function, but only after first checking if it and this instance's Lua representation exists
-    if ((error = g_LuaMan.RunScriptString("if " + m_ScriptPresetName + ".Update and " + m_ScriptObjectName + " then " + m_ScriptPresetName + ".Update(" + m_ScriptObjectName + "); end")) < 0)
+    // Call the defined function, if it's defined
+    if ((error = g_LuaMan.RunObjectFunction(m_ScriptPresetName, "Update", m_ScriptObjectRef)) < 0)
         return error;
 
     return error;
@@ -877,14 +893,14 @@ int MovableObject::OnPieMenu(Actor * pActor)
 	if (m_ScriptPath.empty() || m_ScriptPresetName.empty())
 		return -1;
 
-	if (m_ScriptObjectName.empty())
+	if (m_ScriptObjectRef == NO_LUA_OBJECT_REF)
 		return -1;
 
 	m_pPieMenuActor = pActor;
 
 	int error = 0;
 
-	if ((error = g_LuaMan.RunScriptString("if " + m_ScriptPresetName + ".OnPieMenu and " + m_ScriptObjectName + " then " + m_ScriptPresetName + ".OnPieMenu(" + m_ScriptObjectName + "); end")) < 0)
+	if ((error = g_LuaMan.RunObjectFunction(m_ScriptPresetName, "OnPieMenu", m_ScriptObjectRef)) < 0)
 		return error;
 
 	return error;
@@ -957,6 +973,33 @@ void MovableObject::RegMOID(vector<MovableObject *> &MOIDIndex,
     // Assign the root MOID
     m_RootMOID = (rootMOID == g_NoMOID ? m_MOID : rootMOID);
 
+    // A part that would come out different on the MOID layer, or that started or stopped being
+    // drawn there at all, has the whole root MO cleared and drawn there again
+    bool drawnChanged = m_GetsHitByMOs != m_MOIDDrawnHit;
+    m_MOIDDrawnHit = m_GetsHitByMOs;
+    if (m_GetsHitByMOs && UpdateMOIDDrawState())
+        drawnChanged = true;
+    if (drawnChanged && m_RootMOID < MOIDIndex.size() && MOIDIndex[m_RootMOID])
+        MOIDIndex[m_RootMOID]->m_MOIDDirty = true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Virtual method:  UpdateMOIDDrawState
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Remembers everything about this that shows in how it's drawn onto the
+//                  MOID layer, and tells whether any of it changed since the last time.
+
+bool MovableObject::UpdateMOIDDrawState()
+{
+    Vector drawnPos = m_Pos.GetFloored();
+    if (m_MOID == m_MOIDDrawnID && drawnPos == m_MOIDDrawnPos && m_Scale == m_MOIDDrawnScale)
+        return false;
+
+    m_MOIDDrawnID = m_MOID;
+    m_MOIDDrawnPos = drawnPos;
+    m_MOIDDrawnScale = m_Scale;
+    return true;
 }
 
 } // namespace RTE
\ No newline at end of file
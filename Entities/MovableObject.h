@@ -207,6 +207,27 @@ ENTITYALLOCATION(MovableObject)
     virtual int ReloadScripts();
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsScriptParallel
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Shows whether this' preset declared that its script can run in one of
+//                  LuaMan's worker states, in parallel with other scripts.
+// Arguments:       None.
+// Return value:    Whether this has a script that supports running in parallel.
+
+    bool IsScriptParallel() const { return m_ScriptParallel && !m_ScriptPath.empty(); }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetScriptPath
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the path of the Lua script file that defines this' behaviors.
+// Arguments:       None.
+// Return value:    The script path, empty if this has no script.
+
+    const std::string & GetScriptPath() const { return m_ScriptPath; }
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  GetClass
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -420,6 +441,28 @@ ENTITYALLOCATION(MovableObject)
     int GetMOIDFootprint() const { return m_MOIDFootprint; }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsMOIDDirty
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Indicates whether this or any of its parts changed how they show on
+//                  the MOID layer since this was last drawn there. Only kept up to date
+//                  for MO's owned by MovableMan.
+// Arguments:       None.
+// Return value:    Whether this needs to be drawn onto the MOID layer again.
+
+    bool IsMOIDDirty() const { return m_MOIDDirty; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetMOIDDirty
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets whether this needs to be drawn onto the MOID layer again.
+// Arguments:       Whether it does.
+// Return value:    None.
+
+    void SetMOIDDirty(bool dirty = true) { m_MOIDDirty = dirty; }
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  GetSharpness
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1741,6 +1784,17 @@ protected:
                          MOID rootMOID = g_NoMOID,
                          bool makeNewMOID = true);
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Virtual method:  UpdateMOIDDrawState
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Remembers everything about this that shows in how it's drawn onto the
+//                  MOID layer, and tells whether any of it changed since the last time.
+// Arguments:       None.
+// Return value:    Whether this would come out different on the MOID layer now.
+
+    virtual bool UpdateMOIDDrawState();
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Constructor:     MovableObject
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1822,6 +1876,14 @@ protected:
     // How many total (subsequent) MOID's this MO and all its children are taking up this frame.
     // ie if this MO has no children, this will likely be 1.
     int m_MOIDFootprint;
+    // Whether this or any of its parts changed how they show on the MOID layer since this was last drawn there
+    bool m_MOIDDirty;
+    // The MOID, floored position and scale this had when it was last registered for drawing onto the MOID layer
+    MOID m_MOIDDrawnID;
+    Vector m_MOIDDrawnPos;
+    float m_MOIDDrawnScale;
+    // Whether this was hit by MOs, and so drawn onto the MOID layer, when last registered
+    bool m_MOIDDrawnHit;
     // A set of ID:s of MO:s that already have collided with this MO during this frame.
     std::set<MOID> m_AlreadyHitBy;
     // A counter to count the oscillations in translational velocity, in order to detect settling.
@@ -1838,8 +1900,10 @@ protected:
     std::string m_ScriptPath;
     // The ID name unique to this' preset and its defined scripted functions in the lua state.
     std::string m_ScriptPresetName;
-    // The ID name unique to this' object instance representation in the Lua state.
-    std::string m_ScriptObjectName;
+    // The reference to this' object instance representation in LuaMan's object table, or NO_LUA_OBJECT_REF if there isn't one yet.
+    int m_ScriptObjectRef;
+    // Whether this' script is written to run in one of LuaMan's worker states, with a snapshot of this and commands instead of this itself
+    bool m_ScriptParallel;
 
     // Special post processing flash effect file and Bitmap. Shuold be loaded from a 32bpp bitmap
     ContentFile m_ScreenEffectFile;
@@ -44,6 +44,16 @@ BITMAP * SLTerrain::m_spTempBitmap64 = 0;
 BITMAP * SLTerrain::m_spTempBitmap128 = 0;
 BITMAP * SLTerrain::m_spTempBitmap256 = 0;
 BITMAP * SLTerrain::m_spTempBitmap512 = 0;
+BITMAP * SLTerrain::m_spSettleColorBuffer = 0;
+BITMAP * SLTerrain::m_spSettleMaterialBuffer = 0;
+
+// Size of the square regions that settling sprites are sorted into and composited by
+#define SETTLETILESIZE 128
+// Sprites wider than this are applied one by one as before
+#define SETTLEMAXSPRITESIZE 128
+// Room for a whole tile plus the reach of the biggest sprites past either side of it. Groups that still don't fit,
+// like ones with objects outside the scene clamped into an edge tile, are applied one by one
+#define SETTLEBUFFERSIZE (SETTLETILESIZE + 2 * (SETTLEMAXSPRITESIZE + 1) + 4)
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -156,12 +166,12 @@ void SLTerrain::Clear()
 {
     m_pFGColor = 0;
     m_pBGColor = 0;
-    m_pStructural = 0;
     m_BGTextureFile.Reset();
     m_TerrainFrostings.clear();
     m_TerrainDebris.clear();
     m_TerrainObjects.clear();
     m_UpdatedMateralAreas.clear();
+    m_SettlingObjects.clear();
     m_DrawMaterial = false;
 	m_NeedToClearFrostings = false;
 	m_NeedToClearDebris = false;
@@ -196,6 +206,10 @@ int SLTerrain::Create()
         m_spTempBitmap256 = create_bitmap_ex(8, 256, 256);
     if (!m_spTempBitmap512)
         m_spTempBitmap512 = create_bitmap_ex(8, 512, 512);
+    if (!m_spSettleColorBuffer)
+        m_spSettleColorBuffer = create_bitmap_ex(8, SETTLEBUFFERSIZE, SETTLEBUFFERSIZE);
+    if (!m_spSettleMaterialBuffer)
+        m_spSettleMaterialBuffer = create_bitmap_ex(8, SETTLEBUFFERSIZE, SETTLEBUFFERSIZE);
 
     return 0;
 }
@@ -231,7 +245,6 @@ int SLTerrain::Create(const SLTerrain &reference)
     // Leave these because they are loaded late by LoadData
     m_pFGColor = dynamic_cast<SceneLayer *>(reference.m_pFGColor->Clone());
     m_pBGColor = dynamic_cast<SceneLayer *>(reference.m_pBGColor->Clone());
-//    m_pStructural;
     m_BGTextureFile = reference.m_BGTextureFile;
 
     ////////////////////////////
@@ -320,12 +333,6 @@ int SLTerrain::LoadData()
         return -1;
     }
 
-    // Structural integrity calc buffer bitmap
-    destroy_bitmap(m_pStructural);
-    m_pStructural = create_bitmap_ex(8, m_pMainBitmap->w, m_pMainBitmap->h);
-    AAssert(m_pStructural, "Failed to allocate BITMAP in Terrain::Create");
-    clear_bitmap(m_pStructural);
-
     ///////////////////////////////////////////////
     // Load and texturize the FG color bitmap, based on the materials defined in the recently loaded (main) material layer!
 
@@ -528,19 +535,19 @@ int SLTerrain::SaveData(string pathBase)
         return -1;
 
     // Save the bitmap of the material bitmap
-    if (SceneLayer::SaveData(pathBase + " Mat.bmp") < 0)
+    if (SceneLayer::SaveData(pathBase + " Mat" COMPRESSEDLAYEREXT) < 0)
     {
         DDTAbort("Failed to write the material bitmap data saving an SLTerrain!");
         return -1;
     }
     // Then the foreground color layer
-    if (m_pFGColor->SaveData(pathBase + " FG.bmp") < 0)
+    if (m_pFGColor->SaveData(pathBase + " FG" COMPRESSEDLAYEREXT) < 0)
     {
         DDTAbort("Failed to write the FG color bitmap data saving an SLTerrain!");
         return -1;
     }
     // Then the background color layer
-    if (m_pBGColor->SaveData(pathBase + " BG.bmp") < 0)
+    if (m_pBGColor->SaveData(pathBase + " BG" COMPRESSEDLAYEREXT) < 0)
     {
         DDTAbort("Failed to write the BG color bitmap data saving an SLTerrain!");
         return -1;
@@ -713,7 +720,6 @@ void SLTerrain::Destroy(bool notInherited)
 {
     delete m_pFGColor;
     delete m_pBGColor;
-    destroy_bitmap(m_pStructural);
 
     for (list<TerrainDebris *>::iterator tdItr = m_TerrainDebris.begin(); tdItr != m_TerrainDebris.end(); ++tdItr)
     {
@@ -866,6 +872,7 @@ void SLTerrain::SetFGColorPixel(const int pixelX, const int pixelY, const int co
 
 //    AAssert(m_pFGColor->GetBitmap()->m_LockCount > 0, "Trying to access unlocked terrain bitmap");
     _putpixel(m_pFGColor->GetBitmap(), posX, posY, color);
+    m_pFGColor->SetDataDirty();
 }
 
 
@@ -893,6 +900,7 @@ void SLTerrain::SetBGColorPixel(const int pixelX, const int pixelY, const int co
 
 //    AAssert(m_pBGColor->GetBitmap()->m_LockCount > 0, "Trying to access unlocked terrain bitmap");
     _putpixel(m_pBGColor->GetBitmap(), posX, posY, color);
+    m_pBGColor->SetDataDirty();
 }
 
 
@@ -919,6 +927,7 @@ void SLTerrain::SetMaterialPixel(const int pixelX, const int pixelY, const unsig
        return;
 //    AAssert(m_pMainBitmap->m_LockCount > 0, "Trying to access unlocked terrain bitmap");
     _putpixel(m_pMainBitmap, posX, posY, material);
+    SetDataDirty();
 }
 
 
@@ -1063,6 +1072,7 @@ deque<MOPixel *> SLTerrain::EraseSilhouette(BITMAP *pSprite,
     // Add a box to the updated areas list to show there's been change to the materials layer
 // TODO: improve fit/tightness of box here
     m_UpdatedMateralAreas.push_back(Box(pos - pivot, maxWidth, maxHeight));
+    SetLayersDirty();
 
     return MOPDeque;
 
@@ -1320,6 +1330,8 @@ void SLTerrain::ApplyMovableObject(MovableObject *pMObject)
     if (!pMObject)
         return;
 
+    SetLayersDirty();
+
     // Determine whether a sprite or just a pixel-based MO
     MOSprite *pMOSprite = dynamic_cast<MOSprite *>(pMObject);
 
@@ -1440,6 +1452,194 @@ void SLTerrain::RegisterTerrainChange(TerrainObject *pTObject)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          QueueSettlingObject
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Adds a MovableObject that is settling into the terrain this frame.
+
+void SLTerrain::QueueSettlingObject(MovableObject *pMObject)
+{
+    if (!pMObject)
+        return;
+
+    MOSprite *pMOSprite = dynamic_cast<MOSprite *>(pMObject);
+    if (pMOSprite)
+    {
+        // Too big to fit the settle buffers, so do it the old way
+        if (pMOSprite->GetDiameter() * 2 > SETTLEMAXSPRITESIZE)
+        {
+            ApplyMovableObject(pMObject);
+            return;
+        }
+    }
+    else
+    {
+        // Single pixels are cheap to just draw straight in, and settling gold needs to see the gold settled right before it
+        pMObject->Draw(GetFGColorBitmap(), Vector(), g_DrawColor, true);
+        pMObject->Draw(GetMaterialBitmap(), Vector(), g_DrawMaterial, true);
+        SetLayersDirty();
+    }
+
+    m_SettlingObjects.push_back(pMObject);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FlushSettlingObjects
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Composites all the sprites queued by QueueSettlingObject into the
+//                  terrain, and reports the areas changed by everything queued.
+
+void SLTerrain::FlushSettlingObjects()
+{
+    if (m_SettlingObjects.empty())
+        return;
+
+    SetLayersDirty();
+
+    BITMAP *pFGColor = GetFGColorBitmap();
+    BITMAP *pMaterial = GetMaterialBitmap();
+    int tilesAcross = pMaterial->w / SETTLETILESIZE + 1;
+    int tilesDown = pMaterial->h / SETTLETILESIZE + 1;
+
+    // Sort by tile, and by queue order within each tile
+    vector<pair<int, int> > tileOrder;
+    tileOrder.reserve(m_SettlingObjects.size());
+    for (int i = 0; i < m_SettlingObjects.size(); ++i)
+    {
+        Vector pos = m_SettlingObjects[i]->GetPos().GetFloored();
+        int tileX = MID(0, (int)pos.m_X / SETTLETILESIZE, tilesAcross - 1);
+        int tileY = MID(0, (int)pos.m_Y / SETTLETILESIZE, tilesDown - 1);
+        tileOrder.push_back(pair<int, int>(tileY * tilesAcross + tileX, i));
+    }
+    sort(tileOrder.begin(), tileOrder.end());
+
+    // The unwrapped areas changed in each tile, as left, top, right, bottom (exclusive)
+    vector<RECT> dirtyRects;
+
+    vector<pair<int, int> >::iterator groupStart = tileOrder.begin();
+    while (groupStart != tileOrder.end())
+    {
+        vector<pair<int, int> >::iterator groupEnd = groupStart;
+        RECT bounds = { LONG_MAX, LONG_MAX, LONG_MIN, LONG_MIN };
+        bool hasSprites = false;
+        for (; groupEnd != tileOrder.end() && groupEnd->first == groupStart->first; ++groupEnd)
+        {
+            MovableObject *pMO = m_SettlingObjects[groupEnd->second];
+            Vector pos = pMO->GetPos().GetFloored();
+            // Pixels only cover themselves, sprites their diameter around the pos, just like the temp bitmaps of ApplyMovableObject
+            int extent = 0;
+            if (MOSprite *pMOSprite = dynamic_cast<MOSprite *>(pMO))
+            {
+                extent = (int)ceil(pMOSprite->GetDiameter()) + 1;
+                hasSprites = true;
+            }
+            bounds.left = MIN(bounds.left, (long)pos.m_X - extent);
+            bounds.top = MIN(bounds.top, (long)pos.m_Y - extent);
+            bounds.right = MAX(bounds.right, (long)pos.m_X + extent + 1);
+            bounds.bottom = MAX(bounds.bottom, (long)pos.m_Y + extent + 1);
+        }
+
+        int width = bounds.right - bounds.left;
+        int height = bounds.bottom - bounds.top;
+        if (hasSprites && (width > m_spSettleColorBuffer->w || height > m_spSettleColorBuffer->h))
+        {
+            // Too spread out for the settle buffers, so apply the sprites in queue order the old way, which reports its own changes
+            for (vector<pair<int, int> >::iterator oItr = groupStart; oItr != groupEnd; ++oItr)
+            {
+                MovableObject *pMO = m_SettlingObjects[oItr->second];
+                if (dynamic_cast<MOSprite *>(pMO))
+                    ApplyMovableObject(pMO);
+            }
+        }
+        else if (hasSprites)
+        {
+            Vector bufferCorner(bounds.left, bounds.top);
+
+            rectfill(m_spSettleColorBuffer, 0, 0, width - 1, height - 1, g_KeyColor);
+            rectfill(m_spSettleMaterialBuffer, 0, 0, width - 1, height - 1, g_MaterialAir);
+
+            // Drawn last to first, so the ones queued first end up on top, just as if each had been applied to the terrain in turn
+            for (vector<pair<int, int> >::iterator oItr = groupEnd; oItr != groupStart;)
+            {
+                --oItr;
+                MovableObject *pMO = m_SettlingObjects[oItr->second];
+                if (!dynamic_cast<MOSprite *>(pMO))
+                    continue;
+                pMO->Draw(m_spSettleColorBuffer, bufferCorner, g_DrawColor, true);
+                pMO->Draw(m_spSettleMaterialBuffer, bufferCorner, g_DrawMaterial, true);
+            }
+
+            // Composite with the terrain on top: only fill in where the terrain is empty
+            for (int y = 0; y < height; ++y)
+            {
+                int sceneY = bounds.top + y;
+                if (sceneY < 0 || sceneY >= pMaterial->h)
+                {
+                    if (!m_WrapY)
+                        continue;
+                    sceneY = (sceneY + pMaterial->h) % pMaterial->h;
+                }
+
+                unsigned char *pSrcColor = m_spSettleColorBuffer->line[y];
+                unsigned char *pSrcMaterial = m_spSettleMaterialBuffer->line[y];
+                unsigned char *pDestColor = pFGColor->line[sceneY];
+                unsigned char *pDestMaterial = pMaterial->line[sceneY];
+                for (int x = 0; x < width; ++x)
+                {
+                    if (pSrcColor[x] == g_KeyColor && pSrcMaterial[x] == g_MaterialAir)
+                        continue;
+
+                    int sceneX = bounds.left + x;
+                    if (sceneX < 0 || sceneX >= pMaterial->w)
+                    {
+                        if (!m_WrapX)
+                            continue;
+                        sceneX = (sceneX + pMaterial->w) % pMaterial->w;
+                    }
+
+                    if (pSrcColor[x] != g_KeyColor && pDestColor[sceneX] == g_KeyColor)
+                        pDestColor[sceneX] = pSrcColor[x];
+                    if (pSrcMaterial[x] != g_MaterialAir && pDestMaterial[sceneX] == g_MaterialAir)
+                        pDestMaterial[sceneX] = pSrcMaterial[x];
+                }
+            }
+        }
+
+        dirtyRects.push_back(bounds);
+        groupStart = groupEnd;
+    }
+
+    // Merge any overlapping or touching areas, so neighbouring tiles don't get reported twice
+    for (int i = 0; i < dirtyRects.size(); ++i)
+    {
+        for (int j = i + 1; j < dirtyRects.size(); ++j)
+        {
+            if (dirtyRects[i].left <= dirtyRects[j].right && dirtyRects[j].left <= dirtyRects[i].right &&
+                dirtyRects[i].top <= dirtyRects[j].bottom && dirtyRects[j].top <= dirtyRects[i].bottom)
+            {
+                dirtyRects[i].left = MIN(dirtyRects[i].left, dirtyRects[j].left);
+                dirtyRects[i].top = MIN(dirtyRects[i].top, dirtyRects[j].top);
+                dirtyRects[i].right = MAX(dirtyRects[i].right, dirtyRects[j].right);
+                dirtyRects[i].bottom = MAX(dirtyRects[i].bottom, dirtyRects[j].bottom);
+                dirtyRects.erase(dirtyRects.begin() + j);
+                // The grown area may now touch ones already passed over
+                j = i;
+            }
+        }
+    }
+
+    // The same merged list goes to both the pathfinding and the network
+    for (vector<RECT>::iterator rItr = dirtyRects.begin(); rItr != dirtyRects.end(); ++rItr)
+    {
+        m_UpdatedMateralAreas.push_back(Box(Vector(rItr->left, rItr->top), rItr->right - rItr->left, rItr->bottom - rItr->top));
+        g_SceneMan.RegisterTerrainChange(rItr->left, rItr->top, rItr->right - rItr->left, rItr->bottom - rItr->top, g_KeyColor, false);
+    }
+
+    m_SettlingObjects.clear();
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  ApplyTerrainObject
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1483,6 +1683,7 @@ void SLTerrain::ApplyTerrainObject(TerrainObject *pTObject)
 
     // Add a box to the updated areas list to show there's been change to the materials layer
     m_UpdatedMateralAreas.push_back(Box(loc, pTObject->GetMaterialBitmap()->w, pTObject->GetMaterialBitmap()->h));
+    SetLayersDirty(pTObject->HasBGColor());
 
     // Apply all the child objects of the TO, and first reapply the team so all its children are guaranteed to be on the same team!
     pTObject->SetTeam(pTObject->GetTeam());
@@ -1527,6 +1728,7 @@ bool SLTerrain::IsBoxBuried(const Box &checkBox) const
 
 void SLTerrain::CleanAirBox(Box box, bool wrapsX, bool wrapsY)
 {
+    SetLayersDirty();
     acquire_bitmap(m_pMainBitmap);
     acquire_bitmap(m_pFGColor->GetBitmap());
 
@@ -1587,6 +1789,8 @@ void SLTerrain::CleanAir()
 {
     SLICK_PROFILE(0xFF225486);
 
+    SetLayersDirty();
+
     acquire_bitmap(m_pMainBitmap);
     acquire_bitmap(m_pFGColor->GetBitmap());
 
@@ -1621,6 +1825,7 @@ void SLTerrain::ClearAllMaterial()
 {
     clear_to_color(m_pMainBitmap, g_KeyColor);
     clear_to_color(m_pFGColor->GetBitmap(), g_MaterialAir);
+    SetLayersDirty();
 }
 
 
@@ -562,16 +562,6 @@ ENTITYALLOCATION(SLTerrain)
     void SetMaterialPixel(const int pixelX, const int pixelY, const unsigned char material);
 
 
-//////////////////////////////////////////////////////////////////////////////////////////
-// Method:          GetStructuralBitmap
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Gets the structural bitmap of this Terrain.
-// Arguments:       None.
-// Return value:    A pointer to the material bitmap.
-
-    BITMAP * GetStructuralBitmap() { return m_pStructural; }
-
-
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          GetToDrawMaterial
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -661,6 +651,35 @@ ENTITYALLOCATION(SLTerrain)
 	virtual void RegisterTerrainChange(TerrainObject *pTObject);
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          QueueSettlingObject
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Adds a MovableObject that is settling into the terrain this frame.
+//                  Single pixels are drawn right away so the ones after them see them,
+//                  while sprites are held until FlushSettlingObjects composites them all
+//                  in one go. Sprites too big to batch are applied right away with
+//                  ApplyMovableObject.
+// Arguments:       The MovableObject to settle. Ownership is NOT xferred, but it must be
+//                  kept alive until after the next call to FlushSettlingObjects!
+// Return value:    None.
+
+    void QueueSettlingObject(MovableObject *pMObject);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FlushSettlingObjects
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Composites all the sprites queued by QueueSettlingObject into the
+//                  terrain, sorted by region so each touched tile is only gone over
+//                  once. The areas changed by everything queued are then merged into one
+//                  list of boxes, used for both the updated material areas and the
+//                  network terrain changes.
+// Arguments:       None.
+// Return value:    None.
+
+    void FlushSettlingObjects();
+
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          AddUpdatedMaterialArea
@@ -671,7 +690,20 @@ ENTITYALLOCATION(SLTerrain)
 //                  and may be out of bounds of the scene.
 // Return value:    None.
 
-    void AddUpdatedMaterialArea(const Box &newArea) { m_UpdatedMateralAreas.push_back(newArea); }
+    void AddUpdatedMaterialArea(const Box &newArea) { m_UpdatedMateralAreas.push_back(newArea); SetDataDirty(); }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetLayersDirty
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Marks the material and FG color layers as changed, so they get
+//                  written out again by the next SaveData. Anything drawing directly
+//                  onto the bitmaps of this terrain that should end up in saves has to
+//                  call this.
+// Arguments:       Whether the BG color layer was changed too.
+// Return value:    None.
+
+    void SetLayersDirty(bool background = false) { SetDataDirty(); m_pFGColor->SetDataDirty(); if (background) m_pBGColor->SetDataDirty(); }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -777,6 +809,34 @@ ENTITYALLOCATION(SLTerrain)
 
     virtual void Draw(BITMAP *pTargetBitmap, Box& targetBox, const Vector &scrollOverride = Vector(-1, -1)) const;
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawBackgroundAtOffset
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws this SLTerrain's background color layer to a bitmap as if it
+//                  had been scrolled to a specific offset. Safe to do from several
+//                  threads at once to separate target bitmaps.
+// Arguments:       The bitmap to draw to.
+//                  The box on the target bitmap to limit drawing to.
+//                  The offset to draw the layer at.
+// Return value:    None.
+
+    void DrawBackgroundAtOffset(BITMAP *pTargetBitmap, Box &targetBox, const Vector &layerOffset) const { m_pBGColor->DrawAtOffset(pTargetBitmap, targetBox, layerOffset); }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawForegroundAtOffset
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws this SLTerrain's foreground color layer to a bitmap as if it
+//                  had been scrolled to a specific offset. Safe to do from several
+//                  threads at once to separate target bitmaps.
+// Arguments:       The bitmap to draw to.
+//                  The box on the target bitmap to limit drawing to.
+//                  The offset to draw the layer at.
+// Return value:    None.
+
+    void DrawForegroundAtOffset(BITMAP *pTargetBitmap, Box &targetBox, const Vector &layerOffset) const { m_pFGColor->DrawAtOffset(pTargetBitmap, targetBox, layerOffset); }
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Protected member variable and method declarations
 
@@ -787,7 +847,6 @@ protected:
 
     SceneLayer *m_pFGColor;
     SceneLayer *m_pBGColor;
-    BITMAP *m_pStructural;
     ContentFile m_BGTextureFile;
 
     std::list<TerrainFrosting> m_TerrainFrostings;
@@ -801,6 +860,9 @@ protected:
     // Draw the material layer instead of the color layer.
     bool m_DrawMaterial;
 
+    // The MovableObject:s queued to settle this frame, in the order they were queued. Not owned!
+    std::vector<MovableObject *> m_SettlingObjects;
+
     // Intermediate test layers, deffernt sizes for efficiency
     static BITMAP *m_spTempBitmap16;
     static BITMAP *m_spTempBitmap32;
@@ -808,6 +870,9 @@ protected:
     static BITMAP *m_spTempBitmap128;
     static BITMAP *m_spTempBitmap256;
     static BITMAP *m_spTempBitmap512;
+    // Scratch color and material layers that a whole tile's worth of settling sprites are drawn to before being composited into the terrain
+    static BITMAP *m_spSettleColorBuffer;
+    static BITMAP *m_spSettleMaterialBuffer;
 
 	// Indicates, that before processing frostings-related properties for this terrain
 	// derived list with frostings must be cleared to avoid duplication when loading scenes
@@ -446,6 +446,10 @@ void Scene::Clear()
         m_apUnseenLayer[team] = 0;
         m_SeenPixels[team].clear();
         m_CleanedPixels[team].clear();
+        m_UnseenBits[team].clear();
+        m_UnseenBitsRowWords[team] = 0;
+        m_apUnseenBitsSource[team] = 0;
+        m_UnseenBitsDirty[team] = true;
         m_ScanScheduled[team] = false;
     }
 	m_AreaList.clear();
@@ -609,6 +613,7 @@ int Scene::LoadData(bool placeObjects, bool initPathfinding, bool placeUnits)
                 return -1;
             }
         }
+        InvalidateUnseenBits(team);
     }
 
 	m_SelectedAssemblies.clear();
@@ -840,6 +845,8 @@ int Scene::LoadData(bool placeObjects, bool initPathfinding, bool placeUnits)
                                 int scaledH = ceilf(pTO->GetFGColorBitmap()->h * scale.m_Y);
                                 // Fill the box with key color for the owner ownerTeam, revealing the area that this thing is on
                                 rectfill(m_apUnseenLayer[ownerTeam]->GetBitmap(), scaledX, scaledY, scaledX + scaledW, scaledY + scaledH, g_KeyColor);
+                                m_apUnseenLayer[ownerTeam]->SetDataDirty();
+                                InvalidateUnseenBits(ownerTeam);
                                 // Expand the box a little so the whole placed object is going to be hidden
                                 scaledX -= 1;
                                 scaledY -= 1;
@@ -849,7 +856,11 @@ int Scene::LoadData(bool placeObjects, bool initPathfinding, bool placeUnits)
                                 for (int t = Activity::TEAM_1; t < Activity::MAXTEAMCOUNT; ++t)
                                 {
                                     if (t != ownerTeam && m_apUnseenLayer[t] && m_apUnseenLayer[t]->GetBitmap())
+                                    {
                                         rectfill(m_apUnseenLayer[t]->GetBitmap(), scaledX, scaledY, scaledX + scaledW, scaledY + scaledH, g_BlackColor);
+                                        m_apUnseenLayer[t]->SetDataDirty();
+                                        InvalidateUnseenBits(t);
+                                    }
                                 }
                             }
                         }
@@ -1034,7 +1045,7 @@ int Scene::SaveData(string pathBase)
         {
             sprintf(str, "T%d", team);
             // Save unseen layer data to disk
-            if (m_apUnseenLayer[team]->SaveData(pathBase + " US" + str + ".bmp") < 0)
+            if (m_apUnseenLayer[team]->SaveData(pathBase + " US" + str + COMPRESSEDLAYEREXT) < 0)
             {
                 g_ConsoleMan.PrintString("ERROR: Saving unseen layer " + m_apUnseenLayer[team]->GetPresetName() + "\'s data failed!");
                 return -1;
@@ -1803,6 +1814,7 @@ void Scene::FillUnseenLayer(Vector pixelSize, int team, bool createNow)
         m_apUnseenLayer[team]->Create(pUnseenBitmap, true, Vector(), WrapsX(), WrapsY(), Vector(1.0, 1.0));
         // Calculate how many times smaller the unseen map is compared to the entire terrain's dimensions, and set it as the scale factor on the Unseen layer
         m_apUnseenLayer[team]->SetScaleFactor(Vector((float)GetTerrain()->GetBitmap()->w / (float)m_apUnseenLayer[team]->GetBitmap()->w, (float)GetTerrain()->GetBitmap()->h / (float)m_apUnseenLayer[team]->GetBitmap()->h));
+        InvalidateUnseenBits(team);
     }
 }
 
@@ -1822,6 +1834,7 @@ void Scene::SetUnseenLayer(SceneLayer *pNewLayer, int team)
     m_apUnseenLayer[team] = pNewLayer;
     // Calculate how many times smaller the unseen map is compared to the entire terrain's dimensions, and set it as the scale factor on the Unseen layer
     m_apUnseenLayer[team]->SetScaleFactor(Vector((float)GetTerrain()->GetBitmap()->w / (float)m_apUnseenLayer[team]->GetBitmap()->w, (float)GetTerrain()->GetBitmap()->h / (float)m_apUnseenLayer[team]->GetBitmap()->h));
+    InvalidateUnseenBits(team);
 }
 
 
@@ -1839,7 +1852,7 @@ void Scene::ClearSeenPixels(int team)
         {
             for (list<Vector>::iterator itr = m_SeenPixels[team].begin(); itr != m_SeenPixels[team].end(); ++itr)
             {
-                putpixel(m_apUnseenLayer[team]->GetBitmap(), (*itr).m_X, (*itr).m_Y, g_KeyColor);
+                SetUnseenPixel((*itr).m_X, (*itr).m_Y, g_KeyColor, team);
 
                 // Clean up around the removed pixels too
                 CleanOrphanPixel((*itr).m_X + 1, (*itr).m_Y, W, team);
@@ -1874,80 +1887,50 @@ void Scene::ClearSeenPixels(int team)
 
 bool Scene::CleanOrphanPixel(int posX, int posY, NeighborDirection checkingFrom, int team)
 {
-    if (team == Activity::NOTEAM || !m_apUnseenLayer[team])
+    int rowWords;
+    const unsigned int *pBits = team != Activity::NOTEAM ? GetUnseenBits(team, rowWords) : 0;
+    if (!pBits)
         return false;
 
+    const SceneLayer *pLayer = m_apUnseenLayer[team];
+    int width = pLayer->GetBitmap()->w;
+    int height = pLayer->GetBitmap()->h;
+    bool wrapX = pLayer->WrapsX();
+    bool wrapY = pLayer->WrapsY();
+
     // Do any necessary wrapping
-    m_apUnseenLayer[team]->WrapPosition(posX, posY, false);
+    pLayer->WrapPosition(posX, posY, false);
 
     // First check the actual position of the checked pixel, it may already been seen.
-    if (getpixel(m_apUnseenLayer[team]->GetBitmap(), posX, posY) == g_KeyColor)
+    if (posX < 0 || posX >= width || posY < 0 || posY >= height || !(pBits[posY * rowWords + (posX >> 5)] & (1U << (posX & 31))))
         return false;
 
-    // Ok, not seen, so check surrounding pixels for 'support', ie unseen ones that will keep this also unseen
+    // The neighbors that can lend 'support', ie unseen ones that will keep this also unseen. Diagonal ones count for half
+    static const int neighbors[8][3] = { {1, 0, E}, {-1, 0, W}, {0, 1, S}, {0, -1, N}, {1, 1, SE}, {-1, 1, SW}, {-1, -1, NW}, {1, -1, NE} };
     float support = 0;
-    int testPosX, testPosY;
-    if (checkingFrom != E)
-    {
-        testPosX = posX + 1;
-        testPosY = posY;
-        m_apUnseenLayer[team]->WrapPosition(testPosX, testPosY, false);
-        support += getpixel(m_apUnseenLayer[team]->GetBitmap(), testPosX, testPosY) != g_KeyColor ? 1 : 0;
-    }
-    if (checkingFrom != W)
-    {
-        testPosX = posX - 1;
-        testPosY = posY;
-        m_apUnseenLayer[team]->WrapPosition(testPosX, testPosY, false);
-        support += getpixel(m_apUnseenLayer[team]->GetBitmap(), testPosX, testPosY) != g_KeyColor ? 1 : 0;
-    }
-    if (checkingFrom != S)
-    {
-        testPosX = posX;
-        testPosY = posY + 1;
-        m_apUnseenLayer[team]->WrapPosition(testPosX, testPosY, false);
-        support += getpixel(m_apUnseenLayer[team]->GetBitmap(), testPosX, testPosY) != g_KeyColor ? 1 : 0;
-    }
-    if (checkingFrom != N)
-    {
-        testPosX = posX;
-        testPosY = posY - 1;
-        m_apUnseenLayer[team]->WrapPosition(testPosX, testPosY, false);
-        support += getpixel(m_apUnseenLayer[team]->GetBitmap(), testPosX, testPosY) != g_KeyColor ? 1 : 0;
-    }
-    if (checkingFrom != SE)
-    {
-        testPosX = posX + 1;
-        testPosY = posY + 1;
-        m_apUnseenLayer[team]->WrapPosition(testPosX, testPosY, false);
-        support += getpixel(m_apUnseenLayer[team]->GetBitmap(), testPosX, testPosY) != g_KeyColor ? 0.5f : 0;
-    }
-    if (checkingFrom != SW)
-    {
-        testPosX = posX - 1;
-        testPosY = posY + 1;
-        m_apUnseenLayer[team]->WrapPosition(testPosX, testPosY, false);
-        support += getpixel(m_apUnseenLayer[team]->GetBitmap(), testPosX, testPosY) != g_KeyColor ? 0.5f : 0;
-    }
-    if (checkingFrom != NW)
-    {
-        testPosX = posX - 1;
-        testPosY = posY - 1;
-        m_apUnseenLayer[team]->WrapPosition(testPosX, testPosY, false);
-        support += getpixel(m_apUnseenLayer[team]->GetBitmap(), testPosX, testPosY) != g_KeyColor ? 0.5f : 0;
-    }
-    if (checkingFrom != NE)
+    for (int n = 0; n < 8; ++n)
     {
-        testPosX = posX + 1;
-        testPosY = posY - 1;
-        m_apUnseenLayer[team]->WrapPosition(testPosX, testPosY, false);
-        support += getpixel(m_apUnseenLayer[team]->GetBitmap(), testPosX, testPosY) != g_KeyColor ? 0.5f : 0;
+        if (checkingFrom == neighbors[n][2])
+            continue;
+
+        // The neighbors are never more than a pixel off the layer, so wrapping is a single step
+        int testPosX = posX + neighbors[n][0];
+        int testPosY = posY + neighbors[n][1];
+        if (wrapX)
+            testPosX = testPosX < 0 ? testPosX + width : (testPosX >= width ? testPosX - width : testPosX);
+        if (wrapY)
+            testPosY = testPosY < 0 ? testPosY + height : (testPosY >= height ? testPosY - height : testPosY);
+
+        // Off the edge of the layer counts as unseen
+        bool unseen = testPosX < 0 || testPosX >= width || testPosY < 0 || testPosY >= height || (pBits[testPosY * rowWords + (testPosX >> 5)] & (1U << (testPosX & 31)));
+        if (unseen)
+            support += n < 4 ? 1 : 0.5f;
     }
 
     // Orphaned enough to remove?
     if (support <= 2.5)
     {
-        putpixel(m_apUnseenLayer[team]->GetBitmap(), posX, posY, g_KeyColor);
+        SetUnseenPixel(posX, posY, g_KeyColor, team);
         m_CleanedPixels[team].push_back(Vector(posX, posY));
         return true;
     }    
@@ -1956,6 +1939,92 @@ bool Scene::CleanOrphanPixel(int posX, int posY, NeighborDirection checkingFrom,
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetUnseenBits
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the packed copy of a team's unseen layer, rebuilding it first if
+//                  the layer has been changed in bulk since the last time.
+
+const unsigned int * Scene::GetUnseenBits(int team, int &rowWords)
+{
+    BITMAP *pUnseenBitmap = m_apUnseenLayer[team] ? m_apUnseenLayer[team]->GetBitmap() : 0;
+    if (!pUnseenBitmap)
+        return 0;
+
+    if (m_UnseenBitsDirty[team] || m_apUnseenBitsSource[team] != pUnseenBitmap)
+    {
+        int width = pUnseenBitmap->w;
+        int height = pUnseenBitmap->h;
+        m_UnseenBitsRowWords[team] = (width + 31) >> 5;
+        m_UnseenBits[team].assign(m_UnseenBitsRowWords[team] * height, 0);
+
+        bool direct = bitmap_color_depth(pUnseenBitmap) == 8 && is_memory_bitmap(pUnseenBitmap);
+        for (int y = 0; y < height; ++y)
+        {
+            unsigned int *pRow = &m_UnseenBits[team][y * m_UnseenBitsRowWords[team]];
+            const unsigned char *pLine = pUnseenBitmap->line[y];
+            for (int x = 0; x < width; ++x)
+            {
+                if ((direct ? pLine[x] : getpixel(pUnseenBitmap, x, y)) != g_KeyColor)
+                    pRow[x >> 5] |= 1U << (x & 31);
+            }
+        }
+
+        m_apUnseenBitsSource[team] = pUnseenBitmap;
+        m_UnseenBitsDirty[team] = false;
+    }
+
+    rowWords = m_UnseenBitsRowWords[team];
+    return m_UnseenBits[team].empty() ? 0 : &m_UnseenBits[team][0];
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsUnseenPixel
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Checks whether a pixel of a team's unseen layer is still unseen.
+
+bool Scene::IsUnseenPixel(int posX, int posY, int team)
+{
+    int rowWords;
+    const unsigned int *pBits = team != Activity::NOTEAM ? GetUnseenBits(team, rowWords) : 0;
+    if (!pBits)
+        return false;
+
+    const BITMAP *pUnseenBitmap = m_apUnseenLayer[team]->GetBitmap();
+    if (posX < 0 || posX >= pUnseenBitmap->w || posY < 0 || posY >= pUnseenBitmap->h)
+        return true;
+
+    return (pBits[posY * rowWords + (posX >> 5)] & (1U << (posX & 31))) != 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetUnseenPixel
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets the color of a pixel on a team's unseen layer, keeping its packed
+//                  bits in step.
+
+void Scene::SetUnseenPixel(int posX, int posY, int color, int team)
+{
+    int rowWords;
+    if (team == Activity::NOTEAM || !GetUnseenBits(team, rowWords))
+        return;
+
+    BITMAP *pUnseenBitmap = m_apUnseenLayer[team]->GetBitmap();
+    if (posX < 0 || posX >= pUnseenBitmap->w || posY < 0 || posY >= pUnseenBitmap->h)
+        return;
+
+    putpixel(pUnseenBitmap, posX, posY, color);
+    m_apUnseenLayer[team]->SetDataDirty();
+    unsigned int &word = m_UnseenBits[team][posY * rowWords + (posX >> 5)];
+    if (color != g_KeyColor)
+        word |= 1U << (posX & 31);
+    else
+        word &= ~(1U << (posX & 31));
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          GetDimensions
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -3122,7 +3191,7 @@ void Scene::Update()
 			{
 				for (list<Vector>::iterator itr = m_SeenPixels[team].begin(); itr != m_SeenPixels[team].end(); ++itr)
 				{
-					putpixel(m_apUnseenLayer[team]->GetBitmap(), (*itr).m_X, (*itr).m_Y, g_WhiteColor);
+					SetUnseenPixel((*itr).m_X, (*itr).m_Y, g_WhiteColor, team);
 				}
 			}
 		}
@@ -786,6 +786,57 @@ ENTITYALLOCATION(Scene)
     bool CleanOrphanPixel(int posX, int posY, NeighborDirection checkingFrom = NODIR, int team = Activity::TEAM_1);
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetUnseenBits
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the packed copy of a team's unseen layer, which has one bit per
+//                  pixel of the layer that is set while that pixel is still unseen. Each
+//                  row starts on a new word. The copy is rebuilt from the layer first if
+//                  it has been changed in bulk since the last time.
+// Arguments:       Which team to get the unseen bits of.
+//                  Gets set to how many words each row of bits takes up.
+// Return value:    The first word of the bits, or 0 if the team has no unseen layer.
+//                  Only good until the unseen layer is changed in bulk again.
+
+    const unsigned int * GetUnseenBits(int team, int &rowWords);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          InvalidateUnseenBits
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Notes that a team's unseen layer has been drawn on directly, so its
+//                  packed bits have to be rebuilt before they're used next.
+// Arguments:       Which team's unseen layer was changed.
+// Return value:    None.
+
+    void InvalidateUnseenBits(int team) { if (team != Activity::NOTEAM) { m_UnseenBitsDirty[team] = true; } }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsUnseenPixel
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Checks whether a pixel of a team's unseen layer is still unseen. Pixels
+//                  off the layer count as unseen.
+// Arguments:       The coordinates of the pixel, in the unseen layer's scale.
+//                  Which team's unseen layer to check.
+// Return value:    Whether the pixel is unseen.
+
+    bool IsUnseenPixel(int posX, int posY, int team = Activity::TEAM_1);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetUnseenPixel
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets the color of a pixel on a team's unseen layer, keeping its packed
+//                  bits in step.
+// Arguments:       The coordinates of the pixel, in the unseen layer's scale.
+//                  The color to set, g_KeyColor to make the pixel seen.
+//                  Which team's unseen layer to change.
+// Return value:    None.
+
+    void SetUnseenPixel(int posX, int posY, int color, int team = Activity::TEAM_1);
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          GetDimensions
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1458,6 +1509,12 @@ protected:
     std::list<Vector> m_SeenPixels[Activity::MAXTEAMCOUNT];
     // Pixels on the unseen map deemed to be orphans and cleaned up, will be moved to seen pixels next update
     std::list<Vector> m_CleanedPixels[Activity::MAXTEAMCOUNT];
+    // Packed copies of the unseen layers, one bit per pixel that is set while the pixel is unseen, and how many words each row takes
+    std::vector<unsigned int> m_UnseenBits[Activity::MAXTEAMCOUNT];
+    int m_UnseenBitsRowWords[Activity::MAXTEAMCOUNT];
+    // The bitmap each copy was made of, and whether that has been drawn on directly since. Not owned
+    BITMAP *m_apUnseenBitsSource[Activity::MAXTEAMCOUNT];
+    bool m_UnseenBitsDirty[Activity::MAXTEAMCOUNT];
     // Whether this Scene is scheduled to be orbitally scanned by any team
     bool m_ScanScheduled[Activity::MAXTEAMCOUNT];
 
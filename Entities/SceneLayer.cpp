@@ -13,6 +13,17 @@
 
 #include "SceneLayer.h"
 #include "ContentFile.h"
+#include "ConsoleMan.h"
+#include "ThreadMan.h"
+
+#include "lz4.h"
+#include "lz4hc.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 using namespace std;
 
@@ -21,6 +32,89 @@ namespace RTE
 
 CONCRETECLASSINFO(SceneLayer, Entity, 0)
 
+// Compressed layer file header; followed by LAYERBANDCOUNT ints with the compressed size of each band, then the bands themselves
+#define LAYERFILEMAGIC 0x4C455452 // "RTEL"
+#define LAYERFILEVERSION 1
+// How many rows of pixels are compressed together; bands are independent so they can be decompressed in parallel
+#define LAYERBANDHEIGHT 64
+
+struct LayerFileHeader
+{
+    int Magic;
+    int Version;
+    int Width;
+    int Height;
+    int ColorDepth;
+    int BandHeight;
+    int BandCount;
+};
+
+// Allegro's C stretcher keeps its state in a file static, so split screens drawing scaled layers at once have to take turns
+static mutex s_StretchBlitMutex;
+
+// Copy of a layer's pixels taken on the main thread, so the background thread can write it out while the game keeps changing the original
+struct LayerSnapshot
+{
+    int Width;
+    int Height;
+    int ColorDepth;
+    int RowBytes;
+    vector<char> Pixels;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Function:        SaveLayerSnapshot
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Compresses and writes a layer snapshot to disk. Runs on the background
+//                  thread, so must not touch Allegro or any of the managers. Writes to
+//                  a temp file first so a half-written layer never replaces a good one.
+
+int SaveLayerSnapshot(const LayerSnapshot &snapshot, const string &filePath)
+{
+    LayerFileHeader header;
+    header.Magic = LAYERFILEMAGIC;
+    header.Version = LAYERFILEVERSION;
+    header.Width = snapshot.Width;
+    header.Height = snapshot.Height;
+    header.ColorDepth = snapshot.ColorDepth;
+    header.BandHeight = LAYERBANDHEIGHT;
+    header.BandCount = (snapshot.Height + LAYERBANDHEIGHT - 1) / LAYERBANDHEIGHT;
+
+    vector<int> bandSizes(header.BandCount, 0);
+    vector<char> compressed;
+    vector<char> bandBuffer(LZ4_compressBound(LAYERBANDHEIGHT * snapshot.RowBytes));
+    for (int band = 0; band < header.BandCount; ++band)
+    {
+        int firstRow = band * LAYERBANDHEIGHT;
+        int rows = min(LAYERBANDHEIGHT, snapshot.Height - firstRow);
+        bandSizes[band] = LZ4_compress_HC(&snapshot.Pixels[firstRow * snapshot.RowBytes], &bandBuffer[0], rows * snapshot.RowBytes, bandBuffer.size(), LZ4HC_CLEVEL_DEFAULT);
+        if (bandSizes[band] <= 0)
+            return -1;
+        compressed.insert(compressed.end(), bandBuffer.begin(), bandBuffer.begin() + bandSizes[band]);
+    }
+
+    string tempPath = filePath + ".tmp";
+    FILE *pFile = fopen(tempPath.c_str(), "wb");
+    if (!pFile)
+        return -1;
+
+    bool written = fwrite(&header, sizeof(LayerFileHeader), 1, pFile) == 1 &&
+                   fwrite(&bandSizes[0], sizeof(int), bandSizes.size(), pFile) == bandSizes.size() &&
+                   fwrite(&compressed[0], 1, compressed.size(), pFile) == compressed.size();
+    written = fclose(pFile) == 0 && written;
+
+    if (!written)
+    {
+        remove(tempPath.c_str());
+        return -1;
+    }
+
+    // Swap the finished file in place of any old one
+    remove(filePath.c_str());
+    return rename(tempPath.c_str(), filePath.c_str()) == 0 ? 0 : -1;
+}
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Clear
@@ -46,6 +140,7 @@ void SceneLayer::Clear()
     m_FillRightColor = g_KeyColor;
     m_FillUpColor = g_KeyColor;
     m_FillDownColor = g_KeyColor;
+    m_DataDirty = true;
 }
 
 
@@ -201,6 +296,7 @@ int SceneLayer::Create(const SceneLayer &reference)
     m_FillRightColor = reference.m_FillRightColor;
     m_FillUpColor = reference.m_FillUpColor;
     m_FillDownColor = reference.m_FillDownColor;
+    m_DataDirty = reference.m_DataDirty;
 
     return 0;
 }
@@ -226,8 +322,26 @@ int SceneLayer::LoadData()
     // Copy!
     blit(pCopyFrom, m_pMainBitmap, 0, 0, 0, 0, pCopyFrom->w, pCopyFrom->h);
 */
-    // Re-load directly from disk each time; don't do any caching of these bitmaps
-    m_pMainBitmap = m_BitmapFile.LoadAndReleaseBitmap();
+    const string &dataPath = m_BitmapFile.GetDataPath();
+    if (dataPath.size() > strlen(COMPRESSEDLAYEREXT) && dataPath.compare(dataPath.size() - strlen(COMPRESSEDLAYEREXT), string::npos, COMPRESSEDLAYEREXT) == 0)
+    {
+        // The file may still be in the process of being written by an earlier SaveData, and this collects how that went
+        if (g_ThreadMan.WaitForBackgroundTasks() > 0)
+            g_ConsoleMan.PrintString("ERROR: Failed to write some of the Scene data of the previous save!");
+        m_pMainBitmap = LoadCompressedBitmap(dataPath);
+        if (!m_pMainBitmap)
+        {
+            DDTAbort("Failed to load compressed layer data file:\n\n" + dataPath);
+            return -1;
+        }
+        // This is what's on disk now, so no need to write it out again until it has changed
+        m_DataDirty = false;
+    }
+    else
+    {
+        // Re-load directly from disk each time; don't do any caching of these bitmaps
+        m_pMainBitmap = m_BitmapFile.LoadAndReleaseBitmap();
+    }
 
     m_MainBitmapOwned = true;
 
@@ -256,19 +370,118 @@ int SceneLayer::SaveData(string bitmapPath)
     // Save out the bitmap
     if (m_pMainBitmap)
     {
-        PALETTE palette;
-        get_palette(palette);
-        if (save_bmp(bitmapPath.c_str(), m_pMainBitmap, palette) != 0)
-            return -1;
+        // Skip the write entirely if nothing has changed since the data was last put in the very same file
+        if (!m_DataDirty && bitmapPath == m_BitmapFile.GetDataPath())
+            return 0;
+
+        if (bitmapPath.size() > strlen(COMPRESSEDLAYEREXT) && bitmapPath.compare(bitmapPath.size() - strlen(COMPRESSEDLAYEREXT), string::npos, COMPRESSEDLAYEREXT) == 0)
+        {
+            // Take a snapshot of the pixels so the background thread isn't racing the game for them
+            shared_ptr<LayerSnapshot> pSnapshot(new LayerSnapshot);
+            pSnapshot->Width = m_pMainBitmap->w;
+            pSnapshot->Height = m_pMainBitmap->h;
+            pSnapshot->ColorDepth = bitmap_color_depth(m_pMainBitmap);
+            pSnapshot->RowBytes = m_pMainBitmap->w * ((pSnapshot->ColorDepth + 7) / 8);
+            pSnapshot->Pixels.resize(pSnapshot->RowBytes * pSnapshot->Height);
+            for (int y = 0; y < pSnapshot->Height; ++y)
+                memcpy(&pSnapshot->Pixels[y * pSnapshot->RowBytes], m_pMainBitmap->line[y], pSnapshot->RowBytes);
+
+            g_ThreadMan.QueueBackgroundTask([pSnapshot, bitmapPath]() { return SaveLayerSnapshot(*pSnapshot, bitmapPath); });
+        }
+        else
+        {
+            PALETTE palette;
+            get_palette(palette);
+            if (save_bmp(bitmapPath.c_str(), m_pMainBitmap, palette) != 0)
+                return -1;
+        }
 
-        // Set the new path to point to the new file location - only if there was a successful save of the bitmap
+        // Set the new path to point to the new file location - only if there was a successful save (or queued save) of the bitmap
         m_BitmapFile.SetDataPath(bitmapPath);
+        m_DataDirty = false;
     }
 
     return 0;
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Static method:   LoadCompressedBitmap
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Loads a bitmap from a compressed layer file written by SaveData.
+
+BITMAP * SceneLayer::LoadCompressedBitmap(const string &filePath)
+{
+    FILE *pFile = fopen(filePath.c_str(), "rb");
+    if (!pFile)
+        return 0;
+
+    LayerFileHeader header;
+    if (fread(&header, sizeof(LayerFileHeader), 1, pFile) != 1 || header.Magic != LAYERFILEMAGIC || header.Version != LAYERFILEVERSION ||
+        header.Width <= 0 || header.Height <= 0 || header.BandHeight <= 0 || header.BandCount != (header.Height + header.BandHeight - 1) / header.BandHeight)
+    {
+        fclose(pFile);
+        return 0;
+    }
+
+    vector<int> bandSizes(header.BandCount);
+    if (fread(&bandSizes[0], sizeof(int), header.BandCount, pFile) != (size_t)header.BandCount)
+    {
+        fclose(pFile);
+        return 0;
+    }
+
+    BITMAP *pBitmap = create_bitmap_ex(header.ColorDepth, header.Width, header.Height);
+    if (!pBitmap)
+    {
+        fclose(pFile);
+        return 0;
+    }
+    int rowBytes = header.Width * ((header.ColorDepth + 7) / 8);
+
+    // Read the bands in one after the other, handing each off to be decompressed as soon as enough of them have arrived to keep the pool busy
+    atomic<bool> failed(false);
+    int batchSize = g_ThreadMan.GetWorkerCount() * 2;
+    vector<vector<char> > batch(batchSize);
+    for (int firstBand = 0; firstBand < header.BandCount && !failed; firstBand += batchSize)
+    {
+        int bandsInBatch = min(batchSize, header.BandCount - firstBand);
+        for (int i = 0; i < bandsInBatch; ++i)
+        {
+            batch[i].resize(bandSizes[firstBand + i] > 0 ? bandSizes[firstBand + i] : 1);
+            if (bandSizes[firstBand + i] <= 0 || fread(&batch[i][0], 1, bandSizes[firstBand + i], pFile) != (size_t)bandSizes[firstBand + i])
+                failed = true;
+        }
+        if (failed)
+            break;
+
+        g_ThreadMan.ParallelFor(bandsInBatch, [&](int i)
+        {
+            int band = firstBand + i;
+            int firstRow = band * header.BandHeight;
+            int rows = min(header.BandHeight, header.Height - firstRow);
+            vector<char> pixels(rows * rowBytes);
+            if (LZ4_decompress_safe(&batch[i][0], &pixels[0], bandSizes[band], pixels.size()) != (int)pixels.size())
+            {
+                failed = true;
+                return;
+            }
+            for (int row = 0; row < rows; ++row)
+                memcpy(pBitmap->line[firstRow + row], &pixels[row * rowBytes], rowBytes);
+        });
+    }
+
+    fclose(pFile);
+
+    if (failed)
+    {
+        destroy_bitmap(pBitmap);
+        return 0;
+    }
+    return pBitmap;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  ClearData
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -590,6 +803,18 @@ struct SLDrawBox
 // Description:     Draws this SceneLayer's current scrolled position to a bitmap.
 
 void SceneLayer::Draw(BITMAP *pTargetBitmap, Box& targetBox, const Vector &scrollOverride) const
+{
+    DrawAtOffset(pTargetBitmap, targetBox, m_Offset, scrollOverride);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawAtOffset
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws this SceneLayer to a bitmap as if it had been scrolled to a
+//                  specific offset, without touching the offset actually set on it.
+
+void SceneLayer::DrawAtOffset(BITMAP *pTargetBitmap, Box& targetBox, const Vector &layerOffset, const Vector &scrollOverride) const
 {
     SLICK_PROFILE(0xFF687233);
 
@@ -616,8 +841,8 @@ void SceneLayer::Draw(BITMAP *pTargetBitmap, Box& targetBox, const Vector &scrol
     // Regular scroll
     else
     {
-        offsetX = floorf(m_Offset.m_X * m_ScrollRatio.m_X);
-        offsetY = floorf(m_Offset.m_Y * m_ScrollRatio.m_Y);
+        offsetX = floorf(layerOffset.m_X * m_ScrollRatio.m_X);
+        offsetY = floorf(layerOffset.m_Y * m_ScrollRatio.m_Y);
         // Only force bounds when doing regular scroll offset because the override is used to do terrain object application tricks and sometimes needs the offsets to be < 0
 //        ForceBounds(offsetX, offsetY);
         WrapPosition(offsetX, offsetY);
@@ -748,15 +973,32 @@ void SceneLayer::Draw(BITMAP *pTargetBitmap, Box& targetBox, const Vector &scrol
 //                  scaled according to what has been set with SetScaleFactor.
 
 void SceneLayer::DrawScaled(BITMAP *pTargetBitmap, Box &targetBox, const Vector &scrollOverride) const
+{
+    // If no scaling, use the regular scaling routine
+    if (m_ScaleFactor.m_X == 1.0 && m_ScaleFactor.m_Y == 1.0)
+        return Draw(pTargetBitmap, targetBox, scrollOverride);
+
+    DrawScaledAtOffset(pTargetBitmap, targetBox, m_Offset, scrollOverride);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawScaledAtOffset
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws this SceneLayer scaled to a bitmap as if it had been scrolled to
+//                  a specific offset, without touching the offset actually set on it.
+
+void SceneLayer::DrawScaledAtOffset(BITMAP *pTargetBitmap, Box &targetBox, const Vector &layerOffset, const Vector &scrollOverride) const
 {
     SLICK_PROFILE(0xFF687233);
 
     // If no scaling, use the regular scaling routine
     if (m_ScaleFactor.m_X == 1.0 && m_ScaleFactor.m_Y == 1.0)
-        return Draw(pTargetBitmap, targetBox, scrollOverride);
+        return DrawAtOffset(pTargetBitmap, targetBox, layerOffset, scrollOverride);
 
     DAssert(m_pMainBitmap, "Data of this SceneLayer has not been loaded before trying to draw!");
 
+    lock_guard<mutex> stretchLock(s_StretchBlitMutex);
 
 /*
 
@@ -804,8 +1046,8 @@ void SceneLayer::DrawScaled(BITMAP *pTargetBitmap, Box &targetBox, const Vector
     // Regular scroll
     else
     {
-        offsetX = floorf(m_Offset.m_X * m_ScrollRatio.m_X);
-        offsetY = floorf(m_Offset.m_Y * m_ScrollRatio.m_Y);
+        offsetX = floorf(layerOffset.m_X * m_ScrollRatio.m_X);
+        offsetY = floorf(layerOffset.m_Y * m_ScrollRatio.m_Y);
         // Only force bounds when doing regular scroll offset because the override is used to do terrain object application tricks and sometimes needs the offsets to be < 0
 //        ForceBounds(offsetX, offsetY);
         WrapPosition(offsetX, offsetY);
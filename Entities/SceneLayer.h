@@ -27,6 +27,9 @@ using std::string;
 #include "SceneMan.h"
 //#include "MovableMan.h"
 
+// The extension used for the LZ4-compressed layer data files written by SaveData
+#define COMPRESSEDLAYEREXT ".lyr"
+
 namespace RTE
 {
 /*
@@ -185,7 +188,12 @@ ENTITYALLOCATION(SceneLayer)
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  SaveData
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Saves data currently in memory to disk.
+// Description:     Saves data currently in memory to disk. If the path ends with
+//                  COMPRESSEDLAYEREXT, a snapshot of the bitmap is taken and then
+//                  compressed and written by ThreadMan's background thread, so the
+//                  file may not be complete when this returns. Nothing is written if
+//                  the data hasn't changed since it was last loaded from or saved to
+//                  the same path.
 // Arguments:       The filepath to the where to save the Bitmap data.
 // Return value:    An error return value signaling success or any particular failure.
 //                  Anything below 0 is an error signal.
@@ -214,6 +222,18 @@ ENTITYALLOCATION(SceneLayer)
     virtual bool IsFileData() const { return !m_BitmapFile.GetDataPath().empty();  }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Static method:   LoadCompressedBitmap
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Loads a bitmap from a compressed layer file written by SaveData. The
+//                  file is read band by band, and the bands are decompressed in
+//                  parallel straight into the rows of the new bitmap.
+// Arguments:       The path to the compressed layer file.
+// Return value:    The loaded bitmap, OWNERSHIP IS TRANSFERRED! 0 if loading failed.
+
+    static BITMAP * LoadCompressedBitmap(const std::string &filePath);
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  ReadProperty
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -321,6 +341,29 @@ ENTITYALLOCATION(SceneLayer)
 	size_t GetBitmapHash() const { return m_BitmapFile.GetHash(); }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetDataDirty
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Marks whether the bitmap data has been changed since it was last loaded
+//                  or saved, and so needs to be written out again by SaveData. Anything
+//                  drawing onto the bitmap gotten from GetBitmap has to call this.
+// Arguments:       Whether the data has been changed.
+// Return value:    None.
+
+    void SetDataDirty(bool dirty = true) { m_DataDirty = dirty; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsDataDirty
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Shows whether the bitmap data has been changed since it was last
+//                  loaded or saved.
+// Arguments:       None.
+// Return value:    Whether the data needs to be written out again.
+
+    bool IsDataDirty() const { return m_DataDirty; }
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          GetOffset
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -573,6 +616,40 @@ ENTITYALLOCATION(SceneLayer)
     virtual void DrawScaled(BITMAP *pTargetBitmap, Box &targetBox, const Vector &scrollOverride = Vector(-1, -1)) const;
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawAtOffset
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws this SceneLayer to a bitmap as if it had been scrolled to a
+//                  specific offset, without touching the offset actually set on it.
+//                  Several threads can draw the same layer this way at once, each at
+//                  their own offset and to their own target bitmap.
+// Arguments:       The bitmap to draw to.
+//                  The box on the target bitmap to limit drawing to, with the corner of
+//                  box being where the scroll position lines up.
+//                  The offset to draw this at, as would otherwise be set with SetOffset.
+//                  If a non-{-1,-1} vector is passed, the scroll offset is overridden
+//                  with it. It becomes the new source coordinates.
+// Return value:    None.
+
+    void DrawAtOffset(BITMAP *pTargetBitmap, Box &targetBox, const Vector &layerOffset, const Vector &scrollOverride = Vector(-1, -1)) const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawScaledAtOffset
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Same as DrawAtOffset, but also scaled according to what has been set
+//                  with SetScaleFactor.
+// Arguments:       The bitmap to draw to.
+//                  The box on the target bitmap to limit drawing to, with the corner of
+//                  box being where the scroll position lines up.
+//                  The offset to draw this at, as would otherwise be set with SetOffset.
+//                  If a non-{-1,-1} vector is passed, the scroll offset is overridden
+//                  with it. It becomes the new source coordinates.
+// Return value:    None.
+
+    void DrawScaledAtOffset(BITMAP *pTargetBitmap, Box &targetBox, const Vector &layerOffset, const Vector &scrollOverride = Vector(-1, -1)) const;
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Protected member variable and method declarations
 
@@ -641,6 +718,8 @@ protected:
     int m_FillRightColor;
     int m_FillUpColor;
     int m_FillDownColor;
+    // Whether the bitmap data may differ from what was last loaded from or saved to the path in m_BitmapFile
+    bool m_DataDirty;
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
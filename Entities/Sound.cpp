@@ -47,6 +47,7 @@ void Sound::Clear()
 #endif
     m_CurrentSample = 0;
     m_LastChannel = -1;
+    m_Queued = false;
     m_Loops = 0;
     m_Priority = AudioMan::PRIORITY_LOW;
     m_AffectedByPitch = true;
@@ -87,6 +88,7 @@ int Sound::Create(const Sound &reference)
 
     m_CurrentSample = reference.m_CurrentSample;
     m_LastChannel = -1;
+    m_Queued = false;
     m_Loops = reference.m_Loops;
     m_Priority = reference.m_Priority;
     m_AffectedByPitch = reference.m_AffectedByPitch;
@@ -205,6 +207,10 @@ void Sound::Destroy(bool notInherited)
 {
     // Don't delete samples since they are owned in the CoententFile static maps
 
+    // A queued play still goes ahead, there's just nothing to tell its channel anymore
+    if (m_Queued)
+        g_AudioMan.UnqueueSound(this, false);
+
     if (!notInherited)
         Entity::Destroy();
     Clear();
@@ -457,6 +457,8 @@ protected:
     int m_CurrentSample;
     // Current channel the current Sample of this Sound is being played on.
     int m_LastChannel;
+    // Whether the current Sample is waiting in AudioMan's queue to be given a channel at the end of the frame
+    bool m_Queued;
     // Number of loops (repeats) the sound should play when played. 0 means it plays once, -1 means it plays until stopped 
     int m_Loops;
     // The mixing priority of this, the higher the more likely it's to be mixed and heard
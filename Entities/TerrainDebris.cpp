@@ -219,6 +219,7 @@ void TerrainDebris::ApplyDebris(SLTerrain *pTerrain)
 
     acquire_bitmap(pTerrBitmap);
     acquire_bitmap(pMatBitmap);
+    pTerrain->SetLayersDirty();
 
     int terrainWidth = pTerrBitmap->w;
     // How many pieces of debris we're spreading out.
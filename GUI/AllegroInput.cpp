@@ -31,21 +31,27 @@ using namespace RTE;
 AllegroInput::AllegroInput(int whichPlayer, bool keyJoyMouseCursor):
     GUIInput(whichPlayer, keyJoyMouseCursor)
 {
-    install_keyboard();
-    // Hack to not have the keyboard lose focus permanently when window is started without focus
-//    win_grab_input();
-    install_mouse();
+#ifndef GUI_STANDALONE
+    // Without a window there's no keyboard or mouse to get going
+    if (!g_FrameMan.IsHeadless())
+#endif
+    {
+        install_keyboard();
+        // Hack to not have the keyboard lose focus permanently when window is started without focus
+//        win_grab_input();
+        install_mouse();
 
 #ifndef GUI_STANDALONE
-    // Set the speed of the mouse
-    float mouseDenominator = g_FrameMan.IsFullscreen() ? g_FrameMan.NxFullscreen() : g_FrameMan.NxWindowed();
-    // If Nx fullscreen, adjust the mouse speed accordingly
-    if (g_FrameMan.IsFullscreen() && g_FrameMan.NxFullscreen() > 1)
-        set_mouse_speed(1, 1);
-    else
-        set_mouse_speed(2, 2);
-    set_mouse_range(0, 0, (g_FrameMan.GetResX() * mouseDenominator) - 3, (g_FrameMan.GetResY() * mouseDenominator) - 3);
+        // Set the speed of the mouse
+        float mouseDenominator = g_FrameMan.IsFullscreen() ? g_FrameMan.NxFullscreen() : g_FrameMan.NxWindowed();
+        // If Nx fullscreen, adjust the mouse speed accordingly
+        if (g_FrameMan.IsFullscreen() && g_FrameMan.NxFullscreen() > 1)
+            set_mouse_speed(1, 1);
+        else
+            set_mouse_speed(2, 2);
+        set_mouse_range(0, 0, (g_FrameMan.GetResX() * mouseDenominator) - 3, (g_FrameMan.GetResY() * mouseDenominator) - 3);
 #endif
+    }
     //set_mouse_speed(1, 1);
     //set_mouse_range(0, 0, (g_FrameMan.GetResX() * mouseDenominator) - 3, (g_FrameMan.GetResY() * mouseDenominator) - 3);
 
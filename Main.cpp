@@ -32,12 +32,12 @@
 
 #include "Network.h"
 
-#include <DebugTool/DebugTool.h>
-#include <Profiler/Profiler.h>
+#include "FrameProfiler.h"
 
 #include <algorithm>
 #include <string>
 #include <list>
+#include <vector>
 
 #include "Reader.h"
 #include "Writer.h"
@@ -146,6 +146,58 @@ int g_StationOffsetX, g_StationOffsetY;
 
 std::string g_LoadSingleModule = "";
 
+// The seed benchmarks run with unless another one is passed with -seed
+#define BENCHMARKSEED 1337
+
+// Whether we're running a headless benchmark instead of the game, set up by -benchmark
+bool g_BenchmarkMode = false;
+std::string g_BenchmarkScene = "";
+int g_BenchmarkFrameCount = 0;
+// Scripted spawns; this many of the actor preset is dropped into each active team at the start
+int g_BenchmarkActorsPerTeam = 0;
+std::string g_BenchmarkActorPreset = "";
+// And the explosive preset gets gibbed somewhere on the scene every this many frames
+int g_BenchmarkExplosionInterval = 0;
+std::string g_BenchmarkExplosionPreset = "";
+// Path of the results files, without the extension
+std::string g_BenchmarkOutput = "Benchmark";
+
+// The steps of each frame that get timed during a benchmark
+enum BenchmarkTimings
+{
+    BENCH_INPUT = 0,
+    BENCH_FRAMEMAN,
+    BENCH_AUDIO,
+    BENCH_LUA,
+    BENCH_ACTIVITY,
+    BENCH_MOVABLES,
+    BENCH_GLOBALSCRIPTS,
+    BENCH_CONSOLE,
+    BENCH_DRAW,
+    BENCH_FLIP,
+    BENCH_COUNT
+};
+
+const char *g_BenchmarkTimingNames[BENCH_COUNT] = { "UInputMan", "FrameMan", "AudioMan", "LuaMan", "ActivityMan", "MovableMan", "GlobalScripts", "ConsoleMan", "Draw", "Flip" };
+
+// Everything measured during one benchmark frame, all times in microseconds
+struct BenchmarkFrame
+{
+    // The FrameMan performance counters of the sim update(s) of this frame
+    int64_t m_PerfCounters[FrameMan::PERF_COUNT];
+    // Time spent in each timed step of the frame
+    int64_t m_Timings[BENCH_COUNT];
+    // Time of the whole frame
+    int64_t m_Total;
+    int m_MOIDCount;
+    long m_ParticleCount;
+};
+
+std::vector<BenchmarkFrame> g_BenchmarkFrames;
+BenchmarkFrame g_BenchmarkFrame;
+int64_t g_BenchmarkFrameStart = 0;
+int64_t g_BenchmarkLapStart = 0;
+
 MainMenuGUI *g_pMainMenuGUI = 0;
 ScenarioGUI *g_pScenarioGUI = 0;
 GUIControlManager *g_pLoadingGUI = 0;
@@ -272,7 +324,8 @@ void LoadingSplashProgressReport(std::string reportString, bool newItem = false)
 			vline(g_pLoadingGUIBitmap, g_pLoadingGUIBitmap->w - 2, g_pLoadingGUIBitmap->h - 12, g_pLoadingGUIBitmap->h - 2, 33);
 			vline(g_pLoadingGUIBitmap, g_pLoadingGUIBitmap->w - 1, g_pLoadingGUIBitmap->h - 12, g_pLoadingGUIBitmap->h - 2, 33);
 
-			// Draw onto current frame buffer
+			// Draw onto current frame buffer, once the last game frame is done with it
+			g_FrameMan.WaitForPresent();
 			blit(g_pLoadingGUIBitmap, g_FrameMan.GetBackBuffer32(), 0, 0, g_LoadingGUIPosX, g_LoadingGUIPosY, g_pLoadingGUIBitmap->w, g_pLoadingGUIBitmap->h);
 
 			g_FrameMan.FlipFrameBuffers();
@@ -903,6 +956,247 @@ void EnterMultiplayerLobby()
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Set up the benchmark activity and scene to be started by the next ResetActivity
+
+bool StartBenchmark()
+{
+    if (!g_PresetMan.GetEntityPreset(g_ActivityMan.GetDefaultActivityType(), g_ActivityMan.GetDefaultActivityName()))
+    {
+        g_ConsoleMan.PrintString("ERROR: Can't benchmark, there's no Activity named " + g_ActivityMan.GetDefaultActivityName() + "!");
+        return false;
+    }
+    if (g_SceneMan.SetSceneToLoad(g_BenchmarkScene) < 0)
+        return false;
+
+    // Reseed with the fixed seed so the loading above didn't throw off the randoms, and step the sim exactly once per frame
+    // so each run simulates the same thing no matter how fast or slow the machine is
+    SeedRand();
+    g_TimerMan.SetOneSimUpdatePerFrame(true);
+    g_TimerMan.SetFixedSimStep(true);
+
+    g_BenchmarkFrames.clear();
+    g_BenchmarkFrames.reserve(g_BenchmarkFrameCount);
+
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Gets a random position on the surface of the scene, some distance above the ground
+
+Vector GetBenchmarkSpawnPos()
+{
+    Vector spawnPos(RangeRand(0, g_SceneMan.GetSceneWidth()), 0);
+    return g_SceneMan.MovePointToGround(spawnPos, 20, 5);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Start timing a new benchmark frame, and do the scripted spawns that are due
+
+void BeginBenchmarkFrame()
+{
+    if (!g_BenchmarkMode || !g_InActivity)
+        return;
+
+    g_BenchmarkFrame = BenchmarkFrame();
+    g_BenchmarkFrameStart = g_BenchmarkLapStart = g_TimerMan.GetAbsoulteTime();
+
+    int frame = g_BenchmarkFrames.size();
+    Activity *pActivity = g_ActivityMan.GetActivity();
+
+    if (frame == 0 && g_BenchmarkActorsPerTeam > 0 && pActivity)
+    {
+        const Actor *pPreset = dynamic_cast<const Actor *>(g_PresetMan.GetEntityPreset("Actor", g_BenchmarkActorPreset));
+        if (!pPreset)
+            g_ConsoleMan.PrintString("ERROR: Can't spawn benchmark actors, there's no Actor named " + g_BenchmarkActorPreset + "!");
+        for (int team = Activity::TEAM_1; pPreset && team < Activity::MAXTEAMCOUNT; ++team)
+        {
+            if (!pActivity->TeamActive(team))
+                continue;
+
+            for (int i = 0; i < g_BenchmarkActorsPerTeam; ++i)
+            {
+                Actor *pActor = dynamic_cast<Actor *>(pPreset->Clone());
+                pActor->SetTeam(team);
+                pActor->SetControllerMode(Controller::CIM_AI);
+                pActor->SetPos(GetBenchmarkSpawnPos());
+                g_MovableMan.AddActor(pActor);
+            }
+        }
+    }
+
+    if (g_BenchmarkExplosionInterval > 0 && frame % g_BenchmarkExplosionInterval == 0)
+    {
+        const MOSRotating *pPreset = dynamic_cast<const MOSRotating *>(g_PresetMan.GetEntityPreset("MOSRotating", g_BenchmarkExplosionPreset));
+        if (pPreset)
+        {
+            MOSRotating *pExplosive = dynamic_cast<MOSRotating *>(pPreset->Clone());
+            pExplosive->SetPos(GetBenchmarkSpawnPos());
+            g_MovableMan.AddParticle(pExplosive);
+            pExplosive->GibThis();
+        }
+        // Only complain once
+        else if (frame == 0)
+            g_ConsoleMan.PrintString("ERROR: Can't spawn benchmark explosions, there's no MOSRotating named " + g_BenchmarkExplosionPreset + "!");
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Adds the time since the last lap to one of the timed steps of the benchmark frame
+
+void BenchmarkLap(BenchmarkTimings timing)
+{
+    if (!g_BenchmarkMode)
+        return;
+
+    int64_t now = g_TimerMan.GetAbsoulteTime();
+    g_BenchmarkFrame.m_Timings[timing] += now - g_BenchmarkLapStart;
+    g_BenchmarkLapStart = now;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Adds the FrameMan performance counters of the sim update that just finished to the benchmark frame
+
+void RecordBenchmarkSimUpdate()
+{
+    if (!g_BenchmarkMode)
+        return;
+
+    for (int counter = 0; counter < FrameMan::PERF_COUNT; ++counter)
+        g_BenchmarkFrame.m_PerfCounters[counter] += g_FrameMan.GetPerformanceCounterSample((FrameMan::PerformanceCounters)counter);
+    // Don't count the time since the last lap into whatever step is timed next
+    g_BenchmarkLapStart = g_TimerMan.GetAbsoulteTime();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Writes out all the benchmark frames measured so far as CSV and JSON
+
+bool WriteBenchmarkResults()
+{
+    int frameCount = g_BenchmarkFrames.size();
+    std::string activityName = g_ActivityMan.GetDefaultActivityName();
+
+    // Gather the column names, and the averages and peaks of each column
+    std::vector<std::string> columns;
+    for (int counter = 0; counter < FrameMan::PERF_COUNT; ++counter)
+        columns.push_back("Perf " + g_FrameMan.GetPerformanceCounterName((FrameMan::PerformanceCounters)counter));
+    for (int timing = 0; timing < BENCH_COUNT; ++timing)
+        columns.push_back(g_BenchmarkTimingNames[timing]);
+    columns.push_back("Frame");
+    columns.push_back("MOIDs");
+    columns.push_back("Particles");
+
+    std::vector<std::vector<double> > rows(frameCount);
+    std::vector<double> averages(columns.size(), 0);
+    std::vector<double> peaks(columns.size(), 0);
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        const BenchmarkFrame &data = g_BenchmarkFrames[frame];
+        std::vector<double> &row = rows[frame];
+        for (int counter = 0; counter < FrameMan::PERF_COUNT; ++counter)
+            row.push_back((double)data.m_PerfCounters[counter]);
+        for (int timing = 0; timing < BENCH_COUNT; ++timing)
+            row.push_back((double)data.m_Timings[timing]);
+        row.push_back((double)data.m_Total);
+        row.push_back(data.m_MOIDCount);
+        row.push_back(data.m_ParticleCount);
+
+        for (int column = 0; column < columns.size(); ++column)
+        {
+            averages[column] += row[column] / frameCount;
+            peaks[column] = std::max(peaks[column], row[column]);
+        }
+    }
+
+    // The CSV is just the raw frames, one row each
+    FILE *pFile = fopen((g_BenchmarkOutput + ".csv").c_str(), "w");
+    if (!pFile)
+    {
+        g_ConsoleMan.PrintString("ERROR: Couldn't write the benchmark results to " + g_BenchmarkOutput + ".csv!");
+        return false;
+    }
+    fprintf(pFile, "Frame Number");
+    for (int column = 0; column < columns.size(); ++column)
+        fprintf(pFile, ",%s", columns[column].c_str());
+    fprintf(pFile, "\n");
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        fprintf(pFile, "%i", frame);
+        for (int column = 0; column < columns.size(); ++column)
+            fprintf(pFile, ",%.0f", rows[frame][column]);
+        fprintf(pFile, "\n");
+    }
+    fclose(pFile);
+
+    // The JSON also has what was run and a summary up front, so it can be compared against other runs without any crunching
+    pFile = fopen((g_BenchmarkOutput + ".json").c_str(), "w");
+    if (!pFile)
+    {
+        g_ConsoleMan.PrintString("ERROR: Couldn't write the benchmark results to " + g_BenchmarkOutput + ".json!");
+        return false;
+    }
+    fprintf(pFile, "{\n");
+    fprintf(pFile, "\t\"activity\": \"%s\",\n", activityName.c_str());
+    fprintf(pFile, "\t\"scene\": \"%s\",\n", g_BenchmarkScene.c_str());
+    fprintf(pFile, "\t\"seed\": %u,\n", GetRandSeed());
+    fprintf(pFile, "\t\"frames\": %i,\n", frameCount);
+    fprintf(pFile, "\t\"units\": \"microseconds\",\n");
+    fprintf(pFile, "\t\"columns\": [");
+    for (int column = 0; column < columns.size(); ++column)
+        fprintf(pFile, "%s\"%s\"", column > 0 ? ", " : "", columns[column].c_str());
+    fprintf(pFile, "],\n");
+    fprintf(pFile, "\t\"average\": [");
+    for (int column = 0; column < columns.size(); ++column)
+        fprintf(pFile, "%s%.1f", column > 0 ? ", " : "", averages[column]);
+    fprintf(pFile, "],\n");
+    fprintf(pFile, "\t\"peak\": [");
+    for (int column = 0; column < columns.size(); ++column)
+        fprintf(pFile, "%s%.0f", column > 0 ? ", " : "", peaks[column]);
+    fprintf(pFile, "],\n");
+    fprintf(pFile, "\t\"rows\": [\n");
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        fprintf(pFile, "\t\t[");
+        for (int column = 0; column < columns.size(); ++column)
+            fprintf(pFile, "%s%.0f", column > 0 ? ", " : "", rows[frame][column]);
+        fprintf(pFile, "]%s\n", frame < frameCount - 1 ? "," : "");
+    }
+    fprintf(pFile, "\t]\n}\n");
+    fclose(pFile);
+
+    char report[512];
+    sprintf(report, "Benchmark of %i frames written to %s.csv/.json", frameCount, g_BenchmarkOutput.c_str());
+    g_ConsoleMan.PrintString(report);
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Finish timing the benchmark frame, and wrap up the benchmark once all frames are done
+
+void EndBenchmarkFrame()
+{
+    if (!g_BenchmarkMode || !g_InActivity)
+        return;
+
+    g_BenchmarkFrame.m_Total = g_TimerMan.GetAbsoulteTime() - g_BenchmarkFrameStart;
+    g_BenchmarkFrame.m_MOIDCount = g_MovableMan.GetMOIDCount();
+    g_BenchmarkFrame.m_ParticleCount = g_MovableMan.GetParticleCount();
+    g_BenchmarkFrames.push_back(g_BenchmarkFrame);
+
+    if ((int)g_BenchmarkFrames.size() >= g_BenchmarkFrameCount)
+    {
+        WriteBenchmarkResults();
+        g_Quit = true;
+    }
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Load and display the into, title and menu sequence
 
@@ -2325,6 +2619,8 @@ bool RunGameLoop()
     g_FrameMan.ResetFrameTimer();
     g_TimerMan.EnableAveraging(true);
     g_TimerMan.PauseSim(false);
+    // AudioMan gets updated every sim frame from here on, so it can gather up each frame's one-shot sounds
+    g_AudioMan.SetSoundQueueing(true);
 // Done in ResetActivity
 //    g_ActivityMan.GetActivity()->StartActivity();
     if (g_ResetActivity)
@@ -2335,15 +2631,11 @@ bool RunGameLoop()
         SLICK_PROFILENAME("Game Loop", 0xFFFF0000);
 
         {
+            BeginBenchmarkFrame();
+
             // Need to clear this out; sometimes background layers don't cover the whole back
             g_FrameMan.ClearBackBuffer8();
 
-#ifdef SLICK_PROFILER
-            // Force to only one sim update for this graphics frame if the profiling tool is connected
-// Can switch this on and off in the console now
-//            g_TimerMan.SetOneSimUpdatePerFrame(Debug::DebugTool::Instance()->IsDebugToolConnected());
-#endif // SLICK_PROFILER
-
             // Update the real time measurement and increment
             g_TimerMan.Update();
 
@@ -2368,22 +2660,41 @@ bool RunGameLoop()
 					g_NetworkServer.Update(true);
 					serverUpdated = true;
 				}
+				BenchmarkLap(BENCH_INPUT);
 				g_FrameMan.Update();
+				BenchmarkLap(BENCH_FRAMEMAN);
 				g_AudioMan.Update();
+				BenchmarkLap(BENCH_AUDIO);
 				g_LuaMan.Update();
+				BenchmarkLap(BENCH_LUA);
 				g_FrameMan.StartPerformanceMeasurement(FrameMan::PERF_ACTIVITY);
 				g_ActivityMan.Update();
 				g_FrameMan.StopPerformanceMeasurement(FrameMan::PERF_ACTIVITY);
+				BenchmarkLap(BENCH_ACTIVITY);
 				g_MovableMan.Update();
+				g_SceneMan.StructuralCalc(g_SettingsMan.GetStructuralCalcTime());
+				BenchmarkLap(BENCH_MOVABLES);
 
 				g_ActivityMan.LateUpdateGlobalScripts();
+				BenchmarkLap(BENCH_GLOBALSCRIPTS);
 
 				g_ConsoleMan.Update();
+				BenchmarkLap(BENCH_CONSOLE);
 				g_FrameMan.StopPerformanceMeasurement(FrameMan::PERF_SIM_TOTAL);
+				RecordBenchmarkSimUpdate();
 
+                // A benchmark is over once its activity is, however many frames it got through
+                if (!g_InActivity && g_BenchmarkMode)
+                {
+                    WriteBenchmarkResults();
+                    g_Quit = true;
+                    break;
+                }
                 if (!g_InActivity)
                 {
 					g_TimerMan.PauseSim(true);
+					// The menus draw straight to the 32bpp buffer and screen, so the last game frame has to be out of the way first
+					g_FrameMan.WaitForPresent();
 					// If we're not in a metagame, then show main menu
 					if (g_MetaMan.GameInProgress())
 						g_IntroState = CAMPAIGNFADEIN;
@@ -2397,7 +2708,10 @@ bool RunGameLoop()
 						else
 							g_IntroState = MAINTOSCENARIO;
 					}
+					// The menus don't update AudioMan
+					g_AudioMan.SetSoundQueueing(false);
 					PlayIntroTitle();
+					g_AudioMan.SetSoundQueueing(true);
                 }
                 // Resetting the simulation
                 if (g_ResetActivity)
@@ -2445,21 +2759,29 @@ bool RunGameLoop()
 #endif // 
         }
 
+        // Start the one-shots played since the last AudioMan update now rather than a sim update later, and even if the sim is paused
+        g_AudioMan.FlushSoundQueue();
+
         // Frame draw update
         if (!g_Quit)
         {
             SLICK_PROFILENAME("Rendering Frame", 0xFFFF00FF);
             g_FrameMan.Draw();
+            BenchmarkLap(BENCH_DRAW);
             g_FrameMan.FlipFrameBuffers();
+            // Post processing may have been left to the frame thread, and has to count towards this frame's time too
+            if (g_BenchmarkMode)
+                g_FrameMan.WaitForPresent();
+            BenchmarkLap(BENCH_FLIP);
         }
+        EndBenchmarkFrame();
 
-// Slick Profiler updates - the debug tool needs to update BEFORE the profile system because control messages may have been sent.
-#ifdef SLICK_PROFILER
-        Debug::DebugTool::Instance()->Update();
-	    ProfileSystem::Instance()->Update();
-#endif
+        // Sum up what all threads spent their time on this frame, for the perf overlay
+        FrameProfiler::EndFrame();
     }
 
+    g_AudioMan.SetSoundQueueing(false);
+
     return true;
 }
 
@@ -2528,6 +2850,8 @@ bool HandleMainArgs(int argc, char *argv[], int &appExitVar)
         }
     }
 
+	bool seedPassed = false;
+
 	if (argc > 2)
 	{
 		for (int i = 1; i < argc; i++)
@@ -2543,9 +2867,49 @@ bool HandleMainArgs(int argc, char *argv[], int &appExitVar)
 			{
 				g_LoadSingleModule = argv[i + 1];
 			}
+
+			// Seed the rand with a fixed value instead of the time, so runs can be repeated
+			if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			{
+				SetFixedRandSeed(strtoul(argv[i + 1], 0, 10));
+				seedPassed = true;
+			}
+
+			// Run the activity in the scene for a number of frames without window or sound, then write out how long everything took
+			if (strcmp(argv[i], "-benchmark") == 0 && i + 3 < argc)
+			{
+				g_BenchmarkMode = true;
+				g_ActivityMan.SetDefaultActivityType("Activity");
+				g_ActivityMan.SetDefaultActivityName(argv[i + 1]);
+				g_BenchmarkScene = argv[i + 2];
+				g_BenchmarkFrameCount = atoi(argv[i + 3]);
+				g_SettingsMan.SetPlayIntro(false);
+				g_FrameMan.SetHeadless(true);
+			}
+
+			if (strcmp(argv[i], "-benchmarkactors") == 0 && i + 2 < argc)
+			{
+				g_BenchmarkActorsPerTeam = atoi(argv[i + 1]);
+				g_BenchmarkActorPreset = argv[i + 2];
+			}
+
+			if (strcmp(argv[i], "-benchmarkexplosions") == 0 && i + 2 < argc)
+			{
+				g_BenchmarkExplosionInterval = atoi(argv[i + 1]);
+				g_BenchmarkExplosionPreset = argv[i + 2];
+			}
+
+			if (strcmp(argv[i], "-benchmarkout") == 0 && i + 1 < argc)
+			{
+				g_BenchmarkOutput = argv[i + 1];
+			}
 		}
 	}
 
+	// Benchmarks always have to simulate the same thing to be comparable
+	if (g_BenchmarkMode && !seedPassed)
+		SetFixedRandSeed(BENCHMARKSEED);
+
 	/*
 	if (argc > 3)
 	{
@@ -2605,7 +2969,14 @@ int main(int argc, char *argv[])
     }
 */
     set_config_file("Base.rte/AllegroConfig.txt");
-    allegro_init();
+    // Benchmarks have to run on machines without any display, so don't let Allegro go looking for one
+    bool headless = false;
+    for (int i = 1; i < argc; ++i)
+        headless = headless || strcmp(argv[i], "-benchmark") == 0;
+    if (headless)
+        install_allegro(SYSTEM_NONE, &errno, atexit);
+    else
+        allegro_init();
     // Enable the exit button on the window
     LOCK_FUNCTION(QuitHandler);
     set_close_button_callback(QuitHandler);
@@ -2618,17 +2989,15 @@ int main(int argc, char *argv[])
 //    srand(100);
 
     ///////////////////////////////////////////////////////////////////
-    // Init the Slick Profiler
+    // Init the profiler
 
-#ifdef SLICK_PROFILER
-    Debug::DebugTool::Initialize();
-	ProfileSystem::Initialize();
-#endif
+    FrameProfiler::SetThreadName("Main");
 
     ///////////////////////////////////////////////////////////////////
     // Instantiate all the managers
 
     new ConsoleMan();
+    new ThreadMan();
     new LuaMan();
     new LicenseMan();
     new SettingsMan();
@@ -2673,7 +3042,9 @@ int main(int argc, char *argv[])
     g_TimerMan.Create();
     g_PresetMan.Create();
     g_FrameMan.Create();
-    g_AudioMan.Create();
+    // Benchmarks run without sound, which just leaves the AudioMan disabled
+    if (!g_BenchmarkMode)
+        g_AudioMan.Create();
     g_UInputMan.Create();
 	if (g_NetworkServer.IsServerModeEnabled())
 		g_UInputMan.SetMultiplayerMode(true);
@@ -2738,7 +3109,17 @@ int main(int argc, char *argv[])
 	}
 
     InitMainMenu();
-    if (g_SettingsMan.PlayIntro() && !g_NetworkServer.IsServerModeEnabled())
+    if (g_BenchmarkMode)
+    {
+        // No menus to fall back to if the benchmark can't be run, so just clean up and report failure
+        exitVar = (StartBenchmark() && ResetActivity()) ? 0 : 2;
+        if (exitVar != 0)
+        {
+            g_ConsoleMan.SaveAllText("LogConsole.txt");
+            g_Quit = true;
+        }
+    }
+    else if (g_SettingsMan.PlayIntro() && !g_NetworkServer.IsServerModeEnabled())
         PlayIntroTitle();
 
 	// NETWORK Create multiplayer lobby activity to start as default if server is running
@@ -2748,7 +3129,7 @@ int main(int argc, char *argv[])
 	}
 
     // If we fail to start/reset the activity, then revert to the intro/menu
-    if (!ResetActivity())
+    if (!g_BenchmarkMode && !ResetActivity())
         PlayIntroTitle();
 	
     RunGameLoop();
@@ -2765,6 +3146,8 @@ int main(int argc, char *argv[])
 	g_NetworkClient.Destroy();
 	g_NetworkServer.Destroy();
 
+    // Finish writing out any scene data still queued from saving
+    g_ThreadMan.Destroy();
     g_MetaMan.Destroy();
     g_MovableMan.Destroy();
     g_SceneMan.Destroy();
@@ -2791,15 +3174,10 @@ int main(int argc, char *argv[])
     Entity::ClassInfo::DumpPoolMemoryInfo(Writer("MemCleanupInfo.txt"));
 #endif // _DEBUG
 
-#ifdef SLICK_PROFILER
-	ProfileSystem::Finalize();
-	Debug::DebugTool::Finalize();
-#endif // SLICK_PROFILER
-
 #if defined(__APPLE__)
 	OsxUtil::Destroy();
 #endif // defined(__APPLE__)
 	
-    return 0;
+    return g_BenchmarkMode ? exitVar : 0;
 }
 END_OF_MAIN();
@@ -28,6 +28,8 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <cmath>
 
 
 // Allegro defines those via define in astdlib.h and Boost with stdlib go crazy about those so we need to undefine them manually.
@@ -106,6 +108,10 @@ void AudioMan::Clear()
 		m_SoundEvents[i].clear();
 		m_MusicEvents[i].clear();
 	}
+
+	m_SoundQueueing = false;
+	ClearSoundQueue();
+	m_ChannelVoices.clear();
 }
 
 
@@ -157,6 +163,8 @@ int AudioMan::Create()
         m_NormalFrequencies.push_back(FSOUND_GetFrequency(channel));
         m_PitchModifiers.push_back(1.0);
     }
+    ChannelVoice silentVoice = { PRIORITY_LOW, 0, false };
+    m_ChannelVoices.assign(channelCount, silentVoice);
 
     // Init the global pitch
     SetGlobalPitch(m_GlobalPitch);
@@ -199,6 +207,8 @@ int AudioMan::Create()
 		//m_NormalFrequencies.push_back(FSOUND_GetFrequency(channel));
 		m_PitchModifiers.push_back(1.0);
 	}
+	ChannelVoice silentVoice = { PRIORITY_LOW, 0, false };
+	m_ChannelVoices.assign(channelCount, silentVoice);
 
 	// Init the global pitch
 	SetGlobalPitch(m_GlobalPitch);
@@ -694,6 +704,10 @@ void AudioMan::RegisterMusicEvent(int player, unsigned char state, const char *f
 
 bool AudioMan::PlaySound(int player, Sound *pSound, int priority, float distance, double pitch)
 {
+	// One-shots don't need a channel number before the end of the frame, so all the identical ones in it can share one
+	if (m_SoundQueueing && pSound && pSound->m_Loops == 0)
+		return QueueSound(player, pSound, priority, distance, pitch);
+
 	// We need to play sound before registering a event because it will assign channel number to the sound being played
 	// clients then uses this number to identify the sound being played
 	bool ret = PlaySound(pSound, priority, distance, pitch);
@@ -726,6 +740,7 @@ bool AudioMan::PlaySound(Sound *pSound, int priority, float distance, double pit
         g_ConsoleMan.PrintString("ERROR: Could not play a sound sample!");
         return false;
     }
+    SetChannelVoice(pSound->m_LastChannel & 0x00000FFF, priority, distance, pSound->m_Loops != 0);
 
     // Set sample's channel looping setting
     if (pSound->m_Loops == 0)
@@ -780,6 +795,7 @@ bool AudioMan::PlaySound(Sound *pSound, int priority, float distance, double pit
 		g_ConsoleMan.PrintString("ERROR: Could not play a sound sample!");
 		return false;
 	}
+	SetChannelVoice(pSound->m_LastChannel, priority, distance, pSound->m_Loops != 0);
 
 	// Set sample's channel priority setting
 	// Sound is high enough to be 'reserved', can't be overridden at all
@@ -948,6 +964,10 @@ bool AudioMan::IsPlaying(Sound *pSound)
     if (!m_AudioEnabled || !pSound)
         return false;
 
+    // Will be playing by the end of the frame
+    if (pSound->m_Queued)
+        return true;
+
     if (pSound->GetSampleCount() <= 0 || pSound->m_LastChannel < 0)
         return false;
 
@@ -999,6 +1019,10 @@ bool AudioMan::StopSound(int player, Sound *pSound)
 
 bool AudioMan::StopSound(Sound *pSound)
 {
+	// Not started yet, so just don't
+	if (pSound && pSound->m_Queued)
+		return UnqueueSound(pSound, true);
+
 	if (!m_AudioEnabled || !pSound)
 		return false;
 
@@ -1119,6 +1143,9 @@ double AudioMan::GetMusicPosition()
 
 void AudioMan::StopAll()
 {
+	// Whatever was queued belongs to what is being stopped
+	ClearSoundQueue();
+
 	if (!m_AudioEnabled)
 		return;
 
@@ -1170,6 +1197,252 @@ void AudioMan::Update()
 	if (!m_pMusic && m_SilenceTimer.IsPastRealTimeLimit())
 		PlayNextStream();
 #endif
+
+	FlushSoundQueue();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          QueueSound
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Adds the next sample of a one-shot Sound to the frame's queue, merged
+//                  into an identical play queued close by if there is one.
+
+bool AudioMan::QueueSound(int player, Sound *pSound, int priority, float distance, double pitch)
+{
+	if ((!m_AudioEnabled && !m_IsInMultiplayerMode) || pSound->GetSampleCount() <= 0)
+		return false;
+
+	// The distance is already to the closest listener, so nobody would make this out over the rest of the mix
+	if (distance > SOUNDCULLDISTANCE && priority < PRIORITY_HIGH)
+		return false;
+
+	QueuedSound queued;
+	queued.m_pSample = pSound->StartNextSample();
+	queued.m_Hash = pSound->m_Hash;
+	queued.m_Sounds.push_back(pSound);
+	queued.m_Player = player;
+	queued.m_Priority = priority;
+	queued.m_Distance = distance;
+	queued.m_Pitch = pitch;
+	queued.m_AffectedByPitch = pSound->m_AffectedByPitch;
+
+	if (!queued.m_pSample)
+		return false;
+
+	for (std::vector<QueuedSound>::iterator qItr = m_SoundQueue.begin(); qItr != m_SoundQueue.end(); ++qItr)
+	{
+		if (qItr->m_pSample == queued.m_pSample && qItr->m_Player == player && qItr->m_AffectedByPitch == queued.m_AffectedByPitch && (!queued.m_AffectedByPitch || qItr->m_Pitch == pitch) && std::fabs(qItr->m_Distance - distance) <= SOUNDMERGEDISTANCE)
+		{
+			// The merged play is as loud and as important as the loudest and most important of its parts
+			qItr->m_Distance = std::min(qItr->m_Distance, distance);
+			qItr->m_Priority = std::max(qItr->m_Priority, priority);
+			if (std::find(qItr->m_Sounds.begin(), qItr->m_Sounds.end(), pSound) == qItr->m_Sounds.end())
+				qItr->m_Sounds.push_back(pSound);
+			pSound->m_Queued = true;
+			return true;
+		}
+	}
+
+	m_SoundQueue.push_back(queued);
+	pSound->m_Queued = true;
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          UnqueueSound
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Takes a Sound out of the plays queued this frame, so it won't be told
+//                  which channel they got.
+
+bool AudioMan::UnqueueSound(Sound *pSound, bool cancel)
+{
+	bool cancelled = false;
+	for (std::vector<QueuedSound>::iterator qItr = m_SoundQueue.begin(); qItr != m_SoundQueue.end();)
+	{
+		std::vector<Sound *>::iterator sItr = std::find(qItr->m_Sounds.begin(), qItr->m_Sounds.end(), pSound);
+		if (sItr == qItr->m_Sounds.end())
+		{
+			++qItr;
+			continue;
+		}
+
+		// Other Sounds merged into the same play still want it
+		bool onlyOne = qItr->m_Sounds.size() == 1;
+		qItr->m_Sounds.erase(sItr);
+		if (cancel && onlyOne)
+		{
+			qItr = m_SoundQueue.erase(qItr);
+			cancelled = true;
+		}
+		else
+			++qItr;
+	}
+	pSound->m_Queued = false;
+	return cancelled;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ClearSoundQueue
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Drops all the queued plays without starting them.
+
+void AudioMan::ClearSoundQueue()
+{
+	for (std::vector<QueuedSound>::iterator qItr = m_SoundQueue.begin(); qItr != m_SoundQueue.end(); ++qItr)
+	{
+		for (std::vector<Sound *>::iterator sItr = qItr->m_Sounds.begin(); sItr != qItr->m_Sounds.end(); ++sItr)
+			(*sItr)->m_Queued = false;
+	}
+	m_SoundQueue.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FlushSoundQueue
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Starts all queued one-shot sounds, most important and closest first,
+//                  and registers one network event for each of them.
+
+void AudioMan::FlushSoundQueue()
+{
+	if (m_SoundQueue.empty())
+		return;
+
+	// Whatever doesn't get a voice in the end should be what matters least
+	std::sort(m_SoundQueue.begin(), m_SoundQueue.end(), [](const QueuedSound &a, const QueuedSound &b)
+	{
+		return a.m_Priority != b.m_Priority ? a.m_Priority > b.m_Priority : a.m_Distance < b.m_Distance;
+	});
+
+	for (std::vector<QueuedSound>::iterator qItr = m_SoundQueue.begin(); qItr != m_SoundQueue.end(); ++qItr)
+	{
+		int channel = -1;
+		float distance = qItr->m_Distance;
+		if (distance > 1.0f)
+			distance = 1.0f;
+
+		if (m_AudioEnabled)
+		{
+#ifdef __USE_SOUND_FMOD
+			// FMOD steals the lowest priority channel by itself when all are taken
+			channel = FSOUND_PlaySound(FSOUND_FREE, qItr->m_pSample);
+			if (channel != -1)
+			{
+				int channelIndex = channel & 0x00000FFF;
+				FSOUND_SetLoopMode(channel, FSOUND_LOOP_OFF);
+				if (qItr->m_Priority > 0)
+					FSOUND_SetPriority(channel, qItr->m_Priority);
+				if (distance >= 0)
+					FSOUND_SetVolume(channel, MAX_VOLUME * (1.0f - distance * 0.9f));
+				if (channelIndex < m_NormalFrequencies.size())
+				{
+					m_NormalFrequencies[channelIndex] = qItr->m_AffectedByPitch ? FSOUND_GetFrequency(channel) : 0;
+					m_PitchModifiers[channelIndex] = qItr->m_Pitch;
+				}
+				SetChannelVoice(channelIndex, qItr->m_Priority, qItr->m_Distance, false);
+			}
+#elif __USE_SOUND_SDLMIXER
+			// Past the voice limit for this sample, so the new play takes over the farthest old one
+			int stolen = FindVoiceToSteal(*qItr, true);
+			if (stolen < 0)
+			{
+				channel = Mix_PlayChannel(-1, qItr->m_pSample, 0);
+				// Mixer is full, so bump something that matters less
+				if (channel == -1)
+					stolen = FindVoiceToSteal(*qItr, false);
+			}
+			if (stolen >= 0)
+			{
+				Mix_HaltChannel(stolen);
+				channel = Mix_PlayChannel(stolen, qItr->m_pSample, 0);
+			}
+
+			if (channel != -1)
+			{
+				if (distance >= 0)
+					Mix_SetDistance(channel, (255 * distance * 0.9f));
+				SetChannelVoice(channel, qItr->m_Priority, qItr->m_Distance, false);
+			}
+#endif
+		}
+
+		// Now the Sounds played can be asked about and stopped like any other
+		for (std::vector<Sound *>::iterator sItr = qItr->m_Sounds.begin(); sItr != qItr->m_Sounds.end(); ++sItr)
+		{
+			(*sItr)->m_LastChannel = channel;
+			(*sItr)->m_Queued = false;
+		}
+
+		// Clients mix for themselves, so they hear everything that wasn't culled whether or not it got a voice here
+		if (m_IsInMultiplayerMode)
+			RegisterSoundEvent(qItr->m_Player, SOUND_PLAY, qItr->m_Hash, qItr->m_Distance, channel, 0, qItr->m_Pitch, qItr->m_AffectedByPitch);
+	}
+
+	m_SoundQueue.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FindVoiceToSteal
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Picks the channel a queued sound should take over, if any.
+
+int AudioMan::FindVoiceToSteal(const QueuedSound &queued, bool sampleLimitOnly)
+{
+#ifdef __USE_SOUND_SDLMIXER
+	int sampleVoices = 0;
+	int farthestSampleVoice = -1;
+	int weakestVoice = -1;
+
+	for (int channel = 0; channel < m_ChannelVoices.size(); ++channel)
+	{
+		const ChannelVoice &voice = m_ChannelVoices[channel];
+		// Whoever is playing a loop is going to want it to keep going
+		if (voice.m_Looping || !Mix_Playing(channel))
+			continue;
+
+		if (Mix_GetChunk(channel) == queued.m_pSample)
+		{
+			++sampleVoices;
+			if (farthestSampleVoice < 0 || voice.m_Distance > m_ChannelVoices[farthestSampleVoice].m_Distance)
+				farthestSampleVoice = channel;
+		}
+
+		if (weakestVoice < 0 || voice.m_Priority < m_ChannelVoices[weakestVoice].m_Priority || (voice.m_Priority == m_ChannelVoices[weakestVoice].m_Priority && voice.m_Distance > m_ChannelVoices[weakestVoice].m_Distance))
+			weakestVoice = channel;
+	}
+
+	if (sampleVoices >= SOUNDVOICESPERSAMPLE)
+		return farthestSampleVoice;
+
+	if (!sampleLimitOnly && weakestVoice >= 0)
+	{
+		const ChannelVoice &weakest = m_ChannelVoices[weakestVoice];
+		if (weakest.m_Priority < queued.m_Priority || (weakest.m_Priority == queued.m_Priority && weakest.m_Distance > queued.m_Distance))
+			return weakestVoice;
+	}
+#endif
+
+	return -1;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetChannelVoice
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Notes what a channel has just been started with.
+
+void AudioMan::SetChannelVoice(int channel, int priority, float distance, bool looping)
+{
+	if (channel < 0 || channel >= m_ChannelVoices.size())
+		return;
+
+	m_ChannelVoices[channel].m_Priority = priority;
+	m_ChannelVoices[channel].m_Distance = distance;
+	m_ChannelVoices[channel].m_Looping = looping;
 }
 
 } // namespace RTE
@@ -26,6 +26,13 @@
 
 #define MAX_CLIENTS 4
 
+// How close in normalized distance two plays of the same sample in one frame must be to merge into one
+#define SOUNDMERGEDISTANCE 0.1f
+// Normalized distance beyond which one-shots below high priority aren't worth a voice or a network event
+#define SOUNDCULLDISTANCE 0.9f
+// How many voices may play the same sample at once before the farthest one gets stolen
+#define SOUNDVOICESPERSAMPLE 4
+
 #ifdef __USE_SOUND_FMOD
 struct FSOUND_SAMPLE;
 struct FSOUND_STREAM;
@@ -374,6 +381,54 @@ struct MusicNetworkData
 	Sound * PlaySound(const char *filepath, float distance, bool loop, bool affectedByPitch, int player);
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetSoundQueueing
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets whether non-looping sounds played for network players are
+//                  gathered up and started together on the next Update or FlushSoundQueue,
+//                  instead of right away. Only useful while one of those is being called
+//                  every frame. Turning it off starts everything still queued.
+// Arguments:       Whether to queue one-shot sounds.
+// Return value:    None.
+
+	void SetSoundQueueing(bool queue) { if (!queue) { FlushSoundQueue(); } m_SoundQueueing = queue; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsSoundQueueing
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Shows whether one-shot sounds are currently being queued up.
+// Arguments:       None.
+// Return value:    Whether one-shot sounds are queued until the next Update.
+
+	bool IsSoundQueueing() const { return m_SoundQueueing; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FlushSoundQueue
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Starts all queued one-shot sounds, most important and closest first,
+//                  stealing voices from less important ones when the mixer is full, and
+//                  registers one network event for each of them.
+// Arguments:       None.
+// Return value:    None.
+
+	void FlushSoundQueue();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          UnqueueSound
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Takes a Sound out of the plays queued this frame, so it won't be told
+//                  which channel they got.
+// Arguments:       The Sound to take out.
+//                  Whether to also cancel the plays only it asked for, as when stopped,
+//                  or to let them play, as when it goes away.
+// Return value:    Whether any queued play was cancelled.
+
+	bool UnqueueSound(Sound *pSound, bool cancel);
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          SetSoundAttenuation
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -598,6 +653,40 @@ protected:
 
 	std::list<MusicNetworkData> m_MusicEvents[MAX_CLIENTS];
 
+    // A one-shot sound waiting for the end of the frame, with all the identical plays merged into it
+    struct QueuedSound
+    {
+#ifdef __USE_SOUND_FMOD
+        FSOUND_SAMPLE *m_pSample;
+#elif __USE_SOUND_SDLMIXER
+        Mix_Chunk *m_pSample;
+#endif
+        size_t m_Hash;
+        // The Sounds whose plays were merged into this, to be told the channel it gets
+        std::vector<Sound *> m_Sounds;
+        int m_Player;
+        int m_Priority;
+        // The closest of the merged plays
+        float m_Distance;
+        double m_Pitch;
+        bool m_AffectedByPitch;
+    };
+
+    // What a mixer channel was last started with, for deciding which voice to steal
+    struct ChannelVoice
+    {
+        int m_Priority;
+        float m_Distance;
+        bool m_Looping;
+    };
+
+    // Whether one-shot sounds are queued until the next Update
+    bool m_SoundQueueing;
+    // The one-shots queued up this frame
+    std::vector<QueuedSound> m_SoundQueue;
+    // What each mixer channel is playing, indexed by channel
+    std::vector<ChannelVoice> m_ChannelVoices;
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Private member variable and method declarations
@@ -615,6 +704,51 @@ private:
     void Clear();
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          QueueSound
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Adds the next sample of a one-shot Sound to the frame's queue, merged
+//                  into an identical play queued close by if there is one. Culled if too
+//                  far from every listener.
+// Arguments:       Same as PlaySound.
+// Return value:    Whether the sound was queued or merged, rather than culled.
+
+    bool QueueSound(int player, Sound *pSound, int priority, float distance, double pitch);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ClearSoundQueue
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Drops all the queued plays without starting them.
+// Arguments:       None.
+// Return value:    None.
+
+    void ClearSoundQueue();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FindVoiceToSteal
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Picks the channel a queued sound should take over: the farthest one
+//                  already playing its sample if it has too many voices, otherwise the
+//                  least important, farthest non-looping one if that matters less than it.
+// Arguments:       The queued sound that needs a voice.
+//                  Whether to only look for a voice if the sample has too many already.
+// Return value:    The channel to halt and reuse, or -1 if none should be.
+
+    int FindVoiceToSteal(const QueuedSound &queued, bool sampleLimitOnly);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetChannelVoice
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Notes what a channel has just been started with.
+// Arguments:       The channel, and the priority, distance and looping of its sound.
+// Return value:    None.
+
+    void SetChannelVoice(int channel, int priority, float distance, bool looping);
+
+
     // Disallow the use of some implicit methods.
     AudioMan(const AudioMan &reference);
     AudioMan & operator=(const AudioMan &rhs);
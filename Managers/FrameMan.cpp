@@ -24,12 +24,14 @@
 #include "BuyMenuGUI.h"
 #include "SceneEditorGUI.h"
 #include "MovableMan.h"
+#include "LuaMan.h"
 #include "SLTerrain.h"
 #include "MOSprite.h"
 #include "Scene.h"
 
 
 #include "UInputMan.h"
+#include "ThreadMan.h"
 
 #include "GUI/GUI.h"
 #include "GUI/AllegroBitmap.h"
@@ -45,8 +47,22 @@ std::mutex ScreenRelativeEffectsMutex[MAXSCREENCOUNT];
 using std::list;
 using std::pair;
 using std::deque;
+using std::map;
+using std::vector;
+using std::min;
+using std::max;
 
 #define MSPFAVERAGESAMPLESIZE 10
+// How many rows each of the bands the pixel glows are split up into for the worker threads are
+#define GLOWBANDHEIGHT 32
+// How many angles the rotated post effects are cached at
+#define EFFECTANGLEBUCKETS 256
+// How many bytes of rotated post effects are cached before they're all let go of and rotated again as needed
+#define MAXROTATEDEFFECTBYTES (16 * 1024 * 1024)
+// The largest rotated size of a post effect that gets cached; bigger ones are rotated into a scratch bitmap every time
+#define MAXCACHEDEFFECTSIZE 128
+// How many of the most expensive presets the perf overlay lists while cost accounting is on
+#define PERFTOPPRESETS 10
 
 extern bool g_ResetActivity;
 extern bool g_InActivity;
@@ -81,6 +97,64 @@ void DisplaySwitchIn(void)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// The size of the square bitmap a post effect is rotated into, so the corners get cut
+// off the same way wherever it's rotated.
+
+static int RotatedEffectSize(const BITMAP *pBitmap)
+{
+    if (pBitmap->w < 16 && pBitmap->h < 16)
+        return 16;
+    else if (pBitmap->w < 32 && pBitmap->h < 32)
+        return 32;
+    else if (pBitmap->w < 64 && pBitmap->h < 64)
+        return 64;
+    else if (pBitmap->w < 128 && pBitmap->h < 128)
+        return 128;
+    return 256;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Draws a 32bpp sprite onto a 32bpp bitmap with the same math as draw_trans_sprite under
+// set_screen_blender(strength, ...). Post processing runs on the frame thread and the glow
+// bands on the worker pool, while the main thread keeps setting Allegro's blender, which is
+// process wide, for its own drawing. So this doesn't touch it at all.
+
+static void ScreenBlendSprite(BITMAP *pTarget, BITMAP *pSprite, int x, int y, int strength)
+{
+    // Post effects and glows are all loaded as 32bpp in the 32bpp video mode post processing is done in
+    if (bitmap_color_depth(pSprite) != 32 || bitmap_color_depth(pTarget) != 32)
+        return;
+
+    int startX = max(0, pTarget->cl - x);
+    int endX = min(pSprite->w, pTarget->cr - x);
+    int startY = max(0, pTarget->ct - y);
+    int endY = min(pSprite->h, pTarget->cb - y);
+    // Allegro's trans blender is off by one like this too
+    uint32_t n = strength ? strength + 1 : 0;
+
+    for (int spriteY = startY; spriteY < endY; ++spriteY)
+    {
+        const uint32_t *pSource = (const uint32_t *)pSprite->line[spriteY];
+        uint32_t *pDest = (uint32_t *)pTarget->line[spriteY + y] + x;
+        for (int spriteX = startX; spriteX < endX; ++spriteX)
+        {
+            uint32_t source = pSource[spriteX];
+            if (source == MASK_COLOR_32)
+                continue;
+            uint32_t dest = pDest[spriteX];
+            uint32_t screened = makecol32(255 - ((255 - getr32(source)) * (255 - getr32(dest))) / 256,
+                                          255 - ((255 - getg32(source)) * (255 - getg32(dest))) / 256,
+                                          255 - ((255 - getb32(source)) * (255 - getb32(dest))) / 256);
+            uint32_t redBlue = ((screened & 0xFF00FF) - (dest & 0xFF00FF)) * n / 256 + dest;
+            uint32_t green = ((screened & 0xFF00) - (dest & 0xFF00)) * n / 256 + (dest & 0xFF00);
+            pDest[spriteX] = (redBlue & 0xFF00FF) | (green & 0xFF00);
+        }
+    }
+}
+
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:			Translate coordinates
@@ -407,6 +481,15 @@ void FrameMan::Clear()
 	m_DrawNetworkBackBuffer = false;
 	m_StoreNetworkBackBuffer = false;
 	m_pBackBuffer32 = 0;
+    m_pPresentBuffer8 = 0;
+    m_ThreadedPresentation = true;
+    m_PresentDeferred = false;
+    m_PresentPending = false;
+    m_Headless = false;
+    m_RotatedEffects.clear();
+    m_RotatedEffectBytes = 0;
+    m_pRotatedEffectScratch = 0;
+    m_GlowFrame = 0;
     m_pScreendumpBuffer = 0;
     m_PaletteFile.Reset();
     m_pPaletteDataFile = 0;
@@ -425,11 +508,15 @@ void FrameMan::Clear()
     m_pBlueGlow = 0;
     m_BlueGlowHash = 0;
     m_PostScreenEffects.clear();
+    m_PostScreenGlowBoxes.clear();
+    m_PresentScreenEffects.clear();
+    m_PresentScreenGlowBoxes.clear();
     m_HSplit = false;
     m_VSplit = false;
     m_HSplitOverride = false;
     m_VSplitOverride = false;
-    m_pPlayerScreen = 0;
+    for (int i = 0; i < MAXSCREENCOUNT; ++i)
+        m_apPlayerScreen[i] = 0;
     m_PlayerScreenWidth = 0;
     m_PlayerScreenHeight = 0;
     m_PPM = 0;
@@ -547,7 +634,10 @@ int FrameMan::Create()
 #endif // defined(__APPLE__)
 
 
-    if (set_gfx_mode(m_Fullscreen ? fullscreenGfxDriver : windowedGfxDriver, m_Fullscreen ? m_ResX * m_NxFullscreen : m_ResX * m_NxWindowed, m_Fullscreen ? m_ResY * m_NxFullscreen : m_ResY * m_NxWindowed, 0, 0) != 0)
+    // Without a window there's no gfx mode to set, everything just gets drawn to the back buffers
+    if (m_Headless)
+        g_ConsoleMan.PrintString("Running headless, no gfx mode set.");
+    else if (set_gfx_mode(m_Fullscreen ? fullscreenGfxDriver : windowedGfxDriver, m_Fullscreen ? m_ResX * m_NxFullscreen : m_ResX * m_NxWindowed, m_Fullscreen ? m_ResY * m_NxFullscreen : m_ResY * m_NxWindowed, 0, 0) != 0)
     {
 		g_ConsoleMan.PrintString("Failed to set gfx mode, trying different windowed scaling.");
 
@@ -580,10 +670,8 @@ int FrameMan::Create()
     }
 
     // Clear the screen buffer so it doesn't flash pink
-    if (m_BPP == 8)
-        clear_to_color(screen, m_BlackColor);
-    else
-        clear_to_color(screen, 0);
+    if (!m_Headless)
+        clear_to_color(screen, m_BPP == 8 ? m_BlackColor : 0);
 
     // Sets the allowed color conversions when loading bitmaps from files
     set_color_conversion(COLORCONV_MOST);
@@ -610,6 +698,9 @@ int FrameMan::Create()
     // Create the back buffer, this is still in 8bpp, we will do any postprocessing on the PostProcessing bitmap
     m_pBackBuffer8 = create_bitmap_ex(8, m_ResX, m_ResY);
     clear_to_color(m_pBackBuffer8, m_BlackColor);
+    // Copy of a finished back buffer that the frame thread post processes while the next frame is being made
+    m_pPresentBuffer8 = create_bitmap_ex(8, m_ResX, m_ResY);
+    clear_to_color(m_pPresentBuffer8, m_BlackColor);
 
 	for (int i = 0; i < MAXSCREENCOUNT; i++)
 	{
@@ -644,28 +735,25 @@ int FrameMan::Create()
         glowFile.SetDataPath("Base.rte/Effects/Glows/BlueTiny.bmp");
         m_pBlueGlow = glowFile.GetAsBitmap();
         m_BlueGlowHash = glowFile.GetHash();
-
-		m_pTempEffectBitmap_16 = create_bitmap_ex(32, 16, 16);
-		m_pTempEffectBitmap_32 = create_bitmap_ex(32, 32, 32);
-		m_pTempEffectBitmap_64 = create_bitmap_ex(32, 64, 64);
-		m_pTempEffectBitmap_128 = create_bitmap_ex(32, 128, 128);
-		m_pTempEffectBitmap_256 = create_bitmap_ex(32, 256, 256);
 	}
 
     m_PlayerScreenWidth = m_pBackBuffer8->w;
     m_PlayerScreenHeight = m_pBackBuffer8->h;
 
-    // Create the splitscreen buffer
+    // Create the splitscreen buffers, one for each screen so they can be drawn at the same time
     if (m_HSplit || m_VSplit)
     {
 // TODO: Make this a Video-only memory bitmap: create_video_bitmap"
-        m_pPlayerScreen = create_bitmap_ex(8, m_ResX / (m_VSplit ? 2 : 1), m_ResY / (m_HSplit ? 2 : 1));
-        clear_to_color(m_pPlayerScreen, m_BlackColor);
-        set_clip_state(m_pPlayerScreen, 1);
+        for (int i = 0; i < MAXSCREENCOUNT; ++i)
+        {
+            m_apPlayerScreen[i] = create_bitmap_ex(8, m_ResX / (m_VSplit ? 2 : 1), m_ResY / (m_HSplit ? 2 : 1));
+            clear_to_color(m_apPlayerScreen[i], m_BlackColor);
+            set_clip_state(m_apPlayerScreen[i], 1);
+        }
 
         // Update these to represent the split screens
-        m_PlayerScreenWidth = m_pPlayerScreen->w;
-        m_PlayerScreenHeight = m_pPlayerScreen->h;
+        m_PlayerScreenWidth = m_apPlayerScreen[0]->w;
+        m_PlayerScreenHeight = m_apPlayerScreen[0]->h;
     }
 
 	m_Sample = 0;
@@ -762,6 +850,8 @@ int FrameMan::ReadProperty(std::string propName, Reader &reader)
         reader >> m_PostProcessing;
     else if (propName == "PostPixelGlow")
         reader >> m_PostPixelGlow;
+    else if (propName == "ThreadedPresentation")
+        reader >> m_ThreadedPresentation;
     else if (propName == "PixelsPerMeter")
     {
         reader >> m_PPM;
@@ -791,9 +881,12 @@ int FrameMan::ReadProperty(std::string propName, Reader &reader)
 
 void FrameMan::ResetSplitScreens(bool hSplit, bool vSplit)
 {
-    // Free the previous splitscreen, if any
-    if (m_pPlayerScreen)
-        release_bitmap(m_pPlayerScreen);
+    // Free the previous splitscreens, if any
+    for (int i = 0; i < MAXSCREENCOUNT; ++i)
+    {
+        destroy_bitmap(m_apPlayerScreen[i]);
+        m_apPlayerScreen[i] = 0;
+    }
 
 	// Override screen splitting according to settings if needed
 	if ((hSplit || vSplit) && !(hSplit && vSplit) && (m_HSplitOverride || m_VSplitOverride))
@@ -805,17 +898,20 @@ void FrameMan::ResetSplitScreens(bool hSplit, bool vSplit)
     m_HSplit = hSplit;
     m_VSplit = vSplit;
 
-    // Create the splitscreen buffer
+    // Create the splitscreen buffers, one for each screen so they can be drawn at the same time
     if (m_HSplit || m_VSplit)
     {
 // TODO: Make this a Video-only memory bitmap: create_video_bitmap"
-        m_pPlayerScreen = create_bitmap_ex(8, g_FrameMan.GetResX() / (m_VSplit ? 2 : 1), g_FrameMan.GetResY() / (m_HSplit ? 2 : 1));
-        clear_to_color(m_pPlayerScreen, m_BlackColor);
-        set_clip_state(m_pPlayerScreen, 1);
+        for (int i = 0; i < MAXSCREENCOUNT; ++i)
+        {
+            m_apPlayerScreen[i] = create_bitmap_ex(8, g_FrameMan.GetResX() / (m_VSplit ? 2 : 1), g_FrameMan.GetResY() / (m_HSplit ? 2 : 1));
+            clear_to_color(m_apPlayerScreen[i], m_BlackColor);
+            set_clip_state(m_apPlayerScreen[i], 1);
+        }
 
         // Update these to represent the split screens
-        m_PlayerScreenWidth = m_pPlayerScreen->w;
-        m_PlayerScreenHeight = m_pPlayerScreen->h;
+        m_PlayerScreenWidth = m_apPlayerScreen[0]->w;
+        m_PlayerScreenHeight = m_apPlayerScreen[0]->h;
     }
     // No splits, so set the screen dimensions equal to the back buffer
     else
@@ -857,6 +953,8 @@ int FrameMan::Save(Writer &writer) const
     writer << m_PostProcessing;
     writer.NewProperty("PostPixelGlow");
     writer << m_PostPixelGlow;
+    writer.NewProperty("ThreadedPresentation");
+    writer << m_ThreadedPresentation;
     writer.NewProperty("PixelsPerMeter");
     writer << m_PPM;
     writer.NewProperty("HSplitScreen");
@@ -875,7 +973,10 @@ int FrameMan::Save(Writer &writer) const
 
 void FrameMan::Destroy()
 {
+    WaitForPresent();
+
     destroy_bitmap(m_pBackBuffer8);
+    destroy_bitmap(m_pPresentBuffer8);
 	for (int i = 0; i < MAXSCREENCOUNT; i++)
 	{
 		for (int f = 0; f < 2; f++)
@@ -887,7 +988,11 @@ void FrameMan::Destroy()
 		}
 	}
     destroy_bitmap(m_pBackBuffer32);
-    destroy_bitmap(m_pPlayerScreen);
+    for (int i = 0; i < MAXSCREENCOUNT; ++i)
+        destroy_bitmap(m_apPlayerScreen[i]);
+    for (map<pair<BITMAP *, int>, BITMAP *>::iterator rItr = m_RotatedEffects.begin(); rItr != m_RotatedEffects.end(); ++rItr)
+        destroy_bitmap(rItr->second);
+    destroy_bitmap(m_pRotatedEffectScratch);
     if (m_pPaletteDataFile)
         unload_datafile_object(m_pPaletteDataFile);
     delete m_pGUIScreen;
@@ -1026,7 +1131,7 @@ bool FrameMan::LoadPalette(std::string palettePath)
             DDTAbort(("Failed to load palette from bitmap with following path:\n\n" + palettePath).c_str());
 
         // Set the current palette
-        set_palette(newPalette);
+        SetPalette(newPalette);
 
         // Update what black is now with the loaded palette
         m_BlackColor = bestfit_color(newPalette, 0, 0, 0);
@@ -1056,7 +1161,7 @@ bool FrameMan::LoadPalette(std::string palettePath)
         m_pPaletteDataFile = pTempFile;
 
         // Set the current palette
-        set_palette(*((PALETTE *)m_pPaletteDataFile->dat));
+        SetPalette(*((PALETTE *)m_pPaletteDataFile->dat));
 
         // Update what black is now with the loaded palette
         m_BlackColor = bestfit_color(*((PALETTE *)m_pPaletteDataFile->dat), 0, 0, 0);
@@ -1068,6 +1173,21 @@ bool FrameMan::LoadPalette(std::string palettePath)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetPalette
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes a palette the current one, on the screen too unless headless.
+
+void FrameMan::SetPalette(const PALETTE palette)
+{
+    // Without a gfx mode there's no hardware palette to set, but loading and converting bitmaps still needs to know the palette
+    if (m_Headless)
+        select_palette(palette);
+    else
+        set_palette(palette);
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          FadeInPalette
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1075,6 +1195,10 @@ bool FrameMan::LoadPalette(std::string palettePath)
 
 void FrameMan::FadeInPalette(int fadeSpeed)
 {
+    // No screen to fade in
+    if (m_Headless)
+        return;
+
     if (fadeSpeed < 1)
         fadeSpeed = 1;
     if (fadeSpeed > 64)
@@ -1093,6 +1217,10 @@ void FrameMan::FadeInPalette(int fadeSpeed)
 
 void FrameMan::FadeOutPalette(int fadeSpeed)
 {
+    // No screen to fade out
+    if (m_Headless)
+        return;
+
     if (fadeSpeed < 1)
         fadeSpeed = 1;
     if (fadeSpeed > 64)
@@ -1143,6 +1271,7 @@ int FrameMan::SaveScreenToBMP(const char *namebase)
     } while (filenumber < maxFileTrys);
 
     // Save out the screen bitmap, after making a copy of it, faster sometimes
+    WaitForPresent();
     if (screen) {
         if (!m_pScreendumpBuffer)
             m_pScreendumpBuffer = create_bitmap(screen->w, screen->h);
@@ -1230,19 +1359,9 @@ int FrameMan::SaveWorldToBMP(const char *namebase)
 			}
 			else 
 			{
-				BITMAP * pTargetBitmap;
-
-				if (pBitmap->w < 16 && pBitmap->h < 16)
-					pTargetBitmap = m_pTempEffectBitmap_16;
-				else if (pBitmap->w < 32 && pBitmap->h < 32)
-					pTargetBitmap = m_pTempEffectBitmap_32;
-				else if (pBitmap->w < 64 && pBitmap->h < 64)
-					pTargetBitmap = m_pTempEffectBitmap_64;
-				else if (pBitmap->w < 128 && pBitmap->h < 128)
-					pTargetBitmap = m_pTempEffectBitmap_128;
-				else 
-					pTargetBitmap = m_pTempEffectBitmap_256;
-
+				// Rotated here rather than through the cache, which the frame thread may be using
+				int size = RotatedEffectSize(pBitmap);
+				BITMAP * pTargetBitmap = create_bitmap_ex(32, size, size);
 				clear_to_color(pTargetBitmap, 0);
 				
 				fixed fAngle;
@@ -1250,6 +1369,7 @@ int FrameMan::SaveWorldToBMP(const char *namebase)
 
 				rotate_sprite(pTargetBitmap, pBitmap, 0, 0, fAngle);
 				draw_trans_sprite(pWorldBitmap, pTargetBitmap, effectPosX, effectPosY);
+				destroy_bitmap(pTargetBitmap);
 			}
 		}
 
@@ -1308,6 +1428,13 @@ int FrameMan::SaveBitmapToBMP(BITMAP *pBitmap, const char *namebase)
 
 int FrameMan::ToggleFullscreen()
 {
+    // There's no window to switch to or from
+    if (m_Headless)
+        return -1;
+
+    // Get the last frame out of the frame thread's hands and onto the old screen before it's recreated
+    WaitForPresent();
+
     // Save the palette so we can re-set it after the change.
     PALETTE pal;
     get_palette(pal);
@@ -1448,6 +1575,10 @@ int FrameMan::ToggleFullscreen()
 
 int FrameMan::SwitchWindowMultiplier(int multiplier)
 {
+    // There's no window to switch the multiplier of
+    if (m_Headless)
+        return -1;
+
     // Sanity check input
     if (multiplier <= 0 || multiplier > 4 || multiplier == m_NxWindowed)
         return -1;
@@ -1459,6 +1590,8 @@ int FrameMan::SwitchWindowMultiplier(int multiplier)
         return 0;
     }
 
+    WaitForPresent();
+
     // Refuse windowed multiplier if the resolution is too high
     if (m_ResX > 1024)
         m_NxWindowed = 1;
@@ -1512,63 +1645,39 @@ int FrameMan::SwitchWindowMultiplier(int multiplier)
 //                  processing effects on top like glows etc. Only works in 32bpp mode.
 
 void FrameMan::PostProcess()
+{
+    // Can't touch the 32bpp buffer while the frame thread may still be working on it
+    WaitForPresent();
+    PostProcess(m_pBackBuffer8, m_PostScreenGlowBoxes, m_PostScreenEffects);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          PostProcess
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Copies an 8bpp frame into the 32bpp back buffer and adds the passed in
+//                  glows and effects on top of it. Clears out the effect list when done.
+
+void FrameMan::PostProcess(BITMAP *pSourceBitmap, list<Box> &glowBoxes, list<PostEffect> &effects)
 {
     SLICK_PROFILE(0xFF354556);
 
     if (!m_PostProcessing)
         return;
 
-    // First copy the current 8bpp backbuffer to the 32bpp buffer; we'll add effects to it
-    blit(m_pBackBuffer8, m_pBackBuffer32, 0, 0, 0, 0, m_pBackBuffer8->w, m_pBackBuffer8->h);
+    // First copy the 8bpp frame to the 32bpp buffer; we'll add effects to it
+    blit(pSourceBitmap, m_pBackBuffer32, 0, 0, 0, 0, pSourceBitmap->w, pSourceBitmap->h);
 
-	// Set the screen blender mode for glows
+	// Glows are screen blended at half strength, without Allegro's blender which the main thread may be using meanwhile
 //    set_alpha_blender();
-    set_screen_blender(128, 128, 128, 128);
+//    set_screen_blender(128, 128, 128, 128);
 
 //    acquire_bitmap(m_pBackBuffer8);
 //    acquire_bitmap(m_pBackBuffer32);
 
-    // Randomly sample the entire backbuffer, looking for pixels to put a glow on
-    // NOTE THIS IS SLOW, especially on higher resolutions!
+    // Look through the glow boxes for pixels to put a glow on
     if (m_PostPixelGlow)
-    {
-        int x = 0, y = 0, startX = 0, startY = 0, endX = 0, endY = 0, testpixel = 0;
-
-        for (list<Box>::iterator bItr = m_PostScreenGlowBoxes.begin(); bItr != m_PostScreenGlowBoxes.end(); ++bItr)
-        {
-            startX = (*bItr).m_Corner.m_X;
-            startY = (*bItr).m_Corner.m_Y;
-            endX = startX + (*bItr).m_Width;
-            endY = startY + (*bItr).m_Height;
-            testpixel = 0;
-
-            // Sanity check a little at least
-            if (startX < 0 || startX >= m_pBackBuffer8->w || startY < 0 || startY >= m_pBackBuffer8->h ||
-                endX < 0 || endX >= m_pBackBuffer8->w || endY < 0 || endY >= m_pBackBuffer8->h)
-                continue;
-
-// TODO: REMOVE TEMP DEBUG
-//            rect(m_pBackBuffer32, startX, startY, endX, endY, g_RedColor);
-
-            for (y = startY; y < endY; ++y)
-            {
-                for (x = startX; x < endX; ++x)
-                {
-                    testpixel = _getpixel(m_pBackBuffer8, x, y);
-
-                    // YELLOW
-                    if ((testpixel == g_YellowGlowColor && PosRand() < 0.9) || testpixel == 98 || (testpixel == 120 && PosRand() < 0.7))// || testpixel == 39 || testpixel == 86 || testpixel == 47 || testpixel == 48 || testpixel == 116)
-                        draw_trans_sprite(m_pBackBuffer32, m_pYellowGlow, x - 2, y - 2);
-                    // RED
-        //            if (testpixel == 13)
-        //                draw_trans_sprite(m_pBackBuffer32, m_pRedGlow, x - 2, y - 2);
-                    // BLUE
-                    if (testpixel == 166)
-                        draw_trans_sprite(m_pBackBuffer32, m_pBlueGlow, x - 2, y - 2);
-                }
-            }            
-        }
-    }
+        DrawPixelGlows(pSourceBitmap, glowBoxes);
 /* This one is even slower than above method
     // How many samples to make
     int samples = 640 * 480 * 0.7;
@@ -1597,13 +1706,12 @@ void FrameMan::PostProcess()
     int strength = 0;
 	float angle = 0;
 
-    for (list<PostEffect>::iterator eItr = m_PostScreenEffects.begin(); eItr != m_PostScreenEffects.end(); ++eItr)
+    for (list<PostEffect>::iterator eItr = effects.begin(); eItr != effects.end(); ++eItr)
     {
 		if ((*eItr).m_pBitmap)
 		{
 			pBitmap = (*eItr).m_pBitmap;
 			strength = (*eItr).m_Strength;
-			set_screen_blender(strength, strength, strength, strength);
 			effectPosX = (*eItr).m_Pos.GetFloorIntX() - (pBitmap->w / 2);
 			effectPosY = (*eItr).m_Pos.GetFloorIntY() - (pBitmap->h / 2);
 			angle = (*eItr).m_Angle;
@@ -1611,34 +1719,10 @@ void FrameMan::PostProcess()
 
 			if (angle == 0)
 			{
-				draw_trans_sprite(m_pBackBuffer32, pBitmap, effectPosX, effectPosY);
+				ScreenBlendSprite(m_pBackBuffer32, pBitmap, effectPosX, effectPosY, strength);
 			}
 			else
-			{
-				BITMAP * pTargetBitmap;
-
-				if (pBitmap->w < 16 && pBitmap->h < 16)
-					pTargetBitmap = m_pTempEffectBitmap_16;
-				else if (pBitmap->w < 32 && pBitmap->h < 32)
-					pTargetBitmap = m_pTempEffectBitmap_32;
-				else if (pBitmap->w < 64 && pBitmap->h < 64)
-					pTargetBitmap = m_pTempEffectBitmap_64;
-				else if (pBitmap->w < 128 && pBitmap->h < 128)
-					pTargetBitmap = m_pTempEffectBitmap_128;
-				else
-					pTargetBitmap = m_pTempEffectBitmap_256;
-
-				clear_to_color(pTargetBitmap, 0);
-
-				//fixed fAngle;
-				//fAngle = fixmul(angle, radtofix_r);
-
-				Matrix m;
-				m.SetRadAngle(angle);
-
-				rotate_sprite(pTargetBitmap, pBitmap, 0, 0, ftofix(m.GetAllegroAngle()));
-				draw_trans_sprite(m_pBackBuffer32, pTargetBitmap, effectPosX, effectPosY);
-			}
+				ScreenBlendSprite(m_pBackBuffer32, GetRotatedEffect(pBitmap, angle), effectPosX, effectPosY, strength);
 		}
     }
 
@@ -1649,7 +1733,240 @@ void FrameMan::PostProcess()
 //    set_trans_blender(128, 128, 128, 128);
 
     // Clear the effects list for this frame
-    m_PostScreenEffects.clear();
+    effects.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: HasGlowColor
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Checks eight 8bpp pixels at once for any of the glowing colors, so the
+//                  long stretches without any can be skipped through quickly.
+
+static inline bool HasGlowColor(uint64_t pixels)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    // A byte of the XOR is zero where the pixel is the color, and the classic zero byte test finds those
+    uint64_t yellow = pixels ^ (ones * g_YellowGlowColor);
+    uint64_t hot = pixels ^ (ones * 98);
+    uint64_t orange = pixels ^ (ones * 120);
+    uint64_t blue = pixels ^ (ones * 166);
+    return (((yellow - ones) & ~yellow) | ((hot - ones) & ~hot) | ((orange - ones) & ~orange) | ((blue - ones) & ~blue)) & highs;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: GlowChance
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets a random 0-1.0 value that is always the same for a pixel in a
+//                  particular frame, no matter which band is looking at it.
+
+static inline float GlowChance(int x, int y, unsigned int frame)
+{
+    unsigned int hash = (unsigned int)x * 0x8DA6B343 ^ (unsigned int)y * 0xD8163841 ^ frame * 0xCB1AB31F;
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6D;
+    hash ^= hash >> 12;
+    return (float)(hash & 0xFFFFFF) / 16777216.0f;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawPixelGlows
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Puts a glow on the 32bpp back buffer over every glowing pixel of an
+//                  8bpp frame within the glow boxes.
+
+void FrameMan::DrawPixelGlows(BITMAP *pSourceBitmap, const list<Box> &glowBoxes)
+{
+    // Sanity check a little at least
+    vector<Box> boxes;
+    for (list<Box>::const_iterator bItr = glowBoxes.begin(); bItr != glowBoxes.end(); ++bItr)
+    {
+        int startX = (*bItr).m_Corner.m_X;
+        int startY = (*bItr).m_Corner.m_Y;
+        int endX = startX + (*bItr).m_Width;
+        int endY = startY + (*bItr).m_Height;
+        if (startX < 0 || startX >= pSourceBitmap->w || startY < 0 || startY >= pSourceBitmap->h ||
+            endX < 0 || endX >= pSourceBitmap->w || endY < 0 || endY >= pSourceBitmap->h)
+            continue;
+        boxes.push_back(*bItr);
+    }
+    if (boxes.empty())
+        return;
+
+    unsigned int glowFrame = m_GlowFrame++;
+    // The glows are drawn up and left of the pixel by this much
+    const int glowOffset = 2;
+    int glowHeight = max(m_pYellowGlow->h, m_pBlueGlow->h);
+    int bandCount = (pSourceBitmap->h + GLOWBANDHEIGHT - 1) / GLOWBANDHEIGHT;
+
+    // Each band only draws onto its own rows, but looks at all the pixels whose glows reach into it. Within a band the glows
+    // go on in the same order as if the whole frame was done in one go, so the blending comes out exactly the same
+    g_ThreadMan.ParallelFor(bandCount, [&](int band)
+    {
+        int bandTop = band * GLOWBANDHEIGHT;
+        int bandBottom = min(bandTop + GLOWBANDHEIGHT, pSourceBitmap->h);
+        BITMAP *pBand = create_sub_bitmap(m_pBackBuffer32, 0, bandTop, m_pBackBuffer32->w, bandBottom - bandTop);
+
+        for (vector<Box>::const_iterator bItr = boxes.begin(); bItr != boxes.end(); ++bItr)
+        {
+            int startX = (*bItr).m_Corner.m_X;
+            int endX = startX + (*bItr).m_Width;
+            int startY = max((int)(*bItr).m_Corner.m_Y, bandTop + glowOffset - glowHeight + 1);
+            int endY = min((int)(*bItr).m_Corner.m_Y + (int)(*bItr).m_Height, bandBottom + glowOffset);
+
+            for (int y = startY; y < endY; ++y)
+            {
+                const unsigned char *pRow = pSourceBitmap->line[y];
+                int x = startX;
+                while (x < endX)
+                {
+                    // Skip ahead a whole word at a time while there's nothing to glow
+                    if (x + 8 <= endX)
+                    {
+                        uint64_t pixels;
+                        memcpy(&pixels, pRow + x, 8);
+                        if (!HasGlowColor(pixels))
+                        {
+                            x += 8;
+                            continue;
+                        }
+                    }
+
+                    for (int wordEnd = min(x + 8, endX); x < wordEnd; ++x)
+                    {
+                        int testpixel = pRow[x];
+                        // YELLOW
+                        if ((testpixel == g_YellowGlowColor && GlowChance(x, y, glowFrame) < 0.9) || testpixel == 98 || (testpixel == 120 && GlowChance(x, y, glowFrame) < 0.7))
+                            ScreenBlendSprite(pBand, m_pYellowGlow, x - glowOffset, y - glowOffset - bandTop, 128);
+                        // BLUE
+                        else if (testpixel == 166)
+                            ScreenBlendSprite(pBand, m_pBlueGlow, x - glowOffset, y - glowOffset - bandTop, 128);
+                    }
+                }
+            }
+        }
+
+        destroy_bitmap(pBand);
+    });
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetRotatedEffect
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets a post effect bitmap rotated to the cached angle closest to the
+//                  one asked for.
+
+BITMAP * FrameMan::GetRotatedEffect(BITMAP *pBitmap, float angle)
+{
+    Matrix m;
+    m.SetRadAngle(angle);
+    int bucket = (int)floorf(m.GetAllegroAngle() * EFFECTANGLEBUCKETS / 256.0f + 0.5f) % EFFECTANGLEBUCKETS;
+    if (bucket < 0)
+        bucket += EFFECTANGLEBUCKETS;
+
+    int size = RotatedEffectSize(pBitmap);
+    BITMAP *pRotated = 0;
+
+    // The big ones would soon crowd everything else out of the cache, so just rotate them again each time
+    if (size > MAXCACHEDEFFECTSIZE)
+    {
+        if (!m_pRotatedEffectScratch || m_pRotatedEffectScratch->w != size)
+        {
+            destroy_bitmap(m_pRotatedEffectScratch);
+            m_pRotatedEffectScratch = create_bitmap_ex(32, size, size);
+        }
+        pRotated = m_pRotatedEffectScratch;
+    }
+    else
+    {
+        pair<BITMAP *, int> key(pBitmap, bucket);
+        map<pair<BITMAP *, int>, BITMAP *>::iterator rItr = m_RotatedEffects.find(key);
+        if (rItr != m_RotatedEffects.end())
+            return rItr->second;
+
+        // Keep the cache from growing without bound as new effects and scenes come along; everything rotated before has already been drawn
+        int bytes = size * size * 4;
+        if (m_RotatedEffectBytes + bytes > MAXROTATEDEFFECTBYTES)
+        {
+            for (rItr = m_RotatedEffects.begin(); rItr != m_RotatedEffects.end(); ++rItr)
+                destroy_bitmap(rItr->second);
+            m_RotatedEffects.clear();
+            m_RotatedEffectBytes = 0;
+        }
+
+        pRotated = create_bitmap_ex(32, size, size);
+        m_RotatedEffects[key] = pRotated;
+        m_RotatedEffectBytes += bytes;
+    }
+
+    clear_to_color(pRotated, 0);
+    rotate_sprite(pRotated, pBitmap, 0, 0, ftofix(bucket * 256.0f / EFFECTANGLEBUCKETS));
+
+    return pRotated;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          BenchmarkPostProcess
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Times post processing a made up 1920x1080 frame full of glowing
+//                  pixels and rotated effects, and prints the results to the console.
+
+void FrameMan::BenchmarkPostProcess(int iterations)
+{
+    if (iterations < 1 || !m_pYellowGlow || !m_pBlueGlow)
+        return;
+
+    WaitForPresent();
+
+    // Sprinkle the glowing colors over an otherwise dull frame, about as densely as in a heavy firefight
+    const int width = 1920;
+    const int height = 1080;
+    BITMAP *pFrame = create_bitmap_ex(8, width, height);
+    const int glowColors[] = { g_YellowGlowColor, 98, 120, 166 };
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+            _putpixel(pFrame, x, y, PosRand() < 0.01 ? glowColors[SelectRand(0, 3)] : SelectRand(1, 96));
+    }
+    list<Box> glowBoxes;
+    glowBoxes.push_back(Box(Vector(0, 0), width - 1, height - 1));
+
+    // Post process into a full size buffer of our own, leaving the real one alone
+    BITMAP *pBackBuffer32 = m_pBackBuffer32;
+    m_pBackBuffer32 = create_bitmap_ex(32, width, height);
+    bool postProcessing = m_PostProcessing;
+    bool pixelGlow = m_PostPixelGlow;
+    m_PostProcessing = m_PostPixelGlow = true;
+
+    int64_t totalTime = 0;
+    int64_t peakTime = 0;
+    list<PostEffect> effects;
+    for (int i = 0; i < iterations; ++i)
+    {
+        for (int e = 0; e < 500; ++e)
+            effects.push_back(PostEffect(Vector(PosRand() * width, PosRand() * height), e % 2 ? m_pYellowGlow : m_pBlueGlow, 0, 128, e % 4 ? RangeRand(-PI, PI) : 0));
+
+        int64_t startTime = g_TimerMan.GetAbsoulteTime();
+        PostProcess(pFrame, glowBoxes, effects);
+        int64_t time = g_TimerMan.GetAbsoulteTime() - startTime;
+        totalTime += time;
+        peakTime = max(peakTime, time);
+    }
+
+    destroy_bitmap(m_pBackBuffer32);
+    m_pBackBuffer32 = pBackBuffer32;
+    m_PostProcessing = postProcessing;
+    m_PostPixelGlow = pixelGlow;
+    destroy_bitmap(pFrame);
+
+    char report[256];
+    sprintf(report, "PostProcess at %ix%i: %.2f ms average, %.2f ms peak over %i frames", width, height, (float)totalTime / iterations / 1000.0f, (float)peakTime / 1000.0f, iterations);
+    g_ConsoleMan.PrintString(report);
 }
 
 
@@ -1662,16 +1979,86 @@ void FrameMan::FlipFrameBuffers()
 {
     SLICK_PROFILE(0xFF886532);
 
+    // Only one frame can be on its way to the screen at a time
+    WaitForPresent();
+
+    if (m_PresentDeferred)
+    {
+        m_PresentDeferred = false;
+
+        // Take a copy of the finished frame so the main thread can go right ahead and clear and draw the next one
+        blit(m_pBackBuffer8, m_pPresentBuffer8, 0, 0, 0, 0, m_pBackBuffer8->w, m_pBackBuffer8->h);
+        m_PresentScreenGlowBoxes.swap(m_PostScreenGlowBoxes);
+        m_PresentScreenEffects.swap(m_PostScreenEffects);
+
+        // Allegro 4 can only draw to the screen from the main thread, so the frame thread only post processes, and the
+        // finished frame is blitted to the screen by the main thread the next time it waits for it
+        g_ThreadMan.QueueFrameTask([this]()
+        {
+            if (m_PostProcessing && m_BPP == 32)
+                PostProcess(m_pPresentBuffer8, m_PresentScreenGlowBoxes, m_PresentScreenEffects);
+        });
+        m_PresentPending = true;
+        return;
+    }
+
+    BlitToScreen(m_pBackBuffer8, g_InActivity);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WaitForPresent
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Blocks until the frame thread is done post processing the last frame
+//                  handed to it, if any, and blits it to the screen.
+
+void FrameMan::WaitForPresent()
+{
+    g_ThreadMan.WaitForFrameTask();
+
+    if (m_PresentPending)
+    {
+        m_PresentPending = false;
+        BlitToScreen(m_pPresentBuffer8, true);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ClearBackBuffer32
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Clears the 32bpp backbuffer with black.
+
+void FrameMan::ClearBackBuffer32()
+{
+    if (m_pBackBuffer32)
+    {
+        WaitForPresent();
+        clear_to_color(m_pBackBuffer32, 0);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          BlitToScreen
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Copies a finished frame to the screen, scaling it if needed.
+
+void FrameMan::BlitToScreen(BITMAP *pBackBuffer8, bool inActivity)
+{
+    if (m_Headless)
+        return;
+
     if (get_color_depth() == 32 && m_BPP == 32 && m_pBackBuffer32)
     {
-        if (g_InActivity)
+        if (inActivity)
         {
             if (!m_Fullscreen && m_NxWindowed != 1)
-                stretch_blit(m_PostProcessing ? m_pBackBuffer32 : m_pBackBuffer8, screen, 0, 0, m_pBackBuffer32->w, m_pBackBuffer32->h, 0, 0, SCREEN_W, SCREEN_H);
+                stretch_blit(m_PostProcessing ? m_pBackBuffer32 : pBackBuffer8, screen, 0, 0, m_pBackBuffer32->w, m_pBackBuffer32->h, 0, 0, SCREEN_W, SCREEN_H);
             else if (m_Fullscreen && m_NxFullscreen != 1)
-                stretch_blit(m_PostProcessing ? m_pBackBuffer32 : m_pBackBuffer8, screen, 0, 0, m_pBackBuffer32->w, m_pBackBuffer32->h, 0, 0, SCREEN_W, SCREEN_H);
+                stretch_blit(m_PostProcessing ? m_pBackBuffer32 : pBackBuffer8, screen, 0, 0, m_pBackBuffer32->w, m_pBackBuffer32->h, 0, 0, SCREEN_W, SCREEN_H);
             else
-                blit(m_PostProcessing ? m_pBackBuffer32 : m_pBackBuffer8, screen, 0, 0, 0, 0, m_pBackBuffer32->w, m_pBackBuffer32->h);            
+                blit(m_PostProcessing ? m_pBackBuffer32 : pBackBuffer8, screen, 0, 0, 0, 0, m_pBackBuffer32->w, m_pBackBuffer32->h);            
         }
         // Menu is always 32bpp
         else
@@ -1688,11 +2075,11 @@ void FrameMan::FlipFrameBuffers()
     else
     {
         if (!m_Fullscreen && m_NxWindowed != 1)
-            stretch_blit(m_pBackBuffer8, screen, 0, 0, m_pBackBuffer8->w, m_pBackBuffer8->h, 0, 0, SCREEN_W, SCREEN_H);
+            stretch_blit(pBackBuffer8, screen, 0, 0, pBackBuffer8->w, pBackBuffer8->h, 0, 0, SCREEN_W, SCREEN_H);
         else if (m_Fullscreen && m_NxFullscreen != 1)
-            stretch_blit(m_pBackBuffer8, screen, 0, 0, m_pBackBuffer8->w, m_pBackBuffer8->h, 0, 0, SCREEN_W, SCREEN_H);
+            stretch_blit(pBackBuffer8, screen, 0, 0, pBackBuffer8->w, pBackBuffer8->h, 0, 0, SCREEN_W, SCREEN_H);
         else
-            blit(m_pBackBuffer8, screen, 0, 0, 0, 0, m_pBackBuffer8->w, m_pBackBuffer8->h);
+            blit(pBackBuffer8, screen, 0, 0, 0, 0, pBackBuffer8->w, pBackBuffer8->h);
     }
 }
 
@@ -2032,7 +2419,7 @@ void FrameMan::DrawPrimitives(int player, BITMAP *pTargetBitmap, const Vector &t
 {
     // Count how many split screens we'll need
     //int screenCount = (m_HSplit ? 2 : 1) * (m_VSplit ? 2 : 1);
-    //BITMAP *pDrawScreen = /*get_color_depth() == 8 && */screenCount == 1 ? m_pBackBuffer8 : m_pPlayerScreen;
+    //BITMAP *pDrawScreen = /*get_color_depth() == 8 && */screenCount == 1 ? m_pBackBuffer8 : m_apPlayerScreen[player];
 
 	//Draw primitives
 	for (std::list<GraphicalPrimitive *>::const_iterator it = m_Primitives.begin(); it != m_Primitives.end(); ++it)
@@ -2055,7 +2442,7 @@ void FrameMan::Draw()
     // Count how many split screens we'll need
     int screenCount = (m_HSplit ? 2 : 1) * (m_VSplit ? 2 : 1);
 
-    AAssert(screenCount <= 1 || m_pPlayerScreen, "Splitscreen surface not ready when needed!");
+    AAssert(screenCount <= 1 || m_apPlayerScreen[screenCount - 1], "Splitscreen surface not ready when needed!");
     // Choose which buffer to draw to. If there are no splitscreens and 8bit modes, draw directly to the back buffer, else use a intermediary splitscreen buffer
     char str[512];
 
@@ -2068,13 +2455,29 @@ void FrameMan::Draw()
     // Handy handle
     Activity *pActivity = g_ActivityMan.GetActivity();
 
+    // With split screens, each screen has its own scroll offset and intermediate bitmap, so their scene layers can all be drawn at once on the
+    // worker threads. The scrolling updates before and the HUDs and texts after stay on this thread, in screen order
+    bool drawLayersInParallel = screenCount > 1 && !m_StoreNetworkBackBuffer && !IsInMultiplayerMode() && g_SceneMan.GetLayerDrawMode() == g_LayerNormal;
+    if (drawLayersInParallel)
+    {
+        SLICK_PROFILENAME("Screen Layers", 0xFF321546);
+
+        for (int whichScreen = 0; whichScreen < screenCount; ++whichScreen)
+            g_SceneMan.Update(whichScreen);
+
+        g_ThreadMan.ParallelFor(screenCount, [this](int whichScreen)
+        {
+            g_SceneMan.DrawLayers(whichScreen, m_apPlayerScreen[whichScreen]);
+        });
+    }
+
     for (int whichScreen = 0; whichScreen < screenCount; ++whichScreen)
     {
         SLICK_PROFILENAME("Screen Update", 0xFF321546);
         screenRelativeEffects.clear();
         screenRelativeGlowBoxes.clear();
 
-		BITMAP *pDrawScreen = /*get_color_depth() == 8 && */screenCount == 1 ? m_pBackBuffer8 : m_pPlayerScreen;
+		BITMAP *pDrawScreen = /*get_color_depth() == 8 && */screenCount == 1 ? m_pBackBuffer8 : m_apPlayerScreen[whichScreen];
 		BITMAP *pDrawScreenGUI = pDrawScreen;
 		if (m_StoreNetworkBackBuffer)
 		{
@@ -2085,7 +2488,8 @@ void FrameMan::Draw()
 		AllegroBitmap pPlayerGUIBitmap(pDrawScreenGUI);
 
         // Update the scene view to line up with a specific screen and then draw it onto the intermediate screen
-        g_SceneMan.Update(whichScreen);
+        if (!drawLayersInParallel)
+            g_SceneMan.Update(whichScreen);
 
 		// Save scene layer's offsets for each screen, 
 		// server will pick them to build the frame state and send to client
@@ -2114,8 +2518,12 @@ void FrameMan::Draw()
 		// Try to move at the framebuffer copy time to maybe prevent wonkyness
 		m_TargetPos[m_NetworkFrameCurrent][whichScreen] = targetPos;
 
-        // Draw the scene
-		if (!m_StoreNetworkBackBuffer/* || g_UInputMan.KeyHeld(KEY_6)*/)
+        // Draw the scene, or just what goes on top of it if the layers have already been drawn
+		if (drawLayersInParallel)
+		{
+			g_SceneMan.DrawScreenGUI(whichScreen, pDrawScreenGUI, targetPos);
+		}
+		else if (!m_StoreNetworkBackBuffer/* || g_UInputMan.KeyHeld(KEY_6)*/)
 		{
 			g_SceneMan.Draw(pDrawScreen, pDrawScreenGUI, targetPos);
 		} 
@@ -2250,6 +2658,9 @@ void FrameMan::Draw()
 				GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, 17, 114, str, GUIFont::Left);
 #endif // __USE_SOUND_FMOD
 
+				sprintf(str, "Lua Heap: %i KB  GC: %.2f ms", g_LuaMan.GetHeapSizeKB(), g_LuaMan.GetGCTimeMS());
+				GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, 17, 124, str, GUIFont::Left);
+
 				int xOffset = 17;
 				int yOffset = 134;
 				int blockHeight = 34;
@@ -2326,6 +2737,44 @@ void FrameMan::Draw()
 					sprintf(str, "Peak: %i", peak / 1000);
 		            GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, xOffset + 130, blockStart, str, GUIFont::Left);
 				}
+
+				// Rays cast and pixels checked by them since the last drawn frame, per kind of ray
+				GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, xOffset + 220, yOffset, "Rays / Pixels", GUIFont::Left);
+				for (int ray = 0; ray < SceneMan::RAY_TYPECOUNT; ++ray)
+				{
+					SceneMan::RayType rayType = static_cast<SceneMan::RayType>(ray);
+					sprintf(str, "%s: %i / %i", SceneMan::GetRayTypeName(rayType), g_SceneMan.GetRayCallCount(rayType), g_SceneMan.GetRayPixelCount(rayType));
+					GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, xOffset + 220, yOffset + 10 * (ray + 1), str, GUIFont::Left);
+				}
+
+				int listStart = yOffset + 10 * (SceneMan::RAY_TYPECOUNT + 2);
+
+				// The scopes all threads have spent the most time in lately, while the profiler is running
+				if (FrameProfiler::IsEnabled())
+				{
+					GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, xOffset + 220, listStart, "Scope: ms / calls", GUIFont::Left);
+					const vector<FrameProfiler::ScopeStats> &topScopes = FrameProfiler::GetTopScopes();
+					for (int scope = 0; scope < topScopes.size(); ++scope)
+					{
+						sprintf(str, "%.400s: %.2f / %i", topScopes[scope].m_Name.c_str(), topScopes[scope].m_AverageMS, topScopes[scope].m_Calls);
+						GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, xOffset + 220, listStart + 10 * (scope + 1), str, GUIFont::Left);
+					}
+					listStart += 10 * (topScopes.size() + 2);
+				}
+
+				// The presets that have been costing the most sim and draw time lately, while MovableMan is tallying them
+				if (g_MovableMan.IsCostAccounting())
+				{
+					g_MovableMan.UpdateTopCosts(PERFTOPPRESETS);
+					GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, xOffset + 220, listStart, "Preset: ms (travel / update / script / draw) x count", GUIFont::Left);
+					const vector<PresetCost> &topCosts = g_MovableMan.GetTopCosts();
+					for (int preset = 0; preset < topCosts.size(); ++preset)
+					{
+						const PresetCost &cost = topCosts[preset];
+						sprintf(str, "%.200s: %.2f (%.2f / %.2f / %.2f / %.2f) x%i", cost.m_PresetName.c_str(), cost.m_TotalMS, cost.m_TravelMS, cost.m_UpdateMS, cost.m_ScriptMS, cost.m_DrawMS, cost.m_Instances);
+						GetLargeFont()->DrawAligned(&pPlayerGUIBitmap, xOffset + 220, listStart + 10 * (preset + 1), str, GUIFont::Left);
+					}
+				}
             }
 
         }
@@ -2565,13 +3014,19 @@ void FrameMan::Draw()
 		}*/
 	}
 
-    // Do postprocessing effects, if applicable and enabled
-    if (m_PostProcessing && g_InActivity && m_BPP == 32)
-        PostProcess();
+    // If nothing needs drawing on top of the post processed frame, leave the post processing of it to the frame thread,
+    // which can then do its thing while the next frame is being simulated
+    m_PresentDeferred = m_ThreadedPresentation && g_InActivity && !IsInMultiplayerMode() && !g_ConsoleMan.IsVisible();
+    if (!m_PresentDeferred)
+    {
+        // Do postprocessing effects, if applicable and enabled
+        if (m_PostProcessing && g_InActivity && m_BPP == 32)
+            PostProcess();
 
-    // Draw the console on top of everything
-    if (FlippingWith32BPP())
-        g_ConsoleMan.Draw(m_pBackBuffer32);
+        // Draw the console on top of everything
+        if (FlippingWith32BPP())
+            g_ConsoleMan.Draw(m_pBackBuffer32);
+    }
 
     release_bitmap(m_pBackBuffer8);
 
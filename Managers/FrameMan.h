@@ -1479,19 +1479,35 @@ public:
 // Arguments:       None.
 // Return value:    None.
 
-    void ClearBackBuffer32() { if (m_pBackBuffer32) clear_to_color(m_pBackBuffer32, 0); }
+    void ClearBackBuffer32();
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          FlipFrameBuffers
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Flips the framebuffer.
+// Description:     Flips the framebuffer. If the last drawn frame was left for the frame
+//                  thread to finish, it is handed over and this returns without waiting
+//                  for it; it reaches the screen at the next WaitForPresent, which the
+//                  next flip does first thing.
 // Arguments:       None.
 // Return value:    None.
 
     void FlipFrameBuffers();
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WaitForPresent
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Blocks until the frame thread is done post processing the last frame
+//                  handed to it, if any, and then blits that frame to the screen. Must be
+//                  called from the main thread before touching the 32bpp back buffer or
+//                  the screen outside of the normal frame flow.
+// Arguments:       None.
+// Return value:    None.
+
+    void WaitForPresent();
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          FlippingWith32BPP
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1690,6 +1706,82 @@ public:
 
 	void SetCurrentPing(unsigned int ping) { m_CurrentPing = ping; }
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          BenchmarkPostProcess
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Times post processing a made up 1920x1080 frame full of glowing
+//                  pixels and rotated effects, and prints the results to the console.
+// Arguments:       How many times to post process the frame.
+// Return value:    None.
+
+	void BenchmarkPostProcess(int iterations);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetHeadless
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets whether the FrameMan runs without a window. Headless, no graphics
+//                  mode is set and nothing is ever blitted to the screen, but everything
+//                  is still drawn to the back buffers. Must be set before Create().
+// Arguments:       Whether to run without a window.
+// Return value:    None.
+
+	void SetHeadless(bool headless = true) { m_Headless = headless; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsHeadless
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Shows whether the FrameMan runs without a window.
+// Arguments:       None.
+// Return value:    Whether there's no window being drawn to.
+
+	bool IsHeadless() const { return m_Headless; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetPerformanceCounterSample
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the latest measurement of a performance counter.
+// Arguments:       The counter to get the latest measurement of.
+// Return value:    The time measured in the current sample, in microseconds.
+
+	int64_t GetPerformanceCounterSample(PerformanceCounters counter) const { return m_PerfData[counter][m_Sample]; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetPerformanceCounterName
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the display name of a performance counter.
+// Arguments:       The counter to get the name of.
+// Return value:    The name of the counter.
+
+	const std::string & GetPerformanceCounterName(PerformanceCounters counter) const { return m_PerfCounterNames[counter]; }
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetPerormanceCounterAverage
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Returns an average value of AVERAGE last samples for specified performance counter
+// Arguments:       None.
+// Return value:    An average value for specified counter.
+	int64_t GetPerormanceCounterAverage(PerformanceCounters counter)
+	{
+		int64_t accum = 0;
+		int smpl = m_Sample;
+
+		for (int i = 0 ; i < AVERAGE; ++i)
+		{
+			accum += m_PerfData[counter][smpl];
+
+			smpl--;
+			if (smpl < 0)
+				smpl = MAXSAMPLES - 1;
+		}
+
+		return accum / AVERAGE;
+	}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Protected member variable and method declarations
 
@@ -1712,6 +1804,16 @@ protected:
     BITMAP *m_pBackBuffer8;
     // 32Bits per pixel back buffer, only used if player elects, and only if in 32bpp video mode
     BITMAP *m_pBackBuffer32;
+    // Copy of the last finished 8bpp back buffer, which the frame thread post processes and the main thread then flips from
+    BITMAP *m_pPresentBuffer8;
+    // Whether finished frames should be post processed on the frame thread while the next one is simulated
+    bool m_ThreadedPresentation;
+    // Whether the last drawn frame was left for the frame thread to post process
+    bool m_PresentDeferred;
+    // Whether a frame was handed to the frame thread and still has to be blitted to the screen once it's done with it
+    bool m_PresentPending;
+    // Whether there's no window, so nothing is ever blitted to the screen
+    bool m_Headless;
 
 	// Per-player allocated frame buffer to draw upon during frameman draw
 	BITMAP *m_pNetworkBackBufferIntermediate8[2][MAXSCREENCOUNT];
@@ -1775,12 +1877,17 @@ protected:
     std::list<PostEffect> m_PostScreenEffects;
     // List of screen-relative areas that will be processed with glow
     std::list<Box> m_PostScreenGlowBoxes;
-	// Temp bitmap to rotate post effects in it
-	BITMAP * m_pTempEffectBitmap_16;
-	BITMAP * m_pTempEffectBitmap_32;
-	BITMAP * m_pTempEffectBitmap_64;
-	BITMAP * m_pTempEffectBitmap_128;
-	BITMAP * m_pTempEffectBitmap_256;
+    // The effects and glow areas of the frame that is being finished on the frame thread
+    std::list<PostEffect> m_PresentScreenEffects;
+    std::list<Box> m_PresentScreenGlowBoxes;
+    // Post effect bitmaps already rotated to the angles they have been drawn at, by their source bitmap and angle bucket. Owned, and let go of all at once when too many pile up
+    std::map<std::pair<BITMAP *, int>, BITMAP *> m_RotatedEffects;
+    // How many bytes of pixels the bitmaps in m_RotatedEffects take up
+    int m_RotatedEffectBytes;
+    // Owned bitmap the post effects too big to be cached are rotated into when they're drawn
+    BITMAP *m_pRotatedEffectScratch;
+    // Counts the frames that have been glowed, so the flickering of the glows can be different every frame
+    unsigned int m_GlowFrame;
 
     // Whether the screen is split horizontally across the screen, ie as two splitscreens one above the other.
     bool m_HSplit;
@@ -1790,8 +1897,8 @@ protected:
     bool m_HSplitOverride;
     // Whether the screen is set to split vertically in settings
     bool m_VSplitOverride;
-    // Intermediary split screen bitmap.
-    BITMAP *m_pPlayerScreen;
+    // Intermediary split screen bitmaps, one for each screen.
+    BITMAP *m_apPlayerScreen[MAXSCREENCOUNT];
     // Dimensions of each of the screens of each player. Will be smaller than resolution only if the screen is split
     int m_PlayerScreenWidth;
     int m_PlayerScreenHeight;
@@ -1904,34 +2011,73 @@ protected:
 		}
 	}
 
+
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          GetPerormanceCounterAverage
+// Private member variable and method declarations
+
+private:
+
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Returns an average value of AVERAGE last samples for specified performance counter
-// Arguments:       None.
-// Return value:    An average value for specified counter.
-	int64_t GetPerormanceCounterAverage(PerformanceCounters counter)
-	{
-		int64_t accum = 0;
-		int smpl = m_Sample;
+// Method:          PostProcess
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Copies an 8bpp frame into the 32bpp back buffer and adds the passed in
+//                  glows and effects on top of it.
+// Arguments:       The 8bpp frame to post process.
+//                  The screen areas to look for glowing pixels in.
+//                  The effects to draw. This list is cleared out when done.
+// Return value:    None.
 
-		for (int i = 0 ; i < AVERAGE; ++i)
-		{
-			accum += m_PerfData[counter][smpl];
+    void PostProcess(BITMAP *pSourceBitmap, std::list<Box> &glowBoxes, std::list<PostEffect> &effects);
 
-			smpl--;
-			if (smpl < 0)
-				smpl = MAXSAMPLES - 1;
-		}
 
-		return accum / AVERAGE;
-	}
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawPixelGlows
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Puts a glow on the 32bpp back buffer over every glowing pixel of an
+//                  8bpp frame within the glow boxes. The frame is split up into bands
+//                  of rows that are glowed on the worker threads.
+// Arguments:       The 8bpp frame to look for glowing pixels in.
+//                  The screen areas to look for glowing pixels in.
+// Return value:    None.
+
+    void DrawPixelGlows(BITMAP *pSourceBitmap, const std::list<Box> &glowBoxes);
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Private member variable and method declarations
+// Method:          GetRotatedEffect
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets a post effect bitmap rotated to the cached angle closest to the
+//                  one asked for, rotating it first if it hasn't been at that angle yet.
+// Arguments:       The post effect bitmap to rotate.
+//                  The angle to rotate it to, in radians.
+// Return value:    The rotated bitmap, which is drawn with the same top left corner as
+//                  the unrotated one. Owned by the FrameMan, and only good until the
+//                  next call if the effect is too big to be cached.
+
+    BITMAP * GetRotatedEffect(BITMAP *pBitmap, float angle);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetPalette
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes a palette the current one. When headless it's only selected
+//                  for color conversions, as there's no screen palette to set.
+// Arguments:       The palette to use.
+// Return value:    None.
+
+    void SetPalette(const PALETTE palette);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          BlitToScreen
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Copies a finished frame to the screen, scaling it if needed.
+// Arguments:       The 8bpp frame to show if the 32bpp back buffer isn't used.
+//                  Whether the frame was drawn during an activity.
+// Return value:    None.
+
+    void BlitToScreen(BITMAP *pBackBuffer8, bool inActivity);
 
-private:
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Clear
@@ -62,6 +62,9 @@ extern "C"
 //#include "boost/shared_ptr.hpp"
 
 #include <string>
+#include <map>
+#include <climits>
+#include <cfloat>
 using namespace std;
 using namespace luabind;
 
@@ -122,6 +125,9 @@ namespace RTE
 
 const string LuaMan::m_ClassName = "LuaMan";
 
+// MovableObject:s keep their object references without including the Lua headers
+static_assert(NO_LUA_OBJECT_REF == LUA_NOREF, "NO_LUA_OBJECT_REF has to match LUA_NOREF");
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Preset clone adapters that will return the exact pre-cast types so we don't have to do:
@@ -364,6 +370,605 @@ void AddParticle(MovableMan &This, MovableObject *pParticle)
     else
         This.AddParticle(pParticle);
 }
+void StartProfiler()
+{
+    FrameProfiler::Start();
+    g_ConsoleMan.PrintString("SYSTEM: Profiler started");
+}
+void StopProfiler()
+{
+    FrameProfiler::Stop();
+    g_ConsoleMan.PrintString("SYSTEM: Profiler stopped");
+}
+void ExportProfile(std::string filePath)
+{
+    if (FrameProfiler::ExportTrace(filePath) < 0)
+        g_ConsoleMan.PrintString("ERROR: Could not write the profile to " + filePath);
+    else
+        g_ConsoleMan.PrintString("SYSTEM: Profile written to " + filePath + ", open it in chrome://tracing or Perfetto");
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Fast paths for the hottest MovableObject, MOSRotating and Actor accessors
+//
+// Going through a luabind property means string lookups in the class tables, overload
+// matching and, for Vector:s, a whole new userdata to collect later. These plain C
+// functions in the MOFast table skip all that and hand numbers straight back, e.g.
+// local x, y = MOFast.GetPos(self). The properties are all still there for everything else.
+
+// Means a class' objects can't be used as the fast path's type
+#define NO_FASTPATH_OFFSET INT_MIN
+
+// Where in the objects of each class the TYPE part is, keyed by the metatable all objects of a luabind class share
+template <class TYPE> struct FastPathCache
+{
+    static map<const void *, int> s_Offsets;
+    // Scripts tend to hit the same class over and over, so check the last one before the map
+    static const void *s_pLastMetatable;
+    static int s_LastOffset;
+};
+template <class TYPE> map<const void *, int> FastPathCache<TYPE>::s_Offsets;
+template <class TYPE> const void * FastPathCache<TYPE>::s_pLastMetatable = 0;
+template <class TYPE> int FastPathCache<TYPE>::s_LastOffset = NO_FASTPATH_OFFSET;
+
+template <class TYPE> static void ClearFastPathCache()
+{
+    FastPathCache<TYPE>::s_Offsets.clear();
+    FastPathCache<TYPE>::s_pLastMetatable = 0;
+    FastPathCache<TYPE>::s_LastOffset = NO_FASTPATH_OFFSET;
+}
+
+// The metatables go away with the state, and a new state may well put different ones at the same addresses
+static void ClearFastPathCaches()
+{
+    ClearFastPathCache<MovableObject>();
+    ClearFastPathCache<MOSRotating>();
+    ClearFastPathCache<Actor>();
+}
+
+// Gets the TYPE a luabind object on the stack points to, or 0 if it isn't one. Does the same
+// cast as luabind's own pointer converter, but only works it out once per class
+template <class TYPE> static TYPE * FastPathObject(lua_State *pState, int index, bool modifies)
+{
+    if (lua_type(pState, index) != LUA_TUSERDATA || !lua_getmetatable(pState, index))
+        return 0;
+    const void *pMetatable = lua_topointer(pState, -1);
+    lua_pop(pState, 1);
+
+    detail::object_rep *pObjectRep = static_cast<detail::object_rep *>(lua_touserdata(pState, index));
+
+    int offset = FastPathCache<TYPE>::s_LastOffset;
+    if (pMetatable != FastPathCache<TYPE>::s_pLastMetatable)
+    {
+        map<const void *, int>::iterator itr = FastPathCache<TYPE>::s_Offsets.find(pMetatable);
+        if (itr != FastPathCache<TYPE>::s_Offsets.end())
+            offset = itr->second;
+        else
+        {
+            offset = NO_FASTPATH_OFFSET;
+            // Classes derived in Lua and held objects keep their C++ part elsewhere, so leave those to luabind
+            if (detail::is_class_object(pState, index) && !(pObjectRep->flags() & detail::object_rep::lua_class) && !pObjectRep->crep()->has_holder())
+            {
+                int pointerOffset = 0;
+                if (detail::implicit_cast(pObjectRep->crep(), LUABIND_TYPEID(TYPE), pointerOffset) >= 0)
+                    offset = pointerOffset;
+            }
+            FastPathCache<TYPE>::s_Offsets.insert(pair<const void *, int>(pMetatable, offset));
+        }
+        FastPathCache<TYPE>::s_pLastMetatable = pMetatable;
+        FastPathCache<TYPE>::s_LastOffset = offset;
+    }
+
+    if (offset == NO_FASTPATH_OFFSET || !pObjectRep->ptr() || (modifies && (pObjectRep->flags() & detail::object_rep::constant)))
+        return 0;
+    return static_cast<TYPE *>(pObjectRep->ptr(offset));
+}
+
+#define FASTPATHOBJECT(TYPE, MODIFIES) \
+    TYPE *pObject = FastPathObject<TYPE>(pState, 1, MODIFIES); \
+    if (!pObject) \
+        return luaL_typerror(pState, 1, #TYPE);
+
+#define FASTPATHGETNUMBER(TYPE, NAME, GETTER) \
+    static int FastPath##NAME(lua_State *pState) \
+    { \
+        FASTPATHOBJECT(TYPE, false) \
+        lua_pushnumber(pState, (lua_Number)pObject->GETTER); \
+        return 1; \
+    }
+
+#define FASTPATHGETBOOL(TYPE, NAME, GETTER) \
+    static int FastPath##NAME(lua_State *pState) \
+    { \
+        FASTPATHOBJECT(TYPE, false) \
+        lua_pushboolean(pState, pObject->GETTER); \
+        return 1; \
+    }
+
+#define FASTPATHGETVECTOR(TYPE, NAME, GETTER) \
+    static int FastPath##NAME(lua_State *pState) \
+    { \
+        FASTPATHOBJECT(TYPE, false) \
+        const Vector &vector = pObject->GETTER; \
+        lua_pushnumber(pState, vector.m_X); \
+        lua_pushnumber(pState, vector.m_Y); \
+        return 2; \
+    }
+
+#define FASTPATHSETNUMBER(TYPE, NAME, SETTER, ARGTYPE) \
+    static int FastPath##NAME(lua_State *pState) \
+    { \
+        FASTPATHOBJECT(TYPE, true) \
+        pObject->SETTER((ARGTYPE)luaL_checknumber(pState, 2)); \
+        return 0; \
+    }
+
+#define FASTPATHSETINTEGER(TYPE, NAME, SETTER, ARGTYPE) \
+    static int FastPath##NAME(lua_State *pState) \
+    { \
+        FASTPATHOBJECT(TYPE, true) \
+        pObject->SETTER((ARGTYPE)luaL_checkint(pState, 2)); \
+        return 0; \
+    }
+
+#define FASTPATHSETBOOL(TYPE, NAME, SETTER) \
+    static int FastPath##NAME(lua_State *pState) \
+    { \
+        FASTPATHOBJECT(TYPE, true) \
+        pObject->SETTER(lua_toboolean(pState, 2) != 0); \
+        return 0; \
+    }
+
+#define FASTPATHSETVECTOR(TYPE, NAME, SETTER) \
+    static int FastPath##NAME(lua_State *pState) \
+    { \
+        FASTPATHOBJECT(TYPE, true) \
+        pObject->SETTER(Vector((float)luaL_checknumber(pState, 2), (float)luaL_checknumber(pState, 3))); \
+        return 0; \
+    }
+
+FASTPATHGETVECTOR(MovableObject, GetPos, GetPos())
+FASTPATHSETVECTOR(MovableObject, SetPos, SetPos)
+FASTPATHGETVECTOR(MovableObject, GetVel, GetVel())
+FASTPATHSETVECTOR(MovableObject, SetVel, SetVel)
+FASTPATHGETNUMBER(MovableObject, GetRotAngle, GetRotAngle())
+FASTPATHSETNUMBER(MovableObject, SetRotAngle, SetRotAngle, float)
+FASTPATHGETNUMBER(MovableObject, GetAngularVel, GetAngularVel())
+FASTPATHSETNUMBER(MovableObject, SetAngularVel, SetAngularVel, float)
+FASTPATHGETNUMBER(MovableObject, GetTeam, GetTeam())
+FASTPATHGETNUMBER(MovableObject, GetMass, GetMass())
+FASTPATHGETNUMBER(MovableObject, GetAge, GetAge())
+FASTPATHGETNUMBER(MovableObject, GetLifetime, GetLifetime())
+FASTPATHGETBOOL(MovableObject, IsHFlipped, IsHFlipped())
+FASTPATHGETNUMBER(MovableObject, GetID, GetID())
+FASTPATHGETNUMBER(MovableObject, GetRootID, GetRootID())
+FASTPATHGETBOOL(MovableObject, IsToDelete, ToDelete())
+FASTPATHSETBOOL(MovableObject, SetToDelete, SetToDelete)
+FASTPATHGETNUMBER(MovableObject, GetPinStrength, GetPinStrength())
+FASTPATHGETNUMBER(MovableObject, GetRadius, GetRadius())
+FASTPATHGETNUMBER(MovableObject, GetSharpness, GetSharpness())
+FASTPATHGETBOOL(MovableObject, IsActor, IsActor())
+FASTPATHGETNUMBER(MOSRotating, GetWoundCount, GetWoundCount())
+FASTPATHGETNUMBER(Actor, GetHealth, GetHealth())
+FASTPATHSETINTEGER(Actor, SetHealth, SetHealth, int)
+FASTPATHGETNUMBER(Actor, GetMaxHealth, GetMaxHealth())
+FASTPATHGETNUMBER(Actor, GetStatus, GetStatus())
+FASTPATHSETINTEGER(Actor, SetStatus, SetStatus, Actor::Status)
+FASTPATHGETNUMBER(Actor, GetAimAngle, GetAimAngle(lua_isnoneornil(pState, 2) || lua_toboolean(pState, 2)))
+FASTPATHGETNUMBER(Actor, GetAIMode, GetAIMode())
+FASTPATHGETVECTOR(Actor, GetEyePos, GetEyePos())
+
+// Which class an object has to be for a benchmark case to apply to it
+enum FastPathClass
+{
+    FASTPATH_MOVABLEOBJECT = 0,
+    FASTPATH_MOSROTATING,
+    FASTPATH_ACTOR
+};
+
+// One of the calls MOFast.Benchmark compares: what it looks like through luabind and through the fast path.
+// Each runs as the body of a loop in "local mo, n = ...; <setup> for i = 1, n do <body> end"
+struct FastPathBenchmarkCase
+{
+    const char *m_Name;
+    FastPathClass m_Class;
+    const char *m_LuabindSetup;
+    const char *m_LuabindBody;
+    const char *m_FastSetup;
+    const char *m_FastBody;
+};
+
+// The 30 most used accessors; the fast path function is the one named, put in the local f
+static const FastPathBenchmarkCase s_FastPathBenchmarkCases[] =
+{
+    { "GetPos", FASTPATH_MOVABLEOBJECT, "", "local v = mo.Pos", "", "local x, y = f(mo)" },
+    { "SetPos", FASTPATH_MOVABLEOBJECT, "local v = mo.Pos;", "mo.Pos = v", "local x, y = MOFast.GetPos(mo);", "f(mo, x, y)" },
+    { "GetVel", FASTPATH_MOVABLEOBJECT, "", "local v = mo.Vel", "", "local x, y = f(mo)" },
+    { "SetVel", FASTPATH_MOVABLEOBJECT, "local v = mo.Vel;", "mo.Vel = v", "local x, y = MOFast.GetVel(mo);", "f(mo, x, y)" },
+    { "GetRotAngle", FASTPATH_MOVABLEOBJECT, "", "local a = mo.RotAngle", "", "local a = f(mo)" },
+    { "SetRotAngle", FASTPATH_MOVABLEOBJECT, "local a = mo.RotAngle;", "mo.RotAngle = a", "local a = mo.RotAngle;", "f(mo, a)" },
+    { "GetAngularVel", FASTPATH_MOVABLEOBJECT, "", "local a = mo.AngularVel", "", "local a = f(mo)" },
+    { "SetAngularVel", FASTPATH_MOVABLEOBJECT, "local a = mo.AngularVel;", "mo.AngularVel = a", "local a = mo.AngularVel;", "f(mo, a)" },
+    { "GetTeam", FASTPATH_MOVABLEOBJECT, "", "local t = mo.Team", "", "local t = f(mo)" },
+    { "GetMass", FASTPATH_MOVABLEOBJECT, "", "local m = mo.Mass", "", "local m = f(mo)" },
+    { "GetAge", FASTPATH_MOVABLEOBJECT, "", "local a = mo.Age", "", "local a = f(mo)" },
+    { "GetLifetime", FASTPATH_MOVABLEOBJECT, "", "local l = mo.Lifetime", "", "local l = f(mo)" },
+    { "IsHFlipped", FASTPATH_MOVABLEOBJECT, "", "local h = mo.HFlipped", "", "local h = f(mo)" },
+    { "GetID", FASTPATH_MOVABLEOBJECT, "", "local id = mo.ID", "", "local id = f(mo)" },
+    { "GetRootID", FASTPATH_MOVABLEOBJECT, "", "local id = mo.RootID", "", "local id = f(mo)" },
+    { "IsToDelete", FASTPATH_MOVABLEOBJECT, "", "local d = mo.ToDelete", "", "local d = f(mo)" },
+    { "SetToDelete", FASTPATH_MOVABLEOBJECT, "local d = mo.ToDelete;", "mo.ToDelete = d", "local d = mo.ToDelete;", "f(mo, d)" },
+    { "GetPinStrength", FASTPATH_MOVABLEOBJECT, "", "local p = mo.PinStrength", "", "local p = f(mo)" },
+    { "GetRadius", FASTPATH_MOVABLEOBJECT, "", "local r = mo.Radius", "", "local r = f(mo)" },
+    { "GetSharpness", FASTPATH_MOVABLEOBJECT, "", "local s = mo.Sharpness", "", "local s = f(mo)" },
+    { "IsActor", FASTPATH_MOVABLEOBJECT, "", "local a = mo:IsActor()", "", "local a = f(mo)" },
+    { "GetWoundCount", FASTPATH_MOSROTATING, "", "local w = mo.WoundCount", "", "local w = f(mo)" },
+    { "GetHealth", FASTPATH_ACTOR, "", "local h = mo.Health", "", "local h = f(mo)" },
+    { "SetHealth", FASTPATH_ACTOR, "local h = mo.Health;", "mo.Health = h", "local h = mo.Health;", "f(mo, h)" },
+    { "GetMaxHealth", FASTPATH_ACTOR, "", "local h = mo.MaxHealth", "", "local h = f(mo)" },
+    { "GetStatus", FASTPATH_ACTOR, "", "local s = mo.Status", "", "local s = f(mo)" },
+    { "SetStatus", FASTPATH_ACTOR, "local s = mo.Status;", "mo.Status = s", "local s = mo.Status;", "f(mo, s)" },
+    { "GetAimAngle", FASTPATH_ACTOR, "", "local a = mo:GetAimAngle(true)", "", "local a = f(mo, true)" },
+    { "GetAIMode", FASTPATH_ACTOR, "", "local m = mo.AIMode", "", "local m = f(mo)" },
+    { "GetEyePos", FASTPATH_ACTOR, "", "local v = mo.EyePos", "", "local x, y = f(mo)" }
+};
+
+// Runs one benchmark loop on the object at index 1 and gives how long each call took on average, in ns, or a negative number if it failed
+static double RunFastPathBenchmarkLoop(lua_State *pState, const string &setup, const char *body, int iterations)
+{
+    string chunk = "local mo, n = ...; " + setup + " for i = 1, n do " + body + " end";
+    if (luaL_loadstring(pState, chunk.c_str()))
+    {
+        g_ConsoleMan.PrintString(string("ERROR: ") + lua_tostring(pState, -1));
+        lua_pop(pState, 1);
+        return -1;
+    }
+    lua_pushvalue(pState, 1);
+    lua_pushinteger(pState, iterations);
+
+    Timer loopTimer;
+    if (lua_pcall(pState, 2, 0, 0))
+    {
+        g_ConsoleMan.PrintString(string("ERROR: ") + lua_tostring(pState, -1));
+        lua_pop(pState, 1);
+        return -1;
+    }
+    return loopTimer.GetElapsedRealTimeMS() * 1000000.0 / (double)iterations;
+}
+
+// MOFast.Benchmark(mo, [iterations]) times each of the benchmark cases that apply to an object both ways and prints the results to the console
+static int FastPathBenchmark(lua_State *pState)
+{
+    FASTPATHOBJECT(MovableObject, true)
+    int iterations = luaL_optint(pState, 2, 100000);
+    luaL_argcheck(pState, iterations > 0, 2, "has to be more than 0");
+
+    bool isOfClass[3];
+    isOfClass[FASTPATH_MOVABLEOBJECT] = true;
+    isOfClass[FASTPATH_MOSROTATING] = FastPathObject<MOSRotating>(pState, 1, true) != 0;
+    isOfClass[FASTPATH_ACTOR] = FastPathObject<Actor>(pState, 1, true) != 0;
+
+    char line[256];
+    sprintf(line, "SYSTEM: Timing %i calls each on %.64s, luabind vs. MOFast:", iterations, pObject->GetPresetName().c_str());
+    g_ConsoleMan.PrintString(line);
+
+    double totalLuabind = 0;
+    double totalFast = 0;
+    int caseCount = sizeof(s_FastPathBenchmarkCases) / sizeof(s_FastPathBenchmarkCases[0]);
+    for (int i = 0; i < caseCount; ++i)
+    {
+        const FastPathBenchmarkCase &benchmarkCase = s_FastPathBenchmarkCases[i];
+        if (!isOfClass[benchmarkCase.m_Class])
+            continue;
+
+        double luabindNS = RunFastPathBenchmarkLoop(pState, benchmarkCase.m_LuabindSetup, benchmarkCase.m_LuabindBody, iterations);
+        double fastNS = RunFastPathBenchmarkLoop(pState, string("local f = MOFast.") + benchmarkCase.m_Name + "; " + benchmarkCase.m_FastSetup, benchmarkCase.m_FastBody, iterations);
+        if (luabindNS < 0 || fastNS < 0)
+            continue;
+
+        totalLuabind += luabindNS;
+        totalFast += fastNS;
+        sprintf(line, "%-16s %8.1f ns %8.1f ns  %5.1fx", benchmarkCase.m_Name, luabindNS, fastNS, fastNS > 0 ? luabindNS / fastNS : 0);
+        g_ConsoleMan.PrintString(line);
+    }
+    sprintf(line, "%-16s %8.1f ns %8.1f ns  %5.1fx", "Total", totalLuabind, totalFast, totalFast > 0 ? totalLuabind / totalFast : 0);
+    g_ConsoleMan.PrintString(line);
+
+    return 0;
+}
+
+static const luaL_Reg s_FastPathFunctions[] =
+{
+    { "GetPos", FastPathGetPos },
+    { "SetPos", FastPathSetPos },
+    { "GetVel", FastPathGetVel },
+    { "SetVel", FastPathSetVel },
+    { "GetRotAngle", FastPathGetRotAngle },
+    { "SetRotAngle", FastPathSetRotAngle },
+    { "GetAngularVel", FastPathGetAngularVel },
+    { "SetAngularVel", FastPathSetAngularVel },
+    { "GetTeam", FastPathGetTeam },
+    { "GetMass", FastPathGetMass },
+    { "GetAge", FastPathGetAge },
+    { "GetLifetime", FastPathGetLifetime },
+    { "IsHFlipped", FastPathIsHFlipped },
+    { "GetID", FastPathGetID },
+    { "GetRootID", FastPathGetRootID },
+    { "IsToDelete", FastPathIsToDelete },
+    { "SetToDelete", FastPathSetToDelete },
+    { "GetPinStrength", FastPathGetPinStrength },
+    { "GetRadius", FastPathGetRadius },
+    { "GetSharpness", FastPathGetSharpness },
+    { "IsActor", FastPathIsActor },
+    { "GetWoundCount", FastPathGetWoundCount },
+    { "GetHealth", FastPathGetHealth },
+    { "SetHealth", FastPathSetHealth },
+    { "GetMaxHealth", FastPathGetMaxHealth },
+    { "GetStatus", FastPathGetStatus },
+    { "SetStatus", FastPathSetStatus },
+    { "GetAimAngle", FastPathGetAimAngle },
+    { "GetAIMode", FastPathGetAIMode },
+    { "GetEyePos", FastPathGetEyePos },
+    { "Benchmark", FastPathBenchmark },
+    { 0, 0 }
+};
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Functions of the worker states
+//
+// Scripts in the worker states can't touch the engine at all. They read the snapshot in
+// their object's table and in the Snapshot table, and change things through commands on
+// their object's table which get applied once all worker states are done. Each function
+// has its LuaWorkerState as its only upvalue.
+
+static LuaWorkerState * GetWorkerState(lua_State *pState)
+{
+    return static_cast<LuaWorkerState *>(lua_touserdata(pState, lua_upvalueindex(1)));
+}
+
+// Queues a command with up to four numbers, which come after the object table on the stack
+static int QueueWorkerCommand(lua_State *pState, LuaCommand::CommandType type, int valueCount)
+{
+    LuaWorkerState *pWorker = GetWorkerState(pState);
+    if (!pWorker->m_pCommands)
+        return luaL_error(pState, "commands can only be given from the functions of a scripted object");
+
+    // Check the arguments before anything that needs destructing is made, since a Lua error won't run those
+    float values[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < valueCount; ++i)
+        values[i] = (float)luaL_checknumber(pState, i + 2);
+
+    LuaCommand command;
+    command.m_Type = type;
+    for (int i = 0; i < 4; ++i)
+        command.m_Values[i] = values[i];
+    pWorker->m_pCommands->push_back(command);
+    return 0;
+}
+
+static int WorkerSetPos(lua_State *pState) { return QueueWorkerCommand(pState, LuaCommand::SETPOS, 2); }
+static int WorkerSetVel(lua_State *pState) { return QueueWorkerCommand(pState, LuaCommand::SETVEL, 2); }
+static int WorkerSetRotAngle(lua_State *pState) { return QueueWorkerCommand(pState, LuaCommand::SETROTANGLE, 1); }
+static int WorkerSetAngularVel(lua_State *pState) { return QueueWorkerCommand(pState, LuaCommand::SETANGULARVEL, 1); }
+static int WorkerAddImpulseForce(lua_State *pState) { return QueueWorkerCommand(pState, LuaCommand::ADDIMPULSEFORCE, 2); }
+static int WorkerSetHealth(lua_State *pState) { return QueueWorkerCommand(pState, LuaCommand::SETHEALTH, 1); }
+static int WorkerGibThis(lua_State *pState) { return QueueWorkerCommand(pState, LuaCommand::GIBTHIS, 0); }
+
+static int WorkerSetToDelete(lua_State *pState)
+{
+    // Like MovableObject::SetToDelete, no argument means true
+    bool toDelete = lua_isnoneornil(pState, 2) || lua_toboolean(pState, 2);
+    lua_settop(pState, 1);
+    lua_pushnumber(pState, toDelete ? 1 : 0);
+    return QueueWorkerCommand(pState, LuaCommand::SETTODELETE, 1);
+}
+
+// self:AddParticle(className, presetName, x, y, [velX, velY])
+static int WorkerAddParticle(lua_State *pState)
+{
+    LuaWorkerState *pWorker = GetWorkerState(pState);
+    if (!pWorker->m_pCommands)
+        return luaL_error(pState, "commands can only be given from the functions of a scripted object");
+
+    const char *className = luaL_checkstring(pState, 2);
+    const char *presetName = luaL_checkstring(pState, 3);
+    float values[4];
+    values[0] = (float)luaL_checknumber(pState, 4);
+    values[1] = (float)luaL_checknumber(pState, 5);
+    values[2] = (float)luaL_optnumber(pState, 6, 0);
+    values[3] = (float)luaL_optnumber(pState, 7, 0);
+
+    LuaCommand command;
+    command.m_Type = LuaCommand::ADDPARTICLE;
+    for (int i = 0; i < 4; ++i)
+        command.m_Values[i] = values[i];
+    command.m_Text[0] = className;
+    command.m_Text[1] = presetName;
+    pWorker->m_pCommands->push_back(command);
+    return 0;
+}
+
+static int WorkerGetActorCount(lua_State *pState)
+{
+    lua_pushinteger(pState, GetWorkerState(pState)->m_pActorSnapshots->size());
+    return 1;
+}
+
+// Snapshot.GetActor(index) gives the unique ID, team, position, velocity, health and status of an Actor, counting from 1
+static int WorkerGetActor(lua_State *pState)
+{
+    const vector<LuaObjectSnapshot> &actors = *(GetWorkerState(pState)->m_pActorSnapshots);
+    int index = luaL_checkint(pState, 1) - 1;
+    if (index < 0 || index >= (int)actors.size())
+        return 0;
+
+    const LuaObjectSnapshot &actor = actors[index];
+    lua_pushnumber(pState, (lua_Number)actor.m_UniqueID);
+    lua_pushinteger(pState, actor.m_Team);
+    lua_pushnumber(pState, actor.m_Pos.m_X);
+    lua_pushnumber(pState, actor.m_Pos.m_Y);
+    lua_pushnumber(pState, actor.m_Vel.m_X);
+    lua_pushnumber(pState, actor.m_Vel.m_Y);
+    lua_pushinteger(pState, actor.m_Health);
+    lua_pushinteger(pState, actor.m_Status);
+    return 8;
+}
+
+// Snapshot.FindNearestActor(x, y, team, [onTeam], [maxDistance]) gives the index and distance of the closest Actor that is, or with onTeam false isn't, on a team
+static int WorkerFindNearestActor(lua_State *pState)
+{
+    const vector<LuaObjectSnapshot> &actors = *(GetWorkerState(pState)->m_pActorSnapshots);
+    Vector from((float)luaL_checknumber(pState, 1), (float)luaL_checknumber(pState, 2));
+    int team = luaL_checkint(pState, 3);
+    bool onTeam = lua_isnoneornil(pState, 4) || lua_toboolean(pState, 4);
+    float maxDistance = (float)luaL_optnumber(pState, 5, FLT_MAX);
+
+    int nearest = -1;
+    float nearestDistance = maxDistance;
+    for (int i = 0; i < (int)actors.size(); ++i)
+    {
+        if ((actors[i].m_Team == team) != onTeam)
+            continue;
+        float distance = g_SceneMan.ShortestDistance(from, actors[i].m_Pos).GetMagnitude();
+        if (distance < nearestDistance)
+        {
+            nearest = i;
+            nearestDistance = distance;
+        }
+    }
+
+    if (nearest < 0)
+        return 0;
+    lua_pushinteger(pState, nearest + 1);
+    lua_pushnumber(pState, nearestDistance);
+    return 2;
+}
+
+// The terrain doesn't change while the worker states run, so it's safe to read directly
+static int WorkerGetTerrMatter(lua_State *pState)
+{
+    lua_pushinteger(pState, g_SceneMan.GetTerrMatter(luaL_checkint(pState, 1), luaL_checkint(pState, 2)));
+    return 1;
+}
+
+static int WorkerGetDeltaTimeSecs(lua_State *pState)
+{
+    lua_pushnumber(pState, g_TimerMan.GetDeltaTimeSecs());
+    return 1;
+}
+
+// The console isn't safe to print to from the worker threads, so this holds on to what's printed until the parallel run is done
+static int WorkerPrint(lua_State *pState)
+{
+    lua_getglobal(pState, "tostring");
+    lua_pushvalue(pState, 1);
+    lua_call(pState, 1, 1);
+    const char *text = lua_tostring(pState, -1);
+    GetWorkerState(pState)->m_Messages.push_back(string("PRINT: ") + (text ? text : "nil"));
+    return 0;
+}
+
+static const luaL_Reg s_WorkerCommandFunctions[] =
+{
+    { "SetPos", WorkerSetPos },
+    { "SetVel", WorkerSetVel },
+    { "SetRotAngle", WorkerSetRotAngle },
+    { "SetAngularVel", WorkerSetAngularVel },
+    { "AddImpulseForce", WorkerAddImpulseForce },
+    { "SetHealth", WorkerSetHealth },
+    { "SetToDelete", WorkerSetToDelete },
+    { "GibThis", WorkerGibThis },
+    { "AddParticle", WorkerAddParticle },
+    { 0, 0 }
+};
+
+static const luaL_Reg s_WorkerSnapshotFunctions[] =
+{
+    { "GetActorCount", WorkerGetActorCount },
+    { "GetActor", WorkerGetActor },
+    { "FindNearestActor", WorkerFindNearestActor },
+    { "GetTerrMatter", WorkerGetTerrMatter },
+    { "GetDeltaTimeSecs", WorkerGetDeltaTimeSecs },
+    { 0, 0 }
+};
+
+// Fills the table on top of the stack with functions, each getting the worker state as their upvalue
+static void SetWorkerFunctions(LuaWorkerState *pWorker, const luaL_Reg *pFunctions)
+{
+    for (; pFunctions->name; ++pFunctions)
+    {
+        lua_pushlightuserdata(pWorker->m_pState, pWorker);
+        lua_pushcclosure(pWorker->m_pState, pFunctions->func, 1);
+        lua_setfield(pWorker->m_pState, -2, pFunctions->name);
+    }
+}
+
+// Sets the X and Y of a Vector-like table in the table on top of the stack, if it's still a table
+static void SetWorkerVector(lua_State *pState, const char *name, const Vector &vector)
+{
+    lua_getfield(pState, -1, name);
+    if (lua_istable(pState, -1))
+    {
+        lua_pushnumber(pState, vector.m_X);
+        lua_setfield(pState, -2, "X");
+        lua_pushnumber(pState, vector.m_Y);
+        lua_setfield(pState, -2, "Y");
+    }
+    lua_pop(pState, 1);
+}
+
+static void SetWorkerNumber(lua_State *pState, const char *name, lua_Number value)
+{
+    lua_pushnumber(pState, value);
+    lua_setfield(pState, -2, name);
+}
+
+// Calls a function of a script table with an object table, if the script has it
+static void CallWorkerFunction(LuaWorkerState *pWorker, int scriptIndex, int objectIndex, const char *functionName)
+{
+    lua_State *pState = pWorker->m_pState;
+    lua_getfield(pState, scriptIndex, functionName);
+    if (!lua_isfunction(pState, -1))
+    {
+        lua_pop(pState, 1);
+        return;
+    }
+    lua_pushvalue(pState, objectIndex);
+    if (lua_pcall(pState, 1, 0, 0))
+    {
+        const char *error = lua_tostring(pState, -1);
+        pWorker->m_Messages.push_back(string("ERROR: ") + (error ? error : "unknown error in a parallel script"));
+        lua_pop(pState, 1);
+    }
+}
+
+// Takes the snapshot of an object that its script in a worker state gets to see
+static void TakeLuaSnapshot(MovableObject *pObject, LuaObjectSnapshot &snapshot)
+{
+    snapshot.m_pObject = pObject;
+    snapshot.m_pScriptPath = &pObject->GetScriptPath();
+    snapshot.m_pPresetName = &pObject->GetPresetName();
+    snapshot.m_pClassName = &pObject->GetClassName();
+    snapshot.m_UniqueID = pObject->GetUniqueID();
+    snapshot.m_ID = pObject->GetID();
+    snapshot.m_RootID = pObject->GetRootID();
+    snapshot.m_Team = pObject->GetTeam();
+    snapshot.m_Pos = pObject->GetPos();
+    snapshot.m_Vel = pObject->GetVel();
+    snapshot.m_RotAngle = pObject->GetRotAngle();
+    snapshot.m_AngularVel = pObject->GetAngularVel();
+    snapshot.m_Mass = pObject->GetMass();
+    snapshot.m_Age = (float)pObject->GetAge();
+    snapshot.m_HFlipped = pObject->IsHFlipped();
+
+    Actor *pActor = pObject->IsActor() ? dynamic_cast<Actor *>(pObject) : 0;
+    snapshot.m_IsActor = pActor != 0;
+    snapshot.m_Health = pActor ? pActor->GetHealth() : 0;
+    snapshot.m_MaxHealth = pActor ? pActor->GetMaxHealth() : 0;
+    snapshot.m_Status = pActor ? pActor->GetStatus() : 0;
+}
 
 /*
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -408,8 +1013,17 @@ void LuaMan::Clear()
     m_LastError.clear();
 // TODO: is this the best way to give ID's.. won't ever be reset?
     m_NextPresetID = 0;
-    m_NextObjectID = 0;
     m_pTempEntity = 0;
+    m_ObjectTableRef = LUA_NOREF;
+    m_ObjectConverterRef = LUA_NOREF;
+    m_HeapSizeKB = 0;
+    m_CycleEndHeapSizeKB = 0;
+    m_GCTimeMS = 0;
+    m_WorkerStates.clear();
+    m_WorkerStatesFailed = false;
+    m_ObjectSnapshots.clear();
+    m_ActorSnapshots.clear();
+    m_ObjectCommands.clear();
 
 	//Clear files list
 	for (int i = 0; i < MAX_OPEN_FILES; ++i)
@@ -1427,6 +2041,7 @@ int LuaMan::Create()
             .def("IsFullscreen", &FrameMan::IsFullscreen)
             .property("PostProcessing", &FrameMan::IsPostProcessing, &FrameMan::EnablePostProcessing)
             .property("PostPixelGlow", &FrameMan::IsPixelGlowEnabled, &FrameMan::EnablePixelGlow)
+            .def("BenchmarkPostProcess", &FrameMan::BenchmarkPostProcess)
             .def("LoadPalette", &FrameMan::LoadPalette)
             .def("FadeInPalette", &FrameMan::FadeInPalette)
             .def("FadeOutPalette", &FrameMan::FadeOutPalette)
@@ -1716,6 +2331,7 @@ int LuaMan::Create()
             .def("RestoreUnseen", &SceneMan::RestoreUnseen)
             .def("RestoreUnseenBox", &SceneMan::RestoreUnseenBox)
 			.def("CastSeeRay", &SceneMan::CastSeeRay)
+			.def("CastSeeRayFan", &SceneMan::CastSeeRayFan)
 			.def("CastUnseeRay", &SceneMan::CastUnseeRay)
 			.def("CastUnseenRay", &SceneMan::CastUnseenRay)
 			.def("CastMaterialRay", (bool (SceneMan::*)(const Vector &, const Vector &, unsigned char, Vector &, int, bool))&SceneMan::CastMaterialRay)
@@ -2122,6 +2738,16 @@ int LuaMan::Create()
             .def_readwrite("Team", &AlarmEvent::m_Team)
             .def_readwrite("Range", &AlarmEvent::m_Range),
 
+        class_<PresetCost>("PresetCost")
+            .def_readonly("PresetName", &PresetCost::m_PresetName)
+            .def_readonly("ModuleName", &PresetCost::m_ModuleName)
+            .def_readonly("Instances", &PresetCost::m_Instances)
+            .def_readonly("TravelMS", &PresetCost::m_TravelMS)
+            .def_readonly("UpdateMS", &PresetCost::m_UpdateMS)
+            .def_readonly("ScriptMS", &PresetCost::m_ScriptMS)
+            .def_readonly("DrawMS", &PresetCost::m_DrawMS)
+            .def_readonly("TotalMS", &PresetCost::m_TotalMS),
+
         class_<MovableMan>("MovableManager")
             .def("GetMOFromID", &MovableMan::GetMOFromID)
 			.def("FindObjectByUniqueID", &MovableMan::FindObjectByUniqueID)
@@ -2147,6 +2773,10 @@ int LuaMan::Create()
             .property("MaxDroppedItems", &MovableMan::GetMaxDroppedItems, &MovableMan::SetMaxDroppedItems)
             .property("ScriptedEntity", &MovableMan::GetScriptedEntity, &MovableMan::SetScriptedEntity)
             .def("SortTeamRoster", &MovableMan::SortTeamRoster)
+            .property("CostAccounting", &MovableMan::IsCostAccounting, &MovableMan::SetCostAccounting)
+            .def("UpdateTopCosts", &MovableMan::UpdateTopCosts)
+            .def_readwrite("TopCosts", &MovableMan::m_TopCosts, return_stl_iterator)
+            .def("DumpTopCosts", &MovableMan::DumpTopCosts)
 			.def("ChangeActorTeam", &MovableMan::ChangeActorTeam)
 			.def("AddMO", &AddMO, adopt(_2))
             .def("AddActor", &AddActor, adopt(_2))
@@ -2206,7 +2836,10 @@ int LuaMan::Create()
         def("EaseIn", &EaseIn),
         def("EaseOut", &EaseOut),
         def("EaseInOut", &EaseInOut),
-        def("Clamp", &Limit)
+        def("Clamp", &Limit),
+        def("StartProfiler", &StartProfiler),
+        def("StopProfiler", &StopProfiler),
+        def("ExportProfile", &ExportProfile)
     ];
 
     // Assign the manager instances to globals in the lua master state
@@ -2232,6 +2865,19 @@ int LuaMan::Create()
         "package.path = package.path .. \";Base.rte/?.lua\";\n"
     );
 
+    // The fast path accessors, which are plain C functions rather than luabind ones
+    luaL_register(m_pMasterState, "MOFast", s_FastPathFunctions);
+    lua_pop(m_pMasterState, 1);
+
+    // The Lua representations of scripted objects live in a table only reachable through the registry, instead of each getting a global of its own
+    lua_newtable(m_pMasterState);
+    m_ObjectTableRef = luaL_ref(m_pMasterState, LUA_REGISTRYINDEX);
+    // Compile the conversion once, rather than a new snippet for every object
+    if (luaL_loadstring(m_pMasterState, "local className = ...; return _G[\"To\" .. className](MovableMan.ScriptedEntity);") == 0)
+        m_ObjectConverterRef = luaL_ref(m_pMasterState, LUA_REGISTRYINDEX);
+    else
+        lua_pop(m_pMasterState, 1);
+
     return 0;
 }
 
@@ -2283,7 +2929,9 @@ int LuaMan::Save(Writer &writer) const
 
 void LuaMan::Destroy()
 {
+    DestroyWorkerStates();
     lua_close(m_pMasterState);
+    ClearFastPathCaches();
 
 	//Close all opened files
 	for (int i = 0; i < MAX_OPEN_FILES; ++i)
@@ -2543,21 +3191,561 @@ string LuaMan::GetNewPresetID()
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          GetNewObjectID
+// Method:          CreateObjectReference
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Returns an ID string unique to this runtime for use by individual
-//                  objects that are also tracked in the Lua state and have scripts
-//                  associated with them.
+// Description:     Converts MovableMan.ScriptedEntity to its Lua representation and
+//                  keeps it in the object table owned by this.
 
-string LuaMan::GetNewObjectID()
+int LuaMan::CreateObjectReference(const string &className, bool consoleErrors)
 {
-    // Generate the new ID
-    char newID[64];
-    sprintf(newID, "Obj%05i", m_NextObjectID);
-    // Increment the ID so it will be diff for the next one (improve this primitive approach??)
-    m_NextObjectID++;
+    if (!m_pMasterState || m_ObjectConverterRef == LUA_NOREF)
+        return NO_LUA_OBJECT_REF;
 
-    return string(newID);
+    int objectRef = NO_LUA_OBJECT_REF;
+
+    try
+    {
+        lua_rawgeti(m_pMasterState, LUA_REGISTRYINDEX, m_ObjectConverterRef);
+        lua_pushstring(m_pMasterState, className.c_str());
+        if (lua_pcall(m_pMasterState, 1, 1, 0))
+        {
+            m_LastError = string("When creating Lua object: ") + lua_tostring(m_pMasterState, -1);
+            lua_pop(m_pMasterState, 1);
+            if (consoleErrors)
+            {
+                g_ConsoleMan.PrintString("ERROR: " + m_LastError);
+                ClearErrors();
+            }
+            return NO_LUA_OBJECT_REF;
+        }
+
+        // A nil can't be kept in the table, which means the conversion didn't work out
+        if (lua_isnil(m_pMasterState, -1))
+        {
+            lua_pop(m_pMasterState, 1);
+            return NO_LUA_OBJECT_REF;
+        }
+
+        // Put the object table under the object so luaL_ref can pop the object into it
+        lua_rawgeti(m_pMasterState, LUA_REGISTRYINDEX, m_ObjectTableRef);
+        lua_insert(m_pMasterState, -2);
+        objectRef = luaL_ref(m_pMasterState, -2);
+        lua_pop(m_pMasterState, 1);
+    }
+    catch(const std::exception &e)
+    {
+        m_LastError = string("When creating Lua object: ") + e.what();
+        if (consoleErrors)
+        {
+            g_ConsoleMan.PrintString("ERROR: " + m_LastError);
+            ClearErrors();
+        }
+        return NO_LUA_OBJECT_REF;
+    }
+
+    return objectRef;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ReleaseObjectReference
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Removes an object from the object table, so Lua can collect it once
+//                  nothing else refers to it.
+
+void LuaMan::ReleaseObjectReference(int objectRef)
+{
+    if (!m_pMasterState || objectRef == NO_LUA_OBJECT_REF)
+        return;
+
+    lua_rawgeti(m_pMasterState, LUA_REGISTRYINDEX, m_ObjectTableRef);
+    luaL_unref(m_pMasterState, -1, objectRef);
+    lua_pop(m_pMasterState, 1);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RunObjectFunction
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Calls a function of a preset's table with an object from the object
+//                  table as its argument, if both the function and the object exist.
+
+int LuaMan::RunObjectFunction(const string &presetName, const char *functionName, int objectRef, bool consoleErrors)
+{
+    SLICK_PROFILE(0xFF124325);
+
+    if (!m_pMasterState || objectRef == NO_LUA_OBJECT_REF || presetName.empty())
+        return -1;
+
+    int top = lua_gettop(m_pMasterState);
+
+    // Walk down the dotted path to the preset's table, all of which are plain tables so there's nothing here that can raise an error
+    size_t start = 0;
+    size_t dot = presetName.find('.');
+    lua_getglobal(m_pMasterState, presetName.substr(0, dot).c_str());
+    while (dot != string::npos && lua_istable(m_pMasterState, -1))
+    {
+        start = dot + 1;
+        dot = presetName.find('.', start);
+        lua_getfield(m_pMasterState, -1, presetName.substr(start, dot == string::npos ? string::npos : dot - start).c_str());
+        lua_remove(m_pMasterState, -2);
+    }
+    if (!lua_istable(m_pMasterState, -1))
+    {
+        lua_settop(m_pMasterState, top);
+        return 0;
+    }
+
+    // Not every preset defines every function, which is fine
+    lua_getfield(m_pMasterState, -1, functionName);
+    lua_remove(m_pMasterState, -2);
+    if (!lua_isfunction(m_pMasterState, -1))
+    {
+        lua_settop(m_pMasterState, top);
+        return 0;
+    }
+
+    lua_rawgeti(m_pMasterState, LUA_REGISTRYINDEX, m_ObjectTableRef);
+    lua_rawgeti(m_pMasterState, -1, objectRef);
+    lua_remove(m_pMasterState, -2);
+    if (lua_isnil(m_pMasterState, -1))
+    {
+        lua_settop(m_pMasterState, top);
+        return 0;
+    }
+
+    int error = 0;
+
+    try
+    {
+        if (lua_pcall(m_pMasterState, 1, 0, 0))
+        {
+            // Retrieve and pop the error message off the stack
+            m_LastError = lua_tostring(m_pMasterState, -1);
+            lua_pop(m_pMasterState, 1);
+            if (consoleErrors)
+            {
+                g_ConsoleMan.PrintString("ERROR: " + m_LastError);
+                ClearErrors();
+            }
+            error = -1;
+        }
+    }
+    catch(const std::exception &e)
+    {
+        m_LastError = e.what();
+        if (consoleErrors)
+        {
+            g_ConsoleMan.PrintString("ERROR: " + m_LastError);
+            ClearErrors();
+        }
+        error = -1;
+    }
+
+    lua_settop(m_pMasterState, top);
+
+    return error;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetWorkerStateCount
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets how many Lua states parallel scripts are spread across.
+
+int LuaMan::GetWorkerStateCount() const
+{
+    // Once they're open the count can't change, since each object has to stay with the state that has its table
+    if (!m_WorkerStates.empty())
+        return m_WorkerStates.size();
+    // The scripts are written for the worker states' functions, so there's always at least one to run them in
+    return (int)Limit(g_SettingsMan.GetLuaWorkerStates(), MAX_LUA_WORKER_STATES, 1);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RunParallelScripts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Runs the scripts of objects whose presets support it in the worker
+//                  states, and then applies the changes they asked for in order.
+
+void LuaMan::RunParallelScripts(const vector<MovableObject *> &scriptedObjects, const deque<Actor *> &actors)
+{
+    if (scriptedObjects.empty())
+        return;
+
+    // The master state doesn't have the functions these scripts are written for, so there's nowhere else to run them
+    if (m_WorkerStates.empty() && (m_WorkerStatesFailed || CreateWorkerStates(GetWorkerStateCount()) < 0))
+    {
+        m_WorkerStatesFailed = true;
+        return;
+    }
+
+    SLICK_PROFILE(0xFF124326);
+
+    // Everything the scripts get to know is taken here, so they never touch the objects while running
+    m_ObjectSnapshots.resize(scriptedObjects.size());
+    for (int i = 0; i < (int)scriptedObjects.size(); ++i)
+        TakeLuaSnapshot(scriptedObjects[i], m_ObjectSnapshots[i]);
+    m_ActorSnapshots.resize(actors.size());
+    for (int i = 0; i < (int)actors.size(); ++i)
+        TakeLuaSnapshot(actors[i], m_ActorSnapshots[i]);
+
+    // Each object always goes to the same state, which holds its table from one update to the next
+    int stateCount = m_WorkerStates.size();
+    for (int state = 0; state < stateCount; ++state)
+        m_WorkerStates[state]->m_Objects.clear();
+    for (int i = 0; i < (int)m_ObjectSnapshots.size(); ++i)
+        m_WorkerStates[m_ObjectSnapshots[i].m_UniqueID % stateCount]->m_Objects.push_back(i);
+
+    if (m_ObjectCommands.size() < scriptedObjects.size())
+        m_ObjectCommands.resize(scriptedObjects.size());
+
+    g_ThreadMan.ParallelFor(stateCount, [this](int state)
+    {
+        LuaWorkerState *pWorker = m_WorkerStates[state];
+        for (vector<int>::const_iterator itr = pWorker->m_Objects.begin(); itr != pWorker->m_Objects.end(); ++itr)
+        {
+            pWorker->m_pCommands = &m_ObjectCommands[*itr];
+            RunWorkerObject(pWorker, m_ObjectSnapshots[*itr]);
+        }
+        pWorker->m_pCommands = 0;
+    });
+
+    // Apply the commands object by object in the order they were passed in, same as if the scripts had run one after another
+    for (int i = 0; i < (int)scriptedObjects.size(); ++i)
+    {
+        for (vector<LuaCommand>::const_iterator itr = m_ObjectCommands[i].begin(); itr != m_ObjectCommands[i].end(); ++itr)
+            ApplyCommand(scriptedObjects[i], *itr);
+        m_ObjectCommands[i].clear();
+    }
+
+    for (int state = 0; state < stateCount; ++state)
+    {
+        vector<string> &messages = m_WorkerStates[state]->m_Messages;
+        for (vector<string>::const_iterator itr = messages.begin(); itr != messages.end(); ++itr)
+            g_ConsoleMan.PrintString(*itr);
+        messages.clear();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ReleaseParallelObject
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Runs the Destroy function of an object's script in its worker state,
+//                  if any, and lets go of its Lua table there.
+
+void LuaMan::ReleaseParallelObject(unsigned long uniqueID, const string &scriptPath)
+{
+    if (m_WorkerStates.empty())
+        return;
+
+    LuaWorkerState *pWorker = m_WorkerStates[uniqueID % m_WorkerStates.size()];
+    lua_State *pState = pWorker->m_pState;
+    int top = lua_gettop(pState);
+
+    lua_rawgeti(pState, LUA_REGISTRYINDEX, pWorker->m_ObjectTableRef);
+    lua_pushnumber(pState, (lua_Number)uniqueID);
+    lua_rawget(pState, -2);
+    if (lua_istable(pState, -1))
+    {
+        lua_rawgeti(pState, LUA_REGISTRYINDEX, pWorker->m_ScriptTableRef);
+        lua_getfield(pState, -1, scriptPath.c_str());
+        if (lua_istable(pState, -1))
+        {
+            // The object is on its way out, so whatever Destroy asks of it is thrown away
+            vector<LuaCommand> discardedCommands;
+            pWorker->m_pCommands = &discardedCommands;
+            CallWorkerFunction(pWorker, top + 4, top + 2, "Destroy");
+            pWorker->m_pCommands = 0;
+        }
+
+        lua_pushnumber(pState, (lua_Number)uniqueID);
+        lua_pushnil(pState);
+        lua_rawset(pState, top + 1);
+    }
+    lua_settop(pState, top);
+
+    for (vector<string>::const_iterator itr = pWorker->m_Messages.begin(); itr != pWorker->m_Messages.end(); ++itr)
+        g_ConsoleMan.PrintString(*itr);
+    pWorker->m_Messages.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ForgetParallelScript
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes the worker states load a script file anew the next time an
+//                  object uses it.
+
+void LuaMan::ForgetParallelScript(const string &scriptPath)
+{
+    for (vector<LuaWorkerState *>::iterator itr = m_WorkerStates.begin(); itr != m_WorkerStates.end(); ++itr)
+    {
+        lua_State *pState = (*itr)->m_pState;
+        lua_rawgeti(pState, LUA_REGISTRYINDEX, (*itr)->m_ScriptTableRef);
+        lua_pushnil(pState);
+        lua_setfield(pState, -2, scriptPath.c_str());
+        lua_pop(pState, 1);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CreateWorkerStates
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Opens the worker states and gives them the snapshot and command
+//                  functions.
+
+int LuaMan::CreateWorkerStates(int stateCount)
+{
+    for (int state = 0; state < stateCount; ++state)
+    {
+        lua_State *pState = lua_open();
+        if (!pState)
+        {
+            g_ConsoleMan.PrintString("ERROR: Couldn't open the Lua worker states, scripts of presets with ScriptParallel won't run");
+            DestroyWorkerStates();
+            return -1;
+        }
+
+        LuaWorkerState *pWorker = new LuaWorkerState;
+        pWorker->m_pState = pState;
+        pWorker->m_pCommands = 0;
+        pWorker->m_pActorSnapshots = &m_ActorSnapshots;
+        m_WorkerStates.push_back(pWorker);
+
+        // No luabind and nothing that reaches outside the state, only the plain libraries
+        lua_pushcfunction(pState, luaopen_base);
+        lua_pushliteral(pState, LUA_COLIBNAME);
+        lua_call(pState, 1, 0);
+
+        lua_pushcfunction(pState, luaopen_table);
+        lua_pushliteral(pState, LUA_TABLIBNAME);
+        lua_call(pState, 1, 0);
+
+        lua_pushcfunction(pState, luaopen_string);
+        lua_pushliteral(pState, LUA_STRLIBNAME);
+        lua_call(pState, 1, 0);
+
+        lua_pushcfunction(pState, luaopen_math);
+        lua_pushliteral(pState, LUA_MATHLIBNAME);
+        lua_call(pState, 1, 0);
+
+        lua_newtable(pState);
+        pWorker->m_ScriptTableRef = luaL_ref(pState, LUA_REGISTRYINDEX);
+        lua_newtable(pState);
+        pWorker->m_ObjectTableRef = luaL_ref(pState, LUA_REGISTRYINDEX);
+
+        // The commands are looked up through the objects' metatable, so they can be called like self:SetPos(x, y)
+        lua_newtable(pState);
+        lua_newtable(pState);
+        SetWorkerFunctions(pWorker, s_WorkerCommandFunctions);
+        lua_setfield(pState, -2, "__index");
+        pWorker->m_ObjectMetatableRef = luaL_ref(pState, LUA_REGISTRYINDEX);
+
+        lua_newtable(pState);
+        SetWorkerFunctions(pWorker, s_WorkerSnapshotFunctions);
+        lua_setglobal(pState, "Snapshot");
+
+        lua_pushlightuserdata(pState, pWorker);
+        lua_pushcclosure(pState, WorkerPrint, 1);
+        lua_setglobal(pState, "print");
+    }
+
+    return 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DestroyWorkerStates
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Closes all the worker states.
+
+void LuaMan::DestroyWorkerStates()
+{
+    for (vector<LuaWorkerState *>::iterator itr = m_WorkerStates.begin(); itr != m_WorkerStates.end(); ++itr)
+    {
+        lua_close((*itr)->m_pState);
+        delete (*itr);
+    }
+    m_WorkerStates.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RunWorkerObject
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Runs the script of one object in a worker state, loading the script
+//                  and making the object's Lua table first if need be.
+
+void LuaMan::RunWorkerObject(LuaWorkerState *pWorker, const LuaObjectSnapshot &snapshot)
+{
+    lua_State *pState = pWorker->m_pState;
+    int top = lua_gettop(pState);
+    int scriptIndex = top + 2;
+    int objectIndex = top + 4;
+
+    // Find the functions of the object's script, loading the file if this state hasn't yet
+    lua_rawgeti(pState, LUA_REGISTRYINDEX, pWorker->m_ScriptTableRef);
+    lua_getfield(pState, -1, snapshot.m_pScriptPath->c_str());
+    if (lua_isnil(pState, -1))
+    {
+        lua_pop(pState, 1);
+
+        lua_pushnil(pState);
+        lua_setglobal(pState, "Create");
+        lua_pushnil(pState);
+        lua_setglobal(pState, "Destroy");
+        lua_pushnil(pState);
+        lua_setglobal(pState, "Update");
+
+        const char *path = snapshot.m_pScriptPath->c_str();
+#ifndef WIN32
+        extern char *fcase( const char *path );
+        char *fixed = fcase( path );
+        if ( fixed )
+            path = fixed;
+#endif
+        if (luaL_loadfile(pState, path) || lua_pcall(pState, 0, 0, 0))
+        {
+            const char *error = lua_tostring(pState, -1);
+            pWorker->m_Messages.push_back(string("ERROR: ") + (error ? error : "couldn't load " + *(snapshot.m_pScriptPath)));
+            lua_pop(pState, 1);
+            // Keep the failure so it isn't tried again every update
+            lua_pushboolean(pState, 0);
+        }
+        else
+        {
+            lua_newtable(pState);
+            lua_getglobal(pState, "Create");
+            lua_setfield(pState, -2, "Create");
+            lua_getglobal(pState, "Destroy");
+            lua_setfield(pState, -2, "Destroy");
+            lua_getglobal(pState, "Update");
+            lua_setfield(pState, -2, "Update");
+        }
+        lua_pushvalue(pState, -1);
+        lua_setfield(pState, top + 1, snapshot.m_pScriptPath->c_str());
+    }
+    if (!lua_istable(pState, scriptIndex))
+    {
+        lua_settop(pState, top);
+        return;
+    }
+
+    // Find the object's table, or make it if this is the first time around
+    lua_rawgeti(pState, LUA_REGISTRYINDEX, pWorker->m_ObjectTableRef);
+    lua_pushnumber(pState, (lua_Number)snapshot.m_UniqueID);
+    lua_rawget(pState, -2);
+    bool created = false;
+    if (!lua_istable(pState, -1))
+    {
+        lua_pop(pState, 1);
+        lua_newtable(pState);
+        lua_rawgeti(pState, LUA_REGISTRYINDEX, pWorker->m_ObjectMetatableRef);
+        lua_setmetatable(pState, -2);
+
+        lua_pushstring(pState, snapshot.m_pPresetName->c_str());
+        lua_setfield(pState, -2, "PresetName");
+        lua_pushstring(pState, snapshot.m_pClassName->c_str());
+        lua_setfield(pState, -2, "ClassName");
+        SetWorkerNumber(pState, "UniqueID", (lua_Number)snapshot.m_UniqueID);
+        lua_newtable(pState);
+        lua_setfield(pState, -2, "Pos");
+        lua_newtable(pState);
+        lua_setfield(pState, -2, "Vel");
+
+        lua_pushnumber(pState, (lua_Number)snapshot.m_UniqueID);
+        lua_pushvalue(pState, -2);
+        lua_rawset(pState, top + 3);
+        created = true;
+    }
+
+    // Bring the snapshot in the table up to date, reusing the tables of the Vector:s
+    SetWorkerVector(pState, "Pos", snapshot.m_Pos);
+    SetWorkerVector(pState, "Vel", snapshot.m_Vel);
+    SetWorkerNumber(pState, "ID", snapshot.m_ID);
+    SetWorkerNumber(pState, "RootID", snapshot.m_RootID);
+    SetWorkerNumber(pState, "Team", snapshot.m_Team);
+    SetWorkerNumber(pState, "RotAngle", snapshot.m_RotAngle);
+    SetWorkerNumber(pState, "AngularVel", snapshot.m_AngularVel);
+    SetWorkerNumber(pState, "Mass", snapshot.m_Mass);
+    SetWorkerNumber(pState, "Age", snapshot.m_Age);
+    lua_pushboolean(pState, snapshot.m_HFlipped);
+    lua_setfield(pState, -2, "HFlipped");
+    if (snapshot.m_IsActor)
+    {
+        SetWorkerNumber(pState, "Health", snapshot.m_Health);
+        SetWorkerNumber(pState, "MaxHealth", snapshot.m_MaxHealth);
+        SetWorkerNumber(pState, "Status", snapshot.m_Status);
+    }
+
+    if (created)
+        CallWorkerFunction(pWorker, scriptIndex, objectIndex, "Create");
+    CallWorkerFunction(pWorker, scriptIndex, objectIndex, "Update");
+
+    lua_settop(pState, top);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ApplyCommand
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes the change a parallel script asked for.
+
+void LuaMan::ApplyCommand(MovableObject *pObject, const LuaCommand &command)
+{
+    switch (command.m_Type)
+    {
+        case LuaCommand::SETPOS:
+            pObject->SetPos(Vector(command.m_Values[0], command.m_Values[1]));
+            break;
+        case LuaCommand::SETVEL:
+            pObject->SetVel(Vector(command.m_Values[0], command.m_Values[1]));
+            break;
+        case LuaCommand::SETROTANGLE:
+            pObject->SetRotAngle(command.m_Values[0]);
+            break;
+        case LuaCommand::SETANGULARVEL:
+            pObject->SetAngularVel(command.m_Values[0]);
+            break;
+        case LuaCommand::ADDIMPULSEFORCE:
+            pObject->AddImpulseForce(Vector(command.m_Values[0], command.m_Values[1]));
+            break;
+        case LuaCommand::SETHEALTH:
+        {
+            Actor *pActor = dynamic_cast<Actor *>(pObject);
+            if (pActor)
+                pActor->SetHealth((int)command.m_Values[0]);
+            break;
+        }
+        case LuaCommand::SETTODELETE:
+            pObject->SetToDelete(command.m_Values[0] != 0);
+            break;
+        case LuaCommand::GIBTHIS:
+        {
+            MOSRotating *pRotating = dynamic_cast<MOSRotating *>(pObject);
+            if (pRotating)
+                pRotating->GibThis();
+            break;
+        }
+        case LuaCommand::ADDPARTICLE:
+        {
+            const MovableObject *pPreset = dynamic_cast<const MovableObject *>(g_PresetMan.GetEntityPreset(command.m_Text[0], command.m_Text[1]));
+            if (!pPreset)
+            {
+                g_ConsoleMan.PrintString("ERROR: Couldn't find the " + command.m_Text[0] + " " + command.m_Text[1] + " a parallel script wanted to add");
+                break;
+            }
+            MovableObject *pParticle = dynamic_cast<MovableObject *>(pPreset->Clone());
+            pParticle->SetPos(Vector(command.m_Values[0], command.m_Values[1]));
+            pParticle->SetVel(Vector(command.m_Values[2], command.m_Values[3]));
+            g_MovableMan.AddParticle(pParticle);
+            break;
+        }
+    }
 }
 
 
@@ -2569,7 +3757,28 @@ string LuaMan::GetNewObjectID()
 
 void LuaMan::Update()
 {
-	lua_gc(m_pMasterState, LUA_GCSTEP, 1);
+	int64_t startTicks = g_TimerMan.GetRealTickCount();
+	float ticksPerMS = (float)g_TimerMan.GetTicksPerSecond() / 1000.0f;
+
+	// Collect at least as much as was allocated since last time, so the heap can't keep growing however busy the scripts get
+	int heapSizeKB = lua_gc(m_pMasterState, LUA_GCCOUNT, 0);
+	int allocatedKB = std::max(heapSizeKB - m_HeapSizeKB, 1);
+	bool cycleFinished = lua_gc(m_pMasterState, LUA_GCSTEP, allocatedKB) != 0;
+
+	// Then keep at it with some of the time the last sim updates had to spare, once enough garbage has piled up to be worth it,
+	// so collection cycles get finished off in small steps instead of turning into big pauses later
+	float spareMS = g_TimerMan.GetDeltaTimeMS() - (float)g_FrameMan.GetPerormanceCounterAverage(FrameMan::PERF_SIM_TOTAL) / 1000.0f;
+	float budgetMS = std::max(LUA_GC_MIN_BUDGET_MS, std::min(spareMS * LUA_GC_SPARE_FRACTION, LUA_GC_MAX_BUDGET_MS));
+	int64_t budgetTicks = (int64_t)(budgetMS * ticksPerMS);
+
+	while (!cycleFinished && lua_gc(m_pMasterState, LUA_GCCOUNT, 0) > m_CycleEndHeapSizeKB * (1.0f + LUA_GC_GROWTH_FRACTION) && g_TimerMan.GetRealTickCount() - startTicks < budgetTicks)
+		cycleFinished = lua_gc(m_pMasterState, LUA_GCSTEP, LUA_GC_STEP_KB) != 0;
+
+	m_HeapSizeKB = lua_gc(m_pMasterState, LUA_GCCOUNT, 0);
+	if (cycleFinished)
+		m_CycleEndHeapSizeKB = m_HeapSizeKB;
+
+	m_GCTimeMS += ((float)(g_TimerMan.GetRealTickCount() - startTicks) / ticksPerMS - m_GCTimeMS) / 16.0f;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
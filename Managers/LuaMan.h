@@ -21,13 +21,120 @@
 #include "Serializable.h"
 #include "Entity.h"
 
+#include <vector>
+#include <deque>
+
 // Forward declarations
 struct lua_State;
 
 namespace RTE
 {
 
+class MovableObject;
+class Actor;
+
 #define MAX_OPEN_FILES 10
+// What an object reference is when it doesn't refer to anything, same as LUA_NOREF
+#define NO_LUA_OBJECT_REF -2
+// The least and most time the garbage collector gets each sim update, in ms
+#define LUA_GC_MIN_BUDGET_MS 0.1f
+#define LUA_GC_MAX_BUDGET_MS 2.0f
+// How much of the time left over in a sim update the garbage collector may use up
+#define LUA_GC_SPARE_FRACTION 0.25f
+// How much the heap has to have grown since the last finished collection cycle before spare time goes into collecting
+#define LUA_GC_GROWTH_FRACTION 0.25f
+// How much garbage collection work each extra step does, in KB
+#define LUA_GC_STEP_KB 16
+// The most Lua states that parallel scripts can be spread across
+#define MAX_LUA_WORKER_STATES 16
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Struct:          LuaObjectSnapshot
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     What the scripts in the worker states get to see of a MovableObject,
+//                  taken on the main thread before they run so they never touch the
+//                  object itself.
+
+struct LuaObjectSnapshot
+{
+    // The object this is of, only to be touched on the main thread
+    MovableObject *m_pObject;
+    // These point into the object, which doesn't change while the worker states run
+    const std::string *m_pScriptPath;
+    const std::string *m_pPresetName;
+    const std::string *m_pClassName;
+    unsigned long m_UniqueID;
+    int m_ID;
+    int m_RootID;
+    int m_Team;
+    Vector m_Pos;
+    Vector m_Vel;
+    float m_RotAngle;
+    float m_AngularVel;
+    float m_Mass;
+    float m_Age;
+    bool m_HFlipped;
+    // Only set for Actor:s
+    bool m_IsActor;
+    int m_Health;
+    int m_MaxHealth;
+    int m_Status;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Struct:          LuaCommand
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A change a script in a worker state wants made to its object, or to
+//                  the simulation, which gets applied on the main thread afterwards.
+
+struct LuaCommand
+{
+    enum CommandType
+    {
+        SETPOS = 0,
+        SETVEL,
+        SETROTANGLE,
+        SETANGULARVEL,
+        ADDIMPULSEFORCE,
+        SETHEALTH,
+        SETTODELETE,
+        GIBTHIS,
+        ADDPARTICLE
+    };
+
+    CommandType m_Type;
+    float m_Values[4];
+    // The class and preset names of the particle to add
+    std::string m_Text[2];
+};
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Struct:          LuaWorkerState
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     One of the Lua states that parallel scripts run in. It only knows
+//                  the snapshot and command functions, never the luabind classes, so it
+//                  can run on any thread.
+
+struct LuaWorkerState
+{
+    lua_State *m_pState;
+    // Registry references to the tables of loaded scripts by path and of the objects' Lua tables by unique ID, and the metatable of those
+    int m_ScriptTableRef;
+    int m_ObjectTableRef;
+    int m_ObjectMetatableRef;
+    // Which of the scripted objects this state runs this time around, as indices into LuaMan's snapshots, in the order they were passed in
+    std::vector<int> m_Objects;
+    // Where the commands of the object being run go
+    std::vector<LuaCommand> *m_pCommands;
+    // The snapshots of all Actor:s for the queries
+    const std::vector<LuaObjectSnapshot> *m_pActorSnapshots;
+    // Errors and printouts to pass on to the console once the parallel run is done
+    std::vector<std::string> m_Messages;
+};
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Class:           LuaMan
@@ -266,15 +373,93 @@ enum ServerResult
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          GetNewObjectID
+// Method:          CreateObjectReference
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Returns an ID string unique to this runtime for use by individual
-//                  objects that are also tracked in the Lua state and have scripts
-//                  associated with them.
+// Description:     Converts MovableMan.ScriptedEntity to its Lua representation with the
+//                  To<Class> function of a class, and keeps it in the object table
+//                  owned by this for as long as the reference isn't released.
+// Arguments:       The name of the class to convert the scripted entity to.
+//                  Whether to report errors to the console.
+// Return value:    The reference to the object, or NO_LUA_OBJECT_REF if it couldn't be
+//                  converted.
+
+    int CreateObjectReference(const std::string &className, bool consoleErrors = true);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ReleaseObjectReference
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Removes an object from the object table, so Lua can collect it once
+//                  nothing else refers to it.
+// Arguments:       The reference to the object, as returned by CreateObjectReference.
+// Return value:    None.
+
+    void ReleaseObjectReference(int objectRef);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RunObjectFunction
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Calls a function of a preset's table with an object from the object
+//                  table as its argument, if both the function and the object exist.
+// Arguments:       The dotted path to the preset's table, like "Actors.Pre00001".
+//                  The name of the function in the preset's table.
+//                  The reference to the object to call it with.
+//                  Whether to report errors to the console.
+// Return value:    Returns less than zero if any errors encountered when running the
+//                  function.
+
+    int RunObjectFunction(const std::string &presetName, const char *functionName, int objectRef, bool consoleErrors = true);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetWorkerStateCount
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets how many Lua states parallel scripts are spread across, as set
+//                  with LuaWorkerStates in the settings.
 // Arguments:       None.
-// Return value:    Returns the unique ID as a string.
+// Return value:    The number of worker states, at least 1 since parallel scripts can't
+//                  run in the master state.
+
+    int GetWorkerStateCount() const;
+
 
-    std::string GetNewObjectID();
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RunParallelScripts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Runs the scripts of objects whose presets support it in the worker
+//                  states, spread across the worker threads. Each object is always run
+//                  by the same state. The changes the scripts ask for are then applied
+//                  in the order the objects were passed in, so the outcome doesn't
+//                  depend on how the threads were scheduled.
+// Arguments:       The objects to run the scripts of.
+//                  All the Actor:s in the simulation, which the scripts can query.
+// Return value:    None.
+
+    void RunParallelScripts(const std::vector<MovableObject *> &scriptedObjects, const std::deque<Actor *> &actors);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ReleaseParallelObject
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Runs the Destroy function of an object's script in its worker state,
+//                  if any, and lets go of its Lua table there.
+// Arguments:       The unique ID of the object.
+//                  The path of its script.
+// Return value:    None.
+
+    void ReleaseParallelObject(unsigned long uniqueID, const std::string &scriptPath);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ForgetParallelScript
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes the worker states load a script file anew the next time an
+//                  object uses it.
+// Arguments:       The path of the script.
+// Return value:    None.
+
+    void ForgetParallelScript(const std::string &scriptPath);
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -308,6 +493,26 @@ enum ServerResult
 	void Update();
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetHeapSizeKB
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets how much memory the master state had in use at the last Update.
+// Arguments:       None.
+// Return value:    The size of the Lua heap in KB.
+
+    int GetHeapSizeKB() const { return m_HeapSizeKB; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetGCTimeMS
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets how long garbage collection takes each Update, on average.
+// Arguments:       None.
+// Return value:    The smoothed garbage collection time in ms.
+
+    float GetGCTimeMS() const { return m_GCTimeMS; }
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          FileOpen
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -394,11 +599,25 @@ protected:
     // The next unique preset ID to hand out to the next Preset that wants to define some functions
     // This gets incremented each time a new one is requeste to give unique ID's to all original presets
     long m_NextPresetID;
-    // The next unique object ID to hand out to the next scripted Entity instance that wants to run its preset's scripts
-    // This gets incremented each time a new one is requested to give unique ID's to all scripted objects
-    long m_NextObjectID;
+    // Registry references to the table that holds the Lua representations of all scripted objects, and to the function that converts them
+    int m_ObjectTableRef;
+    int m_ObjectConverterRef;
+    // The size of the heap at the end of the last Update, and when the last collection cycle finished, in KB
+    int m_HeapSizeKB;
+    int m_CycleEndHeapSizeKB;
+    // Smoothed time spent collecting garbage in Update, in ms
+    float m_GCTimeMS;
     // Temporary holder for an Entity object that we want to pass into the Lua state without fuss
     Entity *m_pTempEntity;
+    // The states parallel scripts run in, created the first time they're needed
+    std::vector<LuaWorkerState *> m_WorkerStates;
+    // Whether opening the worker states failed, so it isn't tried again every update
+    bool m_WorkerStatesFailed;
+    // The scripted objects and all Actor:s as they were when the current parallel run started
+    std::vector<LuaObjectSnapshot> m_ObjectSnapshots;
+    std::vector<LuaObjectSnapshot> m_ActorSnapshots;
+    // The commands of each scripted object of the current parallel run, kept around to reuse their memory
+    std::vector<std::vector<LuaCommand> > m_ObjectCommands;
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -417,6 +636,52 @@ private:
     void Clear();
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CreateWorkerStates
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Opens the worker states and gives them the snapshot and command
+//                  functions.
+// Arguments:       How many worker states to open.
+// Return value:    An error return value signaling sucess or any particular failure.
+//                  Anything below 0 is an error signal.
+
+    int CreateWorkerStates(int stateCount);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DestroyWorkerStates
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Closes all the worker states.
+// Arguments:       None.
+// Return value:    None.
+
+    void DestroyWorkerStates();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RunWorkerObject
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Runs the script of one object in a worker state, loading the script
+//                  and making the object's Lua table first if need be. Safe to call on
+//                  any thread, as long as no other thread uses the same worker state.
+// Arguments:       The worker state to run it in.
+//                  The snapshot of the object.
+// Return value:    None.
+
+    void RunWorkerObject(LuaWorkerState *pWorker, const LuaObjectSnapshot &snapshot);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ApplyCommand
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes the change a parallel script asked for.
+// Arguments:       The object whose script gave the command.
+//                  The command.
+// Return value:    None.
+
+    void ApplyCommand(MovableObject *pObject, const LuaCommand &command);
+
+
     // Disallow the use of some implicit methods.
     LuaMan(const LuaMan &reference);
     LuaMan & operator=(const LuaMan &rhs);
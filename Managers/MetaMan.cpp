@@ -419,7 +419,8 @@ int MetaMan::Save(Writer &writer) const
 // Method:          SaveSceneData
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Saves the bitmap data of all Scenes of this Metagame that are currently
-//                  loaded.
+//                  loaded. The layers are written compressed on the background thread,
+//                  and only the ones that actually changed get rewritten.
 
 int MetaMan::SaveSceneData(string pathBase)
 {
@@ -184,7 +184,8 @@ friend class MetaSave;
 // Method:          SaveSceneData
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Saves the bitmap data of all Scenes of this Metagame that are currently
-//                  loaded.
+//                  loaded. The files are written by ThreadMan's background thread, so
+//                  they may not all be on disk yet when this returns.
 // Arguments:       The filepath base to the where to save the Bitmap data. This means
 //                  everything up to and including the unique name of the game.
 // Return value:    An error return value signaling success or any particular failure.
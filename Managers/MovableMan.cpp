@@ -15,6 +15,7 @@
 
 #include "MovableMan.h"
 #include "PresetMan.h"
+#include "ConsoleMan.h"
 #include "AHuman.h"
 #include "MOPixel.h"
 #include "Attachable.h"
@@ -25,6 +26,11 @@
 #include "ADoor.h"
 #include "Atom.h"
 
+// The size in pixels of the cells the MOID layer is divided into, for telling which MOs have to be drawn again
+#define MOIDTOUCHCELLSIZE 32
+// How many more holes than MOIDs the MOID index may have before it's built over from scratch
+#define MOIDCOMPACTMARGIN 64
+
 using namespace std;
 
 namespace RTE
@@ -33,6 +39,29 @@ namespace RTE
 const string MovableMan::m_ClassName = "MovableMan";
 
 
+// Splits a span of pixels along one axis of the scene into at most two that are within it, wrapping or clipping the rest
+static int SplitSceneSpan(int first, int last, int size, bool wraps, int *pFirsts, int *pLasts)
+{
+    if (!wraps || last - first + 1 >= size)
+    {
+        pFirsts[0] = max(first, 0);
+        pLasts[0] = min(last, size - 1);
+        return pFirsts[0] <= pLasts[0] ? 1 : 0;
+    }
+
+    int length = last - first;
+    first = ((first % size) + size) % size;
+    last = first + length;
+    pFirsts[0] = first;
+    pLasts[0] = min(last, size - 1);
+    if (last < size)
+        return 1;
+    pFirsts[1] = 0;
+    pLasts[1] = last - size;
+    return 2;
+}
+
+
 // Comparison functor for sorting movable objects by their X position using STL's sort
 struct MOXPosComparison:
     public binary_function<MovableObject *, MovableObject *, bool>
@@ -63,10 +92,25 @@ void MovableMan::Clear()
     m_SortTeamRoster[Activity::TEAM_2] = false;
     m_SortTeamRoster[Activity::TEAM_3] = false;
     m_SortTeamRoster[Activity::TEAM_4] = false;
+    for (int team = Activity::TEAM_1; team < Activity::MAXTEAMCOUNT; ++team)
+    {
+        m_TeamRosterOrdered[team] = true;
+        m_TeamRosterCursor[team] = 0;
+    }
     m_ValiditySearchResults.clear();
     m_AddedAlarmEvents.clear();
     m_AlarmEvents.clear();
     m_MOIDIndex.clear();
+    m_MOIDBlocks.clear();
+    m_MOIDHoles = 0;
+    m_MOIDGeneration = 0;
+    m_MOIDClearRects.clear();
+    m_MOIDTouchedCells.clear();
+    m_MOIDTouchedCellsX = 0;
+    m_MOIDTouchedCellsY = 0;
+    m_MOIDRoots.clear();
+    m_MOIDRootsKept.clear();
+    m_MOIDScratch.clear();
     m_AGResolution = 1;
     m_SplashRatio = 0.75;
     m_MaxDroppedItems = 25;
@@ -76,6 +120,11 @@ void MovableMan::Clear()
     m_SettlingEnabled = true;
     m_MOSubtractionEnabled = true;
     m_pObjectToScriptUpdate = 0;
+    m_CostAccounting = false;
+    m_PresetCosts.clear();
+    m_TopCosts.clear();
+    m_ActorPositions.clear();
+    m_ActorDistances.clear();
 }
 
 
@@ -263,10 +312,20 @@ void MovableMan::PurgeAllMOs()
     m_SortTeamRoster[Activity::TEAM_2] = false;
     m_SortTeamRoster[Activity::TEAM_3] = false;
     m_SortTeamRoster[Activity::TEAM_4] = false;
+    for (int team = Activity::TEAM_1; team < Activity::MAXTEAMCOUNT; ++team)
+    {
+        m_TeamRosterOrdered[team] = true;
+        m_TeamRosterCursor[team] = 0;
+    }
     m_ValiditySearchResults.clear();
     m_AddedAlarmEvents.clear();
     m_AlarmEvents.clear();
     m_MOIDIndex.clear();
+    // Whatever the purged MOs left on the MOID layer gets cleared in the next MOID update, which builds the index over
+    for (vector<MOIDBlock>::iterator bItr = m_MOIDBlocks.begin(); bItr != m_MOIDBlocks.end(); ++bItr)
+        ClearMOIDBlock(*bItr);
+    m_MOIDBlocks.clear();
+    m_MOIDHoles = 0;
 
     // Set the time limit to 0 so it will report as being past it from the start of simulation
     m_SloMoTimer.SetRealTimeLimitMS(0);
@@ -442,34 +501,26 @@ Actor * MovableMan::GetNextTeamActor(int team, Actor *pAfterThis)
 
     return 0;
 */
-    // First sort the roster
-    m_ActorRoster[team].sort(MOXPosComparison());
+    // First sort the roster, if the actors moved since
+    OrderTeamRoster(team);
 
+    vector<Actor *> &roster = m_ActorRoster[team];
     // Begin at the beginning
-    list<Actor *>::const_iterator aIt = m_ActorRoster[team].begin();
+    int index = 0;
 
-    // Search for the actor to start search from, if specified
+    // Step past the actor to start search from, if specified
     if (pAfterThis)
     {
-        // Make the iterator point to the specified starting point actor
-        for (; aIt != m_ActorRoster[team].end() && *aIt != pAfterThis; ++aIt)
-            ;
-
-        // If we couldn't find the one to search for, then just return the first one
-        if (aIt == m_ActorRoster[team].end())
-            aIt = m_ActorRoster[team].begin();
-        // Go one more step so we're not pointing at the one we're not supposed to get
-        else
-        {
-            ++aIt;
-            // If that was the last one, then return the first in the list
-            if (aIt == m_ActorRoster[team].end())
-                aIt = m_ActorRoster[team].begin();
-        }
+        // If we couldn't find the one to search for, then just return the first one,
+        // and if it was the last one, then return the first in the list too
+        int afterIndex = FindInTeamRoster(team, pAfterThis);
+        if (afterIndex >= 0 && afterIndex + 1 < roster.size())
+            index = afterIndex + 1;
     }
+    m_TeamRosterCursor[team] = index;
 
-    DAssert((*aIt)->GetTeam() == team, "Actor of wrong team found in the wrong roster!");
-    return *aIt;
+    DAssert(roster[index]->GetTeam() == team, "Actor of wrong team found in the wrong roster!");
+    return roster[index];
 }
 
 
@@ -527,34 +578,71 @@ Actor * MovableMan::GetPrevTeamActor(int team, Actor *pBeforeThis)
 
     return 0;
 */
-    // First sort the roster
-    m_ActorRoster[team].sort(MOXPosComparison());
+    // First sort the roster, if the actors moved since
+    OrderTeamRoster(team);
 
-    // Begin at the reverse beginning of roster
-    list<Actor *>::reverse_iterator aIt = m_ActorRoster[team].rbegin();
+    vector<Actor *> &roster = m_ActorRoster[team];
+    // Begin at the end of roster
+    int index = roster.size() - 1;
 
-    // Search for the actor to start search from, if specified
+    // Step back from the actor to start search from, if specified
     if (pBeforeThis)
     {
-        // Make the iterator point to the specified starting point actor
-        for (; aIt != m_ActorRoster[team].rend() && *aIt != pBeforeThis; ++aIt)
-            ;
+        // If we couldn't find the one to search for, then just return the one at the end,
+        // and if it was the first one, then return the last in the list too
+        int beforeIndex = FindInTeamRoster(team, pBeforeThis);
+        if (beforeIndex > 0)
+            index = beforeIndex - 1;
+    }
+    m_TeamRosterCursor[team] = index;
 
-        // If we couldn't find the one to search for, then just return the one at the end
-        if (aIt == m_ActorRoster[team].rend())
-            aIt = m_ActorRoster[team].rbegin();
-        // Go one more step so we're not pointing at the one we're not supposed to get
-        else
-        {
-            ++aIt;
-            // If that was the first one, then return the last in the list
-            if (aIt == m_ActorRoster[team].rend())
-                aIt = m_ActorRoster[team].rbegin();
-        }
+    DAssert(roster[index]->GetTeam() == team, "Actor of wrong team found in the wrong roster!");
+    return roster[index];
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          OrderTeamRoster
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sorts a team's roster by the X positions of its actors, if they moved
+//                  since it was last done.
+
+void MovableMan::OrderTeamRoster(int team)
+{
+    if (team < Activity::TEAM_1 || team >= Activity::MAXTEAMCOUNT || m_TeamRosterOrdered[team])
+        return;
+
+    // Insertion sort, since only the few actors that passed each other are out of place
+    vector<Actor *> &roster = m_ActorRoster[team];
+    for (int i = 1; i < roster.size(); ++i)
+    {
+        Actor *pActor = roster[i];
+        int j = i;
+        for (; j > 0 && MOXPosComparison()(pActor, roster[j - 1]); --j)
+            roster[j] = roster[j - 1];
+        roster[j] = pActor;
     }
+    m_TeamRosterOrdered[team] = true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FindInTeamRoster
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Finds where an actor is in a team's roster, looking under the roster's
+//                  cursor first.
+
+int MovableMan::FindInTeamRoster(int team, const Actor *pActor) const
+{
+    const vector<Actor *> &roster = m_ActorRoster[team];
+
+    // Going through a team one actor at a time, the one asked about is the one handed out last
+    int cursor = m_TeamRosterCursor[team];
+    if (cursor < roster.size() && roster[cursor] == pActor)
+        return cursor;
 
-    DAssert((*aIt)->GetTeam() == team, "Actor of wrong team found in the wrong roster!");
-    return *aIt;
+    vector<Actor *>::const_iterator aIt = find(roster.begin(), roster.end(), pActor);
+    return aIt != roster.end() ? aIt - roster.begin() : -1;
 }
 
 
@@ -598,7 +686,7 @@ Actor * MovableMan::GetClosestTeamActor(int team, int player, const Vector &scen
     // A specific team, so use the rosters instead
     else
     {
-        for (list<Actor *>::iterator aIt = m_ActorRoster[team].begin(); aIt != m_ActorRoster[team].end(); ++aIt)
+        for (vector<Actor *>::iterator aIt = m_ActorRoster[team].begin(); aIt != m_ActorRoster[team].end(); ++aIt)
         {
             if ((*aIt) == pExcludeThis || (*aIt)->GetController()->IsPlayerControlled(player) || (pActivity && pActivity->IsOtherPlayerBrain(*aIt, player)))
                 continue;
@@ -672,24 +760,30 @@ Actor * MovableMan::GetClosestActor(Vector &scenePoint, int maxRadius, float &ge
 
     Activity *pActivity = g_ActivityMan.GetActivity();
 
-    Vector distanceVec;
     float distance;
     float shortestDistance = maxRadius;
     Actor *pClosestActor = 0;
 
-    for (deque<Actor *>::iterator aIt = m_Actors.begin(); aIt != m_Actors.end(); ++aIt)
+    // Measure to all the Actors in one batch first; only the lengths are used, so which way the vectors point doesn't matter
+    int actorCount = m_Actors.size();
+    m_ActorPositions.resize(actorCount);
+    m_ActorDistances.resize(actorCount);
+    for (int i = 0; i < actorCount; ++i)
+        m_ActorPositions[i] = m_Actors[i]->GetPos();
+    g_SceneMan.ShortestDistances(scenePoint, &m_ActorPositions[0], &m_ActorDistances[0], actorCount);
+
+    for (int i = 0; i < actorCount; ++i)
     {
-        if ((*aIt) == pExcludeThis)
+        if (m_Actors[i] == pExcludeThis)
             continue;
 
-        distanceVec = g_SceneMan.ShortestDistance((*aIt)->GetPos(), scenePoint);
-        distance = distanceVec.GetMagnitude();
+        distance = m_ActorDistances[i].GetMagnitude();
 
         // Check if even within search radius
         if (distance < shortestDistance)
         {
             shortestDistance = distance;
-            pClosestActor = *aIt;
+            pClosestActor = m_Actors[i];
         }
     }
 
@@ -714,7 +808,7 @@ Actor * MovableMan::GetClosestBrainActor(int team, const Vector &scenePoint) con
     float shortestDistance = g_SceneMan.GetSceneDim().GetLargest();
     Actor *pClosestBrain = 0;
 
-    for (list<Actor *>::const_iterator aIt = m_ActorRoster[team].begin(); aIt != m_ActorRoster[team].end(); ++aIt)
+    for (vector<Actor *>::const_iterator aIt = m_ActorRoster[team].begin(); aIt != m_ActorRoster[team].end(); ++aIt)
     {
         if (!(*aIt)->HasObjectInGroup("Brains"))
             continue;
@@ -778,7 +872,7 @@ Actor * MovableMan::GetUnassignedBrain(int team) const
     if (/*m_Actors.empty() || */m_ActorRoster[team].empty())
         return 0;
 
-    for (list<Actor *>::const_iterator aIt = m_ActorRoster[team].begin(); aIt != m_ActorRoster[team].end(); ++aIt)
+    for (vector<Actor *>::const_iterator aIt = m_ActorRoster[team].begin(); aIt != m_ActorRoster[team].end(); ++aIt)
     {
         if ((*aIt)->HasObjectInGroup("Brains") && !g_ActivityMan.GetActivity()->IsAssignedBrain(*aIt))
             return *aIt;
@@ -948,6 +1042,45 @@ void MovableMan::AddParticle(MovableObject *pMOToAdd)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          AddParticles
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Adds a whole batch of MovableObject:s to the internal list of MO:s at
+//                  once.
+
+void MovableMan::AddParticles(const vector<MovableObject *> &particlesToAdd)
+{
+    for (vector<MovableObject *>::const_iterator pItr = particlesToAdd.begin(); pItr != particlesToAdd.end(); ++pItr)
+    {
+        if (!(*pItr))
+            continue;
+
+        if ((*pItr)->IsTooFast())
+            (*pItr)->SetToDelete(true);
+        else
+        {
+            (*pItr)->NotResting();
+            (*pItr)->NewFrame();
+            (*pItr)->SetAge(0);
+        }
+    }
+
+    // Split devices out to the items, and push the rest straight onto the end of the particles in one go
+    vector<MovableObject *>::const_iterator rangeStart = particlesToAdd.begin();
+    for (vector<MovableObject *>::const_iterator pItr = particlesToAdd.begin(); pItr != particlesToAdd.end(); ++pItr)
+    {
+        if (*pItr && !(*pItr)->IsDevice())
+            continue;
+
+        m_AddedParticles.insert(m_AddedParticles.end(), rangeStart, pItr);
+        if (*pItr)
+            m_AddedItems.push_back(*pItr);
+        rangeStart = pItr + 1;
+    }
+    m_AddedParticles.insert(m_AddedParticles.end(), rangeStart, particlesToAdd.end());
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          RemoveActor
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1043,15 +1176,15 @@ void MovableMan::AddActorToTeamRoster(Actor * pActorToAdd)
 	if (!pActorToAdd)
 		return;
 
-	// Add to the team roster and then sort it too
+	// Add to the team roster, which gets sorted when it's next needed
 	int team = pActorToAdd->GetTeam();
 	// Also re-set the TEam so that the Team Icons get set up properly
 	pActorToAdd->SetTeam(team);
 	// Only add to a roster if it's on a team AND is controllable (eg doors are not)
 	if (team >= Activity::TEAM_1 && team < Activity::MAXTEAMCOUNT && pActorToAdd->IsControllable())
 	{
-		m_ActorRoster[pActorToAdd->GetTeam()].push_back(pActorToAdd);
-		m_ActorRoster[pActorToAdd->GetTeam()].sort(MOXPosComparison());
+		m_ActorRoster[team].push_back(pActorToAdd);
+		m_TeamRosterOrdered[team] = false;
 	}
 }
 
@@ -1072,7 +1205,7 @@ void MovableMan::RemoveActorFromTeamRoster(Actor * pActorToRem)
 
 	// Remove from roster as well
 	if (team >= Activity::TEAM_1 && team < Activity::MAXTEAMCOUNT)
-		m_ActorRoster[team].remove(pActorToRem);
+		m_ActorRoster[team].erase(remove(m_ActorRoster[team].begin(), m_ActorRoster[team].end(), pActorToRem), m_ActorRoster[team].end());
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1468,7 +1601,11 @@ int MovableMan::EjectAllActors(list<SceneObject *> &actorList, int onlyTeam, boo
 
     // Also clear the actor rosters
     for (int team = Activity::TEAM_1; team < Activity::MAXTEAMCOUNT; ++team)
+    {
         m_ActorRoster[team].clear();
+        m_TeamRosterOrdered[team] = true;
+        m_TeamRosterCursor[team] = 0;
+    }
 
     return addedCount;
 }
@@ -1642,6 +1779,154 @@ void MovableMan::OnPieMenu(Actor * pActor)
 	}
 }
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetCostAccounting
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets whether the time spent on each MovableObject is tallied up per
+//                  preset.
+
+void MovableMan::SetCostAccounting(bool enable)
+{
+    if (enable && !m_CostAccounting)
+    {
+        m_PresetCosts.clear();
+        m_TopCosts.clear();
+    }
+    m_CostAccounting = enable;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          UpdateTopCosts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Refreshes the list of the presets that have been costing the most
+//                  time lately, from the current tallies.
+
+void MovableMan::UpdateTopCosts(int count)
+{
+    m_TopCosts.clear();
+    if (count <= 0)
+        return;
+
+    for (unordered_map<int, unordered_map<string, CostTally> >::iterator mItr = m_PresetCosts.begin(); mItr != m_PresetCosts.end(); ++mItr)
+    {
+        string moduleName = g_PresetMan.GetDataModuleName(mItr->first);
+        for (unordered_map<string, CostTally>::iterator pItr = mItr->second.begin(); pItr != mItr->second.end(); ++pItr)
+        {
+            const CostTally &tally = pItr->second;
+            PresetCost cost;
+            cost.m_PresetName = pItr->first;
+            cost.m_ModuleName = moduleName;
+            cost.m_Instances = tally.m_LastInstances;
+            cost.m_TravelMS = tally.m_Average[COST_TRAVEL] / 1000.0f;
+            cost.m_UpdateMS = tally.m_Average[COST_UPDATE] / 1000.0f;
+            cost.m_ScriptMS = tally.m_Average[COST_SCRIPT] / 1000.0f;
+            cost.m_DrawMS = tally.m_Average[COST_DRAW] / 1000.0f;
+            cost.m_TotalMS = cost.m_TravelMS + cost.m_UpdateMS + cost.m_ScriptMS + cost.m_DrawMS;
+            m_TopCosts.push_back(cost);
+        }
+    }
+
+    count = min(count, (int)m_TopCosts.size());
+    partial_sort(m_TopCosts.begin(), m_TopCosts.begin() + count, m_TopCosts.end(), [](const PresetCost &a, const PresetCost &b) { return a.m_TotalMS > b.m_TotalMS; });
+    m_TopCosts.resize(count);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DumpTopCosts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Refreshes and prints the presets that have been costing the most
+//                  time lately to the console.
+
+void MovableMan::DumpTopCosts(int count)
+{
+    if (!m_CostAccounting)
+    {
+        g_ConsoleMan.PrintString("ERROR: Cost accounting is off, turn it on with MovableMan.CostAccounting = true");
+        return;
+    }
+
+    UpdateTopCosts(count);
+    g_ConsoleMan.PrintString("SYSTEM: Most expensive presets, in ms per sim update (travel / update / script / draw):");
+    char str[512];
+    for (vector<PresetCost>::iterator cItr = m_TopCosts.begin(); cItr != m_TopCosts.end(); ++cItr)
+    {
+        sprintf(str, "%.200s (%.100s) x%i: %.2f = %.2f / %.2f / %.2f / %.2f", cItr->m_PresetName.c_str(), cItr->m_ModuleName.c_str(), cItr->m_Instances,
+                cItr->m_TotalMS, cItr->m_TravelMS, cItr->m_UpdateMS, cItr->m_ScriptMS, cItr->m_DrawMS);
+        g_ConsoleMan.PrintString(str);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          TallyCost
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Adds the time passed since a start time to an MO's preset tally.
+
+int64_t MovableMan::TallyCost(const MovableObject *pMO, CostCategory category, int64_t start)
+{
+    int64_t now = g_TimerMan.GetAbsoulteTime();
+    // Accounting was turned on partway through, so there's nothing to measure from yet
+    if (start == 0)
+        return now;
+
+    CostTally &tally = m_PresetCosts[pMO->GetModuleID()][pMO->GetPresetName()];
+    tally.m_Time[category] += now - start;
+    // Every MO gets updated exactly once per sim update, so that's where they are counted
+    if (category == COST_UPDATE)
+        tally.m_Instances++;
+    else if (category == COST_DRAW)
+        tally.m_DrawInstances++;
+    return now;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RollCosts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Blends the costs tallied during the last sim update into the running
+//                  averages, and starts the tallies over for the next one.
+
+void MovableMan::RollCosts()
+{
+    for (unordered_map<int, unordered_map<string, CostTally> >::iterator mItr = m_PresetCosts.begin(); mItr != m_PresetCosts.end(); ++mItr)
+    {
+        for (unordered_map<string, CostTally>::iterator pItr = mItr->second.begin(); pItr != mItr->second.end(); )
+        {
+            CostTally &tally = pItr->second;
+            float remaining = 0;
+            for (int c = 0; c < COST_COUNT; ++c)
+            {
+                float time = (float)tally.m_Time[c];
+                // Drawing doesn't go one to one with sim updates, so make it the time to draw each of the updated instances once.
+                // Sim updates without any drawing in between leave the draw average as it was
+                if (c == COST_DRAW)
+                {
+                    if (tally.m_DrawInstances > 0)
+                        time = time * (float)tally.m_Instances / (float)tally.m_DrawInstances;
+                    else if (tally.m_Instances > 0)
+                        time = tally.m_Average[c];
+                }
+                tally.m_Average[c] = tally.m_Average[c] * 0.9f + time * 0.1f;
+                tally.m_Time[c] = 0;
+                remaining += tally.m_Average[c];
+            }
+            tally.m_LastInstances = tally.m_Instances;
+            tally.m_Instances = 0;
+            tally.m_DrawInstances = 0;
+
+            // Forget presets that are long gone from the scene
+            if (tally.m_LastInstances == 0 && remaining < 1.0f)
+                pItr = mItr->second.erase(pItr);
+            else
+                ++pItr;
+        }
+    }
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Update
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1668,11 +1953,18 @@ void MovableMan::Update()
     // Lua transfer pointer needs to be cleared, what was set here last update isn't valid anymore
     m_pObjectToScriptUpdate = 0;
 
+    // Start tallying this sim update's costs from scratch
+    if (m_CostAccounting)
+        RollCosts();
+
     // Reset the draw HUD roster line settings
     m_SortTeamRoster[Activity::TEAM_1] = false;
     m_SortTeamRoster[Activity::TEAM_2] = false;
     m_SortTeamRoster[Activity::TEAM_3] = false;
     m_SortTeamRoster[Activity::TEAM_4] = false;
+    // The actors are about to move, so the rosters have to be sorted again the next time they're needed
+    for (int team = Activity::TEAM_1; team < Activity::MAXTEAMCOUNT; ++team)
+        m_TeamRosterOrdered[team] = false;
     // Clear out MO finding optimization buffer - will be added to each frame as thigns are searched for as curently exisitng in the manager
     m_ValiditySearchResults.clear();
 
@@ -1708,6 +2000,7 @@ void MovableMan::Update()
             {
                 if (!((*aIt)->IsUpdated()))
                 {
+                    int64_t costStart = StartCost();
                     (*aIt)->ApplyForces();
                     (*aIt)->PreTravel();
         /*
@@ -1720,6 +2013,7 @@ void MovableMan::Update()
         */
                     (*aIt)->Travel();
                     (*aIt)->PostTravel();
+                    AddCost(*aIt, COST_TRAVEL, costStart);
                 }
                 (*aIt)->NewFrame();
             }
@@ -1734,10 +2028,12 @@ void MovableMan::Update()
             {
                 if (!((*iIt)->IsUpdated()))
                 {
+                    int64_t costStart = StartCost();
                     (*iIt)->ApplyForces();
                     (*iIt)->PreTravel();
                     (*iIt)->Travel();
                     (*iIt)->PostTravel();
+                    AddCost(*iIt, COST_TRAVEL, costStart);
                 }
                 (*iIt)->NewFrame();
             }
@@ -1752,10 +2048,12 @@ void MovableMan::Update()
             {
                 if (!((*parIt)->IsUpdated()))
                 {
+                    int64_t costStart = StartCost();
                     (*parIt)->ApplyForces();
                     (*parIt)->PreTravel();
                     (*parIt)->Travel();
                     (*parIt)->PostTravel();
+                    AddCost(*parIt, COST_TRAVEL, costStart);
                 }
                 (*parIt)->NewFrame();
             }
@@ -1773,19 +2071,31 @@ void MovableMan::Update()
 
         g_SceneMan.LockScene();
 
+        // Scripts whose presets are written for LuaMan's worker states are put aside to run all at once after the updates,
+        // and their objects' impulses are applied after that so the changes the scripts ask for make it into this update
+        m_ParallelScripted.clear();
+        int firstParallelParticle = 0;
+
         // Actor:s
 		g_FrameMan.StartPerformanceMeasurement(FrameMan::PERF_ACTORS_PASS2);
         {
             SLICK_PROFILENAME("Second Pass -  Actors", 0xFF558673);
             for (aIt = m_Actors.begin(); aIt != m_Actors.end(); ++aIt)
             {
+				int64_t costStart = StartCost();
 				//g_FrameMan.StartPerformanceMeasurement(FrameMan::PERF_ACTORS_PASS2);
 				(*aIt)->Update();
+				costStart = AddCost(*aIt, COST_UPDATE, costStart);
 				//g_FrameMan.StopPerformanceMeasurement(FrameMan::PERF_ACTORS_PASS2);
 				//g_FrameMan.StartPerformanceMeasurement(FrameMan::PERF_ACTORS_AI);
-                (*aIt)->UpdateScript();
+                if ((*aIt)->IsScriptParallel())
+                    m_ParallelScripted.push_back(*aIt);
+                else
+                    (*aIt)->UpdateScript();
+                AddCost(*aIt, COST_SCRIPT, costStart);
 				//g_FrameMan.StopPerformanceMeasurement(FrameMan::PERF_ACTORS_AI);
-                (*aIt)->ApplyImpulses();
+                if (!(*aIt)->IsScriptParallel())
+                    (*aIt)->ApplyImpulses();
             }
         }
 		g_FrameMan.StopPerformanceMeasurement(FrameMan::PERF_ACTORS_PASS2);
@@ -1802,9 +2112,16 @@ void MovableMan::Update()
             int itemLimit = m_Items.size() - m_MaxDroppedItems;
             for (iIt = m_Items.begin(); iIt != m_Items.end(); ++iIt, ++count)
             {
+                int64_t costStart = StartCost();
                 (*iIt)->Update();
-                (*iIt)->UpdateScript();
-                (*iIt)->ApplyImpulses();
+                costStart = AddCost(*iIt, COST_UPDATE, costStart);
+                if ((*iIt)->IsScriptParallel())
+                    m_ParallelScripted.push_back(*iIt);
+                else
+                    (*iIt)->UpdateScript();
+                AddCost(*iIt, COST_SCRIPT, costStart);
+                if (!(*iIt)->IsScriptParallel())
+                    (*iIt)->ApplyImpulses();
                 if (count <= itemLimit)
                 {
                     (*iIt)->SetToSettle(true);
@@ -1816,10 +2133,20 @@ void MovableMan::Update()
 		g_FrameMan.StartPerformanceMeasurement(FrameMan::PERF_PARTICLES_PASS2);
         {
             SLICK_PROFILENAME("Second Pass - Particles", 0xFF557766);
+            firstParallelParticle = m_ParallelScripted.size();
             for (parIt = m_Particles.begin(); parIt != m_Particles.end(); ++parIt)
             {
+                int64_t costStart = StartCost();
                 (*parIt)->Update();
+                costStart = AddCost(*parIt, COST_UPDATE, costStart);
+                if ((*parIt)->IsScriptParallel())
+                {
+                    m_ParallelScripted.push_back(*parIt);
+                    AddCost(*parIt, COST_SCRIPT, costStart);
+                    continue;
+                }
                 (*parIt)->UpdateScript();
+                AddCost(*parIt, COST_SCRIPT, costStart);
                 (*parIt)->ApplyImpulses();
                 (*parIt)->RestDetection();
                 // Copy particles that are at rest to the terrain and mark them for deletion.
@@ -1831,12 +2158,48 @@ void MovableMan::Update()
             }
         }
 		g_FrameMan.StopPerformanceMeasurement(FrameMan::PERF_PARTICLES_PASS2);
+
+        // Parallel scripts, whose changes get applied in the same order as the objects were put aside
+        if (!m_ParallelScripted.empty())
+        {
+            SLICK_PROFILENAME("Second Pass - Parallel Scripts", 0xFF557867);
+            g_LuaMan.RunParallelScripts(m_ParallelScripted, m_Actors);
+
+            // Now the impulses, and for the particles the rest detection, that the others got right after their scripts
+            for (int i = 0; i < m_ParallelScripted.size(); ++i)
+            {
+                MovableObject *pScripted = m_ParallelScripted[i];
+                pScripted->ApplyImpulses();
+                if (i >= firstParallelParticle)
+                {
+                    pScripted->RestDetection();
+                    if (pScripted->IsAtRest())
+                        pScripted->SetToSettle(true);
+                }
+            }
+            m_ParallelScripted.clear();
+        }
     }
 
     ///////////////////////////////////////////////////
-    // Clear the MOID layer before starting to delete stuff which may be in the MOIDIndex
+    // Take the MOs about to be deleted out of the MOIDIndex before starting to delete stuff,
+    // the rest stay drawn on the MOID layer for the next MOID update to keep or redraw
 
-    g_SceneMan.ClearAllMOIDDrawings();
+    for (deque<Actor *>::iterator aIt = m_Actors.begin(); aIt != m_Actors.end(); ++aIt)
+    {
+        if ((*aIt)->IsSetToDelete() && HoldsMOIDBlock(*aIt))
+            FreeMOIDBlock((*aIt)->GetID());
+    }
+    for (deque<MovableObject *>::iterator iIt = m_Items.begin(); iIt != m_Items.end(); ++iIt)
+    {
+        if ((*iIt)->IsSetToDelete() && HoldsMOIDBlock(*iIt))
+            FreeMOIDBlock((*iIt)->GetID());
+    }
+    for (deque<MovableObject *>::iterator parIt = m_Particles.begin(); parIt != m_Particles.end(); ++parIt)
+    {
+        if (((*parIt)->IsSetToDelete() || (*parIt)->ToSettle()) && HoldsMOIDBlock(*parIt))
+            FreeMOIDBlock((*parIt)->GetID());
+    }
 //    g_SceneMan.MOIDClearCheck();
 
     ///////////////////////////////////////////////////
@@ -2030,10 +2393,16 @@ void MovableMan::Update()
 
 //                (*parIt)->Draw(g_SceneMan.GetTerrain()->GetFGColorBitmap(), Vector(), g_DrawColor, true);
 //                (*parIt)->Draw(g_SceneMan.GetTerrain()->GetMaterialBitmap(), Vector(), g_DrawMaterial, true);
-                g_SceneMan.GetTerrain()->ApplyMovableObject(*parIt);
+                // Sprites are only composited into the terrain when flushed below, all in one go
+                g_SceneMan.GetTerrain()->QueueSettlingObject(*parIt);
             }
-            delete *(parIt++);
+            parIt++;
         }
+        g_SceneMan.GetTerrain()->FlushSettlingObjects();
+
+        // Can't delete them until they've been flushed into the terrain
+        for (parIt = midIt; parIt != m_Particles.end(); ++parIt)
+            delete *parIt;
         m_Particles.erase(midIt, m_Particles.end());
     }
 
@@ -2042,7 +2411,7 @@ void MovableMan::Update()
     ////////////////////////////////////////////////////////////////////////
     // Draw the MO matter and IDs to their layers for next frame
 
-// Not anymore, we're using ClearAllMOIDDrawings instead.. much more efficient
+// Not anymore, only what changed gets cleared and drawn again.. much more efficient
 //    g_SceneMan.ClearMOIDLayer();
     UpdateDrawMOIDs(g_SceneMan.GetMOIDBitmap());
 
@@ -2076,13 +2445,13 @@ void MovableMan::Update()
     {
         SLICK_PROFILENAME("Sort Team Rosters", 0xFF879646);
         if (m_SortTeamRoster[Activity::TEAM_1])
-            m_ActorRoster[Activity::TEAM_1].sort(MOXPosComparison());
+            OrderTeamRoster(Activity::TEAM_1);
         if (m_SortTeamRoster[Activity::TEAM_2])
-            m_ActorRoster[Activity::TEAM_2].sort(MOXPosComparison());
+            OrderTeamRoster(Activity::TEAM_2);
         if (m_SortTeamRoster[Activity::TEAM_3])
-            m_ActorRoster[Activity::TEAM_3].sort(MOXPosComparison());
+            OrderTeamRoster(Activity::TEAM_3);
         if (m_SortTeamRoster[Activity::TEAM_4])
-            m_ActorRoster[Activity::TEAM_4].sort(MOXPosComparison());
+            OrderTeamRoster(Activity::TEAM_4);
     }
 }
 
@@ -2118,7 +2487,7 @@ void MovableMan::VerifyMOIDIndex()
 		if (*aIt)
 		{
 			DAssert((*aIt)->GetID() == g_NoMOID || (*aIt)->GetID() == count, "MOIDIndex broken!");
-			DAssert((*aIt)->GetRootID() == g_NoMOID || ((*aIt)->GetRootID() >= 0 && (*aIt)->GetRootID() < g_MovableMan.GetMOIDCount()), "MOIDIndex broken!");
+			DAssert((*aIt)->GetRootID() == g_NoMOID || ((*aIt)->GetRootID() >= 0 && (*aIt)->GetRootID() < g_MovableMan.GetMOIDIndexSize()), "MOIDIndex broken!");
 		}
 		count++;
 		if (count == g_NoMOID) count++;
@@ -2127,14 +2496,14 @@ void MovableMan::VerifyMOIDIndex()
 
 	for (deque<MovableObject *>::iterator itr = m_Items.begin(); itr != m_Items.end(); ++itr)
 	{
-		DAssert((*itr)->GetID() == g_NoMOID || (*itr)->GetID() < GetMOIDCount(), "MOIDIndex broken!");
-		DAssert((*itr)->GetRootID() == g_NoMOID || ((*itr)->GetRootID() >= 0 && (*itr)->GetRootID() < g_MovableMan.GetMOIDCount()), "MOIDIndex broken!");
+		DAssert((*itr)->GetID() == g_NoMOID || (*itr)->GetID() < GetMOIDIndexSize(), "MOIDIndex broken!");
+		DAssert((*itr)->GetRootID() == g_NoMOID || ((*itr)->GetRootID() >= 0 && (*itr)->GetRootID() < g_MovableMan.GetMOIDIndexSize()), "MOIDIndex broken!");
 	}
 	// Try the items just added this frame
 	for (deque<MovableObject *>::iterator itr = m_AddedItems.begin(); itr != m_AddedItems.end(); ++itr)
 	{
-		DAssert((*itr)->GetID() == g_NoMOID || (*itr)->GetID() < GetMOIDCount(), "MOIDIndex broken!");
-		DAssert((*itr)->GetRootID() == g_NoMOID || ((*itr)->GetRootID() >= 0 && (*itr)->GetRootID() < g_MovableMan.GetMOIDCount()), "MOIDIndex broken!");
+		DAssert((*itr)->GetID() == g_NoMOID || (*itr)->GetID() < GetMOIDIndexSize(), "MOIDIndex broken!");
+		DAssert((*itr)->GetRootID() == g_NoMOID || ((*itr)->GetRootID() >= 0 && (*itr)->GetRootID() < g_MovableMan.GetMOIDIndexSize()), "MOIDIndex broken!");
 	}
 }
 
@@ -2142,59 +2511,229 @@ void MovableMan::VerifyMOIDIndex()
 // Method:          UpdateDrawMOIDs
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Updates the MOIDs of all current MOs and draws their ID's to a BITMAP
-//                  of choice.
+//                  of choice, only redrawing the ones that changed or were overlapped.
 
 void MovableMan::UpdateDrawMOIDs(BITMAP *pTargetBitmap)
 {
     SLICK_PROFILE(0xFF225464);
 
-    int aCount = m_Actors.size();
-    int iCount = m_Items.size();
-    int parCount = m_Particles.size();
+    // Stamp the blocks in use and the touched cells with a new generation, so none of them have to be reset
+    if (++m_MOIDGeneration == 0)
+    {
+        fill(m_MOIDTouchedCells.begin(), m_MOIDTouchedCells.end(), 0);
+        for (vector<MOIDBlock>::iterator bItr = m_MOIDBlocks.begin(); bItr != m_MOIDBlocks.end(); ++bItr)
+            bItr->m_Generation = 0;
+        m_MOIDGeneration = 1;
+    }
+    int cellsX = (g_SceneMan.GetSceneWidth() + MOIDTOUCHCELLSIZE - 1) / MOIDTOUCHCELLSIZE;
+    int cellsY = (g_SceneMan.GetSceneHeight() + MOIDTOUCHCELLSIZE - 1) / MOIDTOUCHCELLSIZE;
+    if (cellsX != m_MOIDTouchedCellsX || cellsY != m_MOIDTouchedCellsY)
+    {
+        m_MOIDTouchedCellsX = cellsX;
+        m_MOIDTouchedCellsY = cellsY;
+        m_MOIDTouchedCells.assign(cellsX * cellsY, 0);
+    }
 
-    // Clear the index each frame and do it over because MO's get added and
-    // deleted between each frame.
-    m_MOIDIndex.clear();
-    // Add a null and start counter at 1 because MOID == 0 means no MO.
-    // - Update: This isnt' true anymore, but still keep 0 free just to be safe
-    m_MOIDIndex.push_back(0);
+    // Build the index over from scratch when it's new, or when it has more holes than MOIDs in it
+    bool rebuild = m_MOIDIndex.empty() || m_MOIDHoles > (int)m_MOIDIndex.size() - m_MOIDHoles + MOIDCOMPACTMARGIN;
+    if (rebuild)
+    {
+        for (vector<MOIDBlock>::iterator bItr = m_MOIDBlocks.begin(); bItr != m_MOIDBlocks.end(); ++bItr)
+            ClearMOIDBlock(*bItr);
+        m_MOIDIndex.clear();
+        m_MOIDBlocks.clear();
+        m_MOIDHoles = 0;
+        // Add a null and start counter at 1 because MOID == 0 means no MO.
+        // - Update: This isnt' true anymore, but still keep 0 free just to be safe
+        m_MOIDIndex.push_back(0);
+        m_MOIDBlocks.push_back(MOIDBlock());
+    }
+
+    // Find out which MOs still make up the blocks they got last update, in the order they're drawn
+    m_MOIDRoots.clear();
+    m_MOIDRootsKept.clear();
+    for (deque<Actor *>::iterator aIt = m_Actors.begin(); aIt != m_Actors.end(); ++aIt)
+        AddMOIDRoot(*aIt, rebuild);
+    for (deque<MovableObject *>::iterator iIt = m_Items.begin(); iIt != m_Items.end(); ++iIt)
+        AddMOIDRoot(*iIt, rebuild);
+    for (deque<MovableObject *>::iterator parIt = m_Particles.begin(); parIt != m_Particles.end(); ++parIt)
+        AddMOIDRoot(*parIt, rebuild);
 
-    MOID currentMOID = 1;
+    // The rest get new blocks at the end of the index
+    int rootCount = m_MOIDRoots.size();
     int i = 0;
+    for (i = 0; i < rootCount; ++i)
+    {
+        if (m_MOIDRootsKept[i])
+            continue;
+
+        MovableObject *pRoot = m_MOIDRoots[i];
+        pRoot->UpdateMOID(m_MOIDIndex);
+        // The block starts wherever the root ended up, since it may have had to skip g_NoMOID
+        MOID firstID = pRoot->GetID();
+        m_MOIDBlocks.resize(m_MOIDIndex.size());
+        m_MOIDBlocks[firstID].m_Size = m_MOIDIndex.size() - firstID;
+        m_MOIDBlocks[firstID].m_Generation = m_MOIDGeneration;
+        pRoot->SetMOIDDirty();
+    }
+
+    // Blocks no MO claimed anymore are let go of
+    for (MOID id = 1; id < m_MOIDBlocks.size(); ++id)
+    {
+        if (m_MOIDBlocks[id].m_Size > 0 && m_MOIDBlocks[id].m_Generation != m_MOIDGeneration)
+            FreeMOIDBlock(id);
+    }
+
+    // MOs that kept their blocks but look different now have to be cleared off where they were drawn
+    for (i = 0; i < rootCount; ++i)
+    {
+        if (m_MOIDRootsKept[i] && m_MOIDRoots[i]->IsMOIDDirty())
+            ClearMOIDBlock(m_MOIDBlocks[m_MOIDRoots[i]->GetID()]);
+    }
 
-    for (i = 0; i < aCount; ++i) {
-		if (m_Actors[i]->GetsHitByMOs() && !m_Actors[i]->IsSetToDelete())
+    // Clear everything before drawing anything, so the areas cleared get all the MOs in them drawn again, on top of each other in the right order
+    g_SceneMan.TakeMOIDDrawings(m_MOIDClearRects);
+    for (vector<IntRect>::iterator rItr = m_MOIDClearRects.begin(); rItr != m_MOIDClearRects.end(); ++rItr)
+    {
+        g_SceneMan.ClearMOIDRect(rItr->m_Left, rItr->m_Top, rItr->m_Right, rItr->m_Bottom);
+        TouchMOIDRect(*rItr, true);
+    }
+    m_MOIDClearRects.clear();
+
+    // Draw the MOs that changed, and the ones that overlap anything cleared or drawn before them
+    Vector notUsed;
+    for (i = 0; i < rootCount; ++i)
+    {
+        MovableObject *pRoot = m_MOIDRoots[i];
+        MOIDBlock &block = m_MOIDBlocks[pRoot->GetID()];
+        if (!pRoot->IsMOIDDirty())
         {
-			Vector notUsed;
-            m_Actors[i]->UpdateMOID(m_MOIDIndex);
-            m_Actors[i]->Draw(pTargetBitmap, notUsed, g_DrawMOID, true);
-            currentMOID = m_MOIDIndex.size();
+            bool overlapped = false;
+            for (vector<IntRect>::iterator rItr = block.m_DrawnRects.begin(); !overlapped && rItr != block.m_DrawnRects.end(); ++rItr)
+                overlapped = TouchMOIDRect(*rItr, false);
+            if (!overlapped)
+                continue;
+            block.m_DrawnRects.clear();
         }
-        else
-            m_Actors[i]->SetID(g_NoMOID);
+
+        pRoot->Draw(pTargetBitmap, notUsed, g_DrawMOID, true);
+        g_SceneMan.TakeMOIDDrawings(block.m_DrawnRects);
+        for (vector<IntRect>::iterator rItr = block.m_DrawnRects.begin(); rItr != block.m_DrawnRects.end(); ++rItr)
+            TouchMOIDRect(*rItr, true);
+        pRoot->SetMOIDDirty(false);
     }
-    for (i = 0; i < iCount; ++i)
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          AddMOIDRoot
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Lines up an MO owned by this to get MOIDs this update, or takes its
+//                  MOID away if it shouldn't have any.
+
+void MovableMan::AddMOIDRoot(MovableObject *pRoot, bool rebuild)
+{
+    if (!pRoot->GetsHitByMOs() || pRoot->IsSetToDelete())
     {
-        if (m_Items[i]->GetsHitByMOs() && !m_Items[i]->IsSetToDelete())
+        pRoot->SetID(g_NoMOID);
+        return;
+    }
+
+    // Register the MO again off to the side where its block starts, and see if it comes out the same
+    bool kept = false;
+    if (!rebuild && HoldsMOIDBlock(pRoot))
+    {
+        MOID firstID = pRoot->GetID();
+        MOIDBlock &block = m_MOIDBlocks[firstID];
+        m_MOIDScratch.resize(firstID);
+        pRoot->UpdateMOID(m_MOIDScratch);
+        if (m_MOIDScratch.size() == firstID + block.m_Size && equal(m_MOIDScratch.begin() + firstID, m_MOIDScratch.end(), m_MOIDIndex.begin() + firstID))
         {
-            m_Items[i]->UpdateMOID(m_MOIDIndex);
-            m_Items[i]->Draw(pTargetBitmap, Vector(), g_DrawMOID, true);
-            currentMOID = m_MOIDIndex.size();
+            block.m_Generation = m_MOIDGeneration;
+            kept = true;
         }
-        else
-            m_Items[i]->SetID(g_NoMOID);
     }
-    for (i = 0; i < parCount; ++i)
+    m_MOIDRoots.push_back(pRoot);
+    m_MOIDRootsKept.push_back(kept);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          HoldsMOIDBlock
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Tells whether an MO is the owner of a block of MOIDs in the index.
+
+bool MovableMan::HoldsMOIDBlock(MovableObject *pRoot) const
+{
+    MOID firstID = pRoot->GetID();
+    return firstID > 0 && firstID < m_MOIDIndex.size() && m_MOIDIndex[firstID] == pRoot && m_MOIDBlocks[firstID].m_Size > 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FreeMOIDBlock
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Takes a block out of the MOID index, leaving a hole there, and queues
+//                  the areas of the MOID layer it was drawn to for clearing.
+
+void MovableMan::FreeMOIDBlock(MOID firstID)
+{
+    MOIDBlock &block = m_MOIDBlocks[firstID];
+    ClearMOIDBlock(block);
+    fill(m_MOIDIndex.begin() + firstID, m_MOIDIndex.begin() + firstID + block.m_Size, (MovableObject *)0);
+    m_MOIDHoles += block.m_Size;
+    block.m_Size = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ClearMOIDBlock
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Queues the areas of the MOID layer a block was drawn to for clearing
+//                  and forgets them.
+
+void MovableMan::ClearMOIDBlock(MOIDBlock &block)
+{
+    m_MOIDClearRects.insert(m_MOIDClearRects.end(), block.m_DrawnRects.begin(), block.m_DrawnRects.end());
+    block.m_DrawnRects.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          TouchMOIDRect
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Marks or checks the cells of the touched grid that an area of the MOID
+//                  layer covers, taking care of wrapping.
+
+bool MovableMan::TouchMOIDRect(const IntRect &rect, bool mark)
+{
+    int firstsX[2], lastsX[2], firstsY[2], lastsY[2];
+    int spansX = SplitSceneSpan(rect.m_Left, rect.m_Right, g_SceneMan.GetSceneWidth(), g_SceneMan.SceneWrapsX(), firstsX, lastsX);
+    int spansY = SplitSceneSpan(rect.m_Top, rect.m_Bottom, g_SceneMan.GetSceneHeight(), g_SceneMan.SceneWrapsY(), firstsY, lastsY);
+
+    bool touched = false;
+    for (int sY = 0; sY < spansY; ++sY)
     {
-        if (m_Particles[i]->GetsHitByMOs() && !m_Particles[i]->IsSetToDelete())
+        for (int y = firstsY[sY] / MOIDTOUCHCELLSIZE; y <= lastsY[sY] / MOIDTOUCHCELLSIZE; ++y)
         {
-            m_Particles[i]->UpdateMOID(m_MOIDIndex);
-            m_Particles[i]->Draw(pTargetBitmap, Vector(), g_DrawMOID, true);
-            currentMOID = m_MOIDIndex.size();
+            for (int sX = 0; sX < spansX; ++sX)
+            {
+                for (int x = firstsX[sX] / MOIDTOUCHCELLSIZE; x <= lastsX[sX] / MOIDTOUCHCELLSIZE; ++x)
+                {
+                    unsigned int &cell = m_MOIDTouchedCells[y * m_MOIDTouchedCellsX + x];
+                    if (cell == m_MOIDGeneration)
+                    {
+                        if (!mark)
+                            return true;
+                        touched = true;
+                    }
+                    else if (mark)
+                        cell = m_MOIDGeneration;
+                }
+            }
         }
-        else
-            m_Particles[i]->SetID(g_NoMOID);
     }
+    return touched;
 }
 
 
@@ -2210,13 +2749,25 @@ void MovableMan::Draw(BITMAP *pTargetBitmap, const Vector &targetPos)
 
     // Draw objects to accumulation bitmap, in reverse order so actors appear on top.
     for (deque<MovableObject *>::iterator parIt = m_Particles.begin(); parIt != m_Particles.end(); ++parIt)
+    {
+        int64_t costStart = StartCost();
         (*parIt)->Draw(pTargetBitmap, targetPos);
+        AddCost(*parIt, COST_DRAW, costStart);
+    }
 
 	for (deque<MovableObject *>::reverse_iterator itmIt = m_Items.rbegin(); itmIt != m_Items.rend(); ++itmIt)
+    {
+        int64_t costStart = StartCost();
         (*itmIt)->Draw(pTargetBitmap, targetPos);
+        AddCost(*itmIt, COST_DRAW, costStart);
+    }
 
     for (deque<Actor *>::reverse_iterator aIt = m_Actors.rbegin(); aIt != m_Actors.rend(); ++aIt)
+    {
+        int64_t costStart = StartCost();
         (*aIt)->Draw(pTargetBitmap, targetPos);
+        AddCost(*aIt, COST_DRAW, costStart);
+    }
 }
 
 
@@ -16,6 +16,7 @@
 
 #include <list>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -43,6 +44,8 @@ namespace RTE
 class MovableObject;
 class Actor;
 class MOPixel;
+// SceneMan.h may be partway through including this when it's first included
+struct IntRect;
 //class Actor;
 class AHuman;
 //class AtomGroup;
@@ -71,6 +74,33 @@ struct AlarmEvent
 };
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Struct:          PresetCost
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     How much sim and draw time all the MovableObjects of one preset have
+//                  been costing lately, as tallied by MovableMan's cost accounting.
+// Parent(s):       None.
+// Class history:   10/19/2026 PresetCost created.
+
+struct PresetCost
+{
+    PresetCost() { m_Instances = 0; m_TravelMS = m_UpdateMS = m_ScriptMS = m_DrawMS = m_TotalMS = 0; }
+
+    // The preset and the file name of the module it was defined in
+    std::string m_PresetName;
+    std::string m_ModuleName;
+    // How many instances of the preset were updated last sim update
+    int m_Instances;
+    // The average time per sim update spent in each part of all the instances' updates, and all of them together.
+    // Drawing happens per drawn frame and screen instead, so it's averaged over the draws and counted as drawing every instance once
+    float m_TravelMS;
+    float m_UpdateMS;
+    float m_ScriptMS;
+    float m_DrawMS;
+    float m_TotalMS;
+};
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Class:           MovableMan
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -201,7 +231,18 @@ public:
 // Arguments:       None.
 // Return value:    The count of MOIDs in use this frame.
 
-    int GetMOIDCount() { return m_MOIDIndex.size(); }
+    int GetMOIDCount() { return m_MOIDIndex.size() - m_MOIDHoles; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetMOIDIndexSize
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the size of the MOID index, which is one more than the highest
+//                  MOID that may be handed out, including the holes left by MOs gone.
+// Arguments:       None.
+// Return value:    The size of the MOID index this frame.
+
+    int GetMOIDIndexSize() const { return m_MOIDIndex.size(); }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -262,7 +303,7 @@ public:
 //                  ascending by their X posistions. Ownership of the list or contained
 //                  actors is NOT transferred!
 
-    std::list<Actor *> * GetTeamRoster(int team = 0) { return &(m_ActorRoster[team]); }
+    std::vector<Actor *> * GetTeamRoster(int team = 0) { OrderTeamRoster(team); return &(m_ActorRoster[team]); }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -522,6 +563,62 @@ public:
     void SortTeamRoster(int team) { m_SortTeamRoster[team] = true; }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetCostAccounting
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets whether the time spent traveling, updating, running scripts of
+//                  and drawing each MovableObject is tallied up per preset. Starting
+//                  over clears out the old tallies.
+// Arguments:       Whether to do cost accounting.
+// Return value:    None.
+
+    void SetCostAccounting(bool enable);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsCostAccounting
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Shows whether the time spent on each MovableObject is being tallied
+//                  up per preset.
+// Arguments:       None.
+// Return value:    Whether cost accounting is on.
+
+    bool IsCostAccounting() const { return m_CostAccounting; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          UpdateTopCosts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Refreshes the list of the presets that have been costing the most
+//                  time lately, from the current tallies.
+// Arguments:       How many presets to list at most.
+// Return value:    None.
+
+    void UpdateTopCosts(int count);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetTopCosts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the presets that were costing the most time as of the last call
+//                  to UpdateTopCosts.
+// Arguments:       None.
+// Return value:    The most expensive presets, most expensive first.
+
+    const std::vector<PresetCost> & GetTopCosts() const { return m_TopCosts; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DumpTopCosts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Refreshes and prints the presets that have been costing the most
+//                  time lately to the console.
+// Arguments:       How many presets to print at most.
+// Return value:    None.
+
+    void DumpTopCosts(int count);
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          AddMO
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -572,6 +669,19 @@ public:
     void AddParticle(MovableObject *pMOToAdd);
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          AddParticles
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Adds a whole batch of MovableObject:s to the internal list of MO:s at
+//                  once, like debris knocked out of the terrain. Destruction and deletion
+//                  will be taken care of automatically. Do NOT delete the passed MOs
+//                  after adding them here! i.e. Ownership IS transferred!
+// Arguments:       The MovableObject:s to add. Ownership of all of them is transferred.
+// Return value:    None.
+
+    void AddParticles(const std::vector<MovableObject *> &particlesToAdd);
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          RemoveActor
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -909,7 +1019,8 @@ public:
 // Method:          UpdateDrawMOIDs
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Updates the MOIDs of all current MOs and draws their ID's to a BITMAP
-//                  of choice. If there are more than 255 MO's to draw, some will not be.
+//                  of choice. MOs keep their MOIDs from one update to the next, and only
+//                  the ones that changed, or were overlapped by ones that did, are drawn.
 // Arguments:       A pointer to a BITMAP to draw on.
 // Return value:    None.
 
@@ -1036,9 +1147,15 @@ protected:
     std::deque<Actor *> m_AddedActors;
     std::deque<MovableObject *> m_AddedItems;
     std::deque<MovableObject *> m_AddedParticles;
+    // The objects whose scripts were put aside this update to run in LuaMan's worker states
+    std::vector<MovableObject *> m_ParallelScripted;
 
     // Roster of each team's actors, sorted by their X positions in the scene. Actors not owned here
-    std::list<Actor *> m_ActorRoster[Activity::MAXTEAMCOUNT];
+    std::vector<Actor *> m_ActorRoster[Activity::MAXTEAMCOUNT];
+    // Whether each roster is still in order since the actors last moved or were added
+    bool m_TeamRosterOrdered[Activity::MAXTEAMCOUNT];
+    // Where in each roster the actor last handed out by GetNextTeamActor or GetPrevTeamActor is
+    int m_TeamRosterCursor[Activity::MAXTEAMCOUNT];
     // Whether to draw HUD lines between the actors of a specific team
     bool m_SortTeamRoster[Activity::MAXTEAMCOUNT];
 	// Every team's MO footprint
@@ -1087,6 +1204,72 @@ protected:
 	// Global map which stores all objects so they could be foud by their unique ID
 	std::map<long int, MovableObject *> m_KnownObjects;
 
+    // The parts of an MO's time that cost accounting tells apart
+    enum CostCategory
+    {
+        COST_TRAVEL = 0,
+        COST_UPDATE,
+        COST_SCRIPT,
+        COST_DRAW,
+        COST_COUNT
+    };
+
+    // The running tally of one preset's costs
+    struct CostTally
+    {
+        CostTally() { m_Instances = m_LastInstances = m_DrawInstances = 0; for (int c = 0; c < COST_COUNT; ++c) { m_Time[c] = 0; m_Average[c] = 0; } }
+
+        // Microseconds spent so far this sim update, and the running average of past sim updates
+        int64_t m_Time[COST_COUNT];
+        float m_Average[COST_COUNT];
+        // Instances updated so far this sim update, and during the last one
+        int m_Instances;
+        int m_LastInstances;
+        // Instances drawn since the last sim update, counting each screen and drawn frame separately
+        int m_DrawInstances;
+    };
+
+    // Whether the time spent on each MO is tallied up per preset
+    bool m_CostAccounting;
+    // The tallies, keyed by the ID of the module the preset is defined in and then the preset name
+    std::unordered_map<int, std::unordered_map<std::string, CostTally> > m_PresetCosts;
+    // The most expensive presets as of the last UpdateTopCosts
+    std::vector<PresetCost> m_TopCosts;
+    // Scratch space for the Actor positions and distances to them, for measuring them all at once in the closest Actor searches
+    std::vector<Vector> m_ActorPositions;
+    std::vector<Vector> m_ActorDistances;
+
+    // A run of MOIDs held by one MO owned by this and all its parts, and where they were drawn on the MOID layer
+    struct MOIDBlock
+    {
+        MOIDBlock() { m_Size = 0; m_Generation = 0; }
+
+        // How many MOIDs the block spans, 0 if no block starts at this MOID
+        int m_Size;
+        // The last MOID update that found the block still in use
+        unsigned int m_Generation;
+        // The areas registered when the block was last drawn onto the MOID layer
+        std::vector<IntRect> m_DrawnRects;
+    };
+
+    // The blocks of m_MOIDIndex, with each block kept at its first MOID
+    std::vector<MOIDBlock> m_MOIDBlocks;
+    // How many MOIDs in the index are freed up, and not reused until it's all compacted
+    int m_MOIDHoles;
+    // The count of MOID updates, for telling what the blocks and touched cells were stamped by
+    unsigned int m_MOIDGeneration;
+    // Areas of the MOID layer to be cleared before anything is drawn there again, in the next MOID update
+    std::vector<IntRect> m_MOIDClearRects;
+    // A coarse grid over the scene, with the cells cleared or drawn over in this MOID update stamped with its generation
+    std::vector<unsigned int> m_MOIDTouchedCells;
+    int m_MOIDTouchedCellsX;
+    int m_MOIDTouchedCellsY;
+    // Scratch space for the MOs that get MOIDs this update, in drawing order, and whether each kept its block
+    std::vector<MovableObject *> m_MOIDRoots;
+    std::vector<bool> m_MOIDRootsKept;
+    // Scratch index an MO re-registers in to see if it would still fit its block the same way
+    std::vector<MovableObject *> m_MOIDScratch;
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Private member variable and method declarations
@@ -1104,6 +1287,131 @@ private:
     void Clear();
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          OrderTeamRoster
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sorts a team's roster by the X positions of its actors, if they moved
+//                  since it was last done. Since they don't move much between updates,
+//                  it's done by insertion, which takes about one pass.
+// Arguments:       Which team's roster to sort.
+// Return value:    None.
+
+    void OrderTeamRoster(int team);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FindInTeamRoster
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Finds where an actor is in a team's roster, looking under the roster's
+//                  cursor first.
+// Arguments:       Which team's roster to look in.
+//                  The actor to look for.
+// Return value:    The index of the actor in the roster, or -1 if it isn't in it.
+
+    int FindInTeamRoster(int team, const Actor *pActor) const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          AddMOIDRoot
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Lines up an MO owned by this to get MOIDs this update, or takes its
+//                  MOID away if it shouldn't have any.
+// Arguments:       The MO.
+//                  Whether the MOID index is being built over from scratch.
+// Return value:    None.
+
+    void AddMOIDRoot(MovableObject *pRoot, bool rebuild);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          HoldsMOIDBlock
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Tells whether an MO is the owner of a block of MOIDs in the index.
+// Arguments:       The MO.
+// Return value:    Whether the MO's MOID is the start of a block that is registered to it.
+
+    bool HoldsMOIDBlock(MovableObject *pRoot) const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FreeMOIDBlock
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Takes a block out of the MOID index, leaving a hole there, and queues
+//                  the areas of the MOID layer it was drawn to for clearing.
+// Arguments:       The first MOID of the block.
+// Return value:    None.
+
+    void FreeMOIDBlock(MOID firstID);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ClearMOIDBlock
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Queues the areas of the MOID layer a block was drawn to for clearing
+//                  and forgets them.
+// Arguments:       The block.
+// Return value:    None.
+
+    void ClearMOIDBlock(MOIDBlock &block);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          TouchMOIDRect
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Marks or checks the cells of the touched grid that an area of the MOID
+//                  layer covers, taking care of wrapping.
+// Arguments:       The area, with inclusive edges as registered by the MO drawing.
+//                  Whether to mark the cells as touched, or just check them.
+// Return value:    Whether any of the cells were touched already.
+
+    bool TouchMOIDRect(const IntRect &rect, bool mark);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          StartCost
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the time to measure an MO's cost from, if cost accounting is on.
+// Arguments:       None.
+// Return value:    The current time in microseconds, or 0 if not accounting.
+
+    int64_t StartCost() const { return m_CostAccounting ? g_TimerMan.GetAbsoulteTime() : 0; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          AddCost
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Adds the time passed since a start time to an MO's preset tally, if
+//                  cost accounting is on.
+// Arguments:       The MO the time was spent on.
+//                  Which part of the MO's processing the time was spent on.
+//                  When the time started, as given by StartCost or the last AddCost.
+//                  0 if accounting was off then, in which case nothing is tallied.
+// Return value:    The current time in microseconds, to measure the next part from.
+
+    int64_t AddCost(const MovableObject *pMO, CostCategory category, int64_t start) { return m_CostAccounting ? TallyCost(pMO, category, start) : 0; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          TallyCost
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Does the actual tallying for AddCost.
+// Arguments:       Same as AddCost.
+// Return value:    The current time in microseconds.
+
+    int64_t TallyCost(const MovableObject *pMO, CostCategory category, int64_t start);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RollCosts
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Blends the costs tallied during the last sim update into the running
+//                  averages, and starts the tallies over for the next one.
+// Arguments:       None.
+// Return value:    None.
+
+    void RollCosts();
+
+
     // Disallow the use of some implicit methods.
     MovableMan(const MovableMan &reference);
     MovableMan & operator=(const MovableMan &rhs);
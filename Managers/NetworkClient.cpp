@@ -19,27 +19,66 @@
 #include "FrameMan.h"
 #include "Audioman.h"
 #include "SettingsMan.h"
+#include "ThreadMan.h"
 
 #include "NetworkClient.h"
 
 #include "lz4.h"
 //#include "lz4hc.h"
 
+#include <climits>
+#include <atomic>
+#include <algorithm>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define NETWORKCLIENT_SSE2
+#include <emmintrin.h>
+#endif
+
 #define PLAYERNAMECHARLIMIT 15
+// How many rows of the frame each thread composites at a time
+#define COMPOSITEBANDHEIGHT 64
+// How much quicker or slower the frames get shown for every frame the jitter buffer is off its target
+#define PLAYOUTPACESTEP 0.1f
 
 namespace RTE
 {
 	const std::string NetworkClient::m_ClassName = "NetworkClient";
 
-	struct SLDrawBox
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Static function: MaskedCopyRow
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Copies a row of 8 bit pixels, skipping the ones of the key color.
+
+	static void MaskedCopyRow(const unsigned char *pSource, unsigned char *pTarget, int width)
 	{
-		int sourceX;
-		int sourceY;
-		int sourceW;
-		int sourceH;
-		int destX;
-		int destY;
-	};
+		int x = 0;
+#ifdef NETWORKCLIENT_SSE2
+		const __m128i key = _mm_set1_epi8((char)g_KeyColor);
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i source = _mm_loadu_si128((const __m128i *)(pSource + x));
+			__m128i transparent = _mm_cmpeq_epi8(source, key);
+			int transparentBits = _mm_movemask_epi8(transparent);
+			// Most of a layer is either all see-through or all solid, so only blend the mixed runs
+			if (transparentBits == 0xFFFF)
+				continue;
+			if (transparentBits == 0)
+			{
+				_mm_storeu_si128((__m128i *)(pTarget + x), source);
+				continue;
+			}
+			__m128i target = _mm_loadu_si128((const __m128i *)(pTarget + x));
+			_mm_storeu_si128((__m128i *)(pTarget + x), _mm_or_si128(_mm_and_si128(transparent, target), _mm_andnot_si128(transparent, source)));
+		}
+#endif
+		for (; x < width; ++x)
+		{
+			if (pSource[x] != g_KeyColor)
+				pTarget[x] = pSource[x];
+		}
+	}
 
 
 	//////////////////////////////////////////////////////////////////////////////////////////
@@ -51,6 +90,10 @@ namespace RTE
 	void NetworkClient::Clear()
 	{
 		m_LastInputSentTime = 0;
+		m_InputHistoryCount = 0;
+		m_InputSequence = 0;
+		m_FrameBoxJobCount = 0;
+		m_CompositeOps.clear();
 		m_ReceivedData = 0;
 		m_CompressedData = 0;
 		m_IsConnected = false;
@@ -59,10 +102,16 @@ namespace RTE
 		//m_LastLineReceived = 0;
 		m_pSceneBackgroundBitmap = 0;
 		m_pSceneForegroundBitmap = 0;
-		for (int f = 0; f < FRAMES_TO_REMEMBER; f++)
-			m_TargetPos[f].Reset();
 		m_CurrentSceneLayerReceived = -1;
 		m_CurrentFrame = 0;
+		for (int f = 0; f < JITTER_BUFFER_FRAMES; f++)
+		{
+			m_FrameBuffer[f].pBitmap = 0;
+			m_FrameBuffer[f].pGUIBitmap = 0;
+		}
+		ClearFrameBuffer();
+		m_PlayoutDelayMS = 50;
+		m_AdaptivePlayout = true;
 		m_UseNATPunchThroughService = false;
 		m_ServerGuid = RakNet::UNASSIGNED_RAKNET_GUID;
 
@@ -106,6 +155,8 @@ namespace RTE
 		m_Client = RakNet::RakPeerInterface::GetInstance();
 
 		m_ClientInputFps = g_SettingsMan.GetClientInputFps();
+		m_PlayoutDelayMS = g_SettingsMan.GetClientPlayoutDelay();
+		m_AdaptivePlayout = g_SettingsMan.GetClientAdaptivePlayout();
 
 		return 0;
 	}
@@ -118,6 +169,7 @@ namespace RTE
 
 	void NetworkClient::Destroy()
 	{
+		ClearFrameBuffer(true);
 		Clear();
 	}
 
@@ -343,7 +395,24 @@ namespace RTE
 		g_UInputMan.ClearAccumulatedStates();
 		//buf[UInputMan::INPUT_COUNT] = 0;
 
-		m_Client->Send((const char *)&msg, sizeof(msg), IMMEDIATE_PRIORITY, RELIABLE_ORDERED, 0, m_ServerID, false);
+		if (m_InputHistoryCount == INPUT_STATES_PER_MSG)
+		{
+			for (int i = 1; i < INPUT_STATES_PER_MSG; i++)
+				m_InputHistory[i - 1] = m_InputHistory[i];
+			m_InputHistoryCount--;
+		}
+		m_InputHistory[m_InputHistoryCount++] = msg;
+		m_InputSequence++;
+
+		// Every message repeats the last few states, so it can go unreliable and the server just skips the ones it already has
+		RakNet::BitStream stream;
+		stream.Write((unsigned char)ID_CLT_INPUT);
+		stream.Write(m_InputSequence);
+		stream.Write((unsigned char)m_InputHistoryCount);
+		for (int i = 0; i < m_InputHistoryCount; i++)
+			WriteInputState(stream, m_InputHistory[i], i > 0 ? &m_InputHistory[i - 1] : 0);
+
+		m_Client->Send(&stream, IMMEDIATE_PRIORITY, UNRELIABLE, 0, m_ServerID, false);
 
 		/*if (msg.InputElementHeld > 0 || msg.InputElementPressed > 0 || msg.InputElementReleased > 0)
 		{
@@ -353,6 +422,108 @@ namespace RTE
 		}*/
 	}
 
+	void NetworkClient::WriteInputState(RakNet::BitStream &stream, const MsgInput &state, const MsgInput *pBase)
+	{
+		if (pBase)
+		{
+			unsigned int changed = state.InputElementHeld ^ pBase->InputElementHeld;
+			stream.Write(changed != 0);
+			if (changed != 0)
+				stream.WriteCompressed(changed);
+		}
+		else
+			stream.WriteCompressed(state.InputElementHeld);
+
+		stream.Write(state.InputElementPressed != 0);
+		if (state.InputElementPressed != 0)
+			stream.WriteCompressed(state.InputElementPressed);
+		stream.Write(state.InputElementReleased != 0);
+		if (state.InputElementReleased != 0)
+			stream.WriteCompressed(state.InputElementReleased);
+
+		for (int i = 0; i < UInputMan::MAX_MOUSE_BUTTONS; i++)
+		{
+			stream.Write(state.MouseButtonHeld[i]);
+			stream.Write(state.MouseButtonPressed[i]);
+			stream.Write(state.MouseButtonReleased[i]);
+		}
+
+		// Raw mouse movement since the last state, quantized to what a short can hold
+		bool mouseMoved = state.MouseX != 0 || state.MouseY != 0;
+		stream.Write(mouseMoved);
+		if (mouseMoved)
+		{
+			stream.WriteCompressed((short)Limit(state.MouseX, SHRT_MAX, SHRT_MIN));
+			stream.WriteCompressed((short)Limit(state.MouseY, SHRT_MAX, SHRT_MIN));
+		}
+
+		stream.Write(state.MouseWheelMoved != 0);
+		if (state.MouseWheelMoved != 0)
+			stream.Write((signed char)Limit(state.MouseWheelMoved, SCHAR_MAX, SCHAR_MIN));
+
+		stream.Write(state.ResetActivityVote);
+	}
+
+	bool NetworkClient::ReadInputState(RakNet::BitStream &stream, MsgInput &state, const MsgInput *pBase)
+	{
+		bool ok = true;
+		bool flag = false;
+
+		state.Id = ID_CLT_INPUT;
+
+		if (pBase)
+		{
+			unsigned int changed = 0;
+			ok = ok && stream.Read(flag);
+			if (ok && flag)
+				ok = stream.ReadCompressed(changed);
+			state.InputElementHeld = pBase->InputElementHeld ^ changed;
+		}
+		else
+			ok = ok && stream.ReadCompressed(state.InputElementHeld);
+
+		state.InputElementPressed = 0;
+		ok = ok && stream.Read(flag);
+		if (ok && flag)
+			ok = stream.ReadCompressed(state.InputElementPressed);
+		state.InputElementReleased = 0;
+		ok = ok && stream.Read(flag);
+		if (ok && flag)
+			ok = stream.ReadCompressed(state.InputElementReleased);
+
+		for (int i = 0; i < UInputMan::MAX_MOUSE_BUTTONS; i++)
+		{
+			ok = ok && stream.Read(state.MouseButtonHeld[i]);
+			ok = ok && stream.Read(state.MouseButtonPressed[i]);
+			ok = ok && stream.Read(state.MouseButtonReleased[i]);
+		}
+
+		state.MouseX = 0;
+		state.MouseY = 0;
+		ok = ok && stream.Read(flag);
+		if (ok && flag)
+		{
+			short mouseX = 0;
+			short mouseY = 0;
+			ok = stream.ReadCompressed(mouseX) && stream.ReadCompressed(mouseY);
+			state.MouseX = mouseX;
+			state.MouseY = mouseY;
+		}
+
+		state.MouseWheelMoved = 0;
+		ok = ok && stream.Read(flag);
+		if (ok && flag)
+		{
+			signed char wheel = 0;
+			ok = stream.Read(wheel);
+			state.MouseWheelMoved = wheel;
+		}
+
+		ok = ok && stream.Read(state.ResetActivityVote);
+
+		return ok;
+	}
+
 	void NetworkClient::ReceiveTerrainChangeMsg(RakNet::Packet * p)
 	{
 		RTE::MsgTerrainChange * frameData = (RTE::MsgTerrainChange *)p->data;
@@ -438,8 +609,9 @@ namespace RTE
 		}
 	}
 
-	void NetworkClient::DrawBackgrounds(BITMAP * pTargetBitmap)
+	void NetworkClient::DrawBackgrounds(BITMAP * pTargetBitmap, const Vector *pLayerOffsets)
 	{
+		// This only adds the composite ops for the layers, they get drawn along with the rest of the frame
 		for (int i = m_ActiveBackgroundLayers - 1; i >= 0; i--)
 		{
 			if (m_BackgroundBitmaps[i] != 0)
@@ -470,7 +642,6 @@ namespace RTE
 				int sourceH = 0;
 				int destX = 0;
 				int destY = 0;
-				std::list<SLDrawBox> drawList;
 
 				int offsetX;
 				int offsetY;
@@ -484,8 +655,8 @@ namespace RTE
 				// Regular scroll
 				else
 				{
-					offsetX = floorf(m_aBackgroundLayers[frame][i].OffsetX * m_aBackgroundLayers[frame][i].ScrollRatioX);
-					offsetY = floorf(m_aBackgroundLayers[frame][i].OffsetY * m_aBackgroundLayers[frame][i].ScrollRatioY);
+					offsetX = floorf(pLayerOffsets[i].m_X * m_aBackgroundLayers[frame][i].ScrollRatioX);
+					offsetY = floorf(pLayerOffsets[i].m_Y * m_aBackgroundLayers[frame][i].ScrollRatioY);
 
 					{
 						// Only force bounds when doing regular scroll offset because the override is used to do terrain object application tricks and sometimes needs the offsets to be < 0
@@ -527,8 +698,8 @@ namespace RTE
 				// Set the clipping rectangle of the target bitmap to match the specified target box
 				set_clip_rect(pTargetBitmap, targetBox.GetCorner().m_X, targetBox.GetCorner().m_Y, targetBox.GetCorner().m_X + targetBox.GetWidth() - 1, targetBox.GetCorner().m_Y + targetBox.GetHeight() - 1);
 
-				// Choose the correct blitting function based on transparency setting
-				void(*pfBlit)(BITMAP *source, BITMAP *dest, int source_x, int source_y, int dest_x, int dest_y, int width, int height) = m_aBackgroundLayers[frame][i].DrawTrans ? &masked_blit : &blit;
+				// Choose the correct blitting based on transparency setting
+				bool masked = m_aBackgroundLayers[frame][i].DrawTrans;
 
 				// See if this SceneLayer is wider AND higher than the target bitmap; then use simple wrapping logic - oterhwise need to tile
 				if (m_BackgroundBitmaps[i]->w >= pTargetBitmap->w && m_BackgroundBitmaps[i]->h >= pTargetBitmap->h)
@@ -539,7 +710,7 @@ namespace RTE
 					sourceH = m_BackgroundBitmaps[i]->h - offsetY;
 					destX = targetBox.GetCorner().m_X;
 					destY = targetBox.GetCorner().m_Y;
-					pfBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH);
+					AddCompositeBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH, masked);
 
 					sourceX = 0;
 					sourceY = offsetY;
@@ -547,7 +718,7 @@ namespace RTE
 					sourceH = m_BackgroundBitmaps[i]->h - offsetY;
 					destX = targetBox.GetCorner().m_X + m_BackgroundBitmaps[i]->w - offsetX;
 					destY = targetBox.GetCorner().m_Y;
-					pfBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH);
+					AddCompositeBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH, masked);
 
 					sourceX = offsetX;
 					sourceY = 0;
@@ -555,7 +726,7 @@ namespace RTE
 					sourceH = offsetY;
 					destX = targetBox.GetCorner().m_X;
 					destY = targetBox.GetCorner().m_Y + m_BackgroundBitmaps[i]->h - offsetY;
-					pfBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH);
+					AddCompositeBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH, masked);
 
 					sourceX = 0;
 					sourceY = 0;
@@ -563,7 +734,7 @@ namespace RTE
 					sourceH = offsetY;
 					destX = targetBox.GetCorner().m_X + m_BackgroundBitmaps[i]->w - offsetX;
 					destY = targetBox.GetCorner().m_Y + m_BackgroundBitmaps[i]->h - offsetY;
-					pfBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH);
+					AddCompositeBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH, masked);
 				}
 				// Target bitmap is larger in some dimension, so need to draw this tiled as many times as necessary to cover the whole target
 				else
@@ -599,7 +770,7 @@ namespace RTE
 							destX = (!m_aBackgroundLayers[frame][i].WrapX && screenLargerThanSceneX) ? ((pTargetBitmap->w / 2) - (m_BackgroundBitmaps[i]->w / 2)) : (targetBox.GetCorner().m_X + tiledOffsetX - offsetX);
 							destY = (!m_aBackgroundLayers[frame][i].WrapY && screenLargerThanSceneY) ? ((pTargetBitmap->h / 2) - (m_BackgroundBitmaps[i]->h / 2)) : (targetBox.GetCorner().m_Y + tiledOffsetY - offsetY);
 
-							pfBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH);
+							AddCompositeBlit(m_BackgroundBitmaps[i], pTargetBitmap, sourceX, sourceY, destX, destY, sourceW, sourceH, masked);
 
 							tiledOffsetX += m_BackgroundBitmaps[i]->w;
 						}
@@ -616,17 +787,17 @@ namespace RTE
 					if (!m_aBackgroundLayers[frame][i].WrapX && !screenLargerThanSceneX && m_aBackgroundLayers[frame][i].ScrollRatioX < 0)
 					{
 						if (m_aBackgroundLayers[frame][i].FillLeftColor != g_KeyColor && offsetX != 0)
-							rectfill(pTargetBitmap, targetBox.GetCorner().m_X, targetBox.GetCorner().m_Y, targetBox.GetCorner().m_X - offsetX, targetBox.GetCorner().m_Y + targetBox.GetHeight(), m_aBackgroundLayers[frame][i].FillLeftColor);
+							AddCompositeFill(pTargetBitmap, targetBox.GetCorner().m_X, targetBox.GetCorner().m_Y, targetBox.GetCorner().m_X - offsetX, targetBox.GetCorner().m_Y + targetBox.GetHeight(), m_aBackgroundLayers[frame][i].FillLeftColor);
 						if (m_aBackgroundLayers[frame][i].FillRightColor != g_KeyColor)
-							rectfill(pTargetBitmap, (targetBox.GetCorner().m_X - offsetX) + m_BackgroundBitmaps[i]->w, targetBox.GetCorner().m_Y, targetBox.GetCorner().m_X + targetBox.GetWidth(), targetBox.GetCorner().m_Y + targetBox.GetHeight(), m_aBackgroundLayers[frame][i].FillRightColor);
+							AddCompositeFill(pTargetBitmap, (targetBox.GetCorner().m_X - offsetX) + m_BackgroundBitmaps[i]->w, targetBox.GetCorner().m_Y, targetBox.GetCorner().m_X + targetBox.GetWidth(), targetBox.GetCorner().m_Y + targetBox.GetHeight(), m_aBackgroundLayers[frame][i].FillRightColor);
 					}
 
 					if (!m_aBackgroundLayers[frame][i].WrapY && !screenLargerThanSceneY && m_aBackgroundLayers[frame][i].ScrollRatioY < 0)
 					{
 						if (m_aBackgroundLayers[frame][i].FillUpColor != g_KeyColor && offsetY != 0)
-							rectfill(pTargetBitmap, targetBox.GetCorner().m_X, targetBox.GetCorner().m_Y, targetBox.GetCorner().m_X + targetBox.GetWidth(), targetBox.GetCorner().m_Y - offsetY, m_aBackgroundLayers[frame][i].FillUpColor);
+							AddCompositeFill(pTargetBitmap, targetBox.GetCorner().m_X, targetBox.GetCorner().m_Y, targetBox.GetCorner().m_X + targetBox.GetWidth(), targetBox.GetCorner().m_Y - offsetY, m_aBackgroundLayers[frame][i].FillUpColor);
 						if (m_aBackgroundLayers[frame][i].FillDownColor != g_KeyColor)
-							rectfill(pTargetBitmap, targetBox.GetCorner().m_X, (targetBox.GetCorner().m_Y - offsetY) + m_BackgroundBitmaps[i]->h, targetBox.GetCorner().m_X + targetBox.GetWidth(), targetBox.GetCorner().m_Y + targetBox.GetHeight(), m_aBackgroundLayers[frame][i].FillDownColor);
+							AddCompositeFill(pTargetBitmap, targetBox.GetCorner().m_X, (targetBox.GetCorner().m_Y - offsetY) + m_BackgroundBitmaps[i]->h, targetBox.GetCorner().m_X + targetBox.GetWidth(), targetBox.GetCorner().m_Y + targetBox.GetHeight(), m_aBackgroundLayers[frame][i].FillDownColor);
 					}
 				}
 
@@ -637,11 +808,147 @@ namespace RTE
 		}
 	}
 
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          AddCompositeBlit
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Adds a blit to the ops that composite the current frame, clipped the
+	//                  same way Allegro's blit and masked_blit clip.
+
+	void NetworkClient::AddCompositeBlit(BITMAP *pSource, BITMAP *pTarget, int sourceX, int sourceY, int targetX, int targetY, int width, int height, bool masked)
+	{
+		DAssert(bitmap_color_depth(pSource) == 8 && bitmap_color_depth(pTarget) == 8, "Compositing can only be done with 8 bit bitmaps!");
+
+		if (sourceX >= pSource->w || sourceY >= pSource->h || targetX >= pTarget->cr || targetY >= pTarget->cb)
+			return;
+
+		// Clip to the source bitmap
+		if (sourceX < 0)
+		{
+			width += sourceX;
+			targetX -= sourceX;
+			sourceX = 0;
+		}
+		if (sourceY < 0)
+		{
+			height += sourceY;
+			targetY -= sourceY;
+			sourceY = 0;
+		}
+		width = std::min(width, pSource->w - sourceX);
+		height = std::min(height, pSource->h - sourceY);
+
+		// Clip to the clip rect of the target
+		if (targetX < pTarget->cl)
+		{
+			width -= pTarget->cl - targetX;
+			sourceX += pTarget->cl - targetX;
+			targetX = pTarget->cl;
+		}
+		if (targetY < pTarget->ct)
+		{
+			height -= pTarget->ct - targetY;
+			sourceY += pTarget->ct - targetY;
+			targetY = pTarget->ct;
+		}
+		width = std::min(width, pTarget->cr - targetX);
+		height = std::min(height, pTarget->cb - targetY);
+
+		if (width <= 0 || height <= 0)
+			return;
+
+		CompositeOp op;
+		op.pSource = pSource;
+		op.pTarget = pTarget;
+		op.SourceX = sourceX;
+		op.SourceY = sourceY;
+		op.TargetX = targetX;
+		op.TargetY = targetY;
+		op.Width = width;
+		op.Height = height;
+		op.Masked = masked;
+		op.FillColor = 0;
+		m_CompositeOps.push_back(op);
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          AddCompositeFill
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Adds a solid fill to the ops that composite the current frame,
+	//                  clipped the same way Allegro's rectfill clips.
+
+	void NetworkClient::AddCompositeFill(BITMAP *pTarget, int x1, int y1, int x2, int y2, unsigned char color)
+	{
+		DAssert(bitmap_color_depth(pTarget) == 8, "Compositing can only be done with 8 bit bitmaps!");
+
+		if (x2 < x1)
+			std::swap(x1, x2);
+		if (y2 < y1)
+			std::swap(y1, y2);
+
+		x1 = std::max(x1, pTarget->cl);
+		y1 = std::max(y1, pTarget->ct);
+		x2 = std::min(x2, pTarget->cr - 1);
+		y2 = std::min(y2, pTarget->cb - 1);
+
+		if (x2 < x1 || y2 < y1)
+			return;
+
+		CompositeOp op;
+		op.pSource = 0;
+		op.pTarget = pTarget;
+		op.SourceX = 0;
+		op.SourceY = 0;
+		op.TargetX = x1;
+		op.TargetY = y1;
+		op.Width = x2 - x1 + 1;
+		op.Height = y2 - y1 + 1;
+		op.Masked = false;
+		op.FillColor = color;
+		m_CompositeOps.push_back(op);
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          RunCompositeOps
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Carries out all the composite ops in order, but only on a band of rows
+	//                  of their targets.
+
+	void NetworkClient::RunCompositeOps(int top, int bottom)
+	{
+		for (std::vector<CompositeOp>::const_iterator opItr = m_CompositeOps.begin(); opItr != m_CompositeOps.end(); ++opItr)
+		{
+			int startY = std::max(opItr->TargetY, top);
+			int endY = std::min(opItr->TargetY + opItr->Height, bottom);
+
+			for (int y = startY; y < endY; ++y)
+			{
+				unsigned char *pTargetRow = opItr->pTarget->line[y] + opItr->TargetX;
+
+				if (!opItr->pSource)
+					memset(pTargetRow, opItr->FillColor, opItr->Width);
+				else
+				{
+					const unsigned char *pSourceRow = opItr->pSource->line[opItr->SourceY + (y - opItr->TargetY)] + opItr->SourceX;
+					if (opItr->Masked)
+						MaskedCopyRow(pSourceRow, pTargetRow, opItr->Width);
+					else
+						memcpy(pTargetRow, pSourceRow, opItr->Width);
+				}
+			}
+		}
+	}
+
 	void NetworkClient::ReceivePosteEffectsMsg(RakNet::Packet * p)
 	{
 		MsgPostEffects * msg = (MsgPostEffects *)p->data;
 		PostEffectNetworkData * effDataPtr = (PostEffectNetworkData *)((char *)msg + sizeof(MsgPostEffects));
 
+		BufferedFrame * pFrame = GetBufferedFrame(msg->FrameNumber);
+		if (!pFrame)
+			return;
+
 		for (int i = 0; i < msg->PostEffectsCount; i++)
 		{
 			BITMAP * bmp = 0;
@@ -653,7 +960,7 @@ namespace RTE
 			}
 
 			if (bmp)
-				m_PostEffects[msg->FrameNumber].push_back(PostEffect(Vector(effDataPtr->X, effDataPtr->Y), bmp, 0, effDataPtr->Strength, effDataPtr->Angle));
+				pFrame->PostEffects.push_back(PostEffect(Vector(effDataPtr->X, effDataPtr->Y), bmp, 0, effDataPtr->Strength, effDataPtr->Angle));
 			else
 			{
 				//char buf[128];
@@ -802,43 +1109,47 @@ namespace RTE
 	}
 
 
-	void NetworkClient::DrawPostEffects(int frame)
+	void NetworkClient::DrawPostEffects(std::list<PostEffect> &postEffects)
 	{
-		g_FrameMan.SetPostEffectsList(0, m_PostEffects[frame]);
-		//m_PostEffects[frame].clear();
+		g_FrameMan.SetPostEffectsList(0, postEffects);
 	}
 
-	void NetworkClient::DrawFrame()
+	void NetworkClient::DrawFrame(BufferedFrame &frame, const Vector *pLayerOffsets)
 	{
+		// All the boxes of the frame have to be in place before it's composited
+		DecodeFrameBoxes();
+
 		while (g_FrameMan.IsNetworkBitmapLocked(0));
-		BITMAP * src_bmp = g_FrameMan.GetNetworkBackBufferIntermediate8Ready(0);
+		BITMAP * src_bmp = frame.pBitmap;
 		BITMAP * dst_bmp = g_FrameMan.GetNetworkBackBuffer8Ready(0);
 
-		BITMAP * src_gui_bmp = g_FrameMan.GetNetworkBackBufferIntermediateGUI8Ready(0);
+		BITMAP * src_gui_bmp = frame.pGUIBitmap;
 		BITMAP * dst_gui_bmp = g_FrameMan.GetNetworkBackBufferGUI8Ready(0);
 
+		m_CompositeOps.clear();
+
 		// Have to clear to color to fallback if there's no skybox on client
-		clear_to_color(dst_bmp, g_BlackColor);
-		clear_to_color(dst_gui_bmp, g_KeyColor);
+		AddCompositeFill(dst_bmp, 0, 0, dst_bmp->w - 1, dst_bmp->h - 1, g_BlackColor);
+		AddCompositeFill(dst_gui_bmp, 0, 0, dst_gui_bmp->w - 1, dst_gui_bmp->h - 1, g_KeyColor);
 
 		// Draw Scene background
-		int sourceX = m_TargetPos[m_CurrentFrame].m_X;
-		int sourceY = m_TargetPos[m_CurrentFrame].m_Y;
+		int sourceX = frame.TargetPos.m_X;
+		int sourceY = frame.TargetPos.m_Y;
 		int sourceW = src_bmp->w;
 		int sourceH = src_bmp->h;
 		int destX = 0;
 		int destY = 0;
 
-		DrawBackgrounds(dst_bmp);
+		DrawBackgrounds(dst_bmp, pLayerOffsets);
 
-		masked_blit(m_pSceneBackgroundBitmap, dst_bmp, sourceX, sourceY, destX, destY, src_bmp->w, src_bmp->h);
+		AddCompositeBlit(m_pSceneBackgroundBitmap, dst_bmp, sourceX, sourceY, destX, destY, src_bmp->w, src_bmp->h, true);
 
 		// Draw if the out of seam portion is to the left
 		if (sourceX < 0)
 		{
 			int newSourceX = m_pSceneBackgroundBitmap->w + sourceX;
 
-			masked_blit(m_pSceneBackgroundBitmap, dst_bmp, newSourceX, sourceY, destX, destY, src_bmp->w, src_bmp->h);
+			AddCompositeBlit(m_pSceneBackgroundBitmap, dst_bmp, newSourceX, sourceY, destX, destY, src_bmp->w, src_bmp->h, true);
 		}
 		// Draw if the out of seam portion is to the right
 		else if (sourceX + g_FrameMan.GetResX() >= m_pSceneBackgroundBitmap->w)
@@ -846,21 +1157,21 @@ namespace RTE
 			int newDestX = m_pSceneBackgroundBitmap->w - sourceX;
 			int width = g_FrameMan.GetResX() - newDestX;
 
-			masked_blit(m_pSceneBackgroundBitmap, dst_bmp, 0, sourceY, newDestX, destY, width, src_bmp->h);
+			AddCompositeBlit(m_pSceneBackgroundBitmap, dst_bmp, 0, sourceY, newDestX, destY, width, src_bmp->h, true);
 		}
 
 		//draw_sprite(src_bmp, dst_bmp, 0, 0);
-		masked_blit(src_bmp, dst_bmp, 0, 0, 0, 0, src_bmp->w, src_bmp->h);
-		masked_blit(src_gui_bmp, dst_gui_bmp, 0, 0, 0, 0, src_bmp->w, src_bmp->h);
+		AddCompositeBlit(src_bmp, dst_bmp, 0, 0, 0, 0, src_bmp->w, src_bmp->h, true);
+		AddCompositeBlit(src_gui_bmp, dst_gui_bmp, 0, 0, 0, 0, src_bmp->w, src_bmp->h, true);
 
-		masked_blit(m_pSceneForegroundBitmap, dst_bmp, sourceX, sourceY, destX, destY, src_bmp->w, src_bmp->h);
+		AddCompositeBlit(m_pSceneForegroundBitmap, dst_bmp, sourceX, sourceY, destX, destY, src_bmp->w, src_bmp->h, true);
 
 		// Draw if the out of seam portion is to the left
 		if (sourceX < 0)
 		{
 			int newSourceX = m_pSceneForegroundBitmap->w + sourceX;
 
-			masked_blit(m_pSceneForegroundBitmap, dst_bmp, newSourceX, sourceY, destX, destY, src_bmp->w, src_bmp->h);
+			AddCompositeBlit(m_pSceneForegroundBitmap, dst_bmp, newSourceX, sourceY, destX, destY, src_bmp->w, src_bmp->h, true);
 		}
 		// Draw if the out of seam portion is to the right
 		else if (sourceX + g_FrameMan.GetResX() >= m_pSceneForegroundBitmap->w)
@@ -868,10 +1179,17 @@ namespace RTE
 			int newDestX = m_pSceneForegroundBitmap->w - sourceX;
 			int width = g_FrameMan.GetResX() - newDestX;
 
-			masked_blit(m_pSceneForegroundBitmap, dst_bmp, 0, sourceY, newDestX, destY, width, src_bmp->h);
+			AddCompositeBlit(m_pSceneForegroundBitmap, dst_bmp, 0, sourceY, newDestX, destY, width, src_bmp->h, true);
 		}
 
-		DrawPostEffects(m_CurrentFrame);
+		// The ops go down in the same order within each band of rows and the bands don't overlap, so they can all be drawn at once
+		int bandCount = (std::max(dst_bmp->h, dst_gui_bmp->h) + COMPOSITEBANDHEIGHT - 1) / COMPOSITEBANDHEIGHT;
+		g_ThreadMan.ParallelFor(bandCount, [this](int band)
+		{
+			RunCompositeOps(band * COMPOSITEBANDHEIGHT, (band + 1) * COMPOSITEBANDHEIGHT);
+		});
+
+		DrawPostEffects(frame.PostEffects);
 
 		g_FrameMan.SetCurrentPing(GetPing());
 
@@ -905,52 +1223,124 @@ namespace RTE
 		}*/
 		//m_LastLineReceived = lineNumber;
 
+		m_ReceivedData += frameData->DataSize;
+		m_CompressedData += frameData->UncompressedSize;
+
+		// Boxes go into the frame they belong to, so ones from different frames never get mixed up on screen
+		BufferedFrame * pFrame = GetBufferedFrame(frameData->FrameNumber);
+		if (!pFrame)
+			return;
+
 		BITMAP * bmp = 0;
 
 		if (frameData->Layer == 0)
-			bmp = g_FrameMan.GetNetworkBackBufferIntermediate8Ready(0);
+			bmp = pFrame->pBitmap;
 		if (frameData->Layer == 1)
-			bmp = g_FrameMan.GetNetworkBackBufferIntermediateGUI8Ready(0);
-
-		acquire_bitmap(bmp);
+			bmp = pFrame->pGUIBitmap;
+		if (!bmp)
+			return;
 
 		int maxWidth = frameData->BoxWidth;
 		int maxHeight = frameData->BoxHeight;
 		int size = frameData->DataSize;
 
-		m_ReceivedData += frameData->DataSize;
-		m_CompressedData += frameData->UncompressedSize;
-
 		if (bpx + maxWidth - 1 < bmp->w && bpy + maxHeight - 1 < bmp->h && bpx >= 0 && bpy >= 0)
 		{
-			// Unpack box
-			if (frameData->DataSize == 0)
-			{
-				//memset(bmp->line[lineNumber], g_KeyColor, bmp->w);
-				rectfill(bmp, bpx, bpy, bpx + maxWidth - 1, bpy + maxHeight - 1, g_KeyColor);
-			}
-			else
-			{
-				if (frameData->DataSize == frameData->UncompressedSize)
-					memcpy_s(m_aPixelLineBuffer, size, p->data + sizeof(MsgFrameBox), size);
-				else
-					LZ4_decompress_safe((char *)(p->data + sizeof(MsgFrameBox)), (char *)(m_aPixelLineBuffer), size, frameData->UncompressedSize);
+			// Leave the unpacking to the worker threads. The packet is gone by then, so hang on to a copy of the data
+			if (m_FrameBoxJobCount == (int)m_FrameBoxJobs.size())
+				m_FrameBoxJobs.push_back(FrameBoxJob());
+			FrameBoxJob &job = m_FrameBoxJobs[m_FrameBoxJobCount++];
+
+			job.pBitmap = bmp;
+			job.X = bpx;
+			job.Y = bpy;
+			job.Width = maxWidth;
+			job.Height = maxHeight;
+			job.DataSize = size;
+			job.UncompressedSize = frameData->UncompressedSize;
+			job.Outline = size != 0 && g_UInputMan.KeyHeld(KEY_0);
+			job.Data.assign(p->data + sizeof(MsgFrameBox), p->data + sizeof(MsgFrameBox) + size);
+		}
+	}
 
-				// Copy box to bitmap line by line
-				unsigned char * lineAddr = m_aPixelLineBuffer;
-				for (int y = 0; y < maxHeight; y++)
-				{
-					memcpy_s(bmp->line[bpy + y] + bpx, maxWidth, lineAddr, maxWidth);
-					lineAddr += maxWidth;
-				}
 
-				if (g_UInputMan.KeyHeld(KEY_0))
-					rect(bmp, bpx, bpy, bpx + maxWidth - 1, bpy + maxHeight - 1, g_BlackColor);
-			}
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          DecodeFrameBoxes
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Unpacks all the queued frame boxes into their bitmaps, spread across
+	//                  the worker threads.
+
+	void NetworkClient::DecodeFrameBoxes()
+	{
+		if (m_FrameBoxJobCount == 0)
+			return;
+
+		// Each thread gets its own decompression buffer and keeps grabbing boxes until there are none left
+		int threadCount = std::min(g_ThreadMan.GetWorkerCount(), m_FrameBoxJobCount);
+		if ((int)m_DecodeBuffers.size() < threadCount)
+			m_DecodeBuffers.resize(threadCount, std::vector<unsigned char>(MAX_PIXEL_LINE_BUFFER_SIZE));
 
+		std::atomic<int> nextJob(0);
+		g_ThreadMan.ParallelFor(threadCount, [this, &nextJob](int thread)
+		{
+			int job;
+			while ((job = nextJob++) < m_FrameBoxJobCount)
+				DecodeFrameBox(m_FrameBoxJobs[job], &m_DecodeBuffers[thread][0]);
+		});
+
+		m_FrameBoxJobCount = 0;
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Static method:   DecodeFrameBox
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Unpacks one frame box straight into the lines of its bitmap.
+
+	void NetworkClient::DecodeFrameBox(const FrameBoxJob &job, unsigned char *pBuffer)
+	{
+		if (job.Width <= 0 || job.Height <= 0)
+			return;
+
+		if (job.DataSize == 0)
+		{
+			for (int y = 0; y < job.Height; y++)
+				memset(job.pBitmap->line[job.Y + y] + job.X, g_KeyColor, job.Width);
+			return;
 		}
 
-		release_bitmap(bmp);
+		// Uncompressed boxes can be copied straight out of the message data
+		const unsigned char *pPixels = &job.Data[0];
+		int pixelCount = job.DataSize;
+		if (job.DataSize != job.UncompressedSize)
+		{
+			if (job.UncompressedSize > MAX_PIXEL_LINE_BUFFER_SIZE)
+				return;
+			pixelCount = LZ4_decompress_safe((const char *)pPixels, (char *)pBuffer, job.DataSize, job.UncompressedSize);
+			pPixels = pBuffer;
+		}
+		// Don't copy garbage if the box didn't come through whole
+		if (pixelCount < job.Width * job.Height)
+			return;
+
+		// Copy box to bitmap line by line
+		for (int y = 0; y < job.Height; y++)
+		{
+			memcpy(job.pBitmap->line[job.Y + y] + job.X, pPixels, job.Width);
+			pPixels += job.Width;
+		}
+
+		// Outline the box by hand, Allegro's primitives aren't meant to be drawn with from several threads at once
+		if (job.Outline)
+		{
+			memset(job.pBitmap->line[job.Y] + job.X, g_BlackColor, job.Width);
+			memset(job.pBitmap->line[job.Y + job.Height - 1] + job.X, g_BlackColor, job.Width);
+			for (int y = 0; y < job.Height; y++)
+			{
+				job.pBitmap->line[job.Y + y][job.X] = g_BlackColor;
+				job.pBitmap->line[job.Y + y][job.X + job.Width - 1] = g_BlackColor;
+			}
+		}
 	}
 
 	void NetworkClient::ReceiveFrameLineMsg(RakNet::Packet * p)
@@ -958,6 +1348,9 @@ namespace RTE
 		RTE::MsgFrameLine * frameData = (RTE::MsgFrameLine *)p->data;
 		int lineNumber = frameData->LineNumber;
 
+		// Don't let any boxes still waiting to be unpacked land on top of this line later
+		DecodeFrameBoxes();
+
 		m_CurrentSceneLayerReceived = -1;
 
 		// Looks like we've started receiving a new frame, time to draw current frame then
@@ -971,12 +1364,21 @@ namespace RTE
 		}*/
 		//m_LastLineReceived = lineNumber;
 
+		m_ReceivedData += frameData->DataSize;
+		m_CompressedData += frameData->UncompressedSize;
+
+		BufferedFrame * pFrame = GetBufferedFrame(frameData->FrameNumber);
+		if (!pFrame)
+			return;
+
 		BITMAP * bmp = 0;
 		
 		if (frameData->Layer == 0)
-			bmp = g_FrameMan.GetNetworkBackBufferIntermediate8Ready(0);
+			bmp = pFrame->pBitmap;
 		if (frameData->Layer == 1)
-			bmp = g_FrameMan.GetNetworkBackBufferIntermediateGUI8Ready(0);
+			bmp = pFrame->pGUIBitmap;
+		if (!bmp)
+			return;
 
 		acquire_bitmap(bmp);
 
@@ -984,9 +1386,6 @@ namespace RTE
 		int pixels = MIN(bmp->w, width);
 
 
-		m_ReceivedData += frameData->DataSize;
-		m_CompressedData += frameData->UncompressedSize;
-
 		if (lineNumber < bmp->h)
 		{
 			if (frameData->DataSize == 0)
@@ -1020,26 +1419,324 @@ namespace RTE
 	void NetworkClient::ReceiveFrameSetupMsg(RakNet::Packet * p)
 	{
 		RTE::MsgFrameSetup * frameData = (RTE::MsgFrameSetup *)p->data;
-		if (frameData->FrameNumber < 0 || frameData->FrameNumber >= FRAMES_TO_REMEMBER)
+		if (frameData->FrameNumber < 0 || frameData->FrameNumber >= FRAME_NUMBER_WRAP)
+			return;
+
+		// The frame gets shown by UpdatePlayout once it's complete and due, not right away
+		BufferedFrame * pFrame = GetBufferedFrame(frameData->FrameNumber);
+		if (!pFrame)
+			return;
+
+		pFrame->HasSetup = true;
+		pFrame->TargetPos.SetXY(frameData->TargetPosX, frameData->TargetPosY);
+
+		for (int i = 0; i < MAX_BACKGROUND_LAYERS_TRANSMITTED; i++)
+			pFrame->LayerOffsets[i].SetXY(frameData->OffsetX[i], frameData->OffsetY[i]);
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          GetBufferedFrame
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Finds the buffered frame a message with a frame number belongs to,
+	//                  starting a new one if the server has moved on to the next frame.
+
+	NetworkClient::BufferedFrame * NetworkClient::GetBufferedFrame(int frameNumber)
+	{
+		// Frame numbers end up indexing the per frame background layer data once shown, so don't let bad ones in at all
+		if (frameNumber < 0 || frameNumber >= FRAME_NUMBER_WRAP)
+			return 0;
+
+		if (m_FrameCount > 0)
+		{
+			// Reliable messages like the frame setup and post effects can come in well after the unreliable boxes of later frames,
+			// so look through everything buffered. Stragglers can still go in as long as their frame isn't up on screen yet
+			for (int i = m_FrameCount - 1; i >= 0; i--)
+			{
+				BufferedFrame &frame = m_FrameBuffer[(m_OldestFrame + i) % JITTER_BUFFER_FRAMES];
+				if (frame.FrameNumber == frameNumber)
+					return (i == 0 && m_ShowingFrame) ? 0 : &frame;
+			}
+
+			// Frames from before the newest one that aren't buffered anymore are long gone, and mustn't start new frames
+			int newestNumber = m_FrameBuffer[(m_OldestFrame + m_FrameCount - 1) % JITTER_BUFFER_FRAMES].FrameNumber;
+			int behind = (newestNumber - frameNumber + FRAME_NUMBER_WRAP) % FRAME_NUMBER_WRAP;
+			if (behind <= FRAME_NUMBER_WRAP / 2)
+				return 0;
+		}
+
+		return StartBufferedFrame(frameNumber);
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          StartBufferedFrame
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Completes the newest buffered frame and starts receiving a new one
+	//                  on top of a copy of it.
+
+	NetworkClient::BufferedFrame * NetworkClient::StartBufferedFrame(int frameNumber)
+	{
+		// Everything received for the frame being completed has to be in it before it's copied
+		DecodeFrameBoxes();
+
+		int64_t currentTicks = g_TimerMan.GetRealTickCount();
+		BufferedFrame *pPrevious = 0;
+
+		if (m_FrameCount > 0)
+		{
+			pPrevious = &m_FrameBuffer[(m_OldestFrame + m_FrameCount - 1) % JITTER_BUFFER_FRAMES];
+			pPrevious->Complete = true;
+
+			// Keep track of how evenly the frames come in, smoothed the same way as RTP interarrival jitter.
+			// Long hitches like scene loads would throw the estimates off for ages, so leave those out
+			float interval = (float)(currentTicks - pPrevious->ArrivalTime) * 1000.0f / (float)g_TimerMan.GetTicksPerSecond();
+			if (interval < 1000.0f)
+			{
+				if (m_FrameIntervalMS <= 0)
+					m_FrameIntervalMS = interval;
+				else
+				{
+					m_ArrivalJitterMS += (fabs(interval - m_FrameIntervalMS) - m_ArrivalJitterMS) / 16.0f;
+					m_FrameIntervalMS += (interval - m_FrameIntervalMS) / 16.0f;
+				}
+			}
+		}
+
+		// Out of room, so skip ahead rather than hold the newest frames back even more
+		if (m_FrameCount == JITTER_BUFFER_FRAMES)
+		{
+			if (m_ShowingFrame)
+				ShowNextFrame();
+			else
+			{
+				m_FrameBuffer[m_OldestFrame].PostEffects.clear();
+				m_OldestFrame = (m_OldestFrame + 1) % JITTER_BUFFER_FRAMES;
+				m_FrameCount--;
+			}
+		}
+
+		BufferedFrame &frame = m_FrameBuffer[(m_OldestFrame + m_FrameCount) % JITTER_BUFFER_FRAMES];
+		m_FrameCount++;
+
+		frame.FrameNumber = frameNumber;
+		frame.HasSetup = false;
+		frame.Complete = false;
+		frame.ArrivalTime = currentTicks;
+		frame.PostEffects.clear();
+
+		// Make sure the bitmaps are the size the frames come in at
+		BITMAP *pSizeBitmap = g_FrameMan.GetNetworkBackBuffer8Ready(0);
+		if (!frame.pBitmap || frame.pBitmap->w != pSizeBitmap->w || frame.pBitmap->h != pSizeBitmap->h)
+		{
+			if (frame.pBitmap)
+				destroy_bitmap(frame.pBitmap);
+			if (frame.pGUIBitmap)
+				destroy_bitmap(frame.pGUIBitmap);
+			frame.pBitmap = create_bitmap_ex(8, pSizeBitmap->w, pSizeBitmap->h);
+			frame.pGUIBitmap = create_bitmap_ex(8, pSizeBitmap->w, pSizeBitmap->h);
+		}
+
+		// Boxes that get lost or left out by interlacing aren't resent, so start off from what the previous frame looked like
+		if (pPrevious && pPrevious->pBitmap->w == frame.pBitmap->w && pPrevious->pBitmap->h == frame.pBitmap->h)
+		{
+			blit(pPrevious->pBitmap, frame.pBitmap, 0, 0, 0, 0, frame.pBitmap->w, frame.pBitmap->h);
+			blit(pPrevious->pGUIBitmap, frame.pGUIBitmap, 0, 0, 0, 0, frame.pGUIBitmap->w, frame.pGUIBitmap->h);
+			frame.TargetPos = pPrevious->TargetPos;
+			for (int i = 0; i < MAX_BACKGROUND_LAYERS_TRANSMITTED; i++)
+				frame.LayerOffsets[i] = pPrevious->LayerOffsets[i];
+		}
+		else
+		{
+			clear_to_color(frame.pBitmap, g_KeyColor);
+			clear_to_color(frame.pGUIBitmap, g_KeyColor);
+			frame.TargetPos.Reset();
+			for (int i = 0; i < MAX_BACKGROUND_LAYERS_TRANSMITTED; i++)
+				frame.LayerOffsets[i].Reset();
+		}
+
+		return &frame;
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          ShowNextFrame
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Retires the frame on screen, if any, and makes the oldest buffered
+	//                  one the one on screen.
+
+	void NetworkClient::ShowNextFrame()
+	{
+		if (m_ShowingFrame)
+		{
+			m_FrameBuffer[m_OldestFrame].PostEffects.clear();
+			m_OldestFrame = (m_OldestFrame + 1) % JITTER_BUFFER_FRAMES;
+			m_FrameCount--;
+		}
+
+		m_ShowingFrame = m_FrameCount > 0;
+		if (m_ShowingFrame)
+			m_CurrentFrame = m_FrameBuffer[m_OldestFrame].FrameNumber % FRAMES_TO_REMEMBER;
+		m_LastShowTime = g_TimerMan.GetRealTickCount();
+		m_RedrawFrame = true;
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          GetTargetBufferedFrames
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Works out how many complete frames should wait in the jitter buffer
+	//                  behind the one on screen.
+
+	int NetworkClient::GetTargetBufferedFrames() const
+	{
+		// Nothing to go by until a couple of frames have come in
+		if (m_FrameIntervalMS <= 0)
+			return 0;
+
+		float delay = (float)m_PlayoutDelayMS;
+		if (m_AdaptivePlayout)
+			delay += JITTER_DEVIATIONS * m_ArrivalJitterMS;
+
+		// The frame on screen and the one coming in take up a slot each
+		int frames = (int)ceil(delay / m_FrameIntervalMS);
+		return std::max(0, std::min(frames, JITTER_BUFFER_FRAMES - 2));
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          UpdatePlayout
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Puts up the next buffered frame when it's due and redraws the one on
+	//                  screen when its interpolated background layers move.
+
+	void NetworkClient::UpdatePlayout()
+	{
+		if (!m_pSceneBackgroundBitmap || !m_pSceneForegroundBitmap || m_FrameCount == 0)
 			return;
 
-		DrawFrame();
+		int64_t currentTicks = g_TimerMan.GetRealTickCount();
+		float ticksPerMS = (float)g_TimerMan.GetTicksPerSecond() / 1000.0f;
+		float intervalTicks = m_FrameIntervalMS * ticksPerMS;
+
+		// The newest frame isn't ready to go up until the server has moved on from it
+		int waiting = m_FrameCount - (m_ShowingFrame ? 1 : 0);
+		if (!m_FrameBuffer[(m_OldestFrame + m_FrameCount - 1) % JITTER_BUFFER_FRAMES].Complete)
+			waiting--;
+		int target = GetTargetBufferedFrames();
 
-		m_PostEffects[m_CurrentFrame].clear();
-		m_CurrentFrame = frameData->FrameNumber;
+		if (!m_ShowingFrame)
+		{
+			// Let the buffer fill up to the target before the first frame goes up, so it has something to ride out late ones with
+			if (waiting > target)
+			{
+				ShowNextFrame();
+				m_NextShowTime = currentTicks + (int64_t)intervalTicks;
+			}
+		}
+		else if (waiting > 0 && currentTicks >= m_NextShowTime)
+		{
+			ShowNextFrame();
+			waiting--;
+
+			// Don't rush through the backlog after a stall, start pacing over from now
+			if (currentTicks - m_NextShowTime > intervalTicks)
+				m_NextShowTime = currentTicks;
+
+			// Show frames a bit quicker while there are more than the target waiting and a bit slower while there are fewer,
+			// so the buffer drifts back to the target without any visible skips or stalls
+			float pace = 1.0f - PLAYOUTPACESTEP * (float)(waiting - target);
+			pace = std::max(0.5f, std::min(pace, 1.5f));
+			m_NextShowTime += (int64_t)(intervalTicks * pace);
+		}
 
-		m_TargetPos[m_CurrentFrame].m_X = frameData->TargetPosX;
-		m_TargetPos[m_CurrentFrame].m_Y = frameData->TargetPosY;
+		if (!m_ShowingFrame)
+			return;
 
+		BufferedFrame &shownFrame = m_FrameBuffer[m_OldestFrame];
+		Vector layerOffsets[MAX_BACKGROUND_LAYERS_TRANSMITTED];
 		for (int i = 0; i < MAX_BACKGROUND_LAYERS_TRANSMITTED; i++)
+			layerOffsets[i] = shownFrame.LayerOffsets[i];
+
+		// Slide the background layers toward where they are in the next frame, so they scroll smoothly between frames
+		BufferedFrame &nextFrame = m_FrameBuffer[(m_OldestFrame + 1) % JITTER_BUFFER_FRAMES];
+		if (m_FrameCount > 1 && nextFrame.HasSetup && m_NextShowTime > m_LastShowTime)
+		{
+			float progress = (float)(currentTicks - m_LastShowTime) / (float)(m_NextShowTime - m_LastShowTime);
+			progress = std::max(0.0f, std::min(progress, 1.0f));
+
+			for (int i = 0; i < m_ActiveBackgroundLayers; i++)
+			{
+				Vector step = nextFrame.LayerOffsets[i] - shownFrame.LayerOffsets[i];
+				// A layer that wrapped around jumps clear across, and shouldn't be swept over the whole screen on the way
+				if (fabs(step.m_X) < m_SceneWidth / 2 && fabs(step.m_Y) < m_SceneHeight / 2)
+					layerOffsets[i] += step * progress;
+			}
+		}
+
+		// Only bother compositing again if the frame changed or a layer moved by at least a pixel
+		bool redraw = m_RedrawFrame;
+		for (int i = 0; i < m_ActiveBackgroundLayers && !redraw; i++)
+		{
+			const LightweightSceneLayer &layer = m_aBackgroundLayers[m_CurrentFrame][i];
+			redraw = floorf(layerOffsets[i].m_X * layer.ScrollRatioX) != floorf(m_DrawnLayerOffsets[i].m_X * layer.ScrollRatioX) ||
+				floorf(layerOffsets[i].m_Y * layer.ScrollRatioY) != floorf(m_DrawnLayerOffsets[i].m_Y * layer.ScrollRatioY);
+		}
+
+		if (redraw)
+		{
+			DrawFrame(shownFrame, layerOffsets);
+			for (int i = 0; i < MAX_BACKGROUND_LAYERS_TRANSMITTED; i++)
+				m_DrawnLayerOffsets[i] = layerOffsets[i];
+			m_RedrawFrame = false;
+		}
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          ClearFrameBuffer
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Throws away all the buffered frames.
+
+	void NetworkClient::ClearFrameBuffer(bool destroyBitmaps)
+	{
+		// Anything still waiting to be unpacked belongs to the frames being thrown away
+		m_FrameBoxJobCount = 0;
+
+		for (int f = 0; f < JITTER_BUFFER_FRAMES; f++)
 		{
-			m_aBackgroundLayers[m_CurrentFrame][i].OffsetX = frameData->OffsetX[i];
-			m_aBackgroundLayers[m_CurrentFrame][i].OffsetY = frameData->OffsetY[i];
+			if (destroyBitmaps)
+			{
+				if (m_FrameBuffer[f].pBitmap)
+					destroy_bitmap(m_FrameBuffer[f].pBitmap);
+				if (m_FrameBuffer[f].pGUIBitmap)
+					destroy_bitmap(m_FrameBuffer[f].pGUIBitmap);
+				m_FrameBuffer[f].pBitmap = 0;
+				m_FrameBuffer[f].pGUIBitmap = 0;
+			}
+			m_FrameBuffer[f].FrameNumber = -1;
+			m_FrameBuffer[f].HasSetup = false;
+			m_FrameBuffer[f].Complete = false;
+			m_FrameBuffer[f].ArrivalTime = 0;
+			m_FrameBuffer[f].PostEffects.clear();
 		}
+
+		m_OldestFrame = 0;
+		m_FrameCount = 0;
+		m_ShowingFrame = false;
+		m_FrameIntervalMS = 0;
+		m_ArrivalJitterMS = 0;
+		m_LastShowTime = 0;
+		m_NextShowTime = 0;
+		m_RedrawFrame = true;
+		for (int i = 0; i < MAX_BACKGROUND_LAYERS_TRANSMITTED; i++)
+			m_DrawnLayerOffsets[i].Reset();
 	}
 
 	void NetworkClient::ReceiveSceneSetupMsg(RakNet::Packet * p)
 	{
+		// Frames of the old scene are of no use anymore
+		ClearFrameBuffer();
+
 		clear_to_color(g_FrameMan.GetNetworkBackBufferIntermediateGUI8Ready(0), g_KeyColor);
 		clear_to_color(g_FrameMan.GetNetworkBackBufferGUI8Ready(0), g_KeyColor);
 
@@ -1323,6 +2020,10 @@ namespace RTE
 			}
 		}
 
+		// Get whatever boxes came in this update onto the bitmaps, even if the frame isn't complete yet
+		DecodeFrameBoxes();
+		UpdatePlayout();
+
 		// Draw level loading animation
 		if (m_CurrentSceneLayerReceived != -1)
 		{
@@ -18,15 +18,24 @@
 #include "Sound.h"
 
 #include <map>
+#include <vector>
 
 #include "Network.h"
 #include "NatPunchthroughClient.h"
+#include "BitStream.h"
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Inclusions of header files
 
 #define g_NetworkClient NetworkClient::Instance()
 
+// How many of the latest input states each input message carries, so it can be sent unreliably and still survive a few lost packets
+#define INPUT_STATES_PER_MSG 4
+// How many frames the jitter buffer holds, counting the one on screen and the one still being received
+#define JITTER_BUFFER_FRAMES 8
+// How many deviations of frame arrival jitter the adaptive playout delay adds on top of the configured one
+#define JITTER_DEVIATIONS 2.0f
+
 namespace RTE
 {
 	//////////////////////////////////////////////////////////////////////////////////////////
@@ -123,6 +132,7 @@ namespace RTE
 
 		bool IsConnectedAndRegistred() { return m_IsConnected && m_IsRegistered; }
 
+		// One input state sampled by the client. Goes over the wire bit-packed by WriteInputState, not as is
 		struct MsgInput
 		{
 			unsigned char Id;
@@ -142,11 +152,92 @@ namespace RTE
 
 		};
 
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Static method:   WriteInputState
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Bit-packs an input state into a stream. Held elements are written as
+		//                  the ones that changed since the base state, and everything that didn't
+		//                  happen at all costs a single bit.
+		// Arguments:       The stream to write to.
+		//                  The state to write.
+		//                  The state the reader will have decoded right before this one, or 0 if
+		//                  this is the first state in the message.
+		// Return value:    None.
+
+		static void WriteInputState(RakNet::BitStream &stream, const MsgInput &state, const MsgInput *pBase);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Static method:   ReadInputState
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Reads back an input state written by WriteInputState.
+		// Arguments:       The stream to read from.
+		//                  The state to read into.
+		//                  The state decoded right before this one, or 0 if this is the first
+		//                  state in the message.
+		// Return value:    Whether the stream held a whole state.
+
+		static bool ReadInputState(RakNet::BitStream &stream, MsgInput &state, const MsgInput *pBase);
+
 		//////////////////////////////////////////////////////////////////////////////////////////
 		// Protected member variable and method declarations
 
 	protected:
 
+		// A received frame box waiting to be unpacked into its bitmap by the worker threads
+		struct FrameBoxJob
+		{
+			BITMAP *pBitmap;
+			int X;
+			int Y;
+			int Width;
+			int Height;
+			// Size of Data, or 0 if the box is just to be cleared to the key color
+			int DataSize;
+			int UncompressedSize;
+			// Whether to outline the box for debugging
+			bool Outline;
+			// The box pixels as they came in the message, compressed unless DataSize == UncompressedSize
+			std::vector<unsigned char> Data;
+		};
+
+		// A frame received from the server, waiting to be shown or on screen
+		struct BufferedFrame
+		{
+			// The number the server gave this frame; they wrap around at FRAME_NUMBER_WRAP
+			int FrameNumber;
+			// Whether the frame setup message for this has come in yet
+			bool HasSetup;
+			// Whether the server has moved on to the next frame, so this won't change anymore
+			bool Complete;
+			// When the first message of this frame came in, in real ticks
+			int64_t ArrivalTime;
+			// The received frame and GUI layers. Owned
+			BITMAP *pBitmap;
+			BITMAP *pGUIBitmap;
+			Vector TargetPos;
+			Vector LayerOffsets[MAX_BACKGROUND_LAYERS_TRANSMITTED];
+			std::list<PostEffect> PostEffects;
+		};
+
+		// One blit or solid fill that goes into compositing a frame, already clipped to both bitmaps
+		struct CompositeOp
+		{
+			// 0 for a solid fill
+			BITMAP *pSource;
+			BITMAP *pTarget;
+			int SourceX;
+			int SourceY;
+			int TargetX;
+			int TargetY;
+			int Width;
+			int Height;
+			// Whether key color pixels of the source are skipped
+			bool Masked;
+			unsigned char FillColor;
+		};
+
 
 		// Member variables
 		static const std::string m_ClassName;
@@ -192,6 +283,30 @@ namespace RTE
 
 		void ReceiveFrameBoxMsg(RakNet::Packet * p);
 
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          DecodeFrameBoxes
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Unpacks all the queued frame boxes into their bitmaps, spread across
+		//                  the worker threads. Blocks until they're all done.
+		// Arguments:       None.
+		// Return value:    None.
+
+		void DecodeFrameBoxes();
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Static method:   DecodeFrameBox
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Unpacks one frame box straight into the lines of its bitmap. Safe to
+		//                  run for several boxes at once as long as they don't overlap.
+		// Arguments:       The box to unpack.
+		//                  A buffer of MAX_PIXEL_LINE_BUFFER_SIZE bytes to decompress into,
+		//                  which no other thread is using.
+		// Return value:    None.
+
+		static void DecodeFrameBox(const FrameBoxJob &job, unsigned char *pBuffer);
+
 		void ReceiveSceneMsg(RakNet::Packet * p);
 
 		void ReceiveAcceptedMsg();
@@ -206,9 +321,116 @@ namespace RTE
 
 		void ReceiveSceneEndMsg();
 
-		void DrawBackgrounds(BITMAP * pTargetBitmap);
+		void DrawBackgrounds(BITMAP * pTargetBitmap, const Vector *pLayerOffsets);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          AddCompositeBlit
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Adds a blit to the ops that composite the current frame, clipped the
+		//                  same way Allegro's blit and masked_blit clip, including to the current
+		//                  clip rect of the target. Both bitmaps have to be 8 bit memory bitmaps.
+		// Arguments:       The bitmap to blit from and the one to blit to.
+		//                  The source and target coordinates and size, as for blit.
+		//                  Whether to skip the key color pixels like masked_blit.
+		// Return value:    None.
+
+		void AddCompositeBlit(BITMAP *pSource, BITMAP *pTarget, int sourceX, int sourceY, int targetX, int targetY, int width, int height, bool masked);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          AddCompositeFill
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Adds a solid fill to the ops that composite the current frame,
+		//                  clipped the same way Allegro's rectfill clips.
+		// Arguments:       The 8 bit memory bitmap to fill on.
+		//                  The inclusive corners of the rectangle, as for rectfill.
+		//                  The color to fill with.
+		// Return value:    None.
+
+		void AddCompositeFill(BITMAP *pTarget, int x1, int y1, int x2, int y2, unsigned char color);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          RunCompositeOps
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Carries out all the composite ops in order, but only on a band of rows
+		//                  of their targets, so bands can be drawn by different threads.
+		// Arguments:       The first row of the band and the one past its last.
+		// Return value:    None.
+
+		void RunCompositeOps(int top, int bottom);
+
+		void DrawFrame(BufferedFrame &frame, const Vector *pLayerOffsets);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          GetBufferedFrame
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Finds the buffered frame a message with a frame number belongs to,
+		//                  starting a new one if the server has moved on to the next frame.
+		// Arguments:       The frame number of the message.
+		// Return value:    The frame the message belongs to, or 0 if it's for one that is
+		//                  already on screen or older than any buffered, or the frame number
+		//                  is out of range.
 
-		void DrawFrame();
+		BufferedFrame * GetBufferedFrame(int frameNumber);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          StartBufferedFrame
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Completes the newest buffered frame and starts receiving a new one
+		//                  on top of a copy of it, so boxes that aren't resent carry over.
+		// Arguments:       The frame number of the new frame.
+		// Return value:    The new frame.
+
+		BufferedFrame * StartBufferedFrame(int frameNumber);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          ShowNextFrame
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Retires the frame on screen, if any, and makes the oldest buffered
+		//                  one the one on screen.
+		// Arguments:       None.
+		// Return value:    None.
+
+		void ShowNextFrame();
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          UpdatePlayout
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Puts up the next buffered frame when it's due, pacing them so the
+		//                  buffer stays around the target playout delay, and redraws the one
+		//                  on screen when its interpolated background layers move.
+		// Arguments:       None.
+		// Return value:    None.
+
+		void UpdatePlayout();
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          GetTargetBufferedFrames
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Works out how many complete frames should wait in the jitter buffer
+		//                  behind the one on screen, from the configured playout delay and the
+		//                  measured arrival jitter.
+		// Arguments:       None.
+		// Return value:    The target number of waiting frames.
+
+		int GetTargetBufferedFrames() const;
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          ClearFrameBuffer
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Throws away all the buffered frames, keeping their bitmaps around.
+		// Arguments:       Whether to destroy the bitmaps too.
+		// Return value:    None.
+
+		void ClearFrameBuffer(bool destroyBitmaps = false);
 
 		void SendServerGuidRequest(RakNet::SystemAddress addr, std::string serverName, std::string serverPassword);
 
@@ -220,15 +442,29 @@ namespace RTE
 
 		void ReceiveMusicEventsMsg(RakNet::Packet * p);
 
-		void DrawPostEffects(int frame);
+		void DrawPostEffects(std::list<PostEffect> &postEffects);
 
 		unsigned int GetPing();
 
 
 		int64_t m_LastInputSentTime;
 
+		// The last few input states sent, oldest first, all of which go into every input message
+		MsgInput m_InputHistory[INPUT_STATES_PER_MSG];
+		int m_InputHistoryCount;
+		// Sequence number of the newest input state sent
+		unsigned short m_InputSequence;
+
 		unsigned char m_aPixelLineBuffer[MAX_PIXEL_LINE_BUFFER_SIZE];
 
+		// Frame boxes received but not yet unpacked. Only the first m_FrameBoxJobCount are live; the rest are kept to reuse their data buffers
+		std::vector<FrameBoxJob> m_FrameBoxJobs;
+		int m_FrameBoxJobCount;
+		// A decompression buffer for each thread that unpacks frame boxes
+		std::vector<std::vector<unsigned char> > m_DecodeBuffers;
+		// The blits and fills that make up the frame being drawn, in drawing order
+		std::vector<CompositeOp> m_CompositeOps;
+
 		long int m_ReceivedData;
 
 		long int m_CompressedData;
@@ -249,8 +485,26 @@ namespace RTE
 
 		int m_CurrentFrame;
 
-		Vector m_TargetPos[FRAMES_TO_REMEMBER];
-		std::list<PostEffect> m_PostEffects[FRAMES_TO_REMEMBER];
+		// The jitter buffer. m_FrameCount frames are in use starting at m_OldestFrame, in arrival order
+		BufferedFrame m_FrameBuffer[JITTER_BUFFER_FRAMES];
+		int m_OldestFrame;
+		int m_FrameCount;
+		// Whether the oldest buffered frame is the one on screen
+		bool m_ShowingFrame;
+		// Smoothed time between frame arrivals, and the smoothed deviation from it, in ms
+		float m_FrameIntervalMS;
+		float m_ArrivalJitterMS;
+		// When the frame on screen went up and when the next one is due, in real ticks
+		int64_t m_LastShowTime;
+		int64_t m_NextShowTime;
+		// Whether the frame on screen has to be drawn again regardless of how its background layers moved
+		bool m_RedrawFrame;
+		// The background layer offsets the frame on screen was last drawn with
+		Vector m_DrawnLayerOffsets[MAX_BACKGROUND_LAYERS_TRANSMITTED];
+		// How long to hold frames back before showing them, at the least, in ms
+		int m_PlayoutDelayMS;
+		// Whether to hold them back longer when they arrive unevenly
+		bool m_AdaptivePlayout;
 
 		// List of sounds received from server. OWNED!!!
 		std::map<short int, Sound *> m_Sounds;
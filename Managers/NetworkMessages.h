@@ -6,6 +6,8 @@ namespace RTE
 #define MAX_PIXEL_LINE_BUFFER_SIZE 8192
 #define MAX_BACKGROUND_LAYERS_TRANSMITTED 10
 #define FRAMES_TO_REMEMBER 3
+// Frame numbers count up to this and start over. Way more than the client ever buffers, so it can tell late messages from new frames
+#define FRAME_NUMBER_WRAP 256
 
 #define MAX_CLIENTS 4
 
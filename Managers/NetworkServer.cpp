@@ -178,6 +178,9 @@ namespace RTE
 		m_FastAccelerationFactor = 1;
 		m_UseInterlacing = false;
 		m_EncodingFps = 30;
+		m_AdaptiveBitrate = true;
+		m_MinEncodingFps = 10;
+		m_MaxHighCompressionLevel = LZ4HC_CLEVEL_MAX;
 		m_ShowInput = false;
 		m_ShowStats = false;
 		m_TransmitAsBoxes = true;
@@ -185,6 +188,9 @@ namespace RTE
 		m_BoxHeight = 44;
 		m_NatServerConnected = false;
 		m_LastPackedReceived.Reset();
+
+		for (int i = 0; i < MAX_CLIENTS; i++)
+			ResetStreamQuality(i);
 	}
 
 	//////////////////////////////////////////////////////////////////////////////////////////
@@ -220,6 +226,13 @@ namespace RTE
 		m_BoxWidth = g_SettingsMan.GetServerBoxWidth();
 		m_BoxHeight = g_SettingsMan.GetServerBoxHeight();
 
+		m_AdaptiveBitrate = g_SettingsMan.GetServerAdaptiveBitrate();
+		m_MaxHighCompressionLevel = std::max(m_HighCompressionLevel, std::min(g_SettingsMan.GetServerMaxHighCompressionLevel(), LZ4HC_CLEVEL_MAX));
+		m_MinEncodingFps = std::max(1, std::min(g_SettingsMan.GetServerMinEncodingFps(), m_EncodingFps));
+
+		for (int i = 0; i < MAX_CLIENTS; i++)
+			ResetStreamQuality(i);
+
 		return 0;
 	}
 
@@ -255,6 +268,135 @@ namespace RTE
 		}
 	}
 
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          ResetStreamQuality
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Puts a client's stream back to full quality and forgets everything the
+	//                  adaptive bitrate controller measured about its connection.
+
+	void NetworkServer::ResetStreamQuality(int player)
+	{
+		StreamQuality &quality = m_StreamQuality[player];
+
+		quality.Step = 0;
+		quality.HighCompressionLevel = m_HighCompressionLevel;
+		quality.FastAccelerationFactor = m_FastAccelerationFactor;
+		quality.SmoothedRTT = 0;
+		quality.BaseRTT = 0;
+		quality.PacketLoss = 0;
+		quality.EncodeTime = 0;
+		quality.LastCongestionTime = 0;
+		quality.LastStepTime = 0;
+		quality.LastCompressionTime = 0;
+
+		ApplyStreamQualityStep(player);
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          ApplyStreamQualityStep
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Works out the frame rate, interlacing and box size of a client's
+	//                  stream from how many steps down from full quality it is.
+
+	void NetworkServer::ApplyStreamQualityStep(int player)
+	{
+		StreamQuality &quality = m_StreamQuality[player];
+
+		// The first step halves the boxes or lines sent each frame, which the client covers up with the ones from the frame before
+		quality.UseInterlacing = quality.Step >= 1;
+
+		// Then wider boxes, which cost fewer message headers and compress better, as long as one still fits in a message
+		quality.BoxWidth = m_BoxWidth;
+		quality.BoxHeight = m_BoxHeight;
+		if (quality.Step >= 2 && m_BoxWidth * 2 * m_BoxHeight + (int)sizeof(RTE::MsgFrameBox) <= MAX_PIXEL_LINE_BUFFER_SIZE)
+			quality.BoxWidth = m_BoxWidth * 2;
+
+		// And the rest of the steps take the frame rate evenly down to the lowest allowed
+		int fpsSteps = std::max(0, quality.Step - 2);
+		quality.EncodingFps = m_EncodingFps - (m_EncodingFps - m_MinEncodingFps) * fpsSteps / (ADAPTIVE_QUALITY_STEPS - 2);
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:          UpdateStreamQuality
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:     Feeds the latest connection statistics of a client to the adaptive
+	//                  bitrate controller.
+
+	void NetworkServer::UpdateStreamQuality(int player, const RakNet::RakNetStatistics &rns)
+	{
+		StreamQuality &quality = m_StreamQuality[player];
+		int64_t currentTicks = g_TimerMan.GetRealTickCount();
+		int64_t ticksPerMS = g_TimerMan.GetTicksPerSecond() / 1000;
+
+		int ping = m_Server->GetAveragePing(m_ClientConnections[player].ClientId);
+		if (ping >= 0)
+		{
+			if (quality.SmoothedRTT <= 0)
+				quality.SmoothedRTT = quality.BaseRTT = (float)ping;
+			else
+				quality.SmoothedRTT += ((float)ping - quality.SmoothedRTT) / 8.0f;
+
+			// The lowest round trip seen is the one without any queueing, let it creep up slowly in case the route changed
+			if (quality.SmoothedRTT < quality.BaseRTT)
+				quality.BaseRTT = quality.SmoothedRTT;
+			else
+				quality.BaseRTT += (quality.SmoothedRTT - quality.BaseRTT) / 256.0f;
+		}
+		quality.PacketLoss += (rns.packetlossLastSecond - quality.PacketLoss) / 8.0f;
+
+		// Any of frames piling up in the send buffer, packets getting lost or round trips getting much longer than usual
+		// means more is being sent than the connection can take
+		bool congested = rns.isLimitedByCongestionControl ||
+			rns.messageInSendBuffer[MEDIUM_PRIORITY] > ADAPTIVE_SEND_BUFFER_MESSAGES ||
+			quality.PacketLoss > ADAPTIVE_PACKET_LOSS ||
+			(quality.BaseRTT > 0 && quality.SmoothedRTT > quality.BaseRTT * 2 + 50);
+
+		if (congested)
+		{
+			quality.LastCongestionTime = currentTicks;
+			if (quality.Step < ADAPTIVE_QUALITY_STEPS && currentTicks - quality.LastStepTime > ADAPTIVE_STEP_DOWN_MS * ticksPerMS)
+			{
+				quality.Step++;
+				quality.LastStepTime = currentTicks;
+				ApplyStreamQualityStep(player);
+			}
+		}
+		else if (quality.Step > 0 && currentTicks - quality.LastCongestionTime > ADAPTIVE_STEP_UP_MS * ticksPerMS && currentTicks - quality.LastStepTime > ADAPTIVE_STEP_UP_MS * ticksPerMS)
+		{
+			quality.Step--;
+			quality.LastStepTime = currentTicks;
+			ApplyStreamQualityStep(player);
+		}
+
+		if (currentTicks - quality.LastCompressionTime < ADAPTIVE_COMPRESSION_MS * ticksPerMS)
+			return;
+
+		// Compress harder while the stream is stepped down and there's time to spare in the frame, and go easier when
+		// encoding takes up too much of it, so a slow client doesn't hold up its own frames either
+		float frameTime = 1000.0f / (float)quality.EncodingFps;
+		bool harderThanConfigured = m_UseHighCompression ? quality.HighCompressionLevel > m_HighCompressionLevel : quality.FastAccelerationFactor < m_FastAccelerationFactor;
+		bool easierThanConfigured = m_UseHighCompression ? quality.HighCompressionLevel < m_HighCompressionLevel : quality.FastAccelerationFactor > m_FastAccelerationFactor;
+		int change = 0;
+		if (quality.EncodeTime > frameTime * 0.5f)
+			change = -1;
+		else if (quality.EncodeTime < frameTime * 0.25f && (quality.Step > 0 || easierThanConfigured))
+			change = 1;
+		// Back to the configured compression once the connection has recovered
+		else if (quality.Step == 0 && harderThanConfigured)
+			change = -1;
+
+		if (change == 0)
+			return;
+
+		if (m_UseHighCompression)
+			quality.HighCompressionLevel = std::max(LZ4HC_CLEVEL_MIN, std::min(quality.HighCompressionLevel + change, m_MaxHighCompressionLevel));
+		else if (m_UseFastCompression)
+			quality.FastAccelerationFactor = std::max(1, std::min(quality.FastAccelerationFactor - change, m_FastAccelerationFactor * 4));
+		quality.LastCompressionTime = currentTicks;
+	}
+
 	//////////////////////////////////////////////////////////////////////////////////////////
 	// Method:          Destroy
 	//////////////////////////////////////////////////////////////////////////////////////////
@@ -479,11 +621,23 @@ namespace RTE
 			// Process input messages
 			for (int p = 0; p < MAX_CLIENTS; p++)
 			{
-				if (!m_InputMessages[p].empty())
+				if (m_HasPendingInput[p])
 				{
-					NetworkClient::MsgInput msg = m_InputMessages[p].front();
-					m_InputMessages[p].pop();
-					ProcessInputMessage(p, msg);
+					ProcessInputMessage(p, m_PendingInput[p]);
+
+					// Held states carry on until the client says otherwise, the rest has been used up
+					NetworkClient::MsgInput &pending = m_PendingInput[p];
+					pending.MouseX = 0;
+					pending.MouseY = 0;
+					pending.MouseWheelMoved = 0;
+					pending.InputElementPressed = 0;
+					pending.InputElementReleased = 0;
+					for (int i = 0; i < UInputMan::MAX_MOUSE_BUTTONS; i++)
+					{
+						pending.MouseButtonPressed[i] = false;
+						pending.MouseButtonReleased[i] = false;
+					}
+					m_HasPendingInput[p] = false;
 				}
 			}
 
@@ -690,9 +844,12 @@ namespace RTE
 
 				if (i < MAX_CLIENTS)
 				{
-					int lines = 2;
-					sprintf(buf, "Thread: %d\nBuffer: %d / %d",
-						m_ThreadExitReason[i], m_SendBufferMessages[i], m_SendBufferBytes[i] / 1024);
+					int lines = 4;
+					const StreamQuality &quality = m_StreamQuality[i];
+					sprintf(buf, "Thread: %d\nBuffer: %d / %d\nStep: %d  Fps: %d%s\nCmp: %d  Box: %dx%d",
+						m_ThreadExitReason[i], m_SendBufferMessages[i], m_SendBufferBytes[i] / 1024,
+						quality.Step, quality.EncodingFps, m_UseInterlacing || quality.UseInterlacing ? "  Int" : "",
+						m_UseHighCompression ? quality.HighCompressionLevel : quality.FastAccelerationFactor, quality.BoxWidth, quality.BoxHeight);
 					g_FrameMan.GetLargeFont()->DrawAligned(&pGUIBitmap, 10 + i * g_FrameMan.GetResX() / 5, g_FrameMan.GetResY() - lines * 15, buf, GUIFont::Left);
 				}
 		}
@@ -1225,6 +1382,9 @@ namespace RTE
 		msg->FrameNumber = m_FrameNumbers[player];
 		msg->SoundEventsCount = 0;
 
+		// AudioMan merges each frame's one-shots before they get here, so this normally all fits in the one message
+		const int maxEventsPerMsg = (MAX_PIXEL_LINE_BUFFER_SIZE - sizeof(MsgSoundEvents)) / sizeof(AudioMan::SoundNetworkData);
+
 		for (std::list<AudioMan::SoundNetworkData>::iterator eItr = events.begin(); eItr != events.end(); ++eItr)
 		{
 			sndDataPtr->State = (*eItr).State;
@@ -1238,7 +1398,7 @@ namespace RTE
 			msg->SoundEventsCount++;
 			sndDataPtr++;
 
-			if (msg->SoundEventsCount >= 50)
+			if (msg->SoundEventsCount >= maxEventsPerMsg)
 			{
 				//char buf[128];
 				//sprintf(buf, "%d %d", msg->FrameNumber, msg->PostEffectsCount);
@@ -1379,7 +1539,8 @@ namespace RTE
 	{
 		// Calc timing stuff
 		int64_t currentTicks = g_TimerMan.GetRealTickCount();
-		double fps = (double)m_EncodingFps;
+		StreamQuality &quality = m_StreamQuality[player];
+		double fps = (double)quality.EncodingFps;
 		double secsPerFrame = 1.0 / fps;
 		double secsSinceLastFrame = (double)(currentTicks - m_LastFrameSentTime[player]) / g_TimerMan.GetTicksPerSecond();
 
@@ -1416,6 +1577,9 @@ namespace RTE
 		m_SendBufferBytes[player] = (int)rns.bytesInSendBuffer[MEDIUM_PRIORITY] + (int)rns.bytesInSendBuffer[HIGH_PRIORITY];
 		m_SendBufferMessages[player] = (int)rns.messageInSendBuffer[MEDIUM_PRIORITY] + (int)rns.messageInSendBuffer[HIGH_PRIORITY];
 
+		if (m_AdaptiveBitrate)
+			UpdateStreamQuality(player, rns);
+
 		if (rns.isLimitedByCongestionControl)
 		{
 			SetThreadExitReason(player, NetworkServer::SEND_BUFFER_IS_LIMITED_BY_CONGESTION);
@@ -1453,7 +1617,7 @@ namespace RTE
 		}
 
 		m_FrameNumbers[player]++;
-		if (m_FrameNumbers[player] >= FRAMES_TO_REMEMBER)
+		if (m_FrameNumbers[player] >= FRAME_NUMBER_WRAP)
 			m_FrameNumbers[player] = 0;
 
 		// Save a copy of buffer to avoid tearing when the original is updated by frame man
@@ -1468,8 +1632,11 @@ namespace RTE
 		m_FramesSent[player]++;
 
 		// Compression section
-		int compressionMethod = m_HighCompressionLevel;
-		int accelerationFactor = m_FastAccelerationFactor;
+		int compressionMethod = quality.HighCompressionLevel;
+		int accelerationFactor = quality.FastAccelerationFactor;
+		bool useInterlacing = m_UseInterlacing || quality.UseInterlacing;
+		int boxWidth = quality.BoxWidth;
+		int boxHeight = quality.BoxHeight;
 
 		m_SendEven[player] = !m_SendEven[player];
 
@@ -1480,18 +1647,16 @@ namespace RTE
 
 			// Save msg ID
 			frameData->Id = ID_SRV_FRAME_BOX;
-			frameData->BoxWidth = m_BoxWidth;
-			frameData->BoxHeight = m_BoxHeight;
 
-			int bw = m_pBackBuffer8[player]->w / m_BoxWidth;
-			int bh = m_pBackBuffer8[player]->h / m_BoxHeight;
+			int bw = m_pBackBuffer8[player]->w / boxWidth;
+			int bh = m_pBackBuffer8[player]->h / boxHeight;
 
 			for (int by = 0; by <= bh; by++)
 			{
 				int step = 1;
 				int startLine = 0;
 
-				if (m_UseInterlacing)
+				if (useInterlacing)
 				{
 					step = 2;
 					if (m_SendEven[player])
@@ -1502,8 +1667,8 @@ namespace RTE
 
 				for (int bx = startLine; bx <= bw; bx += step)
 				{
-					int bpx = bx * m_BoxWidth;
-					int bpy = by * m_BoxHeight;
+					int bpx = bx * boxWidth;
+					int bpy = by * boxHeight;
 
 					if (bpx >= m_pBackBuffer8[player]->w || bpy >= m_pBackBuffer8[player]->h)
 						break;
@@ -1511,19 +1676,16 @@ namespace RTE
 					frameData->BoxX = bpx;
 					frameData->BoxY = bpy;
 
-					int maxWidth = m_BoxWidth;
-					if (bpx + m_BoxWidth >= m_pBackBuffer8[player]->w)
-					{
+					// The box size can change from frame to frame, and the boxes along the edges are cut short, so every box carries its own
+					int maxWidth = boxWidth;
+					if (bpx + boxWidth >= m_pBackBuffer8[player]->w)
 						maxWidth = m_pBackBuffer8[player]->w - bpx;
-						frameData->BoxWidth = maxWidth;
-					}
+					frameData->BoxWidth = maxWidth;
 
-					int maxHeight = m_BoxHeight;
-					if (bpy + m_BoxHeight >= m_pBackBuffer8[player]->h)
-					{
+					int maxHeight = boxHeight;
+					if (bpy + boxHeight >= m_pBackBuffer8[player]->h)
 						maxHeight = m_pBackBuffer8[player]->h - bpy;
-						frameData->BoxHeight = maxHeight;
-					}
+					frameData->BoxHeight = maxHeight;
 
 					int size = maxWidth * maxHeight;
 					frameData->UncompressedSize = size;
@@ -1637,7 +1799,7 @@ namespace RTE
 			int startLine = 0;
 			int step = 1;
 
-			if (m_UseInterlacing)
+			if (useInterlacing)
 			{
 				step = 2;
 				m_SendEven[player] = !m_SendEven[player];
@@ -1749,6 +1911,7 @@ namespace RTE
 
 		double secsSinceSendStart = (double)(g_TimerMan.GetRealTickCount() - currentTicks) / g_TimerMan.GetTicksPerSecond();
 		m_MsecPerSendCall[player] = secsSinceSendStart * 1000;
+		quality.EncodeTime += ((float)secsSinceSendStart * 1000.0f - quality.EncodeTime) / 8.0f;
 
 		SetThreadExitReason(player, NetworkServer::NORMAL);
 		return 0;
@@ -1774,6 +1937,8 @@ namespace RTE
 				m_SendSceneSetupData[index] = true;
 				m_SendSceneData[index] = false;
 				m_SendFrameData[index] = false;
+
+				ClearInputMessages(index);
 			}
 		}
 	}
@@ -1856,12 +2021,15 @@ namespace RTE
 
 				m_Server->SetTimeoutTime(5000, m_ClientConnections[index].ClientId);
 
+				ResetStreamQuality(index);
 				m_ClientConnections[index].pSendThread = new boost::thread(BackgroundSendThreadFunction, this, index);
 				SendAcceptedMsg(index);
 
 				m_SendSceneSetupData[index] = true;
 				m_SendSceneData[index] = false;
 				m_SendFrameData[index] = false;
+
+				ClearInputMessages(index);
 			}
 		}
 
@@ -1884,8 +2052,9 @@ namespace RTE
 	{
 		if (player >= 0 && player < MAX_CLIENTS)
 		{
-			while (!m_InputMessages[player].empty())
-				m_InputMessages[player].pop();
+			m_HasPendingInput[player] = false;
+			m_InputSequenceValid[player] = false;
+			m_LastInputSequence[player] = 0;
 		}
 	}
 
@@ -1946,11 +2115,35 @@ namespace RTE
 		}
 	}
 
-	void NetworkServer::ReceiveInputMsg(RakNet::Packet * p)
+	void NetworkServer::MergeInputState(int player, const NetworkClient::MsgInput &state)
 	{
-		NetworkClient::MsgInput * m = (NetworkClient::MsgInput *)p->data;
-		//char buf[256];
+		NetworkClient::MsgInput &pending = m_PendingInput[player];
+
+		if (!m_HasPendingInput[player])
+		{
+			pending = state;
+			m_HasPendingInput[player] = true;
+			return;
+		}
+
+		// The newest held states win, but nothing that happened in between may get lost
+		pending.InputElementHeld = state.InputElementHeld;
+		pending.InputElementPressed |= state.InputElementPressed;
+		pending.InputElementReleased |= state.InputElementReleased;
+		for (int i = 0; i < UInputMan::MAX_MOUSE_BUTTONS; i++)
+		{
+			pending.MouseButtonHeld[i] = state.MouseButtonHeld[i];
+			pending.MouseButtonPressed[i] = pending.MouseButtonPressed[i] || state.MouseButtonPressed[i];
+			pending.MouseButtonReleased[i] = pending.MouseButtonReleased[i] || state.MouseButtonReleased[i];
+		}
+		pending.MouseX += state.MouseX;
+		pending.MouseY += state.MouseY;
+		pending.MouseWheelMoved += state.MouseWheelMoved;
+		pending.ResetActivityVote = state.ResetActivityVote;
+	}
 
+	void NetworkServer::ReceiveInputMsg(RakNet::Packet * p)
+	{
 		int player = -1;
 
 		for (int index = 0; index < MAX_CLIENTS; index++)
@@ -1959,57 +2152,34 @@ namespace RTE
 
 		if (player >= 0 && player < MAX_CLIENTS)
 		{
-			// Copy message data
-			NetworkClient::MsgInput msg;
+			RakNet::BitStream stream(p->data, p->length, false);
+			unsigned char id = 0;
+			unsigned short sequence = 0;
+			unsigned char stateCount = 0;
 
-			msg.Id = m->Id;
+			if (!stream.Read(id) || !stream.Read(sequence) || !stream.Read(stateCount) || stateCount > INPUT_STATES_PER_MSG)
+				return;
 
-			msg.MouseX = m->MouseX;
-			msg.MouseY = m->MouseY;
-			for (int i = 0; i < UInputMan::MAX_MOUSE_BUTTONS; i++)
+			// States are oldest first, each packed against the one before it, so all of them have to be decoded
+			NetworkClient::MsgInput states[INPUT_STATES_PER_MSG];
+			for (int i = 0; i < stateCount; i++)
 			{
-				msg.MouseButtonPressed[i] = m->MouseButtonPressed[i];
-				msg.MouseButtonReleased[i] = m->MouseButtonReleased[i];
-				msg.MouseButtonHeld[i] = m->MouseButtonHeld[i];
+				if (!NetworkClient::ReadInputState(stream, states[i], i > 0 ? &states[i - 1] : 0))
+					return;
 			}
-			msg.ResetActivityVote = m->ResetActivityVote;
-
-			msg.MouseWheelMoved = m->MouseWheelMoved;
 
-			msg.InputElementPressed = m->InputElementPressed;
-			msg.InputElementReleased = m->InputElementReleased;
-			msg.InputElementHeld = m->InputElementHeld;
-
-
-			bool skip = true;
-
-			if (!m_InputMessages[player].empty())
+			for (int i = 0; i < stateCount; i++)
 			{
-				NetworkClient::MsgInput lastmsg = m_InputMessages[player].back();
-
-				if (msg.MouseX != lastmsg.MouseX) skip = false;
-				if (msg.MouseY != lastmsg.MouseY) skip = false;;
-				for (int i = 0; i < UInputMan::MAX_MOUSE_BUTTONS; i++)
-				{
-					if (msg.MouseButtonPressed[i] != lastmsg.MouseButtonPressed[i]) skip = false;;
-					if (msg.MouseButtonReleased[i] != lastmsg.MouseButtonReleased[i]) skip = false;;
-					if (msg.MouseButtonHeld[i] != lastmsg.MouseButtonHeld[i]) skip = false;;
-				}
-				if (msg.ResetActivityVote != lastmsg.ResetActivityVote) skip = false;;
+				unsigned short stateSequence = sequence - (stateCount - 1 - i);
 
-				if (msg.MouseWheelMoved != lastmsg.MouseWheelMoved) skip = false;;
+				// Skip what arrived in an earlier message, allowing for the sequence wrapping around
+				if (m_InputSequenceValid[player] && (short)(stateSequence - m_LastInputSequence[player]) <= 0)
+					continue;
 
-				if (msg.InputElementPressed != lastmsg.InputElementPressed) skip = false;;
-				if (msg.InputElementReleased != lastmsg.InputElementReleased) skip = false;;
-				if (msg.InputElementHeld != lastmsg.InputElementHeld) skip = false;;
+				MergeInputState(player, states[i]);
+				m_LastInputSequence[player] = stateSequence;
+				m_InputSequenceValid[player] = true;
 			}
-			else 
-			{
-				skip = false;
-			}
-
-			if (!skip)
-				m_InputMessages[player].push(msg);
 		}
 	}
 
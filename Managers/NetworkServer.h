@@ -19,6 +19,7 @@
 #include "Network.h"
 #include "NetworkClient.h"
 #include "NatPunchthroughClient.h"
+#include "RakNetStatistics.h"
 
 #include "boost\thread.hpp"
 #include <mutex>
@@ -34,6 +35,19 @@
 #define STAT_CURRENT 0
 #define STAT_SHOWN 1
 
+// How many steps down from full quality the adaptive bitrate controller can take a client's stream
+#define ADAPTIVE_QUALITY_STEPS 5
+// How long a client's connection has to stay clear of congestion before its stream is stepped back up, in ms
+#define ADAPTIVE_STEP_UP_MS 3000
+// How long to wait after stepping a stream down before stepping it down again, so the last step gets a chance to show, in ms
+#define ADAPTIVE_STEP_DOWN_MS 500
+// How often the compression level may change, in ms
+#define ADAPTIVE_COMPRESSION_MS 1000
+// How many frame messages may wait in a client's send buffer before it counts as congested
+#define ADAPTIVE_SEND_BUFFER_MESSAGES 250
+// How much of the packets may be lost before a client's connection counts as congested
+#define ADAPTIVE_PACKET_LOSS 0.05f
+
 #define g_NetworkServer NetworkServer::Instance()
 
 namespace RTE
@@ -213,6 +227,8 @@ namespace RTE
 
 		void ProcessInputMessage(int player, NetworkClient::MsgInput msg);
 
+		void MergeInputState(int player, const NetworkClient::MsgInput &state);
+
 		RakNet::RakNetGUID GetServerGuid();
 
 		void DrawStatisticsData();
@@ -221,6 +237,42 @@ namespace RTE
 
 		void UpdateStats(int player);
 
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          ResetStreamQuality
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Puts a client's stream back to full quality and forgets everything the
+		//                  adaptive bitrate controller measured about its connection.
+		// Arguments:       The player whose stream to reset.
+		// Return value:    None.
+
+		void ResetStreamQuality(int player);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          UpdateStreamQuality
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Feeds the latest connection statistics of a client to the adaptive
+		//                  bitrate controller, which steps its stream down while the connection
+		//                  is congested and back up once it has been clear for a while, and
+		//                  picks a compression level that fits in the frame time.
+		// Arguments:       The player whose stream to update.
+		//                  The RakNet statistics of the player's connection.
+		// Return value:    None.
+
+		void UpdateStreamQuality(int player, const RakNet::RakNetStatistics &rns);
+
+
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Method:          ApplyStreamQualityStep
+		//////////////////////////////////////////////////////////////////////////////////////////
+		// Description:     Works out the frame rate, interlacing and box size of a client's
+		//                  stream from how many steps down from full quality it is.
+		// Arguments:       The player whose stream to update.
+		// Return value:    None.
+
+		void ApplyStreamQualityStep(int player);
+
 		void SendPostEffectData(int player);
 
 		void SendSoundData(int player);
@@ -250,6 +302,32 @@ namespace RTE
 
 		ClientConnection m_ClientConnections[MAX_CLIENTS];
 
+		// The stream settings the adaptive bitrate controller picked for a client, and what it measured to pick them
+		struct StreamQuality
+		{
+			// How many steps down from full quality the stream is, up to ADAPTIVE_QUALITY_STEPS
+			int Step;
+			int EncodingFps;
+			bool UseInterlacing;
+			int BoxWidth;
+			int BoxHeight;
+			int HighCompressionLevel;
+			int FastAccelerationFactor;
+			// Smoothed round trip time, and the lowest one seen which is taken to be the uncongested one, in ms
+			float SmoothedRTT;
+			float BaseRTT;
+			// Smoothed fraction of packets lost
+			float PacketLoss;
+			// Smoothed time taken to encode and send a frame, in ms
+			float EncodeTime;
+			// When the connection last looked congested, and when the stream last changed step and compression level, in real ticks
+			int64_t LastCongestionTime;
+			int64_t LastStepTime;
+			int64_t LastCompressionTime;
+		};
+
+		StreamQuality m_StreamQuality[MAX_CLIENTS];
+
 		// Member variables
 		static const std::string m_ClassName;
 
@@ -344,6 +422,11 @@ namespace RTE
 
 		int m_EncodingFps;
 
+		// Whether each client's stream adapts to its connection, and the bounds it adapts within
+		bool m_AdaptiveBitrate;
+		int m_MinEncodingFps;
+		int m_MaxHighCompressionLevel;
+
 		bool m_SendEven[MAX_CLIENTS];
 
 		bool m_ShowStats;
@@ -367,8 +450,12 @@ namespace RTE
 
 		std::mutex m_Mutex[MAX_CLIENTS];
 
-		//std::mutex m_InputQueueMutex[MAX_CLIENTS];
-		std::queue<NetworkClient::MsgInput>m_InputMessages[MAX_CLIENTS];
+		// Everything received from each client since its input was last applied: the newest held states, and all the presses, releases and mouse movement in between
+		NetworkClient::MsgInput m_PendingInput[MAX_CLIENTS];
+		bool m_HasPendingInput[MAX_CLIENTS];
+		// Sequence number of the newest input state received from each client, if any has been
+		unsigned short m_LastInputSequence[MAX_CLIENTS];
+		bool m_InputSequenceValid[MAX_CLIENTS];
 
 		float OffsetX[MAX_CLIENTS][MAX_BACKGROUND_LAYERS_TRANSMITTED];
 		float OffsetY[MAX_CLIENTS][MAX_BACKGROUND_LAYERS_TRANSMITTED];
@@ -21,5 +21,6 @@
 #include "ActivityMan.h"
 #include "MovableMan.h"
 #include "LuaMan.h"
+#include "ThreadMan.h"
 
 #endif // File
\ No newline at end of file
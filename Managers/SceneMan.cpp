@@ -28,6 +28,13 @@
 #include "MOPixel.h"
 #include "Atom.h"
 #include "Material.h"
+#include "ThreadMan.h"
+#include "VectorBatch.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 // Temp
 #include "Controller.h"
 
@@ -36,6 +43,7 @@ using std::string;
 using std::list;
 using std::pair;
 using std::map;
+using std::vector;
 
 #ifdef _WIN32
 #define fmax max
@@ -47,8 +55,17 @@ namespace RTE
 
 #define CLEANAIRINTERVAL 200000
 #define COMPACTINGHEIGHT 25
+// How many rays of a CastRays batch each worker takes at a time
+#define RAYBATCHSIZE 64
+// The size of the cells of the structural grid that terrain changes are tracked in, and how far around
+// a dirty cell to look for chunks that it may have cut loose
+#define STRUCTCELLSIZE 32
+#define STRUCTMARGIN 48
+// Unsupported chunks bigger than this stay where they are, there's no point in turning a whole hillside into particles
+#define STRUCTMAXDEBRIS 2048
 
 const std::string SceneMan::m_ClassName = "SceneMan";
+const char * const SceneMan::m_aRayTypeNames[RAY_TYPECOUNT] = { "Unseen", "Material", "NotMaterial", "StrengthSum", "MaxStrength", "Strength", "Weakness", "MO", "FindMO", "Obstacle" };
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -117,13 +134,24 @@ void SceneMan::Clear()
 
     m_pUnseenRevealSound = 0;
     m_LastUpdatedScreen = 0;
+    for (int i = 0; i < RAY_TYPECOUNT; ++i)
+    {
+        m_aRayCalls[i] = 0;
+        m_aRayPixels[i] = 0;
+        m_aLastRayCalls[i] = 0;
+        m_aLastRayPixels[i] = 0;
+    }
     m_SecondStructPass = false;
 //    m_CalcTimer.Reset();
     m_CleanTimer.Reset();
 
-	if (m_pOrphanSearchBitmap)
-		destroy_bitmap(m_pOrphanSearchBitmap);
-	m_pOrphanSearchBitmap = create_bitmap_ex(8, MAXORPHANRADIUS , MAXORPHANRADIUS);
+	memset(m_aOrphanSearchVisited, 0, sizeof(m_aOrphanSearchVisited));
+	m_OrphanSearchGeneration = 0;
+	m_OrphanSearchStack.clear();
+	m_OrphanRegion.clear();
+	m_OrphanDebris.clear();
+	ClearStructuralGrid();
+	m_StructuralDebris.clear();
 }
 
 /*
@@ -207,6 +235,9 @@ int SceneMan::LoadScene(Scene *pNewScene, bool placeObjects, bool placeUnits)
 		return -1;
     }
 
+    // Changes made while loading aren't anything the structural calculations need to look at
+    ClearStructuralGrid();
+
     // Report successful load to the console
     g_ConsoleMan.PrintString("SYSTEM: Scene \"" + m_pCurrentScene->GetPresetName() + "\" was loaded");
 
@@ -451,8 +482,6 @@ void SceneMan::Destroy()
     delete m_pMOColorLayer;
     delete m_pUnseenRevealSound;
 
-	destroy_bitmap(m_pOrphanSearchBitmap);
-	m_pOrphanSearchBitmap = 0;
 
     Clear();
 }
@@ -911,18 +940,14 @@ void SceneMan::RegisterMOIDDrawing(const Vector &center, float radius)
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          ClearAllMOIDDrawings
+// Method:          TakeMOIDDrawings
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Clears all registered drawn areas of the MOID layer to the g_NoMOID
-//                  color and clears the registrations too. Should be done each sim update.
+// Description:     Hands over all registered drawn areas of the MOID layer without
+//                  clearing them.
 
-void SceneMan::ClearAllMOIDDrawings()
+void SceneMan::TakeMOIDDrawings(vector<IntRect> &drawings)
 {
-    SLICK_PROFILE(0xFF648483);
-
-    for (list<IntRect>::iterator itr = m_MOIDDrawings.begin(); itr != m_MOIDDrawings.end(); ++itr)
-        ClearMOIDRect(itr->m_Left, itr->m_Top, itr->m_Right, itr->m_Bottom);
-
+    drawings.insert(drawings.end(), m_MOIDDrawings.begin(), m_MOIDDrawings.end());
     m_MOIDDrawings.clear();
 }
 
@@ -1007,105 +1032,150 @@ int SceneMan::RemoveOrphans(int posX, int posY, int radius, int maxArea, bool re
 {
 	if (radius > MAXORPHANRADIUS)
 		radius = MAXORPHANRADIUS;
-
-	clear_to_color(m_pOrphanSearchBitmap, g_MaterialAir);
-	int area = RemoveOrphans(posX, posY, posX, posY, 0, radius, maxArea, false);
-	if (remove && area <= maxArea)
-	{
-		clear_to_color(m_pOrphanSearchBitmap, g_MaterialAir);
-		RemoveOrphans(posX, posY, posX, posY, 0, radius, maxArea, true);
-	}
-
-	return area;
-}
-
-//////////////////////////////////////////////////////////////////////////////////////////
-// Method:          RemoveOrphans
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Returns the area of an orphaned region at specified coordinates. 
-
-int SceneMan::RemoveOrphans(int posX, int posY, 
-							int centerPosX, int centerPosY, 
-							int accumulatedArea, int radius, int maxArea, bool remove)
-{
-	int area = 0;
-	int bmpX = 0;
-	int bmpY = 0;
+	if (radius < 3)
+		return MAXORPHANRADIUS * MAXORPHANRADIUS + 1;
 
 	BITMAP * mat = m_pCurrentScene->GetTerrain()->GetMaterialBitmap();
 
-	if (posX < 0 || posY < 0 || posX >= mat->w || posY >= mat->h) return 0;
+	// Start a new generation of visited marks; they only need actual clearing when the counter wraps around
+	if (++m_OrphanSearchGeneration == 0)
+	{
+		memset(m_aOrphanSearchVisited, 0, sizeof(m_aOrphanSearchVisited));
+		m_OrphanSearchGeneration = 1;
+	}
 
-    unsigned char materialID = _getpixel(mat, posX, posY);
-    if (materialID == g_MaterialAir && (posX != centerPosX || posY != centerPosY))
-		return 0;
+	// Scene coordinates of the search window's corner. Window coordinates are used from here on,
+	// with a pixel's index into the visited marks being y * MAXORPHANRADIUS + x
+	int windowX = posX - radius / 2;
+	int windowY = posY - radius / 2;
+	int centerX = radius / 2;
+	int centerY = radius / 2;
+
+	m_OrphanSearchStack.clear();
+	m_OrphanRegion.clear();
+
+	// The center pixel may be air already (it was just knocked loose), in which case whatever touches it is the region
+	int sceneX = windowX + centerX;
+	int sceneY = windowY + centerY;
+	if (sceneX >= 0 && sceneY >= 0 && sceneX < mat->w && sceneY < mat->h && _getpixel(mat, sceneX, sceneY) != g_MaterialAir)
+		m_OrphanSearchStack.push_back(centerY * MAXORPHANRADIUS + centerX);
 	else
 	{
-		bmpX = posX - (centerPosX - radius / 2);
-		bmpY = posY - (centerPosY - radius / 2);
+		m_aOrphanSearchVisited[centerY * MAXORPHANRADIUS + centerX] = m_OrphanSearchGeneration;
+		for (int y = centerY - 1; y <= centerY + 1; ++y)
+			for (int x = centerX - 1; x <= centerX + 1; ++x)
+				m_OrphanSearchStack.push_back(y * MAXORPHANRADIUS + x);
+	}
 
-		// We reached the border of orphan-searching area and 
-		// there are still material pixels there -> the area is not an orphaned teran piece, abort search
-		if (bmpX <= 0 || bmpY <= 0 || bmpX >= radius - 1 || bmpY >= radius - 1)
+	int area = 0;
+	while (!m_OrphanSearchStack.empty())
+	{
+		int seed = m_OrphanSearchStack.back();
+		m_OrphanSearchStack.pop_back();
+		int y = seed / MAXORPHANRADIUS;
+		int x = seed % MAXORPHANRADIUS;
+		sceneY = windowY + y;
+
+		// Pixels off the scene count as air
+		if (sceneY < 0 || sceneY >= mat->h || m_aOrphanSearchVisited[seed] == m_OrphanSearchGeneration || windowX + x < 0 || windowX + x >= mat->w || _getpixel(mat, windowX + x, sceneY) == g_MaterialAir)
+			continue;
+
+		// Grow the span left and right as far as the material goes
+		int left = x;
+		while (left > 0 && windowX + left - 1 >= 0 && m_aOrphanSearchVisited[y * MAXORPHANRADIUS + left - 1] != m_OrphanSearchGeneration && _getpixel(mat, windowX + left - 1, sceneY) != g_MaterialAir)
+			--left;
+		int right = x;
+		while (right < radius - 1 && windowX + right + 1 < mat->w && m_aOrphanSearchVisited[y * MAXORPHANRADIUS + right + 1] != m_OrphanSearchGeneration && _getpixel(mat, windowX + right + 1, sceneY) != g_MaterialAir)
+			++right;
+
+		// We reached the border of orphan-searching area and
+		// there are still material pixels there -> the area is not an orphaned terrain piece, abort search
+		if (left <= 0 || y <= 0 || right >= radius - 1 || y >= radius - 1)
 			return MAXORPHANRADIUS * MAXORPHANRADIUS + 1;
-		else
-		// Check if pixel was already checked
+
+		for (int spanX = left; spanX <= right; ++spanX)
 		{
-			if (_getpixel(m_pOrphanSearchBitmap, bmpX, bmpY) != g_MaterialAir)
-				return 0;
+			m_aOrphanSearchVisited[y * MAXORPHANRADIUS + spanX] = m_OrphanSearchGeneration;
+			m_OrphanRegion.push_back(y * MAXORPHANRADIUS + spanX);
 		}
-	}
+		area += right - left + 1;
+		if (area > maxArea)
+			return area;
 
-	_putpixel(m_pOrphanSearchBitmap, bmpX, bmpY, materialID);
-	area++;
+		// Seed the start of every run of unvisited material in the rows above and below, including diagonals
+		for (int nextY = y - 1; nextY <= y + 1; nextY += 2)
+		{
+			sceneY = windowY + nextY;
+			if (sceneY < 0 || sceneY >= mat->h)
+				continue;
+
+			bool inRun = false;
+			for (int runX = left - 1; runX <= right + 1; ++runX)
+			{
+				bool solid = windowX + runX >= 0 && windowX + runX < mat->w && m_aOrphanSearchVisited[nextY * MAXORPHANRADIUS + runX] != m_OrphanSearchGeneration && _getpixel(mat, windowX + runX, sceneY) != g_MaterialAir;
+				if (solid && !inRun)
+					m_OrphanSearchStack.push_back(nextY * MAXORPHANRADIUS + runX);
+				inRun = solid;
+			}
+		}
+	}
 
-	// We're clear to remove the pixel
-	if (remove)
+	// We're clear to remove the region
+	if (remove && !m_OrphanRegion.empty())
 	{
-		Material const * sceneMat = GetMaterialFromID(materialID);
-		Material const * spawnMat;
-        spawnMat = sceneMat->spawnMaterial ? GetMaterialFromID(sceneMat->spawnMaterial) : sceneMat;
+		SLTerrain *pTerrain = m_pCurrentScene->GetTerrain();
 		float sprayScale = 0.1;
-        Color spawnColor;
-        if (spawnMat->UsesOwnColor())
-            spawnColor = spawnMat->color;
-        else
-            spawnColor.SetRGBWithIndex(m_pCurrentScene->GetTerrain()->GetFGColorPixel(posX, posY));
+		int minX = radius;
+		int minY = radius;
+		int maxX = 0;
+		int maxY = 0;
 
-        // No point generating a key-colored MOPixel
-        if (spawnColor.GetIndex() != g_KeyColor)
-        {
-			// TEST COLOR
-			// spawnColor = 5;
-
-            // Get the new pixel from the pre-allocated pool, should be faster than dynamic allocation
-            // Density is used as the mass for the new MOPixel
-            MOPixel *pixelMO = new MOPixel(spawnColor,
-                                           spawnMat->pixelDensity,
-                                           Vector(posX, posY),
-                                           Vector(-RangeRand((2 * sprayScale) / 2 , 2 * sprayScale),
-                                                  -RangeRand((2 * sprayScale) / 2 , 2 * sprayScale)),
-                                           new Atom(Vector(), spawnMat->id, 0, spawnColor, 2),
-                                           0);
-
-            pixelMO->SetToHitMOs(spawnMat->id == GOLDMATID);
-            pixelMO->SetToGetHitByMOs(false);
-            g_MovableMan.AddParticle(pixelMO);
-            pixelMO = 0;
-        }
-        m_pCurrentScene->GetTerrain()->SetFGColorPixel(posX, posY, g_KeyColor);
-		RegisterTerrainChange(posX, posY, 1, 1, g_KeyColor, false);
-        m_pCurrentScene->GetTerrain()->SetMaterialPixel(posX, posY, g_MaterialAir);
-	}
+		m_OrphanDebris.clear();
+		for (vector<int>::const_iterator pItr = m_OrphanRegion.begin(); pItr != m_OrphanRegion.end(); ++pItr)
+		{
+			int x = (*pItr) % MAXORPHANRADIUS;
+			int y = (*pItr) / MAXORPHANRADIUS;
+			sceneX = windowX + x;
+			sceneY = windowY + y;
+
+			Material const * sceneMat = GetMaterialFromID(_getpixel(mat, sceneX, sceneY));
+			Material const * spawnMat = sceneMat->spawnMaterial ? GetMaterialFromID(sceneMat->spawnMaterial) : sceneMat;
+			Color spawnColor;
+			if (spawnMat->UsesOwnColor())
+				spawnColor = spawnMat->color;
+			else
+				spawnColor.SetRGBWithIndex(pTerrain->GetFGColorPixel(sceneX, sceneY));
 
-	int xoff[8] = { -1,  0,  1, -1,  1, -1,  0,  1};
-	int yoff[8] = { -1, -1, -1,  0,  0,  1,  1,  1};
+			// No point generating a key-colored MOPixel
+			if (spawnColor.GetIndex() != g_KeyColor)
+			{
+				// Density is used as the mass for the new MOPixel
+				MOPixel *pixelMO = new MOPixel(spawnColor,
+											   spawnMat->pixelDensity,
+											   Vector(sceneX, sceneY),
+											   Vector(-RangeRand((2 * sprayScale) / 2 , 2 * sprayScale),
+													  -RangeRand((2 * sprayScale) / 2 , 2 * sprayScale)),
+											   new Atom(Vector(), spawnMat->id, 0, spawnColor, 2),
+											   0);
+
+				pixelMO->SetToHitMOs(spawnMat->id == GOLDMATID);
+				pixelMO->SetToGetHitByMOs(false);
+				m_OrphanDebris.push_back(pixelMO);
+			}
+			pTerrain->SetFGColorPixel(sceneX, sceneY, g_KeyColor);
+			pTerrain->SetMaterialPixel(sceneX, sceneY, g_MaterialAir);
 
-	for (int c = 0; c < 8; c++)
-	{
-		area += RemoveOrphans(posX + xoff[c], posY + yoff[c], centerPosX, centerPosY, area, radius, maxArea, remove);
-		if (accumulatedArea + area > maxArea)
-			break;
+			minX = MIN(minX, x);
+			minY = MIN(minY, y);
+			maxX = MAX(maxX, x);
+			maxY = MAX(maxY, y);
+		}
+
+		g_MovableMan.AddParticles(m_OrphanDebris);
+		m_OrphanDebris.clear();
+
+		// One change covering the whole region, rather than one per pixel
+		RegisterTerrainChange(windowX + minX, windowY + minY, maxX - minX + 1, maxY - minY + 1, g_KeyColor, false);
 	}
 
 	return area;
@@ -1113,6 +1183,9 @@ int SceneMan::RemoveOrphans(int posX, int posY,
 
 void SceneMan::RegisterTerrainChange(int x, int y, int w, int h, unsigned char color, bool back) 
 {
+	if (!back && g_SettingsMan.GetStructuralCalcTime() > 0)
+		MarkStructuralChange(x, y, w, h);
+
 	if (!g_NetworkServer.IsServerModeEnabled())
 		return;
 
@@ -1374,6 +1447,7 @@ bool SceneMan::TryPenetrate(const int posX,
 						RegisterTerrainChange(posX, testY, 1, 1, g_KeyColor, false);
                         _putpixel(pFGColor, posX, testY, g_KeyColor);
                         _putpixel(pMaterial, posX, testY, g_MaterialAir);
+                        m_pCurrentScene->GetTerrain()->SetLayersDirty();
                     }
                     // There is support, so stop checking
                     else
@@ -1386,9 +1460,6 @@ bool SceneMan::TryPenetrate(const int posX,
 		if (removeOrphansRadius && removeOrphansMaxArea && removeOrphansRate > 0 && PosRand() < removeOrphansRate)
 		{
 			RemoveOrphans(posX, posY, removeOrphansRadius, removeOrphansMaxArea, true);
-			/*PALETTE palette;
-			get_palette(palette);
-			save_bmp("Orphan.bmp", m_pOrphanSearchBitmap, palette);*/
 		}
 
         return true;
@@ -1496,7 +1567,7 @@ bool SceneMan::IsUnseen(const int posX, const int posY, const int team)
         Vector scale = pUnseenLayer->GetScaleInverse();
         int scaledX = posX * scale.m_X;
         int scaledY = posY * scale.m_Y;
-        return getpixel(pUnseenLayer->GetBitmap(), scaledX, scaledY) != g_KeyColor;
+        return m_pCurrentScene->IsUnseenPixel(scaledX, scaledY, team);
     }
 
     return false;
@@ -1523,13 +1594,13 @@ bool SceneMan::RevealUnseen(const int posX, const int posY, const int team)
         int scaledY = posY * scale.m_Y;
 
         // Make sure we're actually revealing an unseen pixel that is ON the bitmap!
-        int pixel = getpixel(pUnseenLayer->GetBitmap(), scaledX, scaledY);
-        if (pixel != g_KeyColor && pixel != -1)
+        BITMAP *pUnseenBitmap = pUnseenLayer->GetBitmap();
+        if (scaledX >= 0 && scaledX < pUnseenBitmap->w && scaledY >= 0 && scaledY < pUnseenBitmap->h && m_pCurrentScene->IsUnseenPixel(scaledX, scaledY, team))
         {
             // Add the pixel to the list of now seen pixels so it can be visually flashed
             m_pCurrentScene->GetSeenPixels(team).push_back(Vector(scaledX, scaledY));
             // Clear to key color that pixel on the map so it won't be detected as unseen again
-            putpixel(pUnseenLayer->GetBitmap(), scaledX, scaledY, g_KeyColor);
+            m_pCurrentScene->SetUnseenPixel(scaledX, scaledY, g_KeyColor, team);
             // Play the reveal sound, if there's not too many already revealed this frame
             if (g_SettingsMan.BlipOnRevealUnseen() && m_pUnseenRevealSound && m_pCurrentScene->GetSeenPixels(team).size() < 5)
                 m_pUnseenRevealSound->Play(g_SceneMan.TargetDistanceScalar(Vector(posX, posY)));
@@ -1568,7 +1639,7 @@ bool SceneMan::RestoreUnseen(const int posX, const int posY, const int team)
             // Add the pixel to the list of now seen pixels so it can be visually flashed
             m_pCurrentScene->GetSeenPixels(team).push_back(Vector(scaledX, scaledY));
             // Clear to key color that pixel on the map so it won't be detected as unseen again
-            putpixel(pUnseenLayer->GetBitmap(), scaledX, scaledY, g_BlackColor);
+            m_pCurrentScene->SetUnseenPixel(scaledX, scaledY, g_BlackColor, team);
             // Play the reveal sound, if there's not too many already revealed this frame
             //if (g_SettingsMan.BlipOnRevealUnseen() && m_pUnseenRevealSound && m_pCurrentScene->GetSeenPixels(team).size() < 5)
             //    m_pUnseenRevealSound->Play(g_SceneMan.TargetDistanceScalar(Vector(posX, posY)));
@@ -1604,6 +1675,8 @@ void SceneMan::RevealUnseenBox(const int posX, const int posY, const int width,
 
         // Fill the box
         rectfill(pUnseenLayer->GetBitmap(), scaledX, scaledY, scaledX + scaledW, scaledY + scaledH, g_KeyColor);
+        pUnseenLayer->SetDataDirty();
+        m_pCurrentScene->InvalidateUnseenBits(team);
     }
 }
 
@@ -1631,184 +1704,332 @@ void SceneMan::RestoreUnseenBox(const int posX, const int posY, const int width,
 
         // Fill the box
         rectfill(pUnseenLayer->GetBitmap(), scaledX, scaledY, scaledX + scaledW, scaledY + scaledH, g_BlackColor);
+        pUnseenLayer->SetDataDirty();
+        m_pCurrentScene->InvalidateUnseenBits(team);
     }
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastUnseenRay
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and reveals or hides pixels on the unseen layer of a team
-//                  as long as the accumulated material strengths traced through the terrain
-//                  don't exceed a specific value.
+// The per-pixel checks of the different kinds of rays, which all share the same traversal
+// in SceneMan::TraceRay. Check gets each checked pixel and returns whether the ray should
+// stop there, Pass gets the pixels skipped over in between.
 
-bool SceneMan::CastUnseenRay(int team, const Vector &start, const Vector &ray, Vector &endPos, int strengthLimit, int skip, bool reveal)
+struct UnseenRayVisitor
 {
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->LockBitmaps();
-#endif //_DEBUG
+    UnseenRayVisitor(SceneMan *pSceneMan, Scene *pScene, int team, bool reveal, int strengthLimit)
+    {
+        m_pSceneMan = pSceneMan; m_Team = team; m_Reveal = reveal; m_StrengthLimit = strengthLimit; m_TotalStrength = 0; m_AffectedAny = false; m_Blocked = false;
+        // Look up the team's unseen bits once for the whole ray, or fan of rays
+        const BITMAP *pUnseenBitmap = pScene->GetUnseenLayer(team)->GetBitmap();
+        m_pBits = pScene->GetUnseenBits(team, m_RowWords);
+        m_Width = pUnseenBitmap->w;
+        m_Height = pUnseenBitmap->h;
+        m_Scale = pScene->GetUnseenLayer(team)->GetScaleInverse();
+    }
 
-    if (!m_pCurrentScene->GetUnseenLayer(team))
-        return false;
+    // Starts over for the next ray of a fan
+    void NextRay() { m_TotalStrength = 0; m_Blocked = false; }
 
-    int hitCount = 0, error, dom, sub, domSteps, skipped = skip;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    bool affectedAny = false;
-    unsigned char materialID;
-    Material const * foundMaterial;
-    int totalStrength = 0;
-    // Save the projected end of the ray pos
-    endPos = start + ray;
+    bool Check(const SceneMan::RayPixels &pixels, int posX, int posY)
+    {
+        // Reveal if we can, save the result. Most checked pixels have been seen already, which the bits tell without touching the layer
+        if (m_Reveal)
+        {
+            int scaledX = posX * m_Scale.m_X;
+            int scaledY = posY * m_Scale.m_Y;
+            if (m_pBits && scaledX >= 0 && scaledX < m_Width && scaledY >= 0 && scaledY < m_Height && (m_pBits[scaledY * m_RowWords + (scaledX >> 5)] & (1U << (scaledX & 31))))
+                m_AffectedAny = m_pSceneMan->RevealUnseen(posX, posY, m_Team) || m_AffectedAny;
+        }
+        else
+            m_AffectedAny = m_pSceneMan->RestoreUnseen(posX, posY, m_Team) || m_AffectedAny;
+
+        // Add the encountered material's strength to the tally, and see if we have hit the limits of our ray's strength
+        m_TotalStrength += pixels.GetMaterial(pixels.GetMaterialID(posX, posY))->strength;
+        m_Blocked = m_TotalStrength >= m_StrengthLimit;
+        return m_Blocked;
+    }
+    void Pass(int posX, int posY) { }
+
+    SceneMan *m_pSceneMan;
+    int m_Team;
+    bool m_Reveal;
+    int m_StrengthLimit;
+    int m_TotalStrength;
+    bool m_AffectedAny;
+    bool m_Blocked;
+    // The team's unseen bits and the layer's dimensions and scale
+    const unsigned int *m_pBits;
+    int m_RowWords;
+    int m_Width;
+    int m_Height;
+    Vector m_Scale;
+};
+
+struct MaterialRayVisitor
+{
+    MaterialRayVisitor(unsigned char material, bool notMaterial, bool checkMOs) { m_Material = material; m_NotMaterial = notMaterial; m_CheckMOs = checkMOs; m_Found = false; }
+
+    bool Check(const SceneMan::RayPixels &pixels, int posX, int posY)
+    {
+        // See if we found the looked-for pixel of the correct material, or any other than it, or an MO is blocking the way
+        if (m_NotMaterial)
+            m_Found = pixels.GetMaterialID(posX, posY) != m_Material || (m_CheckMOs && pixels.GetMOID(posX, posY) != g_NoMOID);
+        else
+            m_Found = pixels.GetMaterialID(posX, posY) == m_Material;
+        return m_Found;
+    }
+    void Pass(int posX, int posY) { }
 
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    
-    if (delta[X] == 0 &&  delta[Y] == 0)
-        return false;
+    unsigned char m_Material;
+    bool m_NotMaterial;
+    bool m_CheckMOs;
+    bool m_Found;
+};
 
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
+struct StrengthTallyRayVisitor
+{
+    StrengthTallyRayVisitor(bool max, unsigned char ignoreMaterial) { m_Max = max; m_IgnoreMaterial = ignoreMaterial; m_Tally = 0; }
 
-    if (delta[X] < 0)
+    bool Check(const SceneMan::RayPixels &pixels, int posX, int posY)
     {
-        increment[X] = -1;
-        delta[X] = -delta[X];
+        unsigned char materialID = pixels.GetMaterialID(posX, posY);
+        // The max leaves out doors, the sum air and the ignored material
+        if (m_Max)
+        {
+            if (materialID != g_MaterialDoor)
+                m_Tally = fmax(m_Tally, pixels.GetMaterial(materialID)->strength);
+        }
+        else if (materialID != g_MaterialAir && materialID != m_IgnoreMaterial)
+            m_Tally += pixels.GetMaterial(materialID)->strength;
+        return false;
     }
-    else
-        increment[X] = 1;
+    void Pass(int posX, int posY) { }
 
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
+    bool m_Max;
+    unsigned char m_IgnoreMaterial;
+    float m_Tally;
+};
 
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
+struct StrengthRayVisitor
+{
+    StrengthRayVisitor(float strength, bool weakness, unsigned char ignoreMaterial) { m_Strength = strength; m_Weakness = weakness; m_IgnoreMaterial = ignoreMaterial; m_Found = false; }
 
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else {
-        dom = Y;
-        sub = X;
+    bool Check(const SceneMan::RayPixels &pixels, int posX, int posY)
+    {
+        unsigned char materialID = pixels.GetMaterialID(posX, posY);
+        // See if we found a pixel of equal or less strength than the threshold
+        if (m_Weakness)
+            m_Found = pixels.GetMaterial(materialID)->strength <= m_Strength;
+        // Or of equal or more strength, not counting the ignored material
+        else
+            m_Found = materialID != m_IgnoreMaterial && pixels.GetMaterial(materialID)->strength >= m_Strength;
+        return m_Found;
     }
+    void Pass(int posX, int posY) { }
 
-    error = delta2[sub] - delta[dom];
+    float m_Strength;
+    bool m_Weakness;
+    unsigned char m_IgnoreMaterial;
+    bool m_Found;
+};
 
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
+struct MORayVisitor
+{
+    MORayVisitor(bool find, MOID ignoreMOID, int ignoreTeam, MOID targetMOID, unsigned char ignoreMaterial, bool ignoreAllTerrain) { m_Find = find; m_IgnoreMOID = ignoreMOID; m_IgnoreTeam = ignoreTeam; m_TargetMOID = targetMOID; m_IgnoreMaterial = ignoreMaterial; m_IgnoreAllTerrain = ignoreAllTerrain; m_HitMOID = g_NoMOID; m_Stopped = false; }
 
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
+    bool Check(const SceneMan::RayPixels &pixels, int posX, int posY)
     {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
+        MOID hitMOID = pixels.GetMOID(posX, posY);
+
+        // Looking for a specific MO
+        if (m_Find)
         {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
+            if (hitMOID == m_TargetMOID || g_MovableMan.GetRootMOID(hitMOID) == m_TargetMOID)
+            {
+                m_HitMOID = m_TargetMOID;
+                m_Stopped = true;
+                return true;
+            }
+        }
+        // Or for any MO that isn't ignored
+        else if (hitMOID != g_NoMOID && hitMOID != m_IgnoreMOID && g_MovableMan.GetRootMOID(hitMOID) != m_IgnoreMOID)
+        {
+            // Check if we're supposed to ignore the team of what we hit
+            const MovableObject *pHitMO = m_IgnoreTeam != Activity::NOTEAM ? g_MovableMan.GetMOFromID(hitMOID) : 0;
+            pHitMO = pHitMO ? pHitMO->GetRootParent() : 0;
+            if (!(pHitMO && pHitMO->IgnoresTeamHits() && pHitMO->GetTeam() == m_IgnoreTeam))
+            {
+                m_HitMOID = hitMOID;
+                m_Stopped = true;
+                return true;
+            }
         }
-        error += delta2[sub];
 
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
+        // Detect terrain hits
+        if (!m_IgnoreAllTerrain)
         {
-            // Scene wrapping
-            g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
-            // Reveal if we can, save the result
-			if (reveal)
-				affectedAny = RevealUnseen(intPos[X], intPos[Y], team) || affectedAny;
-			else
-				affectedAny = RestoreUnseen(intPos[X], intPos[Y], team) || affectedAny;
-
-            // Check the strength of the terrain to see if we can penetrate further
-            materialID = GetTerrMatter(intPos[X], intPos[Y]);
-            // Get the material object
-            foundMaterial = GetMaterialFromID(materialID);
-            // Add the encountered material's strength to the tally
-            totalStrength += foundMaterial->strength;
-            // See if we have hit the limits of our ray's strength
-            if (totalStrength >= strengthLimit)
+            unsigned char hitTerrain = pixels.GetMaterialID(posX, posY);
+            m_Stopped = hitTerrain != g_MaterialAir && hitTerrain != m_IgnoreMaterial;
+        }
+        return m_Stopped;
+    }
+    void Pass(int posX, int posY) { }
+
+    bool m_Find;
+    MOID m_IgnoreMOID;
+    int m_IgnoreTeam;
+    MOID m_TargetMOID;
+    unsigned char m_IgnoreMaterial;
+    bool m_IgnoreAllTerrain;
+    MOID m_HitMOID;
+    bool m_Stopped;
+};
+
+struct ObstacleRayVisitor
+{
+    ObstacleRayVisitor(Vector &freePos, MOID ignoreMOID, int ignoreTeam, unsigned char ignoreMaterial): m_FreePos(freePos) { m_IgnoreMOID = ignoreMOID; m_IgnoreTeam = ignoreTeam; m_IgnoreMaterial = ignoreMaterial; m_HitObstacle = false; }
+
+    bool Check(const SceneMan::RayPixels &pixels, int posX, int posY)
+    {
+        unsigned char checkMat = pixels.GetMaterialID(posX, posY);
+        MOID checkMOID = pixels.GetMOID(posX, posY);
+
+        // Translate any found MOID into the root MOID of that hit MO
+        if (checkMOID != g_NoMOID)
+        {
+            MovableObject *pHitMO = g_MovableMan.GetMOFromID(checkMOID);
+            if (pHitMO)
             {
-                // Save the position of the end of the ray where blocked
-                endPos.SetXY(intPos[X], intPos[Y]);
-                break;
+                checkMOID = pHitMO->GetRootID();
+                // Check if we're supposed to ignore the team of what we hit
+                if (m_IgnoreTeam != Activity::NOTEAM)
+                {
+                    pHitMO = pHitMO->GetRootParent();
+                    // We are indeed supposed to ignore this object because of its ignoring of its specific team
+                    if (pHitMO && pHitMO->IgnoresTeamHits() && pHitMO->GetTeam() == m_IgnoreTeam)
+                        checkMOID = g_NoMOID;
+                }
             }
-            // Reset skip counter
-            skipped = 0;
-#ifdef _DEBUG
-            // Draw debug graphics, if applicable
-            if (m_pDebugLayer)
-                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], 13);
-#endif //_DEBUG
         }
+
+        // See if a non-ignored material or MO is blocking the way
+        m_HitObstacle = (checkMat != g_MaterialAir && checkMat != m_IgnoreMaterial) || (checkMOID != g_NoMOID && checkMOID != m_IgnoreMOID);
+        if (!m_HitObstacle)
+            m_FreePos.SetXY(posX, posY);
+        return m_HitObstacle;
     }
+    void Pass(int posX, int posY) { m_FreePos.SetXY(posX, posY); }
 
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->UnlockBitmaps();
-#endif //_DEBUG
+    Vector &m_FreePos;
+    MOID m_IgnoreMOID;
+    int m_IgnoreTeam;
+    unsigned char m_IgnoreMaterial;
+    bool m_HitObstacle;
+};
 
-    return affectedAny;
-}
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastSeeRay
+// Method:          RayPixels::Wrap
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and reveals pixels on the unseen layer of a team
-//                  as long as the accumulated material strengths traced through the terrain
-//                  don't exceed a specific value.
+// Description:     Wraps a position the same way the terrain does.
 
-bool SceneMan::CastSeeRay(int team, const Vector &start, const Vector &ray, Vector &endPos, int strengthLimit, int skip)
+void SceneMan::RayPixels::Wrap(int &posX, int &posY) const
 {
-	return CastUnseenRay(team, start, ray, endPos, strengthLimit, skip, true);
+    if (m_WrapX)
+    {
+        while (posX < 0)
+            posX += m_pMaterialBitmap->w;
+        if (posX >= m_pMaterialBitmap->w)
+            posX %= m_pMaterialBitmap->w;
+    }
+    if (m_WrapY)
+    {
+        while (posY < 0)
+            posY += m_pMaterialBitmap->h;
+        if (posY >= m_pMaterialBitmap->h)
+            posY %= m_pMaterialBitmap->h;
+    }
 }
 
+
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastUnseeRay
+// Method:          RayPixels::GetMaterialID
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and hides pixels on the unseen layer of a team
-//                  as long as the accumulated material strengths traced through the terrain
-//                  don't exceed a specific value.
+// Description:     Gets the terrain material at a position, the same as GetTerrMatter.
 
-bool SceneMan::CastUnseeRay(int team, const Vector &start, const Vector &ray, Vector &endPos, int strengthLimit, int skip)
+unsigned char SceneMan::RayPixels::GetMaterialID(int posX, int posY) const
 {
-	return CastUnseenRay(team, start, ray, endPos, strengthLimit, skip, false);
+    Wrap(posX, posY);
+    if (posX < 0 || posX >= m_pMaterialBitmap->w || posY < 0 || posY >= m_pMaterialBitmap->h)
+        return g_MaterialAir;
+    return m_pMaterialBitmap->line[posY][posX];
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RayPixels::GetMOID
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the MOID at a position, the same as GetMOIDPixel.
+
+MOID SceneMan::RayPixels::GetMOID(int posX, int posY) const
+{
+    Wrap(posX, posY);
+    if (posX < 0 || posX >= m_pMOIDBitmap->w || posY < 0 || posY >= m_pMOIDBitmap->h)
+        return g_NoMOID;
+    return ((unsigned short *)m_pMOIDBitmap->line[posY])[posX];
+}
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastMaterialRay
+// Method:          GetRayPixels
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and gets the location of the first encountered
-//                  pixel of a specific material in the terrain.
+// Description:     Sets up direct access to the layers that rays are cast through.
 
-bool SceneMan::CastMaterialRay(const Vector &start, const Vector &ray, unsigned char material, Vector &result, int skip, bool wrap)
+SceneMan::RayPixels SceneMan::GetRayPixels() const
 {
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->LockBitmaps();
-#endif //_DEBUG
+    DAssert(m_pCurrentScene, "Trying to cast rays before there is a scene or terrain!");
 
-    int hitCount = 0, error, dom, sub, domSteps, skipped = skip;
+    SLTerrain *pTerrain = m_pCurrentScene->GetTerrain();
+    RayPixels pixels;
+    pixels.m_pMaterialBitmap = pTerrain->GetMaterialBitmap();
+    pixels.m_pMOIDBitmap = m_pMOIDLayer->GetBitmap();
+    pixels.m_WrapX = pTerrain->WrapsX();
+    pixels.m_WrapY = pTerrain->WrapsY();
+    pixels.m_apMaterials = m_apMatPalette;
+    return pixels;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          TraceRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     The one Bresenham traversal behind all the ray casts.
+
+template <class RayVisitor>
+int SceneMan::TraceRay(RayType type, const RayPixels &pixels, const Vector &start, const Vector &ray, int skip, bool wrap, RayVisitor &visitor, int endPos[2], int debugColor) const
+{
+    int error, dom, sub, domSteps, skipped = skip, checked = 0;
     int intPos[2], delta[2], delta2[2], increment[2];
-    bool foundPixel = false;
 
     intPos[X] = floorf(start.m_X);
     intPos[Y] = floorf(start.m_Y);
     delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
     delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    
-    if (delta[X] == 0 &&  delta[Y] == 0)
-        return false;
+
+    m_aRayCalls[type]++;
+    endPos[X] = intPos[X];
+    endPos[Y] = intPos[Y];
+
+    if (delta[X] == 0 && delta[Y] == 0)
+        return -1;
+
+#ifdef _DEBUG
+    if (!m_pDebugLayer)
+        debugColor = 0;
+    if (debugColor)
+        m_pDebugLayer->LockBitmaps();
+#endif //_DEBUG
 
     /////////////////////////////////////////////////////
     // Bresenham's line drawing algorithm preparation
@@ -1861,181 +2082,279 @@ bool SceneMan::CastMaterialRay(const Vector &start, const Vector &ray, unsigned
         // Only check pixel if we're not due to skip any, or if this is the last pixel
         if (++skipped > skip || domSteps + 1 == delta[dom])
         {
-            // Scene wrapping, if necessary
+            // Scene wrapping, if necessary. The wrapped position is what the traversal carries on from
             if (wrap)
-                g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
+                pixels.Wrap(intPos[X], intPos[Y]);
 
-            // See if we found the looked-for pixel of the correct material
-            if (GetTerrMatter(intPos[X], intPos[Y]) == material)
-            {
-                // Save result and report success
-                foundPixel = true;
-                result.SetXY(intPos[X], intPos[Y]);
-                // Save last ray pos
-                m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
+            ++checked;
+            if (visitor.Check(pixels, intPos[X], intPos[Y]))
                 break;
-            }
 
             skipped = 0;
 
 #ifdef _DEBUG
             // Draw debug graphics, if applicable
-            if (m_pDebugLayer)
-                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], 13);
+            if (debugColor)
+                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], debugColor);
 #endif //_DEBUG
         }
+        else
+            visitor.Pass(intPos[X], intPos[Y]);
     }
 
 #ifdef _DEBUG
-    if (m_pDebugLayer)
+    if (debugColor)
         m_pDebugLayer->UnlockBitmaps();
 #endif //_DEBUG
 
-    return foundPixel;
+    m_aRayPixels[type] += checked;
+    endPos[X] = intPos[X];
+    endPos[Y] = intPos[Y];
+
+    return domSteps;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastMaterialRay
+// Method:          CastRay
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and returns how far along that ray there is an
-//                  encounter with a pixel of a specific material in the terrain.
+// Description:     Casts a single ray of a batch, without touching any SceneMan state
+//                  other than the ray counters.
 
-float SceneMan::CastMaterialRay(const Vector &start, const Vector &ray, unsigned char material, int skip)
+void SceneMan::CastRay(const RayPixels &pixels, RayQuery &query, int debugColor) const
 {
-    Vector result;
-    if (CastMaterialRay(start, ray, material, result, skip))
+    int endPos[2];
+    query.Hit = false;
+    query.HitMOID = g_NoMOID;
+
+    switch (query.Type)
     {
-        // Calculate the length between the start and the found material pixel coords
-        result -= start;
-        return result.GetMagnitude();
+        case RAY_MATERIAL:
+        case RAY_NOTMATERIAL:
+        {
+            MaterialRayVisitor visitor(query.MaterialID, query.Type == RAY_NOTMATERIAL, query.CheckMOs);
+            // Not-material rays have always wrapped
+            query.Steps = TraceRay(query.Type, pixels, query.Start, query.Ray, query.Skip, query.Wrap || query.Type == RAY_NOTMATERIAL, visitor, endPos, debugColor);
+            query.Hit = visitor.m_Found;
+            break;
+        }
+        case RAY_STRENGTHSUM:
+        case RAY_MAXSTRENGTH:
+        {
+            // These take an end point rather than a ray, and always go the shortest way there
+            StrengthTallyRayVisitor visitor(query.Type == RAY_MAXSTRENGTH, query.MaterialID);
+            query.Steps = TraceRay(query.Type, pixels, query.Start, g_SceneMan.ShortestDistance(query.Start, query.Ray), query.Skip, true, visitor, endPos, debugColor);
+            query.Value = visitor.m_Tally;
+            break;
+        }
+        case RAY_STRENGTH:
+        case RAY_WEAKNESS:
+        {
+            StrengthRayVisitor visitor(query.Strength, query.Type == RAY_WEAKNESS, query.MaterialID);
+            query.Steps = TraceRay(query.Type, pixels, query.Start, query.Ray, query.Skip, query.Wrap, visitor, endPos, debugColor);
+            query.Hit = visitor.m_Found;
+            break;
+        }
+        case RAY_MO:
+        case RAY_FINDMO:
+        {
+            MORayVisitor visitor(query.Type == RAY_FINDMO, query.Type == RAY_MO ? query.IgnoreMOID : g_NoMOID, query.Type == RAY_MO ? query.IgnoreTeam : Activity::NOTEAM, query.Type == RAY_FINDMO ? query.IgnoreMOID : g_NoMOID, query.MaterialID, query.IgnoreAllTerrain);
+            query.Steps = TraceRay(query.Type, pixels, query.Start, query.Ray, query.Skip, true, visitor, endPos, debugColor);
+            query.Hit = visitor.m_Stopped;
+            query.HitMOID = visitor.m_HitMOID;
+            break;
+        }
+        case RAY_OBSTACLE:
+        {
+            ObstacleRayVisitor visitor(query.FreePos, query.IgnoreMOID, query.IgnoreTeam, query.MaterialID);
+            query.Steps = TraceRay(query.Type, pixels, query.Start, query.Ray, query.Skip, true, visitor, endPos, debugColor);
+            query.Hit = visitor.m_HitObstacle;
+            break;
+        }
+        default:
+            // The unseen rays change the scene, so they can't be cast like this
+            query.Steps = -1;
+            return;
     }
 
-    // Signal that we didn't hit anything
-    return -1;
+    if (query.Steps < 0)
+    {
+        // Too short to go anywhere; the tallies and obstacle distance have always come back as 0 then
+        if (query.Type == RAY_STRENGTHSUM || query.Type == RAY_MAXSTRENGTH || query.Type == RAY_OBSTACLE)
+            query.Value = 0;
+        else
+            query.Value = -1;
+        return;
+    }
+
+    query.HitPos.SetXY(endPos[X], endPos[Y]);
+
+    if (query.Type == RAY_OBSTACLE)
+    {
+        // The fraction of a pixel that we start from, to be added to the integer result positions for accuracy
+        Vector startFraction(query.Start.m_X - floorf(query.Start.m_X), query.Start.m_Y - floorf(query.Start.m_Y));
+
+        // Add the pixel fraction to the free position if there were any free pixels
+        if (query.Steps != 0)
+            query.FreePos += startFraction;
+
+        query.Value = -1;
+        if (query.Hit)
+        {
+            query.HitPos += startFraction;
+            // If there was an obstacle on the start position, the distance to it is 0
+            query.Value = query.Steps == 0 ? 0 : g_SceneMan.ShortestDistance(query.HitPos, query.Start).GetMagnitude();
+        }
+    }
+    else if (query.Type != RAY_STRENGTHSUM && query.Type != RAY_MAXSTRENGTH)
+        query.Value = query.Hit ? (query.HitPos - query.Start).GetMagnitude() : -1;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastNotMaterialRay
+// Method:          CastRays
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and gets the location of the first encountered
-//                  pixel that is NOT of a specific material in the scene's terrain.
+// Description:     Casts a whole batch of rays at once, spread across the worker threads.
 
-bool SceneMan::CastNotMaterialRay(const Vector &start, const Vector &ray, unsigned char material, Vector &result, int skip, bool checkMOs)
+void SceneMan::CastRays(vector<RayQuery> &rays)
 {
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->LockBitmaps();
-#endif //_DEBUG
+    if (rays.empty())
+        return;
 
-    int hitCount = 0, error, dom, sub, domSteps, skipped = skip;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    bool foundPixel = false;
+    const RayPixels pixels = GetRayPixels();
 
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
+    // Hand the rays out in chunks, a single ray is too little work to be worth waking a worker for
+    int rayCount = rays.size();
+    int chunkCount = (rayCount + RAYBATCHSIZE - 1) / RAYBATCHSIZE;
+    g_ThreadMan.ParallelFor(chunkCount, [&](int chunk)
+    {
+        int end = std::min((chunk + 1) * RAYBATCHSIZE, rayCount);
+        for (int i = chunk * RAYBATCHSIZE; i < end; ++i)
+            CastRay(pixels, rays[i]);
+    });
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastUnseenRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and reveals or hides pixels on the unseen layer of a team
+//                  as long as the accumulated material strengths traced through the terrain
+//                  don't exceed a specific value.
 
-    if (delta[X] == 0 &&  delta[Y] == 0)
+bool SceneMan::CastUnseenRay(int team, const Vector &start, const Vector &ray, Vector &endPos, int strengthLimit, int skip, bool reveal)
+{
+    if (!m_pCurrentScene->GetUnseenLayer(team))
         return false;
 
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
+    // Save the projected end of the ray pos
+    endPos = start + ray;
 
-    if (delta[X] < 0)
-    {
-        increment[X] = -1;
-        delta[X] = -delta[X];
-    }
-    else
-        increment[X] = 1;
+    UnseenRayVisitor visitor(this, m_pCurrentScene, team, reveal, strengthLimit);
+    int intPos[2];
+    TraceRay(RAY_UNSEEN, GetRayPixels(), start, ray, skip, true, visitor, intPos, 13);
 
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
+    // Save the position of the end of the ray where blocked
+    if (visitor.m_Blocked)
+        endPos.SetXY(intPos[X], intPos[Y]);
 
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
+    return visitor.m_AffectedAny;
+}
 
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else {
-        dom = Y;
-        sub = X;
-    }
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastSeeRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and reveals pixels on the unseen layer of a team
+//                  as long as the accumulated material strengths traced through the terrain
+//                  don't exceed a specific value.
 
-    error = delta2[sub] - delta[dom];
+bool SceneMan::CastSeeRay(int team, const Vector &start, const Vector &ray, Vector &endPos, int strengthLimit, int skip)
+{
+	return CastUnseenRay(team, start, ray, endPos, strengthLimit, skip, true);
+}
 
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastSeeRayFan
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces a fan of rays spread evenly around a center ray, revealing
+//                  pixels on the unseen layer of a team like CastSeeRay does for each.
 
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
+int SceneMan::CastSeeRayFan(int team, const Vector &start, const Vector &centerRay, float spreadDegrees, int rayCount, int strengthLimit, int skip)
+{
+    if (team < Activity::TEAM_1 || team >= Activity::MAXTEAMCOUNT || !m_pCurrentScene->GetUnseenLayer(team) || rayCount <= 0)
+        return 0;
+
+    // One visitor for the whole fan, so the unseen layer is only looked up once
+    UnseenRayVisitor visitor(this, m_pCurrentScene, team, true, strengthLimit);
+    int intPos[2];
+    int revealingRays = 0;
+    for (int i = 0; i < rayCount; ++i)
     {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
-        {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
-        }
-        error += delta2[sub];
+        Vector ray = centerRay;
+        if (rayCount > 1)
+            ray.DegRotate(spreadDegrees * ((float)i / (float)(rayCount - 1) - 0.5f));
 
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
-        {
-            // Scene wrapping, if necessary
-            g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
+        visitor.NextRay();
+        visitor.m_AffectedAny = false;
+        TraceRay(RAY_UNSEEN, GetRayPixels(), start, ray, skip, true, visitor, intPos, 13);
+        if (visitor.m_AffectedAny)
+            revealingRays++;
+    }
 
-            // See if we found the looked-for pixel of the correct material,
-            // Or an MO is blocking the way
-            if (GetTerrMatter(intPos[X], intPos[Y]) != material ||
-                (checkMOs && g_SceneMan.GetMOIDPixel(intPos[X], intPos[Y]) != g_NoMOID))
-            {
-                // Save result and report success
-                foundPixel = true;
-                result.SetXY(intPos[X], intPos[Y]);
-                // Save last ray pos
-                m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                break;
-            }
+    return revealingRays;
+}
 
-            skipped = 0;
-#ifdef _DEBUG
-            // Draw debug graphics, if applicable
-            if (m_pDebugLayer)
-                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], 13);
-#endif //_DEBUG
-        }
-    }
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastUnseeRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and hides pixels on the unseen layer of a team
+//                  as long as the accumulated material strengths traced through the terrain
+//                  don't exceed a specific value.
 
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->UnlockBitmaps();
-#endif //_DEBUG
+bool SceneMan::CastUnseeRay(int team, const Vector &start, const Vector &ray, Vector &endPos, int strengthLimit, int skip)
+{
+	return CastUnseenRay(team, start, ray, endPos, strengthLimit, skip, false);
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastMaterialRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and gets the location of the first encountered
+//                  pixel of a specific material in the terrain.
+
+bool SceneMan::CastMaterialRay(const Vector &start, const Vector &ray, unsigned char material, Vector &result, int skip, bool wrap)
+{
+    RayQuery query;
+    query.Type = RAY_MATERIAL;
+    query.Start = start;
+    query.Ray = ray;
+    query.MaterialID = material;
+    query.Skip = skip;
+    query.Wrap = wrap;
+    CastRay(GetRayPixels(), query, 13);
 
-    return foundPixel;
+    if (query.Hit)
+    {
+        // Save result and last ray pos
+        result = query.HitPos;
+        m_LastRayHitPos = query.HitPos;
+    }
+    return query.Hit;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastNotMaterialRay
+// Method:          CastMaterialRay
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Traces along a vector and returns how far along that ray there is an
-//                  encounter with a pixel of OTHER than a specific material in the terrain.
+//                  encounter with a pixel of a specific material in the terrain.
 
-float SceneMan::CastNotMaterialRay(const Vector &start, const Vector &ray, unsigned char material, int skip, bool checkMOs)
+float SceneMan::CastMaterialRay(const Vector &start, const Vector &ray, unsigned char material, int skip)
 {
     Vector result;
-    if (CastNotMaterialRay(start, ray, material, result, skip, checkMOs))
+    if (CastMaterialRay(start, ray, material, result, skip))
     {
         // Calculate the length between the start and the found material pixel coords
         result -= start;
@@ -2048,95 +2367,69 @@ float SceneMan::CastNotMaterialRay(const Vector &start, const Vector &ray, unsig
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastStrengthSumRay
+// Method:          CastNotMaterialRay
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and returns how the sum of all encountered pixels'
-//                  material strength values. This will take wrapping into account.
+// Description:     Traces along a vector and gets the location of the first encountered
+//                  pixel that is NOT of a specific material in the scene's terrain.
 
-float SceneMan::CastStrengthSumRay(const Vector &start, const Vector &end, int skip, unsigned char ignoreMaterial)
+bool SceneMan::CastNotMaterialRay(const Vector &start, const Vector &ray, unsigned char material, Vector &result, int skip, bool checkMOs)
 {
-    Vector ray = g_SceneMan.ShortestDistance(start, end);
-    float strengthSum = 0;
+    RayQuery query;
+    query.Type = RAY_NOTMATERIAL;
+    query.Start = start;
+    query.Ray = ray;
+    query.MaterialID = material;
+    query.Skip = skip;
+    query.CheckMOs = checkMOs;
+    CastRay(GetRayPixels(), query, 13);
 
-    int error, dom, sub, domSteps, skipped = skip;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    bool foundPixel = false;
-    unsigned char materialID;
-    Material foundMaterial;
-
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    
-    if (delta[X] == 0 &&  delta[Y] == 0)
-        return false;
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
-
-    if (delta[X] < 0)
+    if (query.Hit)
     {
-        increment[X] = -1;
-        delta[X] = -delta[X];
+        // Save result and last ray pos
+        result = query.HitPos;
+        m_LastRayHitPos = query.HitPos;
     }
-    else
-        increment[X] = 1;
+    return query.Hit;
+}
 
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
 
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastNotMaterialRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and returns how far along that ray there is an
+//                  encounter with a pixel of OTHER than a specific material in the terrain.
 
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else
+float SceneMan::CastNotMaterialRay(const Vector &start, const Vector &ray, unsigned char material, int skip, bool checkMOs)
+{
+    Vector result;
+    if (CastNotMaterialRay(start, ray, material, result, skip, checkMOs))
     {
-        dom = Y;
-        sub = X;
+        // Calculate the length between the start and the found material pixel coords
+        result -= start;
+        return result.GetMagnitude();
     }
 
-    error = delta2[sub] - delta[dom];
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
-
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
-    {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
-        {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
-        }
-        error += delta2[sub];
-
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
-        {
-            // Scene wrapping, if necessary
-            g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
+    // Signal that we didn't hit anything
+    return -1;
+}
 
-            // Sum all strengths
-            materialID = GetTerrMatter(intPos[X], intPos[Y]);
-            if (materialID != g_MaterialAir && materialID != ignoreMaterial)
-                strengthSum += GetMaterialFromID(materialID)->strength;
 
-            skipped = 0;
-        }
-    }
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastStrengthSumRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and returns how the sum of all encountered pixels'
+//                  material strength values. This will take wrapping into account.
 
-    return strengthSum;
+float SceneMan::CastStrengthSumRay(const Vector &start, const Vector &end, int skip, unsigned char ignoreMaterial)
+{
+    RayQuery query;
+    query.Type = RAY_STRENGTHSUM;
+    query.Start = start;
+    query.Ray = end;
+    query.MaterialID = ignoreMaterial;
+    query.Skip = skip;
+    CastRay(GetRayPixels(), query);
+    return query.Value;
 }
 
 
@@ -2149,752 +2442,157 @@ float SceneMan::CastStrengthSumRay(const Vector &start, const Vector &end, int s
 
 float SceneMan::CastMaxStrengthRay(const Vector &start, const Vector &end, int skip)
 {
-    Vector ray = g_SceneMan.ShortestDistance(start, end);
-    float maxStrength = 0;
-
-    int error, dom, sub, domSteps, skipped = skip;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    bool foundPixel = false;
-    unsigned char materialID;
-    Material foundMaterial;
-
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    
-    if (delta[X] == 0 &&  delta[Y] == 0)
-        return false;
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
+    RayQuery query;
+    query.Type = RAY_MAXSTRENGTH;
+    query.Start = start;
+    query.Ray = end;
+    query.Skip = skip;
+    CastRay(GetRayPixels(), query);
+    return query.Value;
+}
 
-    if (delta[X] < 0)
-    {
-        increment[X] = -1;
-        delta[X] = -delta[X];
-    }
-    else
-        increment[X] = 1;
 
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastStrengthRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and shows where along that ray there is an
+//                  encounter with a pixel of a material with strength more than or equal
+//                  to a specific value.
 
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
+bool SceneMan::CastStrengthRay(const Vector &start, const Vector &ray, float strength, Vector &result, int skip, unsigned char ignoreMaterial, bool wrap)
+{
+    RayQuery query;
+    query.Type = RAY_STRENGTH;
+    query.Start = start;
+    query.Ray = ray;
+    query.Strength = strength;
+    query.MaterialID = ignoreMaterial;
+    query.Skip = skip;
+    query.Wrap = wrap;
+    CastRay(GetRayPixels(), query, 13);
 
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else
-    {
-        dom = Y;
-        sub = X;
-    }
-
-    error = delta2[sub] - delta[dom];
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
-
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
-    {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
-        {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
-        }
-        error += delta2[sub];
-
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
-        {
-            // Scene wrapping, if necessary
-            g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
-
-            // Sum all strengths
-            materialID = GetTerrMatter(intPos[X], intPos[Y]);
-            if (materialID != g_MaterialDoor)
-                maxStrength = fmax(maxStrength, GetMaterialFromID(materialID)->strength);
-
-            skipped = 0;
-        }
-    }
-    
-    return maxStrength;
-}
-
-
-//////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastStrengthRay
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and shows where along that ray there is an
-//                  encounter with a pixel of a material with strength more than or equal
-//                  to a specific value.
-
-
-bool SceneMan::CastStrengthRay(const Vector &start, const Vector &ray, float strength, Vector &result, int skip, unsigned char ignoreMaterial, bool wrap)
-{
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->LockBitmaps();
-#endif //_DEBUG
-
-    int hitCount = 0, error, dom, sub, domSteps, skipped = skip;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    bool foundPixel = false;
-    unsigned char materialID;
-    Material const * foundMaterial;
-
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    
-    if (delta[X] == 0 &&  delta[Y] == 0)
-        return false;
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
-
-    if (delta[X] < 0)
-    {
-        increment[X] = -1;
-        delta[X] = -delta[X];
-    }
-    else
-        increment[X] = 1;
-
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
-
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
-
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else {
-        dom = Y;
-        sub = X;
-    }
-
-    error = delta2[sub] - delta[dom];
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
-
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
-    {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
-        {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
-        }
-        error += delta2[sub];
-
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
-        {
-            // Scene wrapping, if necessary
-            if (wrap)
-                g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
-
-            materialID = GetTerrMatter(intPos[X], intPos[Y]);
-            // Ignore the ignore material
-            if (materialID != ignoreMaterial)
-            {
-                // Get the material object
-                foundMaterial = GetMaterialFromID(materialID);
-
-                // See if we found a pixel of equal or more strength than the threshold
-                if (foundMaterial->strength >= strength)
-                {
-                    // Save result and report success
-                    foundPixel = true;
-                    result.SetXY(intPos[X], intPos[Y]);
-                    // Save last ray pos
-                    m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                    break;
-                }
-            }
-            skipped = 0;
-
-#ifdef _DEBUG
-            // Draw debug graphics, if applicable
-            if (m_pDebugLayer)
-                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], 13);
-#endif //_DEBUG
-        }
-    }
-
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->UnlockBitmaps();
-#endif //_DEBUG
-
-    // If no pixel of sufficient strength was found, set the result to the final tried position
-    if (!foundPixel)
-        result.SetXY(intPos[X], intPos[Y]);
-
-    return foundPixel;
-}
+    // If no pixel of sufficient strength was found, the result is the final tried position
+    if (query.Steps >= 0)
+        result = query.HitPos;
+    if (query.Hit)
+        m_LastRayHitPos = query.HitPos;
+    return query.Hit;
+}
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          CastWeaknessRay
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Traces along a vector and shows where along that ray there is an
-//                  encounter with a pixel of a material with strength less than or equal
-//                  to a specific value.
-
-bool SceneMan::CastWeaknessRay(const Vector &start, const Vector &ray, float strength, Vector &result, int skip, bool wrap)
-{
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->LockBitmaps();
-#endif //_DEBUG
-
-    int hitCount = 0, error, dom, sub, domSteps, skipped = skip;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    bool foundPixel = false;
-    unsigned char materialID;
-    Material const *foundMaterial;
-
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    
-    if (delta[X] == 0 &&  delta[Y] == 0)
-        return false;
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
-
-    if (delta[X] < 0)
-    {
-        increment[X] = -1;
-        delta[X] = -delta[X];
-    }
-    else
-        increment[X] = 1;
-
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
-
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
-
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else {
-        dom = Y;
-        sub = X;
-    }
-
-    error = delta2[sub] - delta[dom];
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
-
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
-    {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
-        {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
-        }
-        error += delta2[sub];
-
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
-        {
-            // Scene wrapping, if necessary
-            if (wrap)
-                g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
-
-            materialID = GetTerrMatter(intPos[X], intPos[Y]);
-            foundMaterial = GetMaterialFromID(materialID);
-
-            // See if we found a pixel of equal or less strength than the threshold
-            if (foundMaterial->strength <= strength)
-            {
-                // Save result and report success
-                foundPixel = true;
-                result.SetXY(intPos[X], intPos[Y]);
-                // Save last ray pos
-                m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                break;
-            }
-
-            skipped = 0;
-
-#ifdef _DEBUG
-            // Draw debug graphics, if applicable
-            if (m_pDebugLayer)
-                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], 13);
-#endif //_DEBUG
-        }
-    }
-
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->UnlockBitmaps();
-#endif //_DEBUG
-
-    // If no pixel of sufficient strength was found, set the result to the final tried position
-    if (!foundPixel)
-        result.SetXY(intPos[X], intPos[Y]);
-
-    return foundPixel;
-}
-
-
-//////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastMORay
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and returns MOID of the first non-ignored
-//                  non-NoMOID MO encountered. If a non-air terrain pixel is encountered
-//                  first, 0 will be returned.
-
-MOID SceneMan::CastMORay(const Vector &start, const Vector &ray, MOID ignoreMOID, int ignoreTeam, unsigned char ignoreMaterial, bool ignoreAllTerrain, int skip)
-{
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->LockBitmaps();
-#endif //_DEBUG
-
-    int hitCount = 0, error, dom, sub, domSteps, skipped = skip;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    MOID hitMOID = g_NoMOID;
-    unsigned char hitTerrain = 0;
-
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    
-    if (delta[X] == 0 && delta[Y] == 0)
-        return g_NoMOID;
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
-
-    if (delta[X] < 0)
-    {
-        increment[X] = -1;
-        delta[X] = -delta[X];
-    }
-    else
-        increment[X] = 1;
-
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
-
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
-
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else {
-        dom = Y;
-        sub = X;
-    }
-
-    error = delta2[sub] - delta[dom];
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
-
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
-    {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
-        {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
-        }
-        error += delta2[sub];
-
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
-        {
-
-            // Scene wrapping, if necessary
-            g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
-
-            // Detect MOIDs
-            hitMOID = GetMOIDPixel(intPos[X], intPos[Y]);
-            if (hitMOID != g_NoMOID && hitMOID != ignoreMOID && g_MovableMan.GetRootMOID(hitMOID) != ignoreMOID)
-            {
-                // Check if we're supposed to ignore the team of what we hit
-                if (ignoreTeam != Activity::NOTEAM)
-                {
-                    const MovableObject *pHitMO = g_MovableMan.GetMOFromID(hitMOID);
-                    pHitMO = pHitMO ? pHitMO->GetRootParent() : 0;
-                    // Yup, we are supposed to ignore this!
-                    if (pHitMO && pHitMO->IgnoresTeamHits() && pHitMO->GetTeam() == ignoreTeam)
-                    {
-                        ;
-                    }
-                    else
-                    {
-                        // Save last ray pos
-                        m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                        return hitMOID;
-                    }
-                }
-                // Legit hit
-                else
-                {
-                    // Save last ray pos
-                    m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                    return hitMOID;
-                }
-            }
-
-            // Detect terrain hits
-            if (!ignoreAllTerrain)
-            {
-                hitTerrain = g_SceneMan.GetTerrMatter(intPos[X], intPos[Y]);
-                if (hitTerrain != g_MaterialAir && hitTerrain != ignoreMaterial)
-                {
-                    // Save last ray pos
-                    m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                    return g_NoMOID;
-                }
-            }
-
-            skipped = 0;
-
-#ifdef _DEBUG
-            // Draw debug graphics, if applicable
-            if (m_pDebugLayer)
-                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], 120);
-#endif //_DEBUG
-        }
-    }
-
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->UnlockBitmaps();
-#endif //_DEBUG
-
-    // Didn't hit anything but air
-    return g_NoMOID;
-}
-
-
-//////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastFindMORay
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and shows where a specific MOID has been found.
-
-bool SceneMan::CastFindMORay(const Vector &start, const Vector &ray, MOID targetMOID, Vector &resultPos, unsigned char ignoreMaterial, bool ignoreAllTerrain, int skip)
-{
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->LockBitmaps();
-#endif //_DEBUG
-
-    int hitCount = 0, error, dom, sub, domSteps, skipped = skip;;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    MOID hitMOID = g_NoMOID;
-    unsigned char hitTerrain = 0;
-
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    
-    if (delta[X] == 0 && delta[Y] == 0)
-        return g_NoMOID;
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
-
-    if (delta[X] < 0)
-    {
-        increment[X] = -1;
-        delta[X] = -delta[X];
-    }
-    else
-        increment[X] = 1;
-
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
-
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
-
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else {
-        dom = Y;
-        sub = X;
-    }
-
-    error = delta2[sub] - delta[dom];
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
-
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
-    {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
-        {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
-        }
-        error += delta2[sub];
-
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
-        {
-            // Scene wrapping, if necessary
-            g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
-
-            // Detect MOIDs
-            hitMOID = GetMOIDPixel(intPos[X], intPos[Y]);
-            if (hitMOID == targetMOID || g_MovableMan.GetRootMOID(hitMOID) == targetMOID)
-            {
-                // Found target MOID, so save result and report success
-                resultPos.SetXY(intPos[X], intPos[Y]);
-                // Save last ray pos
-                m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                return true;
-            }
-
-            // Detect terrain hits
-            if (!ignoreAllTerrain)
-            {
-                hitTerrain = g_SceneMan.GetTerrMatter(intPos[X], intPos[Y]);
-                if (hitTerrain != g_MaterialAir && hitTerrain != ignoreMaterial)
-                {
-                    // Save last ray pos
-                    m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                    return false;
-                }
-            }
-
-            skipped = 0;
-
-#ifdef _DEBUG
-            // Draw debug graphics, if applicable
-            if (m_pDebugLayer)
-                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], 120);
-#endif //_DEBUG
-        }
-    }
-
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->UnlockBitmaps();
-#endif //_DEBUG
-
-    // Didn't hit the target
-    return false;
-}
-
-
-//////////////////////////////////////////////////////////////////////////////////////////
-// Method:          CastObstacleRay
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Traces along a vector and returns the length of how far the trace went
-//                  without hitting any non-ignored terrain material or MOID at all.
-
-float SceneMan::CastObstacleRay(const Vector &start, const Vector &ray, Vector &obstaclePos, Vector &freePos, MOID ignoreMOID, int ignoreTeam, unsigned char ignoreMaterial, int skip)
-{
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->LockBitmaps();
-#endif //_DEBUG
-
-    int hitCount = 0, error, dom, sub, domSteps, skipped = skip;
-    int intPos[2], delta[2], delta2[2], increment[2];
-    bool hitObstacle = false;
-
-    intPos[X] = floorf(start.m_X);
-    intPos[Y] = floorf(start.m_Y);
-    delta[X] = floorf(start.m_X + ray.m_X) - intPos[X];
-    delta[Y] = floorf(start.m_Y + ray.m_Y) - intPos[Y];
-    // The fraction of a pixel that we start from, to be added to the integer result positions for accuracy
-    Vector startFraction(start.m_X - intPos[X], start.m_Y - intPos[Y]);
-
-    if (delta[X] == 0 && delta[Y] == 0)
-        return false;
-
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm preparation
-
-    if (delta[X] < 0)
-    {
-        increment[X] = -1;
-        delta[X] = -delta[X];
-    }
-    else
-        increment[X] = 1;
-
-    if (delta[Y] < 0)
-    {
-        increment[Y] = -1;
-        delta[Y] = -delta[Y];
-    }
-    else
-        increment[Y] = 1;
-
-    // Scale by 2, for better accuracy of the error at the first pixel
-    delta2[X] = delta[X] << 1;
-    delta2[Y] = delta[Y] << 1;
-
-    // If X is dominant, Y is submissive, and vice versa.
-    if (delta[X] > delta[Y]) {
-        dom = X;
-        sub = Y;
-    }
-    else {
-        dom = Y;
-        sub = X;
-    }
+//                  encounter with a pixel of a material with strength less than or equal
+//                  to a specific value.
 
-    error = delta2[sub] - delta[dom];
+bool SceneMan::CastWeaknessRay(const Vector &start, const Vector &ray, float strength, Vector &result, int skip, bool wrap)
+{
+    RayQuery query;
+    query.Type = RAY_WEAKNESS;
+    query.Start = start;
+    query.Ray = ray;
+    query.Strength = strength;
+    query.Skip = skip;
+    query.Wrap = wrap;
+    CastRay(GetRayPixels(), query, 13);
 
-    /////////////////////////////////////////////////////
-    // Bresenham's line drawing algorithm execution
+    // If no pixel of low enough strength was found, the result is the final tried position
+    if (query.Steps >= 0)
+        result = query.HitPos;
+    if (query.Hit)
+        m_LastRayHitPos = query.HitPos;
+    return query.Hit;
+}
 
-    for (domSteps = 0; domSteps < delta[dom]; ++domSteps)
-    {
-        intPos[dom] += increment[dom];
-        if (error >= 0)
-        {
-            intPos[sub] += increment[sub];
-            error -= delta2[dom];
-        }
-        error += delta2[sub];
 
-        // Only check pixel if we're not due to skip any, or if this is the last pixel
-        if (++skipped > skip || domSteps + 1 == delta[dom])
-        {
-            // Scene wrapping, if necessary
-            g_SceneMan.WrapPosition(intPos[X], intPos[Y]);
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastMORay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and returns MOID of the first non-ignored
+//                  non-NoMOID MO encountered. If a non-air terrain pixel is encountered
+//                  first, g_NoMOID will be returned.
 
-            unsigned char checkMat = GetTerrMatter(intPos[X], intPos[Y]);
-            MOID checkMOID = GetMOIDPixel(intPos[X], intPos[Y]);
+MOID SceneMan::CastMORay(const Vector &start, const Vector &ray, MOID ignoreMOID, int ignoreTeam, unsigned char ignoreMaterial, bool ignoreAllTerrain, int skip)
+{
+    RayQuery query;
+    query.Type = RAY_MO;
+    query.Start = start;
+    query.Ray = ray;
+    query.IgnoreMOID = ignoreMOID;
+    query.IgnoreTeam = ignoreTeam;
+    query.MaterialID = ignoreMaterial;
+    query.IgnoreAllTerrain = ignoreAllTerrain;
+    query.Skip = skip;
+    CastRay(GetRayPixels(), query, 120);
 
-            // Translate any found MOID into the root MOID of that hit MO
-            if (checkMOID != g_NoMOID)
-            {
-                MovableObject *pHitMO = g_MovableMan.GetMOFromID(checkMOID);
-                if (pHitMO)
-                {
-                    checkMOID = pHitMO->GetRootID();
-                    // Check if we're supposed to ignore the team of what we hit
-                    if (ignoreTeam != Activity::NOTEAM)
-                    {
-                        pHitMO = pHitMO->GetRootParent();
-                        // We are indeed supposed to ignore this object because of its ignoring of its specific team
-                        if (pHitMO && pHitMO->IgnoresTeamHits() && pHitMO->GetTeam() == ignoreTeam)
-                            checkMOID = g_NoMOID;
-                    }
-                }
-            }
+    // Save last ray pos, whether it was an MO or the terrain that stopped it
+    if (query.Hit)
+        m_LastRayHitPos = query.HitPos;
+    return query.HitMOID;
+}
 
-            // See if we found the looked-for pixel of the correct material,
-            // Or an MO is blocking the way
-            if ((checkMat != g_MaterialAir && checkMat != ignoreMaterial) || (checkMOID != g_NoMOID && checkMOID != ignoreMOID))
-            {
-                hitObstacle = true;
-                obstaclePos.SetXY(intPos[X], intPos[Y]);
-                // Save last ray pos
-                m_LastRayHitPos.SetIntXY(intPos[X], intPos[Y]);
-                break;
-            }
-            else
-                freePos.SetXY(intPos[X], intPos[Y]);
 
-            skipped = 0;
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastFindMORay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and shows where a specific MOID has been found.
 
-#ifdef _DEBUG
-            // Draw debug graphics, if applicable
-            if (m_pDebugLayer)
-                m_pDebugLayer->SetPixel(intPos[X], intPos[Y], 13);
-#endif //_DEBUG
-        }
-        else
-            freePos.SetXY(intPos[X], intPos[Y]);
-    }
+bool SceneMan::CastFindMORay(const Vector &start, const Vector &ray, MOID targetMOID, Vector &resultPos, unsigned char ignoreMaterial, bool ignoreAllTerrain, int skip)
+{
+    RayQuery query;
+    query.Type = RAY_FINDMO;
+    query.Start = start;
+    query.Ray = ray;
+    query.IgnoreMOID = targetMOID;
+    query.MaterialID = ignoreMaterial;
+    query.IgnoreAllTerrain = ignoreAllTerrain;
+    query.Skip = skip;
+    CastRay(GetRayPixels(), query, 120);
+
+    if (!query.Hit)
+        return false;
 
-#ifdef _DEBUG
-    if (m_pDebugLayer)
-        m_pDebugLayer->UnlockBitmaps();
-#endif //_DEBUG
+    // Save last ray pos, whether it was the target or the terrain that stopped it
+    m_LastRayHitPos = query.HitPos;
+    if (query.HitMOID == g_NoMOID)
+        return false;
+
+    resultPos = query.HitPos;
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastObstacleRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces along a vector and returns the length of how far the trace went
+//                  without hitting any non-ignored terrain material or MOID at all.
 
-    // Add the pixel fraction to the free position if there were any free pixels
-    if (domSteps != 0)
-        freePos += startFraction;
+float SceneMan::CastObstacleRay(const Vector &start, const Vector &ray, Vector &obstaclePos, Vector &freePos, MOID ignoreMOID, int ignoreTeam, unsigned char ignoreMaterial, int skip)
+{
+    RayQuery query;
+    query.Type = RAY_OBSTACLE;
+    query.Start = start;
+    query.Ray = ray;
+    query.FreePos = freePos;
+    query.IgnoreMOID = ignoreMOID;
+    query.IgnoreTeam = ignoreTeam;
+    query.MaterialID = ignoreMaterial;
+    query.Skip = skip;
+    CastRay(GetRayPixels(), query, 13);
 
-    if (hitObstacle)
+    freePos = query.FreePos;
+    if (query.Hit)
     {
-        // Add the pixel fraction to the obstacle position, to acoid losing precision
-        obstaclePos += startFraction;
-        // If there was an obstacle on the start position, return 0 as the distance to obstacle
-        if (domSteps == 0)
-            return 0;
-        // Calculate the length between the start and the found material pixel coords
-        else
-            return g_SceneMan.ShortestDistance(obstaclePos, start).GetMagnitude();
+        obstaclePos = query.HitPos;
+        // Save last ray pos, without the pixel fraction
+        m_LastRayHitPos.SetIntXY(floorf(query.HitPos.m_X), floorf(query.HitPos.m_Y));
     }
 
-    // Didn't hit anything but air
-    return -1.0;
+    // Distance to the obstacle, or -1 if nothing but air was hit
+    return query.Value;
 }
 
 
@@ -2956,47 +2654,392 @@ Vector SceneMan::MovePointToGround(const Vector &from, int maxAltitude, int accu
 // Description:     Calculates the structural integrity of the Terrain during a set time
 //                  and turns structurally unsound areas into MovableObject:s.
 
-void SceneMan::StructuralCalc(unsigned long calcTime) {
+void SceneMan::StructuralCalc(unsigned long calcTime)
+{
+    if (calcTime <= 0 || !m_pCurrentScene || m_StructuralDirtyQueue.empty())
+        return;
+
+    m_CalcTimer.Reset();
+    const BITMAP *pMatBitmap = m_pCurrentScene->GetTerrain()->GetMaterialBitmap();
+
+    // Take the dirty cells a batch at a time, so the time is checked between batches. Whatever's left waits for the next frame
+    while (!m_StructuralDirtyQueue.empty() && !m_CalcTimer.IsPastRealMS(calcTime))
+    {
+        int jobCount = 0;
+        while (jobCount < STRUCTBATCHSIZE && !m_StructuralDirtyQueue.empty())
+        {
+            int cell = m_StructuralDirtyQueue.front();
+            m_StructuralDirtyQueue.pop_front();
+            m_StructuralDirtyCells[cell] = false;
+            m_aStructuralJobs[jobCount++].m_Cell = cell;
+        }
+
+        g_ThreadMan.ParallelFor(jobCount, [&](int job)
+        {
+            FindUnsupportedChunks(m_aStructuralJobs[job], pMatBitmap);
+        });
+
+        // Detaching changes the terrain, so that's done here in order once all the searches are done
+        m_StructuralDebris.clear();
+        for (int job = 0; job < jobCount; ++job)
+            DetachChunks(m_aStructuralJobs[job]);
+        if (!m_StructuralDebris.empty())
+            g_MovableMan.AddParticles(m_StructuralDebris);
+        m_StructuralDebris.clear();
+    }
+}
 
-// TODO: Develop this!")
-    return;
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          MarkStructuralChange
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Marks the cells of the structural grid that an area of the terrain
+//                  touches as needing to be looked at again by StructuralCalc.
 
-    if (calcTime <= 0)
+void SceneMan::MarkStructuralChange(int x, int y, int w, int h)
+{
+    if (!m_pCurrentScene || w <= 0 || h <= 0)
         return;
-    // Pad the time a little for FPS smoothness.
-    calcTime -= 1;
-    m_CalcTimer.Reset();
 
-    SLTerrain *pTerrain = g_SceneMan.GetTerrain();
-    BITMAP *pColBitmap = pTerrain->GetFGColorBitmap();
-    BITMAP *pMatBitmap = pTerrain->GetMaterialBitmap();
-    BITMAP *pStructBitmap = pTerrain->GetStructuralBitmap();
-    Material **pMatPalette = GetMaterialPalette();
-    int posX, posY, height = pColBitmap->h, width = pColBitmap->w;
-
-    // Lock all bitmaps involved, outside the loop.
-    acquire_bitmap(pColBitmap);
-    acquire_bitmap(pMatBitmap);
-    acquire_bitmap(pStructBitmap);
-
-    // Preprocess bottom row to have full support.
-    for (posX = width - 1; posX >= 0; --posX)
-        putpixel(pStructBitmap, posX, height - 1, 255);
-
-    // Start on the second row from bottom.
-    for (posY = height - 2; posY >= 0 && !m_CalcTimer.IsPastSimMS(calcTime); --posY) {
-        for (posX = width - 1; posX >= 0; --posX) {
-            getpixel(pColBitmap, posX, posY);
-            getpixel(pMatBitmap, posX, posY);
-            getpixel(pStructBitmap, posX, posY);
+    int sceneWidth = GetSceneWidth();
+    int sceneHeight = GetSceneHeight();
+    if (m_StructuralCellsX == 0)
+    {
+        m_StructuralCellsX = (sceneWidth + STRUCTCELLSIZE - 1) / STRUCTCELLSIZE;
+        m_StructuralCellsY = (sceneHeight + STRUCTCELLSIZE - 1) / STRUCTCELLSIZE;
+        m_StructuralDirtyCells.assign(m_StructuralCellsX * m_StructuralCellsY, false);
+    }
+
+    int top = MAX(y, 0);
+    int bottom = MIN(y + h, sceneHeight);
+    if (top >= bottom)
+        return;
+
+    bool wrapX = SceneWrapsX();
+    if (w >= sceneWidth)
+    {
+        x = 0;
+        w = sceneWidth;
+    }
+    else if (!wrapX)
+    {
+        w = MIN(x + w, sceneWidth) - MAX(x, 0);
+        x = MAX(x, 0);
+        if (w <= 0)
+            return;
+    }
+
+    for (int cellY = top / STRUCTCELLSIZE; cellY <= (bottom - 1) / STRUCTCELLSIZE; ++cellY)
+    {
+        // Step from cell to cell along the area, wrapping around the seam as needed
+        for (int pixelX = x; pixelX < x + w; )
+        {
+            int sceneX = pixelX % sceneWidth;
+            if (sceneX < 0)
+                sceneX += sceneWidth;
+            int cellX = sceneX / STRUCTCELLSIZE;
+            int cell = cellY * m_StructuralCellsX + cellX;
+            if (!m_StructuralDirtyCells[cell])
+            {
+                m_StructuralDirtyCells[cell] = true;
+                m_StructuralDirtyQueue.push_back(cell);
+            }
+            pixelX += MIN((cellX + 1) * STRUCTCELLSIZE, sceneWidth) - sceneX;
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ClearStructuralGrid
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Forgets all the dirty cells of the structural grid.
+
+void SceneMan::ClearStructuralGrid()
+{
+    m_StructuralDirtyCells.clear();
+    m_StructuralDirtyQueue.clear();
+    m_StructuralCellsX = 0;
+    m_StructuralCellsY = 0;
+}
+
+
+// Finds the first bit at or after a position in a packed row that is set, or clear if looking for clear ones.
+// Returns the limit if there is none before it
+static int NextStructuralBit(const unsigned int *pRow, int from, int limit, bool set)
+{
+    if (from >= limit)
+        return limit;
+
+    int word = from >> 5;
+    unsigned int bits = (set ? pRow[word] : ~pRow[word]) & (0xFFFFFFFFu << (from & 31));
+    while (bits == 0)
+    {
+        if ((++word << 5) >= limit)
+            return limit;
+        bits = set ? pRow[word] : ~pRow[word];
+    }
+
+    int bit = 0;
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    bit = index;
+#else
+    bit = __builtin_ctz(bits);
+#endif
+    return MIN((word << 5) + bit, limit);
+}
+
+// Finds the root run of a union-find set, halving the path on the way
+static int FindStructuralRoot(vector<int> &parents, int run)
+{
+    while (parents[run] != run)
+    {
+        parents[run] = parents[parents[run]];
+        run = parents[run];
+    }
+    return run;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FindUnsupportedChunks
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Finds the chunks of terrain around a dirty cell of the structural
+//                  grid that nothing holds up, without changing anything but the job.
+
+void SceneMan::FindUnsupportedChunks(StructuralJob &job, const BITMAP *pMatBitmap) const
+{
+    int sceneWidth = pMatBitmap->w;
+    int sceneHeight = pMatBitmap->h;
+    int cellX = (job.m_Cell % m_StructuralCellsX) * STRUCTCELLSIZE;
+    int cellY = (job.m_Cell / m_StructuralCellsX) * STRUCTCELLSIZE;
+
+    // The window reaches past the cell on all sides, so chunks that were cut loose right by its edge are seen whole
+    int left = cellX - STRUCTMARGIN;
+    int right = cellX + STRUCTCELLSIZE + STRUCTMARGIN;
+    if (!m_pCurrentScene->WrapsX() || right - left > sceneWidth)
+    {
+        left = MAX(left, 0);
+        right = MIN(right, sceneWidth);
+    }
+    int top = MAX(cellY - STRUCTMARGIN, 0);
+    int bottom = MIN(cellY + STRUCTCELLSIZE + STRUCTMARGIN, sceneHeight);
+    int width = right - left;
+    int height = bottom - top;
+    job.m_WindowX = left;
+    job.m_WindowY = top;
+    job.m_WindowWidth = width;
+    job.m_WindowHeight = height;
+    job.m_RowWords = (width + 31) >> 5;
+
+    // Pack the window into bitsets, reading the material rows directly
+    job.m_Solid.assign(job.m_RowWords * height, 0);
+    job.m_Anchors.assign(job.m_RowWords * height, 0);
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char *pMaterials = pMatBitmap->line[top + y];
+        unsigned int *pSolid = &job.m_Solid[y * job.m_RowWords];
+        unsigned int *pAnchors = &job.m_Anchors[y * job.m_RowWords];
+        for (int x = 0; x < width; ++x)
+        {
+            int sceneX = left + x;
+            if (sceneX < 0)
+                sceneX += sceneWidth;
+            else if (sceneX >= sceneWidth)
+                sceneX -= sceneWidth;
+
+            unsigned char material = pMaterials[sceneX];
+            if (material != g_MaterialAir)
+            {
+                pSolid[x >> 5] |= 1u << (x & 31);
+                if (material == g_MaterialDoor)
+                    pAnchors[x >> 5] |= 1u << (x & 31);
+            }
+        }
+    }
+
+    // Pick the runs of solid pixels out of each row and join the ones that touch runs of the row above, diagonally included
+    job.m_Runs.clear();
+    job.m_Parents.clear();
+    int aboveFirst = 0;
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned int *pSolid = &job.m_Solid[y * job.m_RowWords];
+        int rowFirst = job.m_Runs.size();
+        for (int x = NextStructuralBit(pSolid, 0, width, true); x < width; x = NextStructuralBit(pSolid, x, width, true))
+        {
+            StructuralRun run;
+            run.m_Y = y;
+            run.m_Start = x;
+            run.m_End = NextStructuralBit(pSolid, x, width, false);
+            job.m_Runs.push_back(run);
+            job.m_Parents.push_back(job.m_Parents.size());
+            x = run.m_End;
+        }
+
+        int above = aboveFirst;
+        for (int current = rowFirst; current < job.m_Runs.size(); ++current)
+        {
+            const StructuralRun &run = job.m_Runs[current];
+            // Runs above that end before this one starts can't touch any later ones either
+            while (above < rowFirst && job.m_Runs[above].m_End < run.m_Start)
+                ++above;
+            for (int other = above; other < rowFirst && job.m_Runs[other].m_Start <= run.m_End; ++other)
+            {
+                // Always hang the later root under the earlier one, so every run's parent comes before it
+                int rootA = FindStructuralRoot(job.m_Parents, other);
+                int rootB = FindStructuralRoot(job.m_Parents, current);
+                if (rootA < rootB)
+                    job.m_Parents[rootB] = rootA;
+                else if (rootB < rootA)
+                    job.m_Parents[rootA] = rootB;
+            }
+        }
+        aboveFirst = rowFirst;
+    }
+
+    // Tally up each chunk at its root. Anything reaching the edge of the window may be held up by something outside it,
+    // and the bottom of the scene holds up what's on it, so those count as supported, as does door material
+    int runCount = job.m_Runs.size();
+    int cellLeft = cellX - left;
+    int cellTop = cellY - top;
+    job.m_Pixels.assign(runCount, 0);
+    job.m_InCell.assign(runCount, false);
+    for (int current = 0; current < runCount; ++current)
+    {
+        const StructuralRun &run = job.m_Runs[current];
+        int root = FindStructuralRoot(job.m_Parents, current);
+        if (job.m_Pixels[root] < 0)
+            continue;
+
+        bool supported = run.m_Y == 0 || run.m_Y == height - 1 || run.m_Start == 0 || run.m_End == width ||
+                         NextStructuralBit(&job.m_Anchors[run.m_Y * job.m_RowWords], run.m_Start, run.m_End, true) < run.m_End;
+        if (supported || job.m_Pixels[root] + run.m_End - run.m_Start > STRUCTMAXDEBRIS)
+            job.m_Pixels[root] = -1;
+        else
+        {
+            job.m_Pixels[root] += run.m_End - run.m_Start;
+            // Only chunks the change could have cut loose are of interest, not ones that were already hanging there
+            if (run.m_Y >= cellTop && run.m_Y < cellTop + STRUCTCELLSIZE && run.m_Start < cellLeft + STRUCTCELLSIZE && run.m_End > cellLeft)
+                job.m_InCell[root] = true;
+        }
+    }
+
+    // Number the unsupported chunks and count their runs. Parents come before their runs, so one pass points every run right at its root
+    job.m_Chunks.assign(runCount, -1);
+    job.m_ChunkEnds.clear();
+    for (int current = 0; current < runCount; ++current)
+    {
+        job.m_Parents[current] = job.m_Parents[job.m_Parents[current]];
+        int root = job.m_Parents[current];
+        if (root == current && job.m_Pixels[current] > 0 && job.m_InCell[current])
+        {
+            job.m_Chunks[current] = job.m_ChunkEnds.size();
+            job.m_ChunkEnds.push_back(0);
         }
+        if (job.m_Chunks[root] >= 0)
+            ++job.m_ChunkEnds[job.m_Chunks[root]];
+    }
+
+    // Turn the counts into where each chunk starts, then fill in the runs, which leaves them at where each chunk ends
+    int runTotal = 0;
+    for (int chunk = 0; chunk < job.m_ChunkEnds.size(); ++chunk)
+    {
+        int chunkRuns = job.m_ChunkEnds[chunk];
+        job.m_ChunkEnds[chunk] = runTotal;
+        runTotal += chunkRuns;
+    }
+    job.m_ChunkRuns.resize(runTotal);
+    for (int current = 0; current < runCount && runTotal > 0; ++current)
+    {
+        int chunk = job.m_Chunks[job.m_Parents[current]];
+        if (chunk >= 0)
+            job.m_ChunkRuns[job.m_ChunkEnds[chunk]++] = current;
     }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DetachChunks
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Removes the unsupported chunks a job found from the terrain and turns
+//                  their pixels into debris particles.
+
+void SceneMan::DetachChunks(const StructuralJob &job)
+{
+    if (job.m_ChunkEnds.empty())
+        return;
+
+    SLTerrain *pTerrain = m_pCurrentScene->GetTerrain();
+    BITMAP *pMatBitmap = pTerrain->GetMaterialBitmap();
+    int sceneWidth = pMatBitmap->w;
+    float sprayScale = 0.1;
+
+    int chunkStart = 0;
+    for (int chunk = 0; chunk < job.m_ChunkEnds.size(); ++chunk)
+    {
+        int minX = job.m_WindowWidth;
+        int minY = job.m_WindowHeight;
+        int maxX = -1;
+        int maxY = -1;
+
+        for (int i = chunkStart; i < job.m_ChunkEnds[chunk]; ++i)
+        {
+            const StructuralRun &run = job.m_Runs[job.m_ChunkRuns[i]];
+            int sceneY = job.m_WindowY + run.m_Y;
+            for (int x = run.m_Start; x < run.m_End; ++x)
+            {
+                int sceneX = job.m_WindowX + x;
+                if (sceneX < 0)
+                    sceneX += sceneWidth;
+                else if (sceneX >= sceneWidth)
+                    sceneX -= sceneWidth;
+
+                // Another job of the same batch may have found and taken this chunk already
+                int materialID = _getpixel(pMatBitmap, sceneX, sceneY);
+                if (materialID == g_MaterialAir)
+                    continue;
+
+                Material const * sceneMat = GetMaterialFromID(materialID);
+                Material const * spawnMat = sceneMat->spawnMaterial ? GetMaterialFromID(sceneMat->spawnMaterial) : sceneMat;
+                Color spawnColor;
+                if (spawnMat->UsesOwnColor())
+                    spawnColor = spawnMat->color;
+                else
+                    spawnColor.SetRGBWithIndex(pTerrain->GetFGColorPixel(sceneX, sceneY));
+
+                // No point generating a key-colored MOPixel
+                if (spawnColor.GetIndex() != g_KeyColor)
+                {
+                    // Density is used as the mass for the new MOPixel. The chunk just drops, with a little jostle to break it up
+                    MOPixel *pixelMO = new MOPixel(spawnColor,
+                                                   spawnMat->pixelDensity,
+                                                   Vector(sceneX, sceneY),
+                                                   Vector(RangeRand(-sprayScale, sprayScale), RangeRand(0, sprayScale)),
+                                                   new Atom(Vector(), spawnMat->id, 0, spawnColor, 2),
+                                                   0);
+
+                    pixelMO->SetToHitMOs(spawnMat->id == GOLDMATID);
+                    pixelMO->SetToGetHitByMOs(false);
+                    m_StructuralDebris.push_back(pixelMO);
+                }
+                pTerrain->SetFGColorPixel(sceneX, sceneY, g_KeyColor);
+                pTerrain->SetMaterialPixel(sceneX, sceneY, g_MaterialAir);
+
+                minX = MIN(minX, x);
+                minY = MIN(minY, run.m_Y);
+                maxX = MAX(maxX, x);
+                maxY = MAX(maxY, run.m_Y);
+            }
+        }
+        chunkStart = job.m_ChunkEnds[chunk];
 
-    // Unlock all bitmaps involved.
-    release_bitmap(pColBitmap);
-    release_bitmap(pMatBitmap);
-    release_bitmap(pStructBitmap);
+        // One change covering the whole chunk, which also has the cells around it looked at again in case it held something else up
+        if (maxX >= 0)
+            RegisterTerrainChange(job.m_WindowX + minX, job.m_WindowY + minY, maxX - minX + 1, maxY - minY + 1, g_KeyColor, false);
+    }
 }
 
 
@@ -3158,6 +3201,40 @@ Vector SceneMan::ShortestDistance(Vector pos1, Vector pos2, bool checkBounds)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WrapPositions
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Wraps a whole array of positions at once.
+
+void SceneMan::WrapPositions(Vector *pPositions, int count)
+{
+    DAssert(m_pCurrentScene, "Trying to access scene before there is one!");
+
+    SLTerrain *pTerrain = m_pCurrentScene->GetTerrain();
+    RTE::WrapPositions(pPositions, count, m_pCurrentScene->GetWidth(), m_pCurrentScene->GetHeight(), pTerrain->WrapsX(), pTerrain->WrapsY());
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ShortestDistances
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Calculates the shortest distances from one point to each of a whole
+//                  array of others at once.
+
+void SceneMan::ShortestDistances(const Vector &from, const Vector *pPoints, Vector *pResults, int count)
+{
+    if (!m_pCurrentScene)
+    {
+        for (int i = 0; i < count; ++i)
+            pResults[i].Reset();
+        return;
+    }
+
+    SLTerrain *pTerrain = m_pCurrentScene->GetTerrain();
+    RTE::ShortestDistances(from, pPoints, pResults, count, m_pCurrentScene->GetWidth(), m_pCurrentScene->GetHeight(), pTerrain->WrapsX(), pTerrain->WrapsY());
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          ShortestDistanceX
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -3642,6 +3719,16 @@ void SceneMan::Update(int screen)
     if (screen == 0)
         m_pCurrentScene->Update();
 
+    // Keep the ray counts of everything since the last drawn frame around for the stats
+    if (screen == 0 && g_TimerMan.DrawnSimUpdate())
+    {
+        for (int i = 0; i < RAY_TYPECOUNT; ++i)
+        {
+            m_aLastRayCalls[i] = m_aRayCalls[i].exchange(0);
+            m_aLastRayPixels[i] = m_aRayPixels[i].exchange(0);
+        }
+    }
+
     // Handy
     SLTerrain *pTerrain = m_pCurrentScene->GetTerrain();
 
@@ -3777,11 +3864,38 @@ void SceneMan::Draw(BITMAP *pTargetBitmap, BITMAP *pTargetGUIBitmap, const Vecto
 //    SLICK_PROFILE(0xFF578846);
 
     DAssert(m_pCurrentScene, "Trying to access scene before there is one!");
+
+    // Keep the terrain's own draw mode in line with what we're showing, for anyone else drawing it
+    m_pCurrentScene->GetTerrain()->SetToDrawMaterial(m_LayerDrawMode == g_LayerTerrainMatter);
+
+    DrawLayers(m_LastUpdatedScreen, pTargetBitmap, skipSkybox, skipTerrain);
+
+    if (m_LayerDrawMode != g_LayerTerrainMatter && m_LayerDrawMode != g_LayerMOID)
+    {
+        DrawScreenGUI(m_LastUpdatedScreen, pTargetGUIBitmap, targetPos);
+
+#ifdef _DEBUG
+        // Debug
+        m_pDebugLayer->Draw(pTargetBitmap, Box());
+#endif // _DEBUG
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawLayers
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws the scene and movable object layers as seen by a specific
+//                  screen, using that screen's own scroll offset.
+
+void SceneMan::DrawLayers(int screen, BITMAP *pTargetBitmap, bool skipSkybox, bool skipTerrain) const
+{
+    DAssert(m_pCurrentScene, "Trying to access scene before there is one!");
     // Handy
     SLTerrain *pTerrain = m_pCurrentScene->GetTerrain();
 
     // Learn about the unseen layer, if any
-    int team = m_ScreenTeam[m_LastUpdatedScreen];
+    int team = m_ScreenTeam[screen];
     SceneLayer *pUnseenLayer = team != Activity::NOTEAM ? m_pCurrentScene->GetUnseenLayer(team) : 0;
 
     // Set up the target box to draw to on the target bitmap, if it is larger than the scene in either dimension
@@ -3798,66 +3912,61 @@ void SceneMan::Draw(BITMAP *pTargetBitmap, BITMAP *pTargetGUIBitmap, const Vecto
         targetBox.m_Height = GetSceneHeight();
     }
 
+    const Vector &offset = m_Offset[screen];
+
     switch (m_LayerDrawMode)
     {
         case g_LayerTerrainMatter:
-            pTerrain->SetToDrawMaterial(true);
-            pTerrain->Draw(pTargetBitmap, targetBox);
-//            m_pMOColorLayer->Draw(pTargetBitmap, targetBox);
-
-//            sprintf(str, "Terrain Matter\nHit M to cycle modes");
-//            g_FrameMan.DrawText(pTargetBitmap, str, Vector(475, 4), false);
+            pTerrain->DrawAtOffset(pTargetBitmap, targetBox, offset);
             break;
 
         case g_LayerMOID:
-            m_pMOIDLayer->Draw(pTargetBitmap, targetBox);
-//            sprintf(str, "MovableObject ID\nHit M to cycle modes");
-//            g_FrameMan.DrawText(pTargetBitmap, str, Vector(475, 4), false);
+            m_pMOIDLayer->DrawAtOffset(pTargetBitmap, targetBox, offset);
             break;
 
         // Draw normally
         default:
-			if (skipSkybox)
-			{
-
-			} 
-			else
-			{
-				// Background Layers
-				for (list<SceneLayer *>::reverse_iterator itr = m_pCurrentScene->GetBackLayers().rbegin(); itr != m_pCurrentScene->GetBackLayers().rend(); ++itr)
-					(*itr)->Draw(pTargetBitmap, targetBox);
-			}
+            if (!skipSkybox)
+            {
+                // Background layers may scroll in fractions of the real offset, so give them the total offset, not taking any wrappings into account
+                Vector offsetUnwrapped = offset;
+                offsetUnwrapped.m_X += pTerrain->GetBitmap()->w * m_SeamCrossCount[screen][X];
+                offsetUnwrapped.m_Y += pTerrain->GetBitmap()->h * m_SeamCrossCount[screen][Y];
+
+                // Background Layers
+                for (list<SceneLayer *>::reverse_iterator itr = m_pCurrentScene->GetBackLayers().rbegin(); itr != m_pCurrentScene->GetBackLayers().rend(); ++itr)
+                    (*itr)->DrawAtOffset(pTargetBitmap, targetBox, offsetUnwrapped);
+            }
 
-			if (!skipTerrain)
-				// Terrain background
-				pTerrain->DrawBackground(pTargetBitmap, targetBox);
+            if (!skipTerrain)
+                // Terrain background
+                pTerrain->DrawBackgroundAtOffset(pTargetBitmap, targetBox, offset);
             // Movables' color layer
-            m_pMOColorLayer->Draw(pTargetBitmap, targetBox);
+            m_pMOColorLayer->DrawAtOffset(pTargetBitmap, targetBox, offset);
             // Terrain foreground
-            pTerrain->SetToDrawMaterial(false);
-			if (!skipTerrain)
-				pTerrain->Draw(pTargetBitmap, targetBox);
+            if (!skipTerrain)
+                pTerrain->DrawForegroundAtOffset(pTargetBitmap, targetBox, offset);
 
             // Obscure unexplored/unseen areas
             if (pUnseenLayer && !g_FrameMan.IsInMultiplayerMode())
             {
                 // Draw the unseen obstruction layer so it obscures the team's view
-                pUnseenLayer->DrawScaled(pTargetBitmap, targetBox);
+                pUnseenLayer->DrawScaledAtOffset(pTargetBitmap, targetBox, offset);
             }
+    }
+}
 
-            // Actor and gameplay HUDs and GUIs
-            g_MovableMan.DrawHUD(pTargetGUIBitmap, targetPos, m_LastUpdatedScreen);
-			g_FrameMan.DrawPrimitives(m_LastUpdatedScreen, pTargetGUIBitmap, targetPos);
-//            g_ActivityMan.GetActivity()->Draw(pTargetBitmap, targetPos, m_LastUpdatedScreen);
-            g_ActivityMan.GetActivity()->DrawGUI(pTargetGUIBitmap, targetPos, m_LastUpdatedScreen);
 
-//            sprintf(str, "Normal Layer Draw Mode\nHit M to cycle modes");
-//            g_FrameMan.DrawText(pTargetBitmap, str, Vector(475, 4), false);
-#ifdef _DEBUG
-            // Debug
-            m_pDebugLayer->Draw(pTargetBitmap, Box());
-#endif // _DEBUG
-    }
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawScreenGUI
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws the actor and gameplay HUDs and GUIs for a specific screen.
+
+void SceneMan::DrawScreenGUI(int screen, BITMAP *pTargetGUIBitmap, const Vector &targetPos)
+{
+    g_MovableMan.DrawHUD(pTargetGUIBitmap, targetPos, screen);
+    g_FrameMan.DrawPrimitives(screen, pTargetGUIBitmap, targetPos);
+    g_ActivityMan.GetActivity()->DrawGUI(pTargetGUIBitmap, targetPos, screen);
 }
 
 
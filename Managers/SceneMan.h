@@ -18,7 +18,10 @@
 #include <fstream>
 #include <string>
 #include <list>
+#include <vector>
 #include <queue>
+#include <deque>
+#include <atomic>
 
 
 // *** TEMP
@@ -78,6 +81,7 @@ enum
 #define NUM_PALETTE_ENTRIES 256
 #define MOID_BITMAP_LAYER_DEPTH 16
 #define MAXORPHANRADIUS 11
+#define STRUCTBATCHSIZE 8
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Struct:          IntRect
@@ -132,6 +136,89 @@ class SceneMan:
 public:
 
 
+    // The different kinds of rays that can be cast through the scene
+    enum RayType
+    {
+        RAY_UNSEEN = 0,
+        RAY_MATERIAL,
+        RAY_NOTMATERIAL,
+        RAY_STRENGTHSUM,
+        RAY_MAXSTRENGTH,
+        RAY_STRENGTH,
+        RAY_WEAKNESS,
+        RAY_MO,
+        RAY_FINDMO,
+        RAY_OBSTACLE,
+        RAY_TYPECOUNT
+    };
+
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Nested struct:   RayQuery
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Description:     One ray to cast with CastRays, and what it came back with. Which of the
+    //                  inputs and results mean anything depends on the type of the ray, and
+    //                  they mirror the arguments and return values of the matching Cast*Ray.
+    struct RayQuery
+    {
+        RayQuery() { Type = RAY_MATERIAL; Skip = 0; MaterialID = 0; Strength = 0; IgnoreMOID = g_NoMOID; IgnoreTeam = Activity::NOTEAM; IgnoreAllTerrain = false; CheckMOs = false; Wrap = true; Hit = false; Steps = -1; Value = -1; HitMOID = g_NoMOID; }
+
+        // Inputs
+        RayType Type;
+        Vector Start;
+        // The ray vector, or the end point for RAY_STRENGTHSUM and RAY_MAXSTRENGTH
+        Vector Ray;
+        int Skip;
+        // The material to look for (RAY_MATERIAL, RAY_NOTMATERIAL) or to ignore (all others)
+        unsigned char MaterialID;
+        float Strength;
+        // The MOID to ignore, or to look for with RAY_FINDMO
+        MOID IgnoreMOID;
+        int IgnoreTeam;
+        bool IgnoreAllTerrain;
+        bool CheckMOs;
+        bool Wrap;
+
+        // Results
+        // Whether the ray was stopped by anything
+        bool Hit;
+        // How many pixels were stepped along before stopping, -1 if the ray was too short to cast
+        int Steps;
+        // Distance to the hit for the distance returning rays, otherwise the strength sum or max
+        float Value;
+        // Where the ray stopped, or the last pixel it got to
+        Vector HitPos;
+        // The last free pixel, for RAY_OBSTACLE
+        Vector FreePos;
+        // What was hit by RAY_MO, or the target MOID if RAY_FINDMO found it
+        MOID HitMOID;
+    };
+
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Nested struct:   RayPixels
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Description:     Direct, read-only access to the terrain material and MOID layers for
+    //                  the ray casting, without going through the per-pixel getters.
+    struct RayPixels
+    {
+        // Wraps a position the same way the terrain does
+        void Wrap(int &posX, int &posY) const;
+        // Gets the terrain material at a position, air if out of bounds
+        unsigned char GetMaterialID(int posX, int posY) const;
+        // Gets the MOID at a position, g_NoMOID if out of bounds
+        MOID GetMOID(int posX, int posY) const;
+        // Gets a material from its ID, air if there is no such material
+        Material const * GetMaterial(unsigned char materialID) const { return m_apMaterials[materialID] ? m_apMaterials[materialID] : m_apMaterials[g_MaterialAir]; }
+
+        BITMAP *m_pMaterialBitmap;
+        BITMAP *m_pMOIDBitmap;
+        bool m_WrapX;
+        bool m_WrapY;
+        Material const * const *m_apMaterials;
+    };
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Constructor:     SceneMan
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -139,7 +226,7 @@ public:
 //                  memory. Create() should be called before using the object.
 // Arguments:       None.
 
-    SceneMan() { m_pOrphanSearchBitmap = 0; Clear(); }
+    SceneMan() { Clear(); }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -846,14 +933,14 @@ public:
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Method:          ClearAllMOIDDrawings
+// Method:          TakeMOIDDrawings
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Clears all registered drawn areas of the MOID layer to the g_NoMOID
-//                  color and clears the registrations too. Should be done each sim update.
-// Arguments:       None.
+// Description:     Hands over all registered drawn areas of the MOID layer without
+//                  clearing them, for whoever keeps track of them from there on.
+// Arguments:       The list to add the registered areas to.
 // Return value:    None.
 
-    void ClearAllMOIDDrawings();
+    void TakeMOIDDrawings(std::vector<IntRect> &drawings);
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -945,39 +1032,19 @@ public:
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          RemoveOrphans
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Returns the area of an orphaned region at specified coordinates. 
-// Arguments:       Coordinates to check for region, whether the orphaned region should be converted into MOPixels and region removed.
-//					Area of orphaned object calculated during recursve function call to check if we're out of limits
-//					Size of the are to look for orphaned objects
+// Description:     Returns the area of an orphaned region at specified coordinates, and
+//                  removes the region if requested. The region is found with a single
+//                  iterative scanline fill bounded by the search window, so the work
+//                  done per call is never more than radius * radius pixels.
+// Arguments:       Coordinates to check for region, which serve as the center of the search window.
+//					Size of the area to look for orphaned objects
 //					Max area of orphaned object to remove
-//					Whether to actually remove orphaned pixels or not
-//					Whether to clear internal terrain tracking bitmap or not
-// Return value:    The area of orphaned region at posX,posY
+//					Whether to actually remove orphaned pixels (turning them into MOPixels) or not
+// Return value:    The area of orphaned region at posX,posY. More than maxArea if the region
+//                  is too big, or reaches the edge of the search window.
 
     int RemoveOrphans(int posX, int posY, int radius, int maxArea, bool remove = false);
 
-//////////////////////////////////////////////////////////////////////////////////////////
-// Method:          RemoveOrphans
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Returns the area of an orphaned region at specified coordinates. 
-// Arguments:       Coordinates to check for region, whether the orphaned region should be converted into MOPixels and region removed.
-//					Coordinates of initial terrain penetration to check, which serves as a center of orphaned object detection.
-//					Area of orphaned object calculated during recursve function call to check if we're out of limits
-//					Size of the are to look for orphaned objects
-//					Max area of orphaned object to remove
-//					Whether to actually remove orphaned pixels or not
-//					Whether to clear internal terrain tracking bitmap or not
-// Return value:    The area of orphaned region at posX,posY
-
-    int RemoveOrphans(int posX,
-					  int posY,
-					  int centerPosX,
-					  int centerPosY,
-					  int accumulatedArea,
-					  int radius,
-					  int maxArea,
-					  bool remove = false);
-
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          MakeAllUnseen
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1127,6 +1194,24 @@ public:
 
     bool CastSeeRay(int team, const Vector &start, const Vector &ray, Vector &endPos, int strengthLimit, int skip = 0);
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastSeeRayFan
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Traces a fan of rays spread evenly around a center ray, revealing
+//                  pixels on the unseen layer of a team like CastSeeRay does for each.
+//                  Much cheaper than casting the rays one by one.
+// Arguments:       The team to see for.
+//                  The starting position of all the rays.
+//                  The ray in the middle of the fan, which also sets the rays' length.
+//                  How many degrees the fan spans, from its first ray to its last.
+//                  How many rays to cast.
+//                  The strength limit of each ray, as with CastSeeRay.
+//                  For every pixel checked, how many to skip to the next one.
+// Return value:    How many of the rays revealed any pixels.
+
+    int CastSeeRayFan(int team, const Vector &start, const Vector &centerRay, float spreadDegrees, int rayCount, int strengthLimit, int skip = 0);
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          CastUnseeRay
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1368,6 +1453,49 @@ public:
     const Vector & GetLastRayHitPos() { return m_LastRayHitPos; }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastRays
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Casts a whole batch of rays at once, spread across the worker threads.
+//                  Only reads the scene, so the RAY_UNSEEN type isn't supported, and the
+//                  last ray hit position isn't updated. Nothing may change the terrain or
+//                  the MOID layer while this runs.
+// Arguments:       The rays to cast. Their results are filled in.
+// Return value:    None.
+
+    void CastRays(std::vector<RayQuery> &rays);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetRayCallCount
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets how many rays of a type were cast during the last drawn frame.
+// Arguments:       The type of ray.
+// Return value:    The number of rays of that type cast.
+
+    int GetRayCallCount(RayType type) const { return m_aLastRayCalls[type]; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetRayPixelCount
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets how many pixels rays of a type checked during the last drawn frame.
+// Arguments:       The type of ray.
+// Return value:    The number of pixels checked by rays of that type.
+
+    int GetRayPixelCount(RayType type) const { return m_aLastRayPixels[type]; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetRayTypeName
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets a short display name of a type of ray.
+// Arguments:       The type of ray.
+// Return value:    The name of that type.
+
+    static const char * GetRayTypeName(RayType type) { return m_aRayTypeNames[type]; }
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          FindAltitude
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1421,6 +1549,17 @@ public:
     void StructuralCalc(unsigned long calcTime);
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          MarkStructuralChange
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Marks the cells of the structural grid that an area of the terrain
+//                  touches as needing to be looked at again by StructuralCalc.
+// Arguments:       x,y - scene coordinates of the area, w,h - size of the area.
+// Return value:    None.
+
+    void MarkStructuralChange(int x, int y, int w, int h);
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          IsWithinBounds
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1504,6 +1643,34 @@ public:
     Vector ShortestDistance(Vector pos1, Vector pos2, bool checkBounds = false);
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WrapPositions
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Wraps a whole array of positions at once, like calling WrapPosition
+//                  on each of them.
+// Arguments:       The positions to wrap, if needed.
+//                  How many positions there are.
+// Return value:    None.
+
+    void WrapPositions(Vector *pPositions, int count);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ShortestDistances
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Calculates the shortest distances from one point to each of a whole
+//                  array of others at once, like calling ShortestDistance(from, point)
+//                  on each of them. The points all have to be within the scene bounds
+//                  already; use WrapPositions on them first if they might not be.
+// Arguments:       The position to measure from.
+//                  The positions to measure to.
+//                  Where to put the resulting shortest distance vectors.
+//                  How many positions there are to measure to.
+// Return value:    None.
+
+    void ShortestDistances(const Vector &from, const Vector *pPoints, Vector *pResults, int count);
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          ShortestDistanceX
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1744,6 +1911,39 @@ public:
     void Draw(BITMAP *pTargetBitmap, BITMAP *pTargetGUIBitmap,  const Vector &targetPos = Vector(), bool skipSkybox = false, bool skipTerrain = false);
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawLayers
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws the scene and movable object layers as seen by a specific
+//                  screen, using that screen's own scroll offset rather than the one
+//                  last set on the layers. Update() must have been called for the
+//                  screen first. Doesn't change any state, so several screens can be
+//                  drawn at once from different threads, each to its own bitmap.
+// Arguments:       Which screen to draw the layers for.
+//                  A pointer to a BITMAP to draw on, appropriately sized for the split
+//                  screen segment.
+//                  Whether to skip the background layers.
+//                  Whether to skip the terrain layers.
+// Return value:    None.
+
+    void DrawLayers(int screen, BITMAP *pTargetBitmap, bool skipSkybox = false, bool skipTerrain = false) const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DrawScreenGUI
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Draws the actor and gameplay HUDs and GUIs for a specific screen.
+//                  Only to be done from the main thread.
+// Arguments:       Which screen to draw the GUIs for.
+//                  A pointer to a BITMAP to draw on, appropriately sized for the split
+//                  screen segment.
+//                  The offset into the scene where the target bitmap's upper left corner
+//                  is located.
+// Return value:    None.
+
+    void DrawScreenGUI(int screen, BITMAP *pTargetGUIBitmap, const Vector &targetPos);
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          ClearMOColorLayer
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1799,6 +1999,7 @@ public:
 // Method:          RegisterTerrainChange
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Registers terrain change event for the network server to be then sent to clients.
+//                  Foreground changes also mark the area for the structural calculations.
 // Arguments:       x,y - scene coordinates of change, w,h - size of the changed region, 
 //					color - changed color for one-pixel events, 
 //					back - if true, then background bitmap was changed if false then foreground.
@@ -1926,6 +2127,14 @@ protected:
 
     // The last screen everything has been updated to
     int m_LastUpdatedScreen;
+
+    // How many rays of each type have been cast and how many pixels they checked since the last drawn frame. Rays can be cast from several threads
+    mutable std::atomic<int> m_aRayCalls[RAY_TYPECOUNT];
+    mutable std::atomic<int> m_aRayPixels[RAY_TYPECOUNT];
+    // The ray counts of the last drawn frame
+    int m_aLastRayCalls[RAY_TYPECOUNT];
+    int m_aLastRayPixels[RAY_TYPECOUNT];
+    static const char * const m_aRayTypeNames[RAY_TYPECOUNT];
     // Whether we're in second pass of the structural computations.
     // Second pass is where structurally unsound areas of the Terrain are turned into
     // MovableObject:s.
@@ -1937,8 +2146,70 @@ protected:
 
     // The Timer to measure time between cleanings of the color layer of the Terrain.
     Timer m_CleanTimer;
-	// Bitmap to look for orphaned regions
-	BITMAP * m_pOrphanSearchBitmap;
+	// Visited marks of the orphan search window, stamped with the generation of the search that visited them so they never need clearing
+	unsigned int m_aOrphanSearchVisited[MAXORPHANRADIUS * MAXORPHANRADIUS];
+	// The generation of the current orphan search
+	unsigned int m_OrphanSearchGeneration;
+	// Explicit stack of seed pixels (window indices) for the orphan scanline fill
+	std::vector<int> m_OrphanSearchStack;
+	// The window indices of the pixels found in the current orphaned region
+	std::vector<int> m_OrphanRegion;
+	// The particles made out of a removed orphaned region, handed over to MovableMan in one go
+	std::vector<MovableObject *> m_OrphanDebris;
+
+    // A run of solid pixels on one row of a structural search window, in window coordinates
+    struct StructuralRun
+    {
+        int m_Y;
+        int m_Start;
+        // One past the last pixel of the run
+        int m_End;
+    };
+
+    // The work of finding the unsupported chunks of terrain around one dirty cell of the structural grid.
+    // The buffers are kept between frames so they only ever grow
+    struct StructuralJob
+    {
+        // The cell of the structural grid this is about
+        int m_Cell;
+        // The search window in scene coordinates; the left edge can be off the scene if it wraps
+        int m_WindowX;
+        int m_WindowY;
+        int m_WindowWidth;
+        int m_WindowHeight;
+        // How many 32 bit words each row of the packed bitsets takes
+        int m_RowWords;
+        // One bit per pixel of the window that isn't air, row after row
+        std::vector<unsigned int> m_Solid;
+        // One bit per pixel of the window that is door material, which always holds up whatever it's part of
+        std::vector<unsigned int> m_Anchors;
+        // All the runs of solid pixels in the window, row by row
+        std::vector<StructuralRun> m_Runs;
+        // Union-find parents of the runs, merging the ones that touch into chunks
+        std::vector<int> m_Parents;
+        // Pixel count of each chunk, kept at the root run; -1 when it's held up by something
+        std::vector<int> m_Pixels;
+        // Whether each chunk reaches into the cell itself, kept at the root run
+        std::vector<bool> m_InCell;
+        // Which unsupported chunk each root run heads, -1 for none
+        std::vector<int> m_Chunks;
+        // The runs of the unsupported chunks, grouped chunk by chunk
+        std::vector<int> m_ChunkRuns;
+        // One past the last index into m_ChunkRuns of each unsupported chunk
+        std::vector<int> m_ChunkEnds;
+    };
+
+    // Whether each cell of the structural grid has had terrain changes that aren't looked at yet
+    std::vector<bool> m_StructuralDirtyCells;
+    // The dirty cells in the order they were marked
+    std::deque<int> m_StructuralDirtyQueue;
+    // The size of the structural grid in cells, 0 until something is first marked in the current scene
+    int m_StructuralCellsX;
+    int m_StructuralCellsY;
+    // One job per dirty cell handled in a batch, spread across the worker threads
+    StructuralJob m_aStructuralJobs[STRUCTBATCHSIZE];
+    // The particles made out of the unsupported chunks of a batch, handed over to MovableMan in one go
+    std::vector<MovableObject *> m_StructuralDebris;
 
 
 // TODO TEMP REMOVE
@@ -1952,6 +2223,86 @@ protected:
 
 private:
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetRayPixels
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets up direct access to the layers that rays are cast through.
+// Arguments:       None.
+// Return value:    The layer access for the current scene.
+
+    RayPixels GetRayPixels() const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          TraceRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     The one Bresenham traversal behind all the ray casts. Walks along a
+//                  ray and hands each checked pixel to a visitor, which decides whether
+//                  to stop there. Pixels skipped over are handed to it separately.
+// Arguments:       The type of ray, for the counters.
+//                  The layers to read from.
+//                  The start position and the ray vector.
+//                  How many pixels to skip between each checked one.
+//                  Whether to wrap the traversed positions around the scene.
+//                  The visitor, with bool Check(const RayPixels &, int x, int y) and
+//                  void Pass(int x, int y) methods.
+//                  Where to put the last traversed position.
+//                  The color to mark checked pixels with on the debug layer, 0 for none.
+// Return value:    How many steps were taken before stopping, or -1 if the ray is too
+//                  short to traverse at all.
+
+    template <class RayVisitor>
+    int TraceRay(RayType type, const RayPixels &pixels, const Vector &start, const Vector &ray, int skip, bool wrap, RayVisitor &visitor, int endPos[2], int debugColor = 0) const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          CastRay
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Casts a single ray of a batch, without touching any SceneMan state
+//                  other than the ray counters.
+// Arguments:       The layers to read from.
+//                  The ray to cast, which gets its results filled in.
+//                  The color to mark checked pixels with on the debug layer, 0 for none.
+// Return value:    None.
+
+    void CastRay(const RayPixels &pixels, RayQuery &query, int debugColor = 0) const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FindUnsupportedChunks
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Finds the chunks of terrain around a dirty cell of the structural
+//                  grid that nothing holds up, without changing anything but the job.
+//                  Safe to run for several jobs at once on the worker threads.
+// Arguments:       The job with the cell to look around, which gets the chunks filled in.
+//                  The material bitmap of the terrain.
+// Return value:    None.
+
+    void FindUnsupportedChunks(StructuralJob &job, const BITMAP *pMatBitmap) const;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          DetachChunks
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Removes the unsupported chunks a job found from the terrain and turns
+//                  their pixels into debris particles in m_StructuralDebris.
+// Arguments:       The job to detach the chunks of.
+// Return value:    None.
+
+    void DetachChunks(const StructuralJob &job);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ClearStructuralGrid
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Forgets all the dirty cells of the structural grid, which gets sized
+//                  to the scene again the next time something is marked.
+// Arguments:       None.
+// Return value:    None.
+
+    void ClearStructuralGrid();
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Clear
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -89,7 +89,12 @@ void SettingsMan::Clear()
 	m_ServerFastAccelerationFactor = 1;
 	m_ServerUseInterlacing = false;
 	m_ServerEncodingFps = 30;
+	m_ServerAdaptiveBitrate = true;
+	m_ServerMinEncodingFps = 10;
+	m_ServerMaxHighCompressionLevel = 12;
 	m_ClientInputFps = 30;
+	m_ClientPlayoutDelay = 50;
+	m_ClientAdaptivePlayout = true;
 
 	m_ServerTransmitAsBoxes = true;
 	m_ServerBoxWidth = 32;
@@ -97,6 +102,9 @@ void SettingsMan::Clear()
 
 	m_UseNATService = false;
 	m_DisableLoadingScreen = false;
+	m_SilhouetteAngleBuckets = 128;
+	m_LuaWorkerStates = 0;
+	m_StructuralCalcTime = 0;
 
 	m_AudioChannels = 32;
 
@@ -322,6 +330,12 @@ int SettingsMan::ReadProperty(std::string propName, Reader &reader)
 		reader >> m_ServerUseInterlacing;
 	else if (propName == "ServerEncodingFps")
 		reader >> m_ServerEncodingFps;
+	else if (propName == "ServerAdaptiveBitrate")
+		reader >> m_ServerAdaptiveBitrate;
+	else if (propName == "ServerMinEncodingFps")
+		reader >> m_ServerMinEncodingFps;
+	else if (propName == "ServerMaxHighCompressionLevel")
+		reader >> m_ServerMaxHighCompressionLevel;
 	else if (propName == "ServerTransmitAsBoxes")
 		reader >> m_ServerTransmitAsBoxes;
 	else if (propName == "ServerBoxWidth")
@@ -330,6 +344,10 @@ int SettingsMan::ReadProperty(std::string propName, Reader &reader)
 		reader >> m_ServerBoxHeight;
 	else if (propName == "ClientInputFps")
 		reader >> m_ClientInputFps;
+	else if (propName == "ClientPlayoutDelay")
+		reader >> m_ClientPlayoutDelay;
+	else if (propName == "ClientAdaptivePlayout")
+		reader >> m_ClientAdaptivePlayout;
 	else if (propName == "UseNATService")
 		reader >> m_UseNATService;
 	else if (propName == "NATServiceAddress")
@@ -346,6 +364,12 @@ int SettingsMan::ReadProperty(std::string propName, Reader &reader)
 		reader >> m_AudioChannels;
 	else if (propName == "DisableLoadingScreen")
 		reader >> m_DisableLoadingScreen;
+	else if (propName == "SilhouetteAngleBuckets")
+		reader >> m_SilhouetteAngleBuckets;
+	else if (propName == "LuaWorkerStates")
+		reader >> m_LuaWorkerStates;
+	else if (propName == "StructuralCalcTime")
+		reader >> m_StructuralCalcTime;
 	else if (propName == "SoundVolume")
     {
         int volume = 0;
@@ -530,6 +554,12 @@ int SettingsMan::Save(Writer &writer) const
 	writer << m_ServerUseInterlacing;
 	writer.NewProperty("ServerEncodingFps");
 	writer << m_ServerEncodingFps;
+	writer.NewProperty("ServerAdaptiveBitrate");
+	writer << m_ServerAdaptiveBitrate;
+	writer.NewProperty("ServerMinEncodingFps");
+	writer << m_ServerMinEncodingFps;
+	writer.NewProperty("ServerMaxHighCompressionLevel");
+	writer << m_ServerMaxHighCompressionLevel;
 	writer.NewProperty("ServerTransmitAsBoxes");
 	writer << m_ServerTransmitAsBoxes;
 	writer.NewProperty("ServerBoxWidth");
@@ -538,6 +568,10 @@ int SettingsMan::Save(Writer &writer) const
 	writer << m_ServerBoxHeight;
 	writer.NewProperty("ClientInputFps");
 	writer << m_ClientInputFps;
+	writer.NewProperty("ClientPlayoutDelay");
+	writer << m_ClientPlayoutDelay;
+	writer.NewProperty("ClientAdaptivePlayout");
+	writer << m_ClientAdaptivePlayout;
 	writer.NewProperty("UseNATService");
 	writer << m_UseNATService;
 
@@ -566,6 +600,12 @@ int SettingsMan::Save(Writer &writer) const
 	
 	writer.NewProperty("DisableLoadingScreen");
 	writer << m_DisableLoadingScreen;
+	writer.NewProperty("SilhouetteAngleBuckets");
+	writer << m_SilhouetteAngleBuckets;
+	writer.NewProperty("LuaWorkerStates");
+	writer << m_LuaWorkerStates;
+	writer.NewProperty("StructuralCalcTime");
+	writer << m_StructuralCalcTime;
 
 	writer.NewProperty("AudioChannels");
 	writer << m_AudioChannels;
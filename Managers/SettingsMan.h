@@ -594,12 +594,62 @@ public:
 	//  
 	int GetServerEncodingFps() const { return m_ServerEncodingFps; }
 
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:			GetServerAdaptiveBitrate
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:		Gets whether the server adapts the frame rate, interlacing, box size
+	//					and compression of each client's stream to its connection.
+	// Arguments:		None.
+	// Return value:	Whether the streams adapt.
+
+	bool GetServerAdaptiveBitrate() const { return m_ServerAdaptiveBitrate; }
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:			GetServerMinEncodingFps
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:		Gets the lowest frame rate an adaptive stream drops to on a congested
+	//					connection. ServerEncodingFps is the highest.
+	// Arguments:		None.
+	// Return value:	The lowest frame rate.
+
+	int GetServerMinEncodingFps() const { return m_ServerMinEncodingFps; }
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:			GetServerMaxHighCompressionLevel
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:		Gets the highest compression level an adaptive stream goes up to on a
+	//					congested connection, when there's time left to encode at it.
+	// Arguments:		None.
+	// Return value:	The highest compression level.
+
+	int GetServerMaxHighCompressionLevel() const { return m_ServerMaxHighCompressionLevel; }
+
 	//////////////////////////////////////////////////////////////////////////////////////////
 	// Method:			_
 	//////////////////////////////////////////////////////////////////////////////////////////
 	//  
 	int GetClientInputFps() const { return m_ClientInputFps; }
 
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:			GetClientPlayoutDelay
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:		Gets how long a network client holds received frames back at the
+	//					least before showing them, to smooth out uneven arrival.
+	// Arguments:		None.
+	// Return value:	The playout delay in ms.
+
+	int GetClientPlayoutDelay() const { return m_ClientPlayoutDelay; }
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:			GetClientAdaptivePlayout
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:		Gets whether a network client holds frames back longer than the
+	//					playout delay when they arrive with a lot of jitter.
+	// Arguments:		None.
+	// Return value:	Whether the playout delay adapts to the jitter.
+
+	bool GetClientAdaptivePlayout() const { return m_ClientAdaptivePlayout; }
+
 	//////////////////////////////////////////////////////////////////////////////////////////
 	// Method:			_
 	//////////////////////////////////////////////////////////////////////////////////////////
@@ -640,6 +690,28 @@ public:
 
 	bool DisableLoadingScreen() { return m_DisableLoadingScreen; }
 
+	int GetSilhouetteAngleBuckets() { return m_SilhouetteAngleBuckets; }
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:			GetLuaWorkerStates
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:		Gets how many Lua states the scripts of presets that support it are
+	//					run in, in parallel on the worker threads.
+	// Arguments:		None.
+	// Return value:	The number of worker states, 0 to run them all in a single one.
+
+	int GetLuaWorkerStates() const { return m_LuaWorkerStates; }
+
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Method:			GetStructuralCalcTime
+	//////////////////////////////////////////////////////////////////////////////////////////
+	// Description:		Gets how much time each sim update may spend looking for terrain that
+	//					was cut loose and dropping it.
+	// Arguments:		None.
+	// Return value:	The time in ms, 0 if terrain never falls.
+
+	int GetStructuralCalcTime() const { return m_StructuralCalcTime; }
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Protected member variable and method declarations
@@ -703,8 +775,18 @@ protected:
 
 	int m_ServerEncodingFps;
 
+	bool m_ServerAdaptiveBitrate;
+
+	int m_ServerMinEncodingFps;
+
+	int m_ServerMaxHighCompressionLevel;
+
 	int m_ClientInputFps;
 
+	int m_ClientPlayoutDelay;
+
+	bool m_ClientAdaptivePlayout;
+
 	bool m_ServerTransmitAsBoxes;
 
 	int m_ServerBoxWidth;
@@ -727,6 +809,15 @@ protected:
 
 	bool m_DisableLoadingScreen;
 
+	// How many angles the MOSRotating silhouettes are cached pre-rotated at, 0 means they're rotated every time they're drawn
+	int m_SilhouetteAngleBuckets;
+
+	// How many Lua states parallel scripts are spread across, 0 means they all share one
+	int m_LuaWorkerStates;
+
+	// How many ms of each sim update go to finding and dropping unsupported terrain, 0 means it's never looked for
+	int m_StructuralCalcTime;
+
     // The coordinates of all the license pixels in the hidden license file (base.rte/oldpal.bmp)
     std::list<Vector> m_LicensePixels;
     // List of the module names we were subscribed to last time the game was started
@@ -3,9 +3,9 @@
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Source file for the ThreadMan class.
 // Project:         Retro Terrain Engine
-// Author(s):       
-//                  
-//                  
+// Author(s):
+//
+//
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -13,14 +13,17 @@
 
 
 #include "ThreadMan.h"
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
 
 using namespace std;
 
 namespace RTE
 {
 
-#define DELTABUFFERSIZE 30
-
 const string ThreadMan::m_ClassName = "ThreadMan";
 
 
@@ -32,6 +35,15 @@ const string ThreadMan::m_ClassName = "ThreadMan";
 
 void ThreadMan::Clear()
 {
+    m_Workers.clear();
+    m_WorkQueue.clear();
+    m_pBackgroundThread = 0;
+    m_BackgroundQueue.clear();
+    m_BackgroundRunning = false;
+    m_BackgroundFailures = 0;
+    m_pFrameThread = 0;
+    m_FrameTask = 0;
+    m_Quit = false;
 }
 
 
@@ -42,8 +54,18 @@ void ThreadMan::Clear()
 
 int ThreadMan::Create()
 {
+    // Leave one core for the main thread, which always takes part in the ParallelFor:s it starts
+    int poolSize = (int)thread::hardware_concurrency() - 1;
+    if (poolSize < 1)
+        poolSize = 1;
+
+    for (int i = 0; i < poolSize; ++i)
+        m_Workers.push_back(new thread(&ThreadMan::WorkerLoop, this));
 
-	return 0;
+    m_pBackgroundThread = new thread(&ThreadMan::BackgroundLoop, this);
+    m_pFrameThread = new thread(&ThreadMan::FrameLoop, this);
+
+    return 0;
 }
 
 
@@ -54,9 +76,288 @@ int ThreadMan::Create()
 
 void ThreadMan::Destroy()
 {
+    // Let the background thread finish writing out whatever it has been given first
+    WaitForBackgroundTasks();
+    WaitForFrameTask();
+
+    {
+        lock_guard<mutex> workLock(m_WorkMutex);
+        lock_guard<mutex> backgroundLock(m_BackgroundMutex);
+        lock_guard<mutex> frameLock(m_FrameMutex);
+        m_Quit = true;
+    }
+    m_WorkAvailable.notify_all();
+    m_BackgroundAvailable.notify_all();
+    m_FrameAvailable.notify_all();
 
+    for (vector<thread *>::iterator wItr = m_Workers.begin(); wItr != m_Workers.end(); ++wItr)
+    {
+        (*wItr)->join();
+        delete (*wItr);
+    }
+    if (m_pBackgroundThread)
+    {
+        m_pBackgroundThread->join();
+        delete m_pBackgroundThread;
+    }
+    if (m_pFrameThread)
+    {
+        m_pFrameThread->join();
+        delete m_pFrameThread;
+    }
 
     Clear();
 }
 
-} // namespace RTE
\ No newline at end of file
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ParallelFor
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Runs a job once for every index in [0, count), spread across the
+//                  worker pool and the calling thread.
+
+void ThreadMan::ParallelFor(int count, const function<void (int)> &job)
+{
+    if (count <= 0)
+        return;
+
+    // Not worth waking anyone up for
+    if (count == 1 || m_Workers.empty())
+    {
+        for (int i = 0; i < count; ++i)
+            job(i);
+        return;
+    }
+
+    // The shared state of this batch; kept alive by whichever helper is last to let go of it
+    struct Batch
+    {
+        function<void (int)> Job;
+        int Count;
+        atomic<int> NextIndex;
+        atomic<int> DoneCount;
+        mutex DoneMutex;
+        condition_variable AllDone;
+    };
+    shared_ptr<Batch> pBatch(new Batch);
+    pBatch->Job = job;
+    pBatch->Count = count;
+    pBatch->NextIndex = 0;
+    pBatch->DoneCount = 0;
+
+    // Grabs indices until there are none left
+    function<void ()> drain = [pBatch]()
+    {
+        int index;
+        while ((index = pBatch->NextIndex++) < pBatch->Count)
+        {
+            pBatch->Job(index);
+            if (++pBatch->DoneCount == pBatch->Count)
+            {
+                lock_guard<mutex> doneLock(pBatch->DoneMutex);
+                pBatch->AllDone.notify_all();
+            }
+        }
+    };
+
+    int helpers = min((int)m_Workers.size(), count - 1);
+    {
+        lock_guard<mutex> workLock(m_WorkMutex);
+        for (int i = 0; i < helpers; ++i)
+            m_WorkQueue.push_back(drain);
+    }
+    m_WorkAvailable.notify_all();
+
+    // Pitch in ourselves, then wait for the stragglers. We wait for the indices rather than the helpers,
+    // so a nested ParallelFor on a busy pool can never deadlock waiting for helpers that haven't started
+    drain();
+    unique_lock<mutex> doneLock(pBatch->DoneMutex);
+    while (pBatch->DoneCount < pBatch->Count)
+        pBatch->AllDone.wait(doneLock);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          QueueBackgroundTask
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Queues a task to be run on the background thread.
+
+void ThreadMan::QueueBackgroundTask(const function<int ()> &task)
+{
+    // No thread to hand it off to, so just do it right away
+    if (!m_pBackgroundThread)
+    {
+        if (task() < 0)
+            m_BackgroundFailures++;
+        return;
+    }
+
+    {
+        lock_guard<mutex> backgroundLock(m_BackgroundMutex);
+        m_BackgroundQueue.push_back(task);
+    }
+    m_BackgroundAvailable.notify_one();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WaitForBackgroundTasks
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Blocks until all queued background tasks have finished running.
+
+int ThreadMan::WaitForBackgroundTasks()
+{
+    unique_lock<mutex> backgroundLock(m_BackgroundMutex);
+    while (!m_BackgroundQueue.empty() || m_BackgroundRunning)
+        m_BackgroundIdle.wait(backgroundLock);
+
+    int failures = m_BackgroundFailures;
+    m_BackgroundFailures = 0;
+    return failures;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsBackgroundBusy
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Shows whether there are background tasks still waiting or running.
+
+bool ThreadMan::IsBackgroundBusy()
+{
+    lock_guard<mutex> backgroundLock(m_BackgroundMutex);
+    return !m_BackgroundQueue.empty() || m_BackgroundRunning;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          QueueFrameTask
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Hands a task to the frame thread, after any previous one is done.
+
+void ThreadMan::QueueFrameTask(const function<void ()> &task)
+{
+    if (!m_pFrameThread)
+    {
+        task();
+        return;
+    }
+
+    {
+        unique_lock<mutex> frameLock(m_FrameMutex);
+        while (m_FrameTask)
+            m_FrameDone.wait(frameLock);
+        m_FrameTask = task;
+    }
+    m_FrameAvailable.notify_one();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WaitForFrameTask
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Blocks until the frame thread is done with its last task.
+
+void ThreadMan::WaitForFrameTask()
+{
+    unique_lock<mutex> frameLock(m_FrameMutex);
+    while (m_FrameTask)
+        m_FrameDone.wait(frameLock);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WorkerLoop
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     The function each pool thread runs until told to quit.
+
+void ThreadMan::WorkerLoop()
+{
+    FrameProfiler::SetThreadName("Worker");
+
+    while (true)
+    {
+        function<void ()> work;
+        {
+            unique_lock<mutex> workLock(m_WorkMutex);
+            while (!m_Quit && m_WorkQueue.empty())
+                m_WorkAvailable.wait(workLock);
+            if (m_Quit)
+                return;
+            work = m_WorkQueue.front();
+            m_WorkQueue.pop_front();
+        }
+        work();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          BackgroundLoop
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     The function the background thread runs until told to quit.
+
+void ThreadMan::BackgroundLoop()
+{
+    FrameProfiler::SetThreadName("Background");
+
+    while (true)
+    {
+        function<int ()> task;
+        {
+            unique_lock<mutex> backgroundLock(m_BackgroundMutex);
+            while (!m_Quit && m_BackgroundQueue.empty())
+                m_BackgroundAvailable.wait(backgroundLock);
+            if (m_BackgroundQueue.empty())
+                return;
+            task = m_BackgroundQueue.front();
+            m_BackgroundQueue.pop_front();
+            m_BackgroundRunning = true;
+        }
+
+        int result = task();
+
+        {
+            lock_guard<mutex> backgroundLock(m_BackgroundMutex);
+            m_BackgroundRunning = false;
+            if (result < 0)
+                m_BackgroundFailures++;
+            if (m_BackgroundQueue.empty())
+                m_BackgroundIdle.notify_all();
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FrameLoop
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     The function the frame thread runs until told to quit.
+
+void ThreadMan::FrameLoop()
+{
+    FrameProfiler::SetThreadName("Frame");
+
+    while (true)
+    {
+        function<void ()> task;
+        {
+            unique_lock<mutex> frameLock(m_FrameMutex);
+            while (!m_Quit && !m_FrameTask)
+                m_FrameAvailable.wait(frameLock);
+            if (!m_FrameTask)
+                return;
+            task = m_FrameTask;
+        }
+
+        // The task stays in m_FrameTask while it runs, so waiters know it isn't done yet
+        task();
+
+        {
+            lock_guard<mutex> frameLock(m_FrameMutex);
+            m_FrameTask = 0;
+        }
+        m_FrameDone.notify_all();
+    }
+}
+
+} // namespace RTE
@@ -6,21 +6,21 @@
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Header file for the ThreadMan class.
 // Project:         Retro Terrain Engine
-// Author(s):       
-//                  
-//                  
+// Author(s):
+//
+//
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Inclusions of header files
 
-#include "global_types.h"
-
-
 #include <string>
 #include <deque>
-
-//#include <boost/thread.hpp>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "Singleton.h"
 #define g_ThreadMan ThreadMan::Instance()
@@ -31,7 +31,11 @@ namespace RTE
 //////////////////////////////////////////////////////////////////////////////////////////
 // Class:           ThreadMan
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     The centralized singleton manager of all threads.
+// Description:     The centralized singleton manager of all threads. Owns a pool of
+//                  worker threads for splitting up data-parallel work, a single
+//                  background thread that executes queued (mostly disk I/O) tasks in
+//                  the order they were submitted, and a frame thread that post processes
+//                  one drawn frame while the next one is being simulated.
 // Parent(s):       Singleton
 // Class history:   03/29/2014  ThreadMan created.
 
@@ -70,7 +74,8 @@ public:
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Create
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Makes the ThreadMan object ready for use.
+// Description:     Makes the ThreadMan object ready for use, starting the worker pool
+//                  and the background task thread.
 // Arguments:       None.
 // Return value:    An error return value signaling sucess or any particular failure.
 //                  Anything below 0 is an error signal.
@@ -92,7 +97,8 @@ public:
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Destroy
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Destroys and resets (through Clear()) the ThreadMan object.
+// Description:     Destroys and resets (through Clear()) the ThreadMan object. Any
+//                  queued background tasks are finished before the threads are joined.
 // Arguments:       None.
 // Return value:    None.
 
@@ -108,6 +114,86 @@ public:
 
     virtual const std::string & GetClassName() const { return m_ClassName; }
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetWorkerCount
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets how many threads can work on a ParallelFor at once, including
+//                  the calling thread.
+// Arguments:       None.
+// Return value:    The number of threads that share the work of a ParallelFor.
+
+    int GetWorkerCount() const { return m_Workers.size() + 1; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ParallelFor
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Runs a job once for every index in [0, count), spread across the
+//                  worker pool and the calling thread. Blocks until every index has
+//                  been processed. The job must not touch any state shared between
+//                  indices without its own synchronization.
+// Arguments:       The number of indices to run the job for.
+//                  The job to run, which gets passed the index to process.
+// Return value:    None.
+
+    void ParallelFor(int count, const std::function<void (int)> &job);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          QueueBackgroundTask
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Queues a task to be run on the background thread. Tasks are run
+//                  one at a time in the order they were queued, so a task can rely on
+//                  all earlier ones having finished.
+// Arguments:       The task to run. It should return < 0 if it failed.
+// Return value:    None.
+
+    void QueueBackgroundTask(const std::function<int ()> &task);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WaitForBackgroundTasks
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Blocks until all queued background tasks have finished running.
+// Arguments:       None.
+// Return value:    How many background tasks have failed since the last call to this.
+
+    int WaitForBackgroundTasks();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsBackgroundBusy
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Shows whether there are background tasks still waiting or running.
+// Arguments:       None.
+// Return value:    Whether the background thread has any work left.
+
+    bool IsBackgroundBusy();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          QueueFrameTask
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Hands a task to the frame thread. Only one frame task can be in
+//                  flight at a time, so this first waits for any previous one to finish.
+// Arguments:       The task to run.
+// Return value:    None.
+
+    void QueueFrameTask(const std::function<void ()> &task);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WaitForFrameTask
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Blocks until the frame thread is done with whatever task it was
+//                  given last, if any.
+// Arguments:       None.
+// Return value:    None.
+
+    void WaitForFrameTask();
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Protected member variable and method declarations
 
@@ -116,6 +202,43 @@ protected:
     // Member variables
     static const std::string m_ClassName;
 
+    // The pool threads that pick up ParallelFor work
+    std::vector<std::thread *> m_Workers;
+    // Work waiting to be picked up by the pool
+    std::deque<std::function<void ()> > m_WorkQueue;
+    // Guards m_WorkQueue and m_Quit
+    std::mutex m_WorkMutex;
+    // Signaled when there's new work for the pool, or it's time to quit
+    std::condition_variable m_WorkAvailable;
+
+    // The thread that runs the background tasks in order
+    std::thread *m_pBackgroundThread;
+    // The background tasks not yet run
+    std::deque<std::function<int ()> > m_BackgroundQueue;
+    // Whether the background thread is currently in the middle of a task
+    bool m_BackgroundRunning;
+    // Failed background tasks since last WaitForBackgroundTasks
+    int m_BackgroundFailures;
+    // Guards all the background members above
+    std::mutex m_BackgroundMutex;
+    // Signaled when a new background task is queued, or it's time to quit
+    std::condition_variable m_BackgroundAvailable;
+    // Signaled when the background queue has been emptied out
+    std::condition_variable m_BackgroundIdle;
+
+    // The thread that runs the frame tasks
+    std::thread *m_pFrameThread;
+    // The frame task waiting to be run or currently running, empty if none
+    std::function<void ()> m_FrameTask;
+    // Guards m_FrameTask
+    std::mutex m_FrameMutex;
+    // Signaled when a frame task is handed over, or it's time to quit
+    std::condition_variable m_FrameAvailable;
+    // Signaled when the frame task has been finished
+    std::condition_variable m_FrameDone;
+
+    // Whether the threads should wrap up and exit
+    bool m_Quit;
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -123,6 +246,36 @@ protected:
 
 private:
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          WorkerLoop
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     The function each pool thread runs until told to quit.
+// Arguments:       None.
+// Return value:    None.
+
+    void WorkerLoop();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          BackgroundLoop
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     The function the background thread runs until told to quit.
+// Arguments:       None.
+// Return value:    None.
+
+    void BackgroundLoop();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          FrameLoop
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     The function the frame thread runs until told to quit.
+// Arguments:       None.
+// Return value:    None.
+
+    void FrameLoop();
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          Clear
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -141,4 +294,4 @@ private:
 
 } // namespace RTE
 
-#endif // File
\ No newline at end of file
+#endif // File
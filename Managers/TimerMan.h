@@ -355,6 +355,18 @@ public:
     bool IsSimSpeedLimited() const { return m_OneSimUpdatePerFrame && m_SimSpeedLimited; }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetFixedSimStep
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sets whether to ignore real time altogether and run exactly one sim
+//                  update for every graphics frame, however long the frames take. Makes
+//                  runs repeatable regardless of how fast the machine is.
+// Arguments:       Whether to run exactly one sim update per frame.
+// Return value:    None.
+
+    void SetFixedSimStep(bool fixedStep = true) { m_FixedSimStep = fixedStep; }
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Method:          TimeForSimUpdate
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -470,6 +482,8 @@ protected:
     bool m_OneSimUpdatePerFrame;
     // Whether the simulation is limted to going at 1.0x and not faster
     bool m_SimSpeedLimited;
+    // Whether every frame gets exactly one sim update, no matter how much real time has passed
+    bool m_FixedSimStep;
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -803,6 +803,10 @@ int UInputMan::Create()
 //    if (!g_FrameMan.IsFullscreen())
 //        rest(500);
 
+    // Without a window there's no input to get going, and nothing else may be there to find either
+    if (g_FrameMan.IsHeadless())
+        return 0;
+
     // Get the Allegro keyboard going
     install_keyboard();
     // Hack to not have the keyboard lose focus permanently when window is started without focus
@@ -923,6 +927,9 @@ void UInputMan::Destroy()
 
 void UInputMan::ReInitKeyboard()
 {
+    if (g_FrameMan.IsHeadless())
+        return;
+
 //    remove_keyboard();
     install_keyboard();
 }
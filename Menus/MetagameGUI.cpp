@@ -22,6 +22,7 @@
 #include "LicenseMan.h"
 #include "ConsoleMan.h"
 #include "MetaMan.h"
+#include "ThreadMan.h"
 #include "AchievementMan.h"
 
 #include "GUI/GUI.h"
@@ -1327,6 +1328,11 @@ bool MetagameGUI::LoadGame()
 
 bool MetagameGUI::SaveGame(string saveName, string savePath, bool resaveSceneData)
 {
+    // Scene data is written out in the background, so this is the first chance to tell if the last save's went wrong.
+    // Always wait for it to be done with, or its result would get mixed in with this save's, and it may still be writing files this is about to replace
+    if (g_ThreadMan.WaitForBackgroundTasks() > 0)
+        g_ConsoleMan.PrintString("ERROR: Failed to write some of the Scene data of the previous save!");
+
     // If specified, first load all bitmap data of all Scenes in the current Metagame that have once saved em, so we can re-save them to the new files
     if (resaveSceneData)
         g_MetaMan.LoadSceneData();
@@ -1335,7 +1341,8 @@ bool MetagameGUI::SaveGame(string saveName, string savePath, bool resaveSceneDat
     g_MetaMan.m_GameName = saveName;
 
     // Save any loaded scene data FIRST, so that all the paths of ContentFiles get updated to the actual save location first,
-    // which may have been changed due to the saveName being different than before.   
+    // which may have been changed due to the saveName being different than before.
+    // The layers are only snapshotted here; ThreadMan's background thread compresses and writes them while we carry on.
     g_MetaMan.SaveSceneData(METASAVEPATH + saveName);
 
     // Whichever new or existing, create a writer with the path
@@ -15,6 +15,7 @@
 
 #include <math.h>
 #include <fstream>
+#include <atomic>
 #include "FrameMan.h"
 #include "SceneMan.h"
 #include "Vector.h"
@@ -25,57 +26,145 @@ namespace RTE
 #define X 0
 #define Y 1 
 
+// VS2013 has no thread_local yet, but its own TLS works fine for plain data like this
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define RAND_THREAD_LOCAL __declspec(thread)
+#else
+#define RAND_THREAD_LOCAL thread_local
+#endif
+
+// The seed everything is currently seeded from, and whether it's fixed rather than the time
+static unsigned int s_RandSeed = 0;
+static bool s_FixedRandSeed = false;
+// Bumped on every reseed, so the threads know to restart their streams. Starts above 0 so unseeded use still gets set up
+static std::atomic<unsigned int> s_RandGeneration(1);
+// How many streams have been handed out since the last reseed
+static std::atomic<unsigned int> s_RandStreamCount(0);
+
+// The stream of each thread, and which seeding it was set up for. A generation of 0 means not set up at all
+static RAND_THREAD_LOCAL RandomGenerator s_ThreadRand;
+static RAND_THREAD_LOCAL unsigned int s_ThreadRandGeneration = 0;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          RandomGenerator::Seed
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Restarts the stream from a seed.
+
+void RandomGenerator::Seed(unsigned int seed)
+{
+    // Spread the seed out over the whole state with splitmix32, so no seed gives an all-zero state
+    for (int i = 0; i < 4; ++i)
+    {
+        seed += 0x9E3779B9;
+        unsigned int mixed = seed;
+        mixed = (mixed ^ (mixed >> 16)) * 0x85EBCA6B;
+        mixed = (mixed ^ (mixed >> 13)) * 0xC2B2AE35;
+        m_State[i] = mixed ^ (mixed >> 16);
+    }
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Global function: SeedRand
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Seeds the rand with the current runtime time.
+// Description:     Seeds the rand with the current runtime time, or the fixed seed.
 
-void SeedRand() { srand(time(0)); }
+void SeedRand() { SeedRand(s_FixedRandSeed ? s_RandSeed : (unsigned int)time(0)); }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Global function: PosRand
+// Global function: SeedRand
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     A good rand function that return a float between 0.0 and 0.999
+// Description:     Seeds the rand with a specific seed.
 
-double PosRand()
+void SeedRand(unsigned int seed)
 {
-    return (rand() / (RAND_MAX / 1000 + 1)) / 1000.0;
+    s_RandSeed = seed;
+    s_RandStreamCount = 0;
+    // Skip 0, which is what a thread's generation starts out as
+    if (++s_RandGeneration == 0)
+        ++s_RandGeneration;
+    // Claim the first stream for the calling thread right away
+    GetThreadRand();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: SetFixedRandSeed
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes all following SeedRand() calls use a fixed seed.
+
+void SetFixedRandSeed(unsigned int seed)
+{
+    s_FixedRandSeed = true;
+    SeedRand(seed);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: GetRandSeed
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the seed the rand was last seeded with.
+
+unsigned int GetRandSeed() { return s_RandSeed; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: GetThreadRand
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the random stream of the calling thread.
+
+RandomGenerator & GetThreadRand()
+{
+    unsigned int generation = s_RandGeneration.load(std::memory_order_relaxed);
+    if (s_ThreadRandGeneration != generation)
+    {
+        // Each stream gets a seed of its own, derived from the shared one and the order it was handed out in
+        s_ThreadRand.Seed(s_RandSeed + 0x6C8E9CF5 * s_RandStreamCount++);
+        s_ThreadRandGeneration = generation;
+    }
+    return s_ThreadRand;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Global function: NormalRand
+// Global function: PosRandFill
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     A good rand function that returns a floating point value between -1.0
-//                  and 1.0, both inclusive.
+// Description:     Fills a whole array with PosRand values in one go.
 
-double NormalRand()
+void PosRandFill(double *pValues, int count)
 {
-    return (static_cast<double>(rand()) / (RAND_MAX / 2)) - 1.0;
+    RandomGenerator &generator = GetThreadRand();
+    for (int i = 0; i < count; ++i)
+        pValues[i] = generator.NextPos();
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Global function: RangeRand
+// Global function: NormalRandFill
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     A good rand function that returns a floating point value between two
-//                  given thresholds, the min being inclusive, but the max not.
+// Description:     Fills a whole array with NormalRand values in one go.
 
-double RangeRand(float min, float max)
+void NormalRandFill(double *pValues, int count)
 {
-    return min + ((max - min) * PosRand());
+    RandomGenerator &generator = GetThreadRand();
+    for (int i = 0; i < count; ++i)
+        pValues[i] = generator.NextNormal();
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Global function: SelectRand
+// Global function: RangeRandFill
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     A rand function that returns an int between min and max, both inclusive.
+// Description:     Fills a whole array with RangeRand values in one go.
 
-int SelectRand(int min, int max)
+void RangeRandFill(double *pValues, int count, float min, float max)
 {
-    return min + (int)((max - min) * PosRand() + 0.5);
+    RandomGenerator &generator = GetThreadRand();
+    double range = max - min;
+    for (int i = 0; i < count; ++i)
+        pValues[i] = min + range * generator.NextPos();
 }
 
 
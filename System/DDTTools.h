@@ -14,8 +14,7 @@
 #include "time.h"
 #include <cmath>
 
-#include <DebugTool/DebugTool.h>
-#include <Profiler/Profiler.h>
+#include "FrameProfiler.h"
 
 struct TexMapTable;
 
@@ -35,20 +34,99 @@ const double SixteenthPI = 0.1963495408;
 class Vector;
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Class:           RandomGenerator
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A small and fast xoshiro128+ pseudo random number generator. Each
+//                  instance is its own independent stream, so it can be used by one
+//                  thread without locking or disturbing anyone else's sequence. It's
+//                  kept plain data so it can live in thread local storage, which means
+//                  Seed must be called before drawing anything from it.
+
+class RandomGenerator
+{
+public:
+
+    // Restarts the stream from a seed. The same seed always gives the same sequence
+    void Seed(unsigned int seed);
+
+    // Gets the next raw 32 bits of the stream
+    unsigned int Next()
+    {
+        unsigned int result = m_State[0] + m_State[3];
+        unsigned int shifted = m_State[1] << 9;
+        m_State[2] ^= m_State[0];
+        m_State[3] ^= m_State[1];
+        m_State[1] ^= m_State[2];
+        m_State[0] ^= m_State[3];
+        m_State[2] ^= shifted;
+        m_State[3] = (m_State[3] << 11) | (m_State[3] >> 21);
+        return result;
+    }
+
+    // Gets a value between 0.0 inclusive and 1.0 exclusive. Only the top 24 bits are used, the lowest ones of xoshiro128+ are weak
+    double NextPos() { return (Next() >> 8) * (1.0 / 16777216.0); }
+
+    // Gets a value between -1.0 and 1.0, both inclusive
+    double NextNormal() { return (Next() >> 8) * (2.0 / 16777215.0) - 1.0; }
+
+private:
+
+    unsigned int m_State[4];
+};
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Global function: SeedRand
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Seeds the rand with the current runtime time.
+// Description:     Seeds the rand with the current runtime time, unless a fixed seed
+//                  has been set with SetFixedRandSeed, in which case that is used.
 
 void SeedRand();
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: SeedRand
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Seeds the rand with a specific seed. The calling thread's stream
+//                  restarts right away, every other thread's on its next rand call.
+
+void SeedRand(unsigned int seed);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: SetFixedRandSeed
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes all following SeedRand() calls use a fixed seed instead of the
+//                  time, so runs can be repeated exactly.
+
+void SetFixedRandSeed(unsigned int seed);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: GetRandSeed
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the seed the rand was last seeded with.
+
+unsigned int GetRandSeed();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: GetThreadRand
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the random stream of the calling thread, which all the rand
+//                  functions below draw from. The main thread's stream is always the
+//                  first one handed out after seeding, so it repeats for a fixed seed.
+
+RandomGenerator & GetThreadRand();
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Global function: PosRand
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     A good rand function that return a float between 0.0 and 0.999
 
-double PosRand();
+inline double PosRand() { return GetThreadRand().NextPos(); }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -57,7 +135,7 @@ double PosRand();
 // Description:     A good rand function that returns a floating point value between -1.0
 //                  and 1.0, both inclusive.
 
-double NormalRand()/* { return (static_cast<double>(rand()) / (RAND_MAX / 2)) - 1.0; }*/;
+inline double NormalRand() { return GetThreadRand().NextNormal(); }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -66,7 +144,7 @@ double NormalRand()/* { return (static_cast<double>(rand()) / (RAND_MAX / 2)) -
 // Description:     A good rand function that returns a floating point value between two
 //                  given thresholds, the min being inclusive, but the max not.
 
-double RangeRand(float min, float max)/* { return min + ((max - min) * PosRand()); }*/;
+inline double RangeRand(float min, float max) { return min + ((max - min) * PosRand()); }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -74,7 +152,32 @@ double RangeRand(float min, float max)/* { return min + ((max - min) * PosRand()
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     A rand function that returns an int between min and max, both inclusive.
 
-int SelectRand(int min, int max);
+inline int SelectRand(int min, int max) { return min + (int)((max - min) * PosRand() + 0.5); }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: PosRandFill
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Fills a whole array with PosRand values in one go, for spawning lots
+//                  of particles at once.
+
+void PosRandFill(double *pValues, int count);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: NormalRandFill
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Fills a whole array with NormalRand values in one go.
+
+void NormalRandFill(double *pValues, int count);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: RangeRandFill
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Fills a whole array with RangeRand values in one go.
+
+void RangeRandFill(double *pValues, int count, float min, float max);
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
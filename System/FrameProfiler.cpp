@@ -0,0 +1,365 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+// File:            FrameProfiler.cpp
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Source file for the FrameProfiler class.
+// Project:         Retro Terrain Engine
+// Author(s):
+//
+//
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Inclusions of header files
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include "TimerMan.h"
+
+using namespace std;
+
+namespace RTE
+{
+
+// How many of its latest scopes each thread keeps around for exporting. Must be a power of two
+#define PROFILERBUFFERSIZE 32768
+// Scopes that could be in the middle of being overwritten by their thread, which export steers clear of
+#define PROFILERBUFFERMARGIN 256
+// How many scopes make it into the top list
+#define PROFILERTOPSCOPES 12
+// How much of the previous average a frame's time is blended into
+#define PROFILERAVERAGEWEIGHT 0.9f
+
+// VS2013 has no thread_local yet, but its own TLS works fine for plain data like this
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL thread_local
+#endif
+
+// The scopes recorded by one thread. Only the owning thread writes into it, everyone else only reads
+struct ThreadBuffer
+{
+    // What the thread is called in exported traces, and its id there
+    string m_Name;
+    int m_Id;
+    // The ring of the latest scopes
+    FrameProfiler::ScopeEvent m_Events[PROFILERBUFFERSIZE];
+    // How many scopes have ever been written into the ring
+    atomic<uint64_t> m_Written;
+    // How many of those have been summed up by EndFrame, only touched by the main thread
+    uint64_t m_Aggregated;
+};
+
+// All the buffers of all threads that ever recorded anything. They are never freed, since the threads mostly live as long as the game
+// and an exported trace should still show threads that have exited
+static vector<ThreadBuffer *> s_Buffers;
+// Guards s_Buffers and the thread names
+static mutex s_BuffersMutex;
+
+// The calling thread's own buffer, made the first time it is needed
+static PROFILER_THREAD_LOCAL ThreadBuffer *s_pThreadBuffer = 0;
+// How many profiled scopes the calling thread is currently inside of
+static PROFILER_THREAD_LOCAL int s_ThreadDepth = 0;
+
+// The running per frame averages of all scopes seen, in microseconds, keyed by their function and name
+typedef pair<const char *, const char *> ScopeKey;
+static map<ScopeKey, float> s_Averages;
+
+atomic<bool> FrameProfiler::s_Enabled(false);
+vector<FrameProfiler::ScopeStats> FrameProfiler::s_TopScopes;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the calling thread's buffer, registering a new one if it has none.
+
+static ThreadBuffer * GetThreadBuffer()
+{
+    if (!s_pThreadBuffer)
+    {
+        ThreadBuffer *pBuffer = new ThreadBuffer;
+        pBuffer->m_Written = 0;
+        pBuffer->m_Aggregated = 0;
+
+        lock_guard<mutex> buffersLock(s_BuffersMutex);
+        pBuffer->m_Id = s_Buffers.size();
+        pBuffer->m_Name = "Thread " + to_string(pBuffer->m_Id);
+        s_Buffers.push_back(pBuffer);
+        s_pThreadBuffer = pBuffer;
+    }
+    return s_pThreadBuffer;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Copies the scopes of a thread's ring from the passed in index on, leaving
+//                  out any that the thread has lapped or could have been overwriting while
+//                  they were copied. Returns the index after the last scope copied.
+
+static uint64_t CopyThreadEvents(ThreadBuffer *pBuffer, uint64_t from, vector<FrameProfiler::ScopeEvent> &events)
+{
+    events.clear();
+    uint64_t written = pBuffer->m_Written.load(memory_order_acquire);
+    // Steer clear of the oldest scopes up front, so there's usually nothing to drop afterwards
+    uint64_t first = max(from, written > PROFILERBUFFERSIZE - PROFILERBUFFERMARGIN ? written - (PROFILERBUFFERSIZE - PROFILERBUFFERMARGIN) : 0);
+    for (uint64_t i = first; i < written; ++i)
+        events.push_back(pBuffer->m_Events[i & (PROFILERBUFFERSIZE - 1)]);
+
+    // The thread only starts rewriting the slot of scope i once it has published all the scopes before i + PROFILERBUFFERSIZE,
+    // so whatever it got to by the end of the copying tells which of the copies could be torn
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t rewritten = pBuffer->m_Written.load(memory_order_relaxed);
+    uint64_t firstIntact = rewritten >= PROFILERBUFFERSIZE ? rewritten - PROFILERBUFFERSIZE + 1 : 0;
+    if (firstIntact > first)
+        events.erase(events.begin(), events.begin() + (size_t)min(firstIntact - first, (uint64_t)events.size()));
+
+    return written;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Makes a string safe to put between the quotes of a JSON string.
+
+static string EscapeJSON(const string &text)
+{
+    string escaped;
+    escaped.reserve(text.size());
+    for (string::const_iterator cItr = text.begin(); cItr != text.end(); ++cItr)
+    {
+        unsigned char character = *cItr;
+        if (character == '"' || character == '\\')
+        {
+            escaped += '\\';
+            escaped += character;
+        }
+        else if (character < 0x20)
+        {
+            static const char *s_HexDigits = "0123456789abcdef";
+            escaped += "\\u00";
+            escaped += s_HexDigits[character >> 4];
+            escaped += s_HexDigits[character & 0xF];
+        }
+        else
+            escaped += character;
+    }
+    return escaped;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the name a scope is shown as.
+
+static string GetScopeName(const char *function, const char *name)
+{
+    return name ? string(function) + ": " + name : string(function);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          Start
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Starts recording scopes on all threads.
+
+void FrameProfiler::Start()
+{
+    if (s_Enabled)
+        return;
+
+    // Don't let whatever was recorded last time around show up in the new averages
+    {
+        lock_guard<mutex> buffersLock(s_BuffersMutex);
+        for (vector<ThreadBuffer *>::iterator bItr = s_Buffers.begin(); bItr != s_Buffers.end(); ++bItr)
+            (*bItr)->m_Aggregated = (*bItr)->m_Written;
+    }
+    s_Averages.clear();
+    s_TopScopes.clear();
+
+    s_Enabled = true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          Stop
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Stops recording scopes.
+
+void FrameProfiler::Stop()
+{
+    s_Enabled = false;
+    s_TopScopes.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetThreadName
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Names the calling thread in exported traces.
+
+void FrameProfiler::SetThreadName(const string &name)
+{
+    ThreadBuffer *pBuffer = GetThreadBuffer();
+    lock_guard<mutex> buffersLock(s_BuffersMutex);
+    pBuffer->m_Name = name;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          EnterScope
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Notes that the calling thread went one profiled scope deeper.
+
+int FrameProfiler::EnterScope()
+{
+    return s_ThreadDepth++;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          LeaveScope
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Records a scope the calling thread has just left.
+
+void FrameProfiler::LeaveScope(const char *function, const char *name, int64_t start, int depth)
+{
+    int64_t end = GetTime();
+    s_ThreadDepth--;
+
+    ThreadBuffer *pBuffer = GetThreadBuffer();
+    uint64_t written = pBuffer->m_Written.load(memory_order_relaxed);
+    ScopeEvent &event = pBuffer->m_Events[written & (PROFILERBUFFERSIZE - 1)];
+    event.m_Function = function;
+    event.m_Name = name;
+    event.m_Start = start;
+    event.m_Duration = end - start;
+    event.m_Depth = depth;
+    // Publish the scope only once it's all written
+    pBuffer->m_Written.store(written + 1, memory_order_release);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetTime
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the current time, as used by the recorded scopes.
+
+int64_t FrameProfiler::GetTime()
+{
+    return g_TimerMan.GetAbsoulteTime();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          EndFrame
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sums up all the scopes recorded on all threads since the last call
+//                  into the top scopes list.
+
+void FrameProfiler::EndFrame()
+{
+    if (!s_Enabled)
+        return;
+
+    // Total up this frame's time and calls per scope, across all threads. Nested scopes count toward their parents as well
+    map<ScopeKey, pair<int64_t, int> > frameTotals;
+    {
+        vector<ScopeEvent> events;
+        lock_guard<mutex> buffersLock(s_BuffersMutex);
+        for (vector<ThreadBuffer *>::iterator bItr = s_Buffers.begin(); bItr != s_Buffers.end(); ++bItr)
+        {
+            // If a thread has lapped its ring since last frame, only the latest scopes can be counted
+            (*bItr)->m_Aggregated = CopyThreadEvents(*bItr, (*bItr)->m_Aggregated, events);
+            for (vector<ScopeEvent>::const_iterator eItr = events.begin(); eItr != events.end(); ++eItr)
+            {
+                pair<int64_t, int> &total = frameTotals[ScopeKey(eItr->m_Function, eItr->m_Name)];
+                total.first += eItr->m_Duration;
+                total.second++;
+            }
+        }
+    }
+
+    // Blend this frame into the running averages, letting scopes that haven't run lately fade away
+    for (map<ScopeKey, float>::iterator aItr = s_Averages.begin(); aItr != s_Averages.end(); )
+    {
+        if (frameTotals.find(aItr->first) == frameTotals.end())
+        {
+            aItr->second *= PROFILERAVERAGEWEIGHT;
+            if (aItr->second < 1.0f)
+            {
+                s_Averages.erase(aItr++);
+                continue;
+            }
+        }
+        ++aItr;
+    }
+    vector<pair<float, ScopeKey> > ranked;
+    for (map<ScopeKey, pair<int64_t, int> >::iterator tItr = frameTotals.begin(); tItr != frameTotals.end(); ++tItr)
+    {
+        map<ScopeKey, float>::iterator aItr = s_Averages.find(tItr->first);
+        if (aItr == s_Averages.end())
+            s_Averages[tItr->first] = (float)tItr->second.first;
+        else
+            aItr->second = aItr->second * PROFILERAVERAGEWEIGHT + (float)tItr->second.first * (1.0f - PROFILERAVERAGEWEIGHT);
+    }
+    for (map<ScopeKey, float>::iterator aItr = s_Averages.begin(); aItr != s_Averages.end(); ++aItr)
+        ranked.push_back(pair<float, ScopeKey>(aItr->second, aItr->first));
+
+    int topCount = min((int)ranked.size(), PROFILERTOPSCOPES);
+    partial_sort(ranked.begin(), ranked.begin() + topCount, ranked.end(), [](const pair<float, ScopeKey> &a, const pair<float, ScopeKey> &b) { return a.first > b.first; });
+
+    s_TopScopes.resize(topCount);
+    for (int i = 0; i < topCount; ++i)
+    {
+        const ScopeKey &key = ranked[i].second;
+        map<ScopeKey, pair<int64_t, int> >::iterator tItr = frameTotals.find(key);
+        s_TopScopes[i].m_Name = GetScopeName(key.first, key.second);
+        s_TopScopes[i].m_AverageMS = ranked[i].first / 1000.0f;
+        s_TopScopes[i].m_Calls = tItr != frameTotals.end() ? tItr->second.second : 0;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ExportTrace
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Writes everything still in the threads' ring buffers to a file in
+//                  the Chrome trace event JSON format.
+
+int FrameProfiler::ExportTrace(const string &filePath)
+{
+    ofstream traceFile(filePath.c_str());
+    if (!traceFile.good())
+        return -1;
+
+    traceFile << "{\"traceEvents\":[\n";
+    bool firstEvent = true;
+
+    vector<ScopeEvent> events;
+    lock_guard<mutex> buffersLock(s_BuffersMutex);
+    for (vector<ThreadBuffer *>::iterator bItr = s_Buffers.begin(); bItr != s_Buffers.end(); ++bItr)
+    {
+        ThreadBuffer *pBuffer = *bItr;
+
+        if (!firstEvent)
+            traceFile << ",\n";
+        firstEvent = false;
+        traceFile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << pBuffer->m_Id << ",\"args\":{\"name\":\"" << EscapeJSON(pBuffer->m_Name) << "\"}}";
+
+        // The thread could be recording while we read, so only the scopes it can't have been overwriting are written out
+        CopyThreadEvents(pBuffer, 0, events);
+        for (vector<ScopeEvent>::const_iterator eItr = events.begin(); eItr != events.end(); ++eItr)
+        {
+            traceFile << ",\n{\"name\":\"" << EscapeJSON(eItr->m_Name ? eItr->m_Name : eItr->m_Function) << "\",\"cat\":\"" << EscapeJSON(eItr->m_Function)
+                      << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << pBuffer->m_Id << ",\"ts\":" << eItr->m_Start << ",\"dur\":" << eItr->m_Duration
+                      << ",\"args\":{\"depth\":" << eItr->m_Depth << "}}";
+        }
+    }
+
+    traceFile << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return traceFile.good() ? 0 : -1;
+}
+
+} // namespace RTE
@@ -0,0 +1,238 @@
+#ifndef _RTEFRAMEPROFILER_
+#define _RTEFRAMEPROFILER_
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// File:            FrameProfiler.h
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Header file for the FrameProfiler class and the profiling macros.
+// Project:         Retro Terrain Engine
+// Author(s):
+//
+//
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Inclusions of header files
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace RTE
+{
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Class:           FrameProfiler
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Built-in hierarchical profiler. Every thread records the scopes it
+//                  leaves into its own ring buffer, which can be exported as a Chrome
+//                  trace (chrome://tracing or Perfetto) at any time, and is summed up
+//                  into the most expensive scopes once per frame for the perf overlay.
+//                  Costs next to nothing while not started.
+// Parent(s):       None.
+// Class history:   10/19/2026 FrameProfiler created.
+
+class FrameProfiler
+{
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Public member variable, method and friend function declarations
+
+public:
+
+    // One scope that was entered and left on some thread
+    struct ScopeEvent
+    {
+        // Function the scope is in, and the name of the scope within it if any. Not owned, always string literals
+        const char *m_Function;
+        const char *m_Name;
+        // When the scope was entered and for how long, in microseconds
+        int64_t m_Start;
+        int64_t m_Duration;
+        // How many profiled scopes the scope was nested in
+        int m_Depth;
+    };
+
+    // How expensive a scope has been lately, for the overlay
+    struct ScopeStats
+    {
+        std::string m_Name;
+        // Time spent in the scope per frame, summed over all threads and averaged over the last few frames
+        float m_AverageMS;
+        // How many times the scope was entered last frame
+        int m_Calls;
+    };
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          IsEnabled
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Shows whether scopes are currently being recorded.
+// Arguments:       None.
+// Return value:    Whether the profiler is running.
+
+    static bool IsEnabled() { return s_Enabled.load(std::memory_order_relaxed); }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          Start
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Starts recording scopes on all threads.
+// Arguments:       None.
+// Return value:    None.
+
+    static void Start();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          Stop
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Stops recording scopes. What has been recorded is kept around for
+//                  exporting.
+// Arguments:       None.
+// Return value:    None.
+
+    static void Stop();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          SetThreadName
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Names the calling thread in exported traces.
+// Arguments:       The name of the calling thread.
+// Return value:    None.
+
+    static void SetThreadName(const std::string &name);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          EnterScope
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Notes that the calling thread went one profiled scope deeper.
+// Arguments:       None.
+// Return value:    How many profiled scopes the entered scope is nested in.
+
+    static int EnterScope();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          LeaveScope
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Records a scope the calling thread has just left.
+// Arguments:       The function the scope is in.
+//                  The name of the scope within the function, or 0 if it is the function.
+//                  When the scope was entered, as given by GetTime.
+//                  The depth EnterScope returned for the scope.
+// Return value:    None.
+
+    static void LeaveScope(const char *function, const char *name, int64_t start, int depth);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetTime
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the current time, as used by the recorded scopes.
+// Arguments:       None.
+// Return value:    The current time in microseconds.
+
+    static int64_t GetTime();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          EndFrame
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Sums up all the scopes recorded on all threads since the last call
+//                  into the top scopes list. Should be called once per drawn frame, on
+//                  the main thread.
+// Arguments:       None.
+// Return value:    None.
+
+    static void EndFrame();
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          GetTopScopes
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Gets the scopes that have taken the most time per frame lately,
+//                  as of the last EndFrame. Only to be used on the main thread.
+// Arguments:       None.
+// Return value:    The most expensive scopes, most expensive first.
+
+    static const std::vector<ScopeStats> & GetTopScopes() { return s_TopScopes; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ExportTrace
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Writes everything still in the threads' ring buffers to a file in
+//                  the Chrome trace event JSON format.
+// Arguments:       The path of the file to write.
+// Return value:    An error return value signaling sucess or any particular failure.
+//                  Anything below 0 is an error signal.
+
+    static int ExportTrace(const std::string &filePath);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Private member variable and method declarations
+
+private:
+
+    // Whether scopes are being recorded. Read by every thread, only changed by the main thread
+    static std::atomic<bool> s_Enabled;
+    // The most expensive scopes as of the last EndFrame
+    static std::vector<ScopeStats> s_TopScopes;
+
+};
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Class:           ProfileScope
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Records the time from its construction to its destruction as a scope
+//                  in the FrameProfiler, if the profiler was running when it was made.
+// Parent(s):       None.
+// Class history:   10/19/2026 ProfileScope created.
+
+class ProfileScope
+{
+
+public:
+
+    ProfileScope(const char *function, const char *name = 0)
+    {
+        m_Active = FrameProfiler::IsEnabled();
+        if (m_Active)
+        {
+            m_Function = function;
+            m_Name = name;
+            m_Depth = FrameProfiler::EnterScope();
+            m_Start = FrameProfiler::GetTime();
+        }
+    }
+
+    ~ProfileScope() { if (m_Active) { FrameProfiler::LeaveScope(m_Function, m_Name, m_Start, m_Depth); } }
+
+private:
+
+    bool m_Active;
+    const char *m_Function;
+    const char *m_Name;
+    int64_t m_Start;
+    int m_Depth;
+
+    // Disallow the use of some implicit methods.
+    ProfileScope(const ProfileScope &reference);
+    ProfileScope & operator=(const ProfileScope &rhs);
+
+};
+
+} // namespace RTE
+
+// The markers kept the names they had back when they fed the Slick DebugTool; the colors are ignored
+#define SLICK_PROFILE(color) RTE::ProfileScope _prof_obj_(__FUNCTION__);
+#define SLICK_PROFILENAME(name, color) RTE::ProfileScope _prof_obj_(__FUNCTION__, name);
+
+#endif // File
@@ -15,11 +15,17 @@
 #pragma intrinsic (sin, cos)
 #include "DDTTools.h"
 
+#include <type_traits>
+
 using namespace std;
 
 namespace RTE
 {
 
+#if !defined(__GNUC__) || defined(__clang__) || __GNUC__ >= 5
+static_assert(is_trivially_copyable<Matrix>::value, "Matrix has to stay plain old data like Vector");
+#endif
+
 const string Matrix::ClassName = "Matrix";
 
 
@@ -43,16 +49,12 @@ void Matrix::Clear()
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Create
+// Method:          Create
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Makes the Matrix object ready for use.
 
 int Matrix::Create()
 {
-    // Read all the properties
-    if (Serializable::Create() < 0)
-        return -1;
-
     m_ElementsUpdated = false;
 
     return 0;
@@ -60,7 +62,21 @@ int Matrix::Create()
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Create
+// Method:          Create
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Reads this Matrix from a Reader, like Serializable::Create does.
+
+int Matrix::Create(Reader &reader, bool checkType)
+{
+    if (ReadPlainObject(reader, *this, checkType) < 0)
+        return -1;
+
+    return Create();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          Create
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Makes the Matrix object ready for use.
 
@@ -100,12 +116,10 @@ int Matrix::Create(const Matrix &reference)
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  ReadProperty
+// Method:          ReadProperty
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Reads a property value from a reader stream. If the name isn't
-//                  recognized by this class, then ReadProperty of the parent class
-//                  is called. If the property isn't recognized by any of the base classes,
-//                  false is returned, and the reader's position is untouched.
+//                  recognized by this class, the value is skipped and an error reported.
 
 int Matrix::ReadProperty(std::string propName, Reader &reader)
 {
@@ -118,22 +132,25 @@ int Matrix::ReadProperty(std::string propName, Reader &reader)
     else if (propName == "AngleRadians")
         reader >> m_Rotation;
     else
-        // See if the base class(es) can find a match instead
-        return Serializable::ReadProperty(propName, reader);
+    {
+        reader.ReadPropValue();
+        reader.ReportError("Could not match property");
+        return -1;
+    }
 
     return 0;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Save
+// Method:          Save
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Saves the complete state of this Matrix with a Writer for
 //                  later recreation with Create(Reader &reader);
 
 int Matrix::Save(Writer &writer) const
 {
-    Serializable::Save(writer);
+    writer.ObjectStart(ClassName);
 
     writer.NewProperty("AngleDegrees");
     writer << GetDegAngle();
@@ -142,25 +159,6 @@ int Matrix::Save(Writer &writer) const
 }
 
 
-//////////////////////////////////////////////////////////////////////////////////////////
-// Operator:        Matrix assignment
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     An assignment operator for setting one Matrix equal to another.
-
-Matrix & Matrix::operator=(const Matrix &rhs)
-{
-    if (*this == rhs)
-        return *this;
-
-    m_Rotation = rhs.m_Rotation;
-    m_Flipped[X] = rhs.m_Flipped[X];
-    m_Flipped[Y] = rhs.m_Flipped[Y];
-    m_ElementsUpdated = false;
-
-    return *this;
-}
-
-
 //////////////////////////////////////////////////////////////////////////////////////////
 // Operator:        Float assignment
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -507,7 +505,7 @@ void Matrix::SetYFlipped(bool flipY)
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  UpdateElements
+// Method:          UpdateElements
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Makes the elements of this matrix update to represent the set angle.
 
@@ -524,4 +522,29 @@ void Matrix::UpdateElements()
     m_ElementsUpdated = true;
 }
 
-} // namespace RTE
\ No newline at end of file
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global operator: Matrix Reader extraction
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A Reader extraction operator for filling a Matrix from a Reader.
+
+Reader & operator>>(Reader &reader, Matrix &operand)
+{
+    operand.Create(reader);
+    return reader;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global operator: Matrix Writer insertion
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A Writer insertion operator for sending a Matrix to a Writer.
+
+Writer & operator<<(Writer &writer, const Matrix &operand)
+{
+    operand.Save(writer);
+    writer.ObjectEnd();
+    return writer;
+}
+
+} // namespace RTE
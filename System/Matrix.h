@@ -28,12 +28,13 @@ namespace RTE
 //////////////////////////////////////////////////////////////////////////////////////////
 // Class:           Matrix
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     A 2x2 matrix to rotate 2D Vector:s with.
-// Parent(s):       Serializable.
+// Description:     A 2x2 matrix to rotate 2D Vector:s with. Plain old data like Vector,
+//                  read and written through the Reader and Writer operators below.
+// Parent(s):       None.
 // Class history:   02/01/2004  Matrix created.
+//                  10/19/2026  Matrix no longer a Serializable.
 
-class Matrix:
-    public Serializable
+class Matrix
 {
 
 
@@ -63,37 +64,18 @@ public:
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Constructor:     Matrix
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Copy constructor method used to instantiate a Matrix object
-//                  identical to an already existing one.
-// Arguments:       A Matrix object which is passed in by reference.
-
-    Matrix(const Matrix &reference) { Clear(); Create(reference); }
-
-
-//////////////////////////////////////////////////////////////////////////////////////////
-// Destructor:      ~Matrix
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Destructor method used to clean up a Matrix object before deletion.
-// Arguments:       None.
-
-    virtual ~Matrix() { /*Destroy(true);*/  }
-
-
-//////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Create
+// Method:          Create
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Makes the Matrix object ready for use.
 // Arguments:       None.
 // Return value:    An error return value signaling sucess or any particular failure.
 //                  Anything below 0 is an error signal.
 
-    virtual int Create();
+    int Create();
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Create
+// Method:          Create
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Makes the Matrix object ready for use.
 // Arguments:       The float angle in radians which this rotational matrix should
@@ -101,7 +83,7 @@ public:
 // Return value:    An error return value signaling sucess or any particular failure.
 //                  Anything below 0 is an error signal.
 
-    virtual int Create(float angle);
+    int Create(float angle);
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -112,27 +94,38 @@ public:
 // Return value:    An error return value signaling sucess or any particular failure.
 //                  Anything below 0 is an error signal.
 
-    virtual int Create(const Matrix &reference);
+    int Create(const Matrix &reference);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          Create
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Reads this Matrix from a Reader, like Serializable::Create does.
+// Arguments:       A Reader that the Matrix will create itself from.
+//                  Whether there is a class name in the stream to check against to make
+//                  sure the correct type is being read from the stream.
+// Return value:    An error return value signaling sucess or any particular failure.
+//                  Anything below 0 is an error signal.
+
+    int Create(Reader &reader, bool checkType = true);
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  ReadProperty
+// Method:          ReadProperty
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Reads a property value from a Reader stream. If the name isn't
-//                  recognized by this class, then ReadProperty of the parent class
-//                  is called. If the property isn't recognized by any of the base classes,
-//                  false is returned, and the Reader's position is untouched.
+//                  recognized by this class, the value is skipped and an error reported.
 // Arguments:       The name of the property to be read.
 //                  A Reader lined up to the value of the property to be read.
 // Return value:    An error return value signaling whether the property was successfully
 //                  read or not. 0 means it was read successfully, and any nonzero indicates
-//                  that a property of that name could not be found in this or base classes.
+//                  that a property of that name could not be found in this class.
 
-    virtual int ReadProperty(std::string propName, Reader &reader);
+    int ReadProperty(std::string propName, Reader &reader);
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Save
+// Method:          Save
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Saves the complete state of this Matrix to an output stream for
 //                  later recreation with Create(Reader &reader);
@@ -140,7 +133,7 @@ public:
 // Return value:    An error return value signaling sucess or any particular failure.
 //                  Anything below 0 is an error signal.
 
-    virtual int Save(Writer &writer) const;
+    int Save(Writer &writer) const;
 
 /*
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -153,16 +146,6 @@ public:
     virtual void Destroy() { Clear(); }
 */
 
-//////////////////////////////////////////////////////////////////////////////////////////
-// Operator:        Matrix assignment
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     An assignment operator for setting one Matrix equal to another.
-// Arguments:       A Matrix reference.
-// Return value:    A reference to the changed Matrix.
-
-    Matrix & operator=(const Matrix &rhs);
-
-
 //////////////////////////////////////////////////////////////////////////////////////////
 // Operator:        Float assignment
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -424,13 +407,13 @@ public:
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  GetClassName
+// Method:          GetClassName
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Gets the class name of this Matrix.
 // Arguments:       None.
 // Return value:    A string with the friendly-formatted type name of this Matrix.
 
-    virtual const std::string & GetClassName() const { return ClassName; }
+    const std::string & GetClassName() const { return ClassName; }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -603,17 +586,39 @@ private:
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  UpdateElements
+// Method:          UpdateElements
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Makes the elements of this matrix update to represent the set angle.
 // Arguments:       None.
 // Return value:    None.
 
-    virtual void UpdateElements();
+    void UpdateElements();
 
 
 };
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global operator: Matrix Reader extraction
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A Reader extraction operator for filling a Matrix from a Reader.
+// Arguments:       A Reader reference as the left hand side operand.
+//                  A Matrix reference as the right hand side operand.
+// Return value:    A Reader reference for further use in an expression.
+
+Reader & operator>>(Reader &reader, Matrix &operand);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global operator: Matrix Writer insertion
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A Writer insertion operator for sending a Matrix to a Writer.
+// Arguments:       A Writer reference as the left hand side operand.
+//                  A Matrix reference as the right hand side operand.
+// Return value:    A Writer reference for further use in an expression.
+
+Writer & operator<<(Writer &writer, const Matrix &operand);
+
 } // namespace RTE
 
 #endif // File
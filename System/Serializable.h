@@ -271,6 +271,42 @@ private:
 
 };
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: ReadPlainObject
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Reads an object that is written like a Serializable but can't afford
+//                  to be one, like the plain-old-data math types, the same way that
+//                  Serializable::Create(Reader &) reads a Serializable.
+// Arguments:       A Reader lined up to the object.
+//                  The object to read into. Its type needs GetClassName and ReadProperty
+//                  methods like a Serializable's.
+//                  Whether there is a class name in the stream to check against to make
+//                  sure the correct type is being read from the stream.
+// Return value:    An error return value signaling sucess or any particular failure.
+//                  Anything below 0 is an error signal.
+
+template <class Type>
+int ReadPlainObject(Reader &reader, Type &object, bool checkType = true)
+{
+    if (checkType && reader.ReadPropValue() != object.GetClassName())
+    {
+        reader.ReportError("Wrong type in Reader when passed to ReadPlainObject()");
+        return -1;
+    }
+
+    while (reader.NextProperty())
+    {
+        string propName = reader.ReadPropName();
+        // Same as in Serializable::Create, an empty name may come out of an IncludeFile without any properties.
+        // ReadProperty reports anything it can't match through the reader itself
+        if (propName != "")
+            object.ReadProperty(propName, reader);
+    }
+
+    return 0;
+}
+
 } // namespace RTE
 
 #endif // File
\ No newline at end of file
@@ -18,11 +18,17 @@
 #endif
 #include "DDTTools.h"
 
+#include <type_traits>
+
 using namespace std;
 
 namespace RTE
 {
 
+#if !defined(__GNUC__) || defined(__clang__) || __GNUC__ >= 5
+static_assert(is_trivially_copyable<Vector>::value, "Vector has to stay plain old data to be memcpy'd and batched");
+#endif
+
 const string Vector::ClassName = "Vector";
 
 /*
@@ -109,12 +115,10 @@ int Vector::Create()
 */
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  ReadProperty
+// Method:          ReadProperty
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Reads a property value from a reader stream. If the name isn't
-//                  recognized by this class, then ReadProperty of the parent class
-//                  is called. If the property isn't recognized by any of the base classes,
-//                  false is returned, and the reader's position is untouched.
+//                  recognized by this class, the value is skipped and an error reported.
 
 int Vector::ReadProperty(std::string propName, Reader &reader)
 {
@@ -123,22 +127,26 @@ int Vector::ReadProperty(std::string propName, Reader &reader)
     else if (propName == "Y")
         reader >> m_Y;
     else
-        // See if the base class(es) can find a match instead
-        return Serializable::ReadProperty(propName, reader);
+    {
+        // Eat the value of the property which failed to read, like Serializable does
+        reader.ReadPropValue();
+        reader.ReportError("Could not match property");
+        return -1;
+    }
 
     return 0;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Save
+// Method:          Save
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Saves the complete state of this Vector with a Writer for
 //                  later recreation with Create(Reader &reader);
 
 int Vector::Save(Writer &writer) const
 {
-    Serializable::Save(writer);
+    writer.ObjectStart(ClassName);
 
     writer.NewProperty("X");
     writer << m_X;
@@ -193,23 +201,6 @@ int Vector::Save(ostream &stream) const
 }
 */
 
-//////////////////////////////////////////////////////////////////////////////////////////
-// Operator:        Vector assignment
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     An assignment operator for setting one Vector equal to another.
-
-Vector & Vector::operator=(const Vector &rhs)
-{
-    if (*this == rhs)
-        return *this;
-
-    m_X = rhs.m_X;
-    m_Y = rhs.m_Y;
-
-    return *this;
-}
-
-
 //////////////////////////////////////////////////////////////////////////////////////////
 // Operator:        Vector average assignment
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -771,4 +762,30 @@ void Vector::DegRotate(float angle)
     m_Y = tempY;
 }
 */
-} // namespace RTE
\ No newline at end of file
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global operator: Vector Reader extraction
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A Reader extraction operator for filling a Vector from a Reader.
+
+Reader & operator>>(Reader &reader, Vector &operand)
+{
+    operand.Create(reader);
+    return reader;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global operator: Vector Writer insertion
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A Writer insertion operator for sending a Vector to a Writer.
+
+Writer & operator<<(Writer &writer, const Vector &operand)
+{
+    operand.Save(writer);
+    writer.ObjectEnd();
+    return writer;
+}
+
+} // namespace RTE
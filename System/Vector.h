@@ -33,12 +33,15 @@ enum { X = 0, Y = 1 };
 //////////////////////////////////////////////////////////////////////////////////////////
 // Class:           Vector
 //////////////////////////////////////////////////////////////////////////////////////////
-// Description:     A useful 2D float vector.
-// Parent(s):       Serializable.
+// Description:     A useful 2D float vector. Plain old data without any virtual methods,
+//                  so it can be copied around as memory and packed into arrays for the
+//                  batch operations in VectorBatch.h. It is read and written like a
+//                  Serializable through the Reader and Writer operators below.
+// Parent(s):       None.
 // Class history:   02/22/2001  Vector created.
+//                  10/19/2026  Vector no longer a Serializable.
 
-class Vector:
-    public Serializable
+class Vector
 {
 
 
@@ -77,24 +80,6 @@ public:
     Vector(int inputX, int inputY);
 */
 
-//////////////////////////////////////////////////////////////////////////////////////////
-// Constructor:     Vector
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Copy constructor method used to instantiate a Vector object
-//                  identical to an already existing one.
-// Arguments:       A Vector object which is passed in by reference.
-
-    Vector(const Vector &reference) { /*Clear();*/ Create(reference.m_X, reference.m_Y); }
-
-
-//////////////////////////////////////////////////////////////////////////////////////////
-// Destructor:      ~Vector
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     Destructor method used to clean up a Vector object before deletion.
-// Arguments:       None.
-
-    virtual ~Vector() { /*Destroy(true);*/  }
-
 /*
 //////////////////////////////////////////////////////////////////////////////////////////
 // Virtual method:  Create
@@ -108,14 +93,14 @@ public:
 */
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Create
+// Method:          Create
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Makes the Vector object ready for use.
 // Arguments:       Two floats defining the initial X and Y values of this Vector.
 // Return value:    An error return value signaling sucess or any particular failure.
 //                  Anything below 0 is an error signal.
 
-    virtual int Create(float inputX, float inputY)
+    int Create(float inputX, float inputY)
     {
         m_X = inputX;
         m_Y = inputY;
@@ -136,23 +121,34 @@ public:
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  ReadProperty
+// Method:          Create
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Reads this Vector from a Reader, like Serializable::Create does.
+// Arguments:       A Reader that the Vector will create itself from.
+//                  Whether there is a class name in the stream to check against to make
+//                  sure the correct type is being read from the stream.
+// Return value:    An error return value signaling sucess or any particular failure.
+//                  Anything below 0 is an error signal.
+
+    int Create(Reader &reader, bool checkType = true) { return ReadPlainObject(reader, *this, checkType); }
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Method:          ReadProperty
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Reads a property value from a Reader stream. If the name isn't
-//                  recognized by this class, then ReadProperty of the parent class
-//                  is called. If the property isn't recognized by any of the base classes,
-//                  false is returned, and the Reader's position is untouched.
+//                  recognized by this class, the value is skipped and an error reported.
 // Arguments:       The name of the property to be read.
 //                  A Reader lined up to the value of the property to be read.
 // Return value:    An error return value signaling whether the property was successfully
 //                  read or not. 0 means it was read successfully, and any nonzero indicates
-//                  that a property of that name could not be found in this or base classes.
+//                  that a property of that name could not be found in this class.
 
-    virtual int ReadProperty(std::string propName, Reader &reader);
+    int ReadProperty(std::string propName, Reader &reader);
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  Save
+// Method:          Save
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Saves the complete state of this Vector to an output stream for
 //                  later recreation with Create(Reader &reader);
@@ -160,7 +156,7 @@ public:
 // Return value:    An error return value signaling sucess or any particular failure.
 //                  Anything below 0 is an error signal.
 
-    virtual int Save(Writer &writer) const;
+    int Save(Writer &writer) const;
 
 /*
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -198,16 +194,6 @@ public:
     virtual void Destroy() { Clear(); }
 */
 
-//////////////////////////////////////////////////////////////////////////////////////////
-// Operator:        Vector assignment
-//////////////////////////////////////////////////////////////////////////////////////////
-// Description:     An assignment operator for setting one Vector equal to another.
-// Arguments:       A Vector reference.
-// Return value:    A reference to the changed Vector.
-
-    Vector & operator=(const Vector &rhs);
-
-
 //////////////////////////////////////////////////////////////////////////////////////////
 // Operator:        Vector average assignment
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -457,13 +443,13 @@ public:
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Virtual method:  GetClassName
+// Method:          GetClassName
 //////////////////////////////////////////////////////////////////////////////////////////
 // Description:     Gets the class name of this Vector.
 // Arguments:       None.
 // Return value:    A string with the friendly-formatted type name of this Vector.
 
-    virtual const std::string & GetClassName() const { return ClassName; }
+    const std::string & GetClassName() const { return ClassName; }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -1004,6 +990,28 @@ private:
 
 };
 
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global operator: Vector Reader extraction
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A Reader extraction operator for filling a Vector from a Reader.
+// Arguments:       A Reader reference as the left hand side operand.
+//                  A Vector reference as the right hand side operand.
+// Return value:    A Reader reference for further use in an expression.
+
+Reader & operator>>(Reader &reader, Vector &operand);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global operator: Vector Writer insertion
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     A Writer insertion operator for sending a Vector to a Writer.
+// Arguments:       A Writer reference as the left hand side operand.
+//                  A Vector reference as the right hand side operand.
+// Return value:    A Writer reference for further use in an expression.
+
+Writer & operator<<(Writer &writer, const Vector &operand);
+
 } // namespace RTE
 
 #endif // File
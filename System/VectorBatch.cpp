@@ -0,0 +1,181 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+// File:            VectorBatch.cpp
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Source file for the Vector batch functions.
+// Project:         Retro Terrain Engine
+// Author(s):
+//
+//
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Inclusions of header files
+
+#include "VectorBatch.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define VECTORBATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace RTE
+{
+
+// The SSE2 paths load two Vector:s at a time straight out of the arrays
+static_assert(sizeof(Vector) == 2 * sizeof(float), "Vector arrays have to be tightly packed floats");
+
+#ifdef VECTORBATCH_SSE2
+// Rounds every lane down, which SSE2 has no single instruction for
+static inline __m128 FloorLanes(__m128 value)
+{
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(value));
+    // Truncation went up for the negative non-integers, so take those one back down
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, value), _mm_set1_ps(1.0f)));
+}
+
+// A mask of the lanes that belong to the axes that are turned on, for the interleaved X, Y, X, Y layout of a pair of Vector:s
+static inline __m128 AxisMask(bool onX, bool onY)
+{
+    __m128i mask = _mm_set_epi32(onY ? -1 : 0, onX ? -1 : 0, onY ? -1 : 0, onX ? -1 : 0);
+    return _mm_castsi128_ps(mask);
+}
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: RotateOffsets
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Rotates a number of offsets by a Matrix.
+
+void RotateOffsets(const Vector *pOffsets, Vector *pResults, int count, const Matrix &rotation, bool flipX)
+{
+    // Can't update the elements of a const Matrix, so work them out here if they're stale
+    float e00, e01, e10, e11;
+    if (rotation.m_ElementsUpdated)
+    {
+        e00 = rotation.m_Elements[0][0];
+        e01 = rotation.m_Elements[0][1];
+        e10 = rotation.m_Elements[1][0];
+        e11 = rotation.m_Elements[1][1];
+    }
+    else
+    {
+        // Inverse angle to make CCW positive direction, same as Matrix::UpdateElements
+        e00 = e11 = (float)cos(-rotation.m_Rotation);
+        e10 = (float)sin(-rotation.m_Rotation);
+        e01 = -e10;
+    }
+    // Mirroring first and then by the Matrix' own flip cancel out
+    float signX = (flipX != rotation.m_Flipped[X]) ? -1.0f : 1.0f;
+    float signY = rotation.m_Flipped[Y] ? -1.0f : 1.0f;
+
+    int i = 0;
+#ifdef VECTORBATCH_SSE2
+    const __m128 sign = _mm_setr_ps(signX, signY, signX, signY);
+    const __m128 diagonal = _mm_setr_ps(e00, e11, e00, e11);
+    const __m128 cross = _mm_setr_ps(e01, e10, e01, e10);
+    for (; i + 1 < count; i += 2)
+    {
+        __m128 offsets = _mm_mul_ps(_mm_loadu_ps(&pOffsets[i].m_X), sign);
+        __m128 swapped = _mm_shuffle_ps(offsets, offsets, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_ps(&pResults[i].m_X, _mm_add_ps(_mm_mul_ps(offsets, diagonal), _mm_mul_ps(swapped, cross)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        float offsetX = pOffsets[i].m_X * signX;
+        float offsetY = pOffsets[i].m_Y * signY;
+        pResults[i].SetXY(e00 * offsetX + e01 * offsetY, e10 * offsetX + e11 * offsetY);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: WrapPositions
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Wraps a number of positions that are outside an area back into it
+//                  on the axes that wrap.
+
+void WrapPositions(Vector *pPositions, int count, float width, float height, bool wrapX, bool wrapY)
+{
+    if (!wrapX && !wrapY)
+        return;
+
+    int i = 0;
+#ifdef VECTORBATCH_SSE2
+    const __m128 wraps = AxisMask(wrapX, wrapY);
+    const __m128 size = _mm_setr_ps(width, height, width, height);
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 1 < count; i += 2)
+    {
+        __m128 positions = _mm_loadu_ps(&pPositions[i].m_X);
+        __m128 outside = _mm_and_ps(wraps, _mm_or_ps(_mm_cmplt_ps(positions, zero), _mm_cmpge_ps(positions, size)));
+        // Only bother storing when something actually wrapped, which is seldom
+        if (_mm_movemask_ps(outside))
+        {
+            __m128 wrapped = _mm_sub_ps(positions, _mm_mul_ps(FloorLanes(_mm_div_ps(positions, size)), size));
+            _mm_storeu_ps(&pPositions[i].m_X, _mm_or_ps(_mm_and_ps(outside, wrapped), _mm_andnot_ps(outside, positions)));
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        if (wrapX && (pPositions[i].m_X < 0 || pPositions[i].m_X >= width))
+            pPositions[i].m_X -= floorf(pPositions[i].m_X / width) * width;
+        if (wrapY && (pPositions[i].m_Y < 0 || pPositions[i].m_Y >= height))
+            pPositions[i].m_Y -= floorf(pPositions[i].m_Y / height) * height;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: ShortestDistances
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Finds the shortest vectors from one point to each of a number of
+//                  others in an area that may wrap around.
+
+void ShortestDistances(const Vector &from, const Vector *pPoints, Vector *pResults, int count, float width, float height, bool wrapX, bool wrapY)
+{
+    float halfWidth = width / 2;
+    float halfHeight = height / 2;
+
+    int i = 0;
+#ifdef VECTORBATCH_SSE2
+    const __m128 wraps = AxisMask(wrapX, wrapY);
+    const __m128 origin = _mm_setr_ps(from.m_X, from.m_Y, from.m_X, from.m_Y);
+    const __m128 size = _mm_and_ps(wraps, _mm_setr_ps(width, height, width, height));
+    const __m128 half = _mm_setr_ps(halfWidth, halfHeight, halfWidth, halfHeight);
+    const __m128 negativeHalf = _mm_sub_ps(_mm_setzero_ps(), half);
+    for (; i + 1 < count; i += 2)
+    {
+        __m128 distances = _mm_sub_ps(_mm_loadu_ps(&pPoints[i].m_X), origin);
+        // Going the other way around is shorter past half the area; size is zero on the axes that don't wrap
+        distances = _mm_sub_ps(distances, _mm_and_ps(_mm_cmpgt_ps(distances, half), size));
+        distances = _mm_add_ps(distances, _mm_and_ps(_mm_cmplt_ps(distances, negativeHalf), size));
+        _mm_storeu_ps(&pResults[i].m_X, distances);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        Vector distance = pPoints[i] - from;
+        if (wrapX)
+        {
+            if (distance.m_X > halfWidth)
+                distance.m_X -= width;
+            else if (distance.m_X < -halfWidth)
+                distance.m_X += width;
+        }
+        if (wrapY)
+        {
+            if (distance.m_Y > halfHeight)
+                distance.m_Y -= height;
+            else if (distance.m_Y < -halfHeight)
+                distance.m_Y += height;
+        }
+        pResults[i] = distance;
+    }
+}
+
+} // namespace RTE
@@ -0,0 +1,73 @@
+#ifndef _RTEVECTORBATCH_
+#define _RTEVECTORBATCH_
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// File:            VectorBatch.h
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Header file for the functions that do the same thing to a whole array
+//                  of Vector:s at once. They use SSE2 where the compiler targets it, two
+//                  Vector:s per register, and give the same results as doing it one
+//                  Vector at a time with the usual operators.
+// Project:         Retro Terrain Engine
+// Author(s):
+//
+//
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Inclusions of header files
+
+#include "Vector.h"
+#include "Matrix.h"
+
+namespace RTE
+{
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: RotateOffsets
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Rotates a number of offsets by a Matrix, like doing
+//                  offset.GetXFlipped(flipX) * rotation for each of them.
+// Arguments:       The offsets to rotate.
+//                  Where to put the rotated offsets. May be the same array as the offsets.
+//                  How many offsets there are.
+//                  The Matrix to rotate them by.
+//                  Whether to mirror the offsets on the X axis before rotating them.
+// Return value:    None.
+
+void RotateOffsets(const Vector *pOffsets, Vector *pResults, int count, const Matrix &rotation, bool flipX = false);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: WrapPositions
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Wraps a number of positions that are outside an area back into it
+//                  on the axes that wrap, like SceneLayer::WrapPosition does.
+// Arguments:       The positions to wrap, in place.
+//                  How many positions there are.
+//                  The width and height of the area.
+//                  Whether the area wraps on the X and Y axes.
+// Return value:    None.
+
+void WrapPositions(Vector *pPositions, int count, float width, float height, bool wrapX, bool wrapY);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Global function: ShortestDistances
+//////////////////////////////////////////////////////////////////////////////////////////
+// Description:     Finds the shortest vectors from one point to each of a number of
+//                  others in an area that may wrap around, like SceneMan::ShortestDistance
+//                  does for positions that are already within bounds.
+// Arguments:       The point to measure from.
+//                  The points to measure to.
+//                  Where to put the vectors from the first point to each of the others.
+//                  How many points there are to measure to.
+//                  The width and height of the area.
+//                  Whether the area wraps on the X and Y axes.
+// Return value:    None.
+
+void ShortestDistances(const Vector &from, const Vector *pPoints, Vector *pResults, int count, float width, float height, bool wrapX, bool wrapY);
+
+} // namespace RTE
+
+#endif // File